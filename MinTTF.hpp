@@ -44,8 +44,21 @@
 #include <type_traits>
 
 #include <algorithm>
+#include <memory>
+
+#include <mutex>
+#include <atomic>
+#include <thread>
 
 #include <bit>
+#include <cmath>
+#include <numbers>
+#include <cstring>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+    #include <immintrin.h>
+#endif
 
 namespace MTTF
 {
@@ -163,6 +176,23 @@ namespace MTTF
     }
 
 
+    template <typename T>
+    using SharedPtr = std::shared_ptr<T>;
+
+    template <typename T, typename... TArgs>
+    auto MakeShared(TArgs&&... args) -> SharedPtr<T>
+    {
+        return std::make_shared<T>(Forward<TArgs>(args)...);
+    }
+
+
+    using Mutex = std::mutex;
+    using LockGuard = std::lock_guard<Mutex>;
+
+    template <typename T>
+    using Atomic = std::atomic<T>;
+
+
     template <typename T>
     auto ByteSwap(T x) -> T
     {
@@ -240,13 +270,13 @@ namespace MTTF
     }
 
     template <typename T>
-    auto Max(T a, T b) -> T
+    constexpr auto Max(T a, T b) -> T
     {
         return std::max(a, b);
     }
 
     template <typename T>
-    auto Min(T a, T b) -> T
+    constexpr auto Min(T a, T b) -> T
     {
         return std::min(a, b);
     }
@@ -311,6 +341,13 @@ namespace MTTF
         UnsupportedLocaTableVersion,
         UnsupportedHheaTableVersion,
         UnsupportedLocaTableIndex,
+        InvalidFaceIndex,
+        // Only reported when loading with LoadOptions::validate.
+        InvalidTableDirectory,
+        InvalidTableLength,
+        InvalidCmapTable,
+        InvalidLocaTable,
+        InvalidGlyphData,
     };
 
     struct OffsetTable
@@ -336,6 +373,7 @@ namespace MTTF
         OpenType10,
         OpenTypeCCF,
         OldPostScript,
+        Collection,
         Unsupported,
     };
 
@@ -382,1498 +420,9630 @@ namespace MTTF
         }
     };
 
-    using TTFCurve = Variant<QuadraticBezierCurve, Line>;
-
-    struct GlyphData
+    // Only produced by CFF outlines.
+    struct CubicBezierCurve
     {
-        Array<TTFCurve> components;
-        Line boundingBoxDiagonal;
+        TTFPoint startPoint;
+        TTFPoint controlPoint0;
+        TTFPoint controlPoint1;
+        TTFPoint endPoint;
+
+        CubicBezierCurve() {}
+        CubicBezierCurve(TTFPoint s, TTFPoint c0, TTFPoint c1, TTFPoint e)
+            : startPoint(s), controlPoint0(c0), controlPoint1(c1), endPoint(e)
+        {
+
+        }
     };
 
-    // The contents of the .ttf file;
-    class FontData
+    using TTFCurve = Variant<QuadraticBezierCurve, Line, CubicBezierCurve>;
+
+    // Array that keeps up to INLINE_CAPACITY elements inside the object itself and only moves to
+    // the heap when it grows beyond that. The heap pointer shares the bytes of the inline storage
+    // so the array costs nothing more than the inline elements and two counters. Once on the heap
+    // the storage is kept when clearing so the array can be reused without allocating.
+    template <typename T, U32 INLINE_CAPACITY>
+    class SmallArray
     {
-        Span<const U8> data;
+        static_assert(std::is_trivially_copyable_v<T>);
 
-        U32 tableCount;
-        Location headTable;
-        Location locaTable;
-        Location hheaTable;
-        Location cmapTable;
-        Location maxpTable;
-        Location glyfTable;
-        Location hmtxTable;
-        Location kernTable;
-        Location nameTable;
-        Location cffTable;
+        static constexpr U64 STORAGE_SIZE = Max(sizeof(T) * INLINE_CAPACITY, sizeof(T*));
 
-        U32 indexMapOffset;
-        U32 charEncodingFormat;
-        B longLocaIndex;
+        alignas(Max(alignof(T), alignof(T*))) Byte storage[STORAGE_SIZE];
+        U32 count = 0;
+        U32 capacity = INLINE_CAPACITY;
 
-    public:
-        U16 unitsPerEm;
-        // The bounding box
-        I16 xMin;
-        I16 yMin;
-        I16 xMax;
-        I16 yMax;
+        auto IsOnHeap() const -> B
+        {
+            return capacity > INLINE_CAPACITY;
+        }
 
-        U16 numberOfLongHorizontalMetrics;
-        I16 ascent;
-        I16 descent;
-        I16 lineGap;
-        U16 advanceWidthMax;
+        auto GetHeapPointer() const -> T*
+        {
+            T* pointer;
+            std::memcpy(&pointer, storage, sizeof(T*));
+            return pointer;
+        }
 
-        auto Load(Span<const Byte>) -> Error;
-        auto GetCharIndex(I32 codepoint) const -> U32;
-        auto FetchGlyphDataForCodepoint(I32 codepoint) const -> GlyphData;
-    private:
+        auto ReleaseHeap() -> V
+        {
+            if (IsOnHeap())
+            {
+                delete[] GetHeapPointer();
+                capacity = INLINE_CAPACITY;
+            }
+        }
 
-        auto CheckFontVersion(U32 v) const -> FontVersion;
-        auto ParseContents() -> Error;
-        auto ParseTtOutlinesFont() -> Error;
-        auto ParseCffOutlinesFont()->Error;
-        auto FindTable(U32 tag) -> Location;
-        auto ParseTtfContainedFont() -> Error;
-        auto FetchGlobalInfoFromHead() -> Error;
-        auto FetchGlobalInfoFromHhea() -> Error;
-        auto GetIdxDataTableFromCmap() -> Error;
+        // Moves the elements to a heap block of exactly newCapacity elements or inside the object
+        // when they fit.
+        auto Reallocate(U32 newCapacity) -> V
+        {
+            if (newCapacity <= INLINE_CAPACITY)
+            {
+                if (IsOnHeap())
+                {
+                    auto heapPointer = GetHeapPointer();
+                    std::copy(heapPointer, heapPointer + count, (T*)storage);
+                    delete[] heapPointer;
+                    capacity = INLINE_CAPACITY;
+                }
 
+                return;
+            }
 
-        auto GetCharIndexFmt4(U32 codepoint) const -> U32;
-        auto GetCharIndexFmt6(U32 codepoint) const -> U32;
-        auto GetCharIndexFmt12(U32 codepoint) const -> U32;
-        auto GetGlyphOffset(U32 glyphIndex) const -> U32;
-        auto FetchGlyphData(U32 glyphIndex) const -> GlyphData;
-        auto LoadContour
-        (
-            GlyphData& data,
-            Span<const TTFPoint> vertices,
-            Span<const U8> flags,
-            U64 sidx,
-            U64 eidx
-        ) const -> U64;
-    };
+            auto newStorage = new T[newCapacity];
+            std::copy(begin(), end(), newStorage);
+            ReleaseHeap();
+            std::memcpy(storage, &newStorage, sizeof(T*));
+            capacity = newCapacity;
+        }
 
+    public:
+        SmallArray() = default;
 
-    // These should work on little endian machine hence we need to
-    // use conversion in order to abstract endianess.
-    constexpr U32 CFF_TAG_LE = 0x20464643;
-    constexpr U32 GLYF_TAG_LE = 0x66796C67;
-    constexpr U32 NAME_TAG_LE = 0x656D616E;
-    constexpr U32 LOCA_TAG_LE = 0x61636F6C;
-    constexpr U32 MAXP_TAG_LE = 0x7078616D;
-    constexpr U32 CMAP_TAG_LE = 0x70616D63;
-    constexpr U32 HEAD_TAG_LE = 0x64616568;
-    constexpr U32 HHEA_TAG_LE = 0x61656868;
-    constexpr U32 HMTX_TAG_LE = 0x78746D68;
+        SmallArray(const SmallArray& other)
+        {
+            *this = other;
+        }
 
-    constexpr U16 PLATFORM_ID_UNICODE = 0;
-    constexpr U16 PLATFORM_ID_MICROSOFT = 3;
+        SmallArray(SmallArray&& other) noexcept
+        {
+            *this = std::move(other);
+        }
 
-    constexpr U16 PLATFORM_SPECIFIC_ID_MS_UCS2 = 1;
-    constexpr U16 PLATFORM_SPECIFIC_ID_MS_UCS4 = 10;
+        ~SmallArray()
+        {
+            ReleaseHeap();
+        }
 
-    struct GrayScaleSurface
-    {
-        Array<Byte> data;
-        U32 width;
-        U32 height;
-    };
+        auto operator=(const SmallArray& other) -> SmallArray&
+        {
+            if (this != &other)
+            {
+                clear();
+                reserve(other.count);
+                std::copy(other.begin(), other.end(), data());
+                count = other.count;
+            }
 
-    auto RasterizeGlyph(const FontData& fontData, I32 codepoint, I32 height) -> GrayScaleSurface;
-}
+            return *this;
+        }
 
-#ifdef MIN_TTF_IMPLEMENTATION
+        auto operator=(SmallArray&& other) noexcept -> SmallArray&
+        {
+            if (this == &other)
+            {
+                return *this;
+            }
 
-namespace MTTF
-{
-    auto FontData::LoadContour(GlyphData& data, Span<const TTFPoint> vertices, Span<const U8> flags, U64 sidx, U64 eidx) const -> U64
-    {
-        auto cidx = sidx;
+            // Either the inline elements or the heap pointer are carried over with the bytes.
+            ReleaseHeap();
+            std::memcpy(storage, other.storage, STORAGE_SIZE);
+            count = other.count;
+            capacity = other.capacity;
+            other.count = 0;
+            other.capacity = INLINE_CAPACITY;
+            return *this;
+        }
 
-        if ((flags[cidx] & 1u) == 0)
-            // The first point is control point
+        auto reserve(U64 newCapacity) -> V
         {
-            auto curve = QuadraticBezierCurve();
-
-            if ((flags[eidx] & 1u) == 0)
+            if (newCapacity > capacity)
             {
-                curve.startPoint.x = ((I32(vertices[cidx].x) + I32(vertices[eidx].x)) / 2);
-                curve.startPoint.y = ((I32(vertices[cidx].y) + I32(vertices[eidx].y)) / 2);
+                Reallocate(U32(newCapacity));
             }
-            else
+        }
+
+        auto push_back(const T& element) -> V
+        {
+            if (count == capacity)
             {
-                curve.startPoint = vertices[eidx];
+                Reallocate(capacity * 2);
             }
 
-            curve.controlPoint = vertices[cidx];
-            // No bound checking at this level.
-            cidx += 1;
+            data()[count++] = element;
+        }
 
-            if ((flags[cidx] & 1u) == 0)
+        auto resize(U64 newCount) -> V
+        {
+            reserve(newCount);
+            count = U32(newCount);
+        }
+
+        auto clear() -> V
+        {
+            count = 0;
+        }
+
+        // Moves the elements back inside the object or into an exactly sized heap block. Useful
+        // for arrays that are going to be stored for a long time.
+        auto shrink_to_fit() -> V
+        {
+            if (IsOnHeap() && count != capacity)
             {
-                curve.endPoint.x = ((I32(curve.controlPoint.x) + I32(vertices[cidx].x)) / 2);
-                curve.endPoint.y = ((I32(curve.controlPoint.y) + I32(vertices[cidx].y)) / 2);
+                Reallocate(count);
             }
-            else
+        }
+
+        // Heap memory owned by the array. The inline storage is part of the object size.
+        auto GetHeapMemoryUsage() const -> U64
+        {
+            return IsOnHeap() ? capacity * sizeof(T) : 0;
+        }
+
+        auto size() const -> U64 { return count; }
+        auto empty() const -> B { return count == 0; }
+        auto data() -> T* { return IsOnHeap() ? GetHeapPointer() : (T*)storage; }
+        auto data() const -> const T* { return IsOnHeap() ? GetHeapPointer() : (const T*)storage; }
+        auto begin() -> T* { return data(); }
+        auto begin() const -> const T* { return data(); }
+        auto end() -> T* { return data() + count; }
+        auto end() const -> const T* { return data() + count; }
+        auto back() -> T& { return data()[count - 1]; }
+        auto back() const -> const T& { return data()[count - 1]; }
+        auto operator[](U64 i) -> T& { return data()[i]; }
+        auto operator[](U64 i) const -> const T& { return data()[i]; }
+    };
+
+    enum class OutlineCommand : U8
+    {
+        // Starts a new contour at the next point.
+        MoveTo,
+        // Line from the current point to the next point.
+        LineTo,
+        // Quadratic Bezier curve with the next two points as control and end point.
+        QuadTo,
+        // Cubic Bezier curve with the next three points as control points and end point.
+        CubicTo,
+    };
+
+    // Packed outline representation. The points of consecutive segments are shared so each
+    // segment only stores what it adds to the current point, together with a one byte command.
+    // Small outlines are stored entirely inside the object.
+    class Outline
+    {
+    public:
+        static constexpr U32 INLINE_POINTS = 8;
+        static constexpr U32 INLINE_COMMANDS = 8;
+        static constexpr U32 INLINE_CONTOURS = 2;
+
+        SmallArray<TTFPoint, INLINE_POINTS> points;
+        SmallArray<OutlineCommand, INLINE_COMMANDS> commands;
+        // One past the index of the last command of each contour.
+        SmallArray<U32, INLINE_CONTOURS> contourEnds;
+
+        auto Clear() -> V
+        {
+            points.clear();
+            commands.clear();
+            contourEnds.clear();
+            contourOpen = false;
+        }
+
+        auto BeginContour() -> V
+        {
+            EndContour();
+            contourOpen = true;
+            needsMoveTo = true;
+        }
+
+        auto EndContour() -> V
+        {
+            if (contourOpen && !needsMoveTo)
             {
-                curve.endPoint = vertices[cidx];
+                contourEnds.push_back(U32(commands.size()));
             }
 
-            data.components.emplace_back(curve);
+            contourOpen = false;
         }
 
-        while (cidx < eidx)
+        auto AddLine(TTFPoint startPoint, TTFPoint endPoint) -> V
         {
-            // At least the first point has been added already so we can safely check the
-            // previous point.
+            MoveToIfNeeded(startPoint);
+            commands.push_back(OutlineCommand::LineTo);
+            points.push_back(endPoint);
+        }
 
-            if ((flags[cidx] & 1u) == 0)
-            {
-                // The previous point must be a control point because else we would've
-                // parsed the whole curve in the previous iteration
-                auto startPoint =
-                    TTFPoint
-                    (
-                        ((I32(vertices[cidx - 1].x) + I32(vertices[cidx].x)) / 2),
-                        ((I32(vertices[cidx - 1].y) + I32(vertices[cidx].y)) / 2)
-                    );
+        auto AddQuadraticBezierCurve(TTFPoint startPoint, TTFPoint controlPoint, TTFPoint endPoint) -> V
+        {
+            MoveToIfNeeded(startPoint);
+            commands.push_back(OutlineCommand::QuadTo);
+            points.push_back(controlPoint);
+            points.push_back(endPoint);
+        }
 
-                if ((flags[cidx + 1] & 1u) == 0)
+        auto AddCubicBezierCurve(TTFPoint startPoint, TTFPoint controlPoint0, TTFPoint controlPoint1, TTFPoint endPoint) -> V
+        {
+            MoveToIfNeeded(startPoint);
+            commands.push_back(OutlineCommand::CubicTo);
+            points.push_back(controlPoint0);
+            points.push_back(controlPoint1);
+            points.push_back(endPoint);
+        }
+
+        auto GetSegmentCount() const -> U64
+        {
+            return commands.size() - contourEnds.size();
+        }
+
+        auto ShrinkToFit() -> V
+        {
+            points.shrink_to_fit();
+            commands.shrink_to_fit();
+            contourEnds.shrink_to_fit();
+        }
+
+        auto GetMemoryUsage() const -> U64
+        {
+            return
+                sizeof(Outline) +
+                points.GetHeapMemoryUsage() +
+                commands.GetHeapMemoryUsage() +
+                contourEnds.GetHeapMemoryUsage();
+        }
+
+        // Calls visitor with a Line or a QuadraticBezierCurve for every segment. This is the
+        // adapter for code written against the TTFCurve representation.
+        template <typename TVisitor>
+        auto ForEachSegment(TVisitor&& visitor) const -> V
+        {
+            TTFPoint currentPoint(0, 0);
+            auto pointIdx = 0u;
+
+            for (auto command : commands)
+            {
+                switch (command)
                 {
-                    auto endPoint =
-                        TTFPoint
+                    case OutlineCommand::MoveTo:
+                        currentPoint = points[pointIdx];
+                        pointIdx += 1;
+                        break;
+                    case OutlineCommand::LineTo:
+                        visitor(Line(currentPoint, points[pointIdx]));
+                        currentPoint = points[pointIdx];
+                        pointIdx += 1;
+                        break;
+                    case OutlineCommand::QuadTo:
+                        visitor(QuadraticBezierCurve(currentPoint, points[pointIdx], points[pointIdx + 1]));
+                        currentPoint = points[pointIdx + 1];
+                        pointIdx += 2;
+                        break;
+                    case OutlineCommand::CubicTo:
+                        visitor
                         (
-                            ((I32(vertices[cidx].x) + I32(vertices[cidx + 1].x)) / 2),
-                            ((I32(vertices[cidx].y) + I32(vertices[cidx + 1].y)) / 2)
+                            CubicBezierCurve(currentPoint, points[pointIdx], points[pointIdx + 1], points[pointIdx + 2])
                         );
-
-                    auto curve = QuadraticBezierCurve(startPoint, vertices[cidx], endPoint);
-                    data.components.emplace_back(curve);
-                }
-                else
-                {
-                    auto curve =
-                        QuadraticBezierCurve(startPoint, vertices[cidx], vertices[cidx + 1]);
-                    data.components.emplace_back(curve);
+                        currentPoint = points[pointIdx + 2];
+                        pointIdx += 3;
+                        break;
                 }
             }
-            else
+        }
+
+        // The bounding box of the outline itself. Curves add their extrema rather than their
+        // control points.
+        auto GetBoundingBox() const -> Line
+        {
+            if (points.empty())
             {
-                if ((flags[cidx + 1] & 1u) == 0)
+                return Line(TTFPoint(0, 0), TTFPoint(0, 0));
+            }
+
+            F64 minX = points[0].x;
+            F64 minY = points[0].y;
+            F64 maxX = minX;
+            F64 maxY = minY;
+
+            auto addPoint = [&](F64 x, F64 y)
+            {
+                minX = Min(minX, x);
+                minY = Min(minY, y);
+                maxX = Max(maxX, x);
+                maxY = Max(maxY, y);
+            };
+
+            // Adds the points of the curve given by the polynomial c0 + c1 t + c2 t^2 + c3 t^3
+            // where its derivative is zero inside (0, 1).
+            auto addExtrema = [&](const StaticArray<F64, 4>& cx, const StaticArray<F64, 4>& cy)
+            {
+                auto evaluate = [](const StaticArray<F64, 4>& c, F64 t)
                 {
-                    TTFPoint endPoint;
+                    return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+                };
 
-                    if (cidx + 1 == eidx)
-                    {
-                        if ((flags[sidx] & 1u) == 0)
-                        {
-                            endPoint.x = ((I32(vertices[sidx].x) + I32(vertices[eidx].x)) / 2);
-                            endPoint.y = ((I32(vertices[sidx].y) + I32(vertices[eidx].y)) / 2);
-                        }
-                        else
-                        {
-                            endPoint = vertices[sidx];
-                        }
+                for (auto& c : { cx, cy })
+                {
+                    auto a = 3.0 * c[3];
+                    auto b = 2.0 * c[2];
+                    StaticArray<F64, 2> roots = { -1.0, -1.0 };
 
-                        auto curve = QuadraticBezierCurve(vertices[cidx], vertices[cidx + 1], endPoint);
-                        data.components.emplace_back(curve);
+                    if (a == 0.0)
+                    {
+                        roots[0] = b != 0.0 ? -c[1] / b : -1.0;
                     }
-                    else
+                    else if (auto discriminant = b * b - 4.0 * a * c[1]; discriminant >= 0.0)
                     {
-                        // The next index is not the last so we can use at least one more point.
-                        if ((flags[cidx + 2] & 1u) == 0)
+                        roots[0] = (-b + Sqrt(discriminant)) / (2.0 * a);
+                        roots[1] = (-b - Sqrt(discriminant)) / (2.0 * a);
+                    }
+
+                    for (auto t : roots)
+                    {
+                        if (t > 0.0 && t < 1.0)
                         {
-                            endPoint.x = ((I32(vertices[cidx + 1].x) + I32(vertices[cidx + 2].x)) / 2);
-                            endPoint.y = ((I32(vertices[cidx + 1].y) + I32(vertices[cidx + 2].y)) / 2);
-                        }
-                        else
-                        {
-                            endPoint = vertices[cidx + 2];
+                            addPoint(evaluate(cx, t), evaluate(cy, t));
                         }
-
-                        auto curve = QuadraticBezierCurve(vertices[cidx], vertices[cidx + 1], endPoint);
-                        data.components.emplace_back(curve);
                     }
-
-                    // We used one more point here.
-                    cidx += 1;
                 }
-                else
+            };
+
+            ForEachSegment
+            (
+                [&](const auto& segment)
                 {
-                    data.components.emplace_back(Line(vertices[cidx], vertices[cidx + 1]));
+                    using TSegment = std::decay_t<decltype(segment)>;
+
+                    auto s = segment.startPoint;
+                    auto e = segment.endPoint;
+                    addPoint(s.x, s.y);
+                    addPoint(e.x, e.y);
+
+                    if constexpr (std::is_same_v<TSegment, QuadraticBezierCurve>)
+                    {
+                        auto c = segment.controlPoint;
+                        addExtrema
+                        (
+                            { F64(s.x), 2.0 * (c.x - s.x), F64(s.x - 2 * c.x + e.x), 0.0 },
+                            { F64(s.y), 2.0 * (c.y - s.y), F64(s.y - 2 * c.y + e.y), 0.0 }
+                        );
+                    }
+                    else if constexpr (std::is_same_v<TSegment, CubicBezierCurve>)
+                    {
+                        auto c0 = segment.controlPoint0;
+                        auto c1 = segment.controlPoint1;
+                        addExtrema
+                        (
+                            {
+                                F64(s.x),
+                                3.0 * (c0.x - s.x),
+                                3.0 * (s.x - 2 * c0.x + c1.x),
+                                F64(e.x - s.x + 3 * (c0.x - c1.x))
+                            },
+                            {
+                                F64(s.y),
+                                3.0 * (c0.y - s.y),
+                                3.0 * (s.y - 2 * c0.y + c1.y),
+                                F64(e.y - s.y + 3 * (c0.y - c1.y))
+                            }
+                        );
+                    }
                 }
-            }
+            );
 
-            cidx += 1;
+            return Line
+            (
+                TTFPoint(TTFScalar(Floor(minX)), TTFScalar(Floor(minY))),
+                TTFPoint(TTFScalar(Ceil(maxX)), TTFScalar(Ceil(maxY)))
+            );
         }
 
-        if (cidx == eidx)
+        auto ToCurves() const -> Array<TTFCurve>
         {
-            if ((flags[eidx] & 1u) == 0)
-            {
-                // The previous point must be a control point because else we would've
-                // parsed the whole curve before this part of the code
-                auto startPoint =
-                    TTFPoint
-                    (
-                        ((I32(vertices[eidx - 1].x) + I32(vertices[eidx].x)) / 2),
-                        ((I32(vertices[eidx - 1].y) + I32(vertices[eidx].y)) / 2)
-                    );
-
-                TTFPoint endPoint;
+            Array<TTFCurve> curves;
+            curves.reserve(GetSegmentCount());
+            ForEachSegment([&](const auto& segment) { curves.emplace_back(segment); });
+            return curves;
+        }
 
-                if ((flags[sidx] & 1u) == 0)
-                {
-                    endPoint.x = ((I32(vertices[sidx].x) + I32(vertices[eidx].x)) / 2);
-                    endPoint.y = ((I32(vertices[sidx].y) + I32(vertices[eidx].y)) / 2);
-                }
-                else
-                {
-                    endPoint = vertices[sidx];
-                }
+    private:
+        B contourOpen = false;
+        B needsMoveTo = false;
 
-                auto curve = QuadraticBezierCurve(startPoint, vertices[eidx], endPoint);
-                data.components.emplace_back(QuadraticBezierCurve(curve));
+        auto MoveToIfNeeded(TTFPoint startPoint) -> V
+        {
+            if (!contourOpen)
+            {
+                BeginContour();
             }
-            else
+
+            if (needsMoveTo)
             {
-                // If the start was control point we have already pushed this curve in the
-                // beginning.
-                if ((flags[sidx] & 1u) > 0)
-                {
-                    data.components.emplace_back(Line(vertices[eidx], vertices[sidx]));
-                }
+                commands.push_back(OutlineCommand::MoveTo);
+                points.push_back(startPoint);
+                needsMoveTo = false;
             }
         }
+    };
 
-        return eidx + 1;
-    }
-
-
-    auto FontData::Load(Span<const U8> data) -> Error
+    struct GlyphData
     {
-        this->data = data;
-        return ParseContents();
-    }
-
+        Outline outline;
+        Line boundingBoxDiagonal;
+    };
 
-    auto FontData::GetCharIndex(I32 codepoint) const -> U32
+    // Temporary arrays used while decoding glyphs. Keep one per thread and pass it to every
+    // FetchGlyphData call in order to avoid allocating them for each glyph.
+    struct GlyphDecodeScratch
     {
-        switch (charEncodingFormat)
-        {
-            case 4:
-                return GetCharIndexFmt4(codepoint);
-            case 6:
-                return GetCharIndexFmt6(codepoint);
-            case 12:
-                GetCharIndexFmt12(codepoint);
-            // This is impossible since we already checked for those formats
-            default:
-                return 0;
-        }
-    }
-
+        Array<U32> endPointsOfContours;
+        Array<U8> flags;
+        Array<TTFPoint> vertices;
+    };
 
-    auto FontData::FetchGlyphDataForCodepoint(I32 codepoint) const -> GlyphData
+    struct GlyfHeader
     {
-        return FetchGlyphData(GetCharIndex(codepoint));
-    }
+        I16 numberOfContours;
+        I16 xMin;
+        I16 yMin;
+        I16 xMax;
+        I16 yMax;
+    };
 
+    constexpr U8 GLYPH_FLAG_ON_CURVE = 0x01;
+    constexpr U8 GLYPH_FLAG_X_SHORT_VECTOR = 0x02;
+    constexpr U8 GLYPH_FLAG_Y_SHORT_VECTOR = 0x04;
+    constexpr U8 GLYPH_FLAG_REPEAT = 0x08;
+    constexpr U8 GLYPH_FLAG_X_SAME_OR_POSITIVE = 0x10;
+    constexpr U8 GLYPH_FLAG_Y_SAME_OR_POSITIVE = 0x20;
+
+    // The steps of decoding a simple glyph. data starts at the encoded flags or coordinates and
+    // is the memory that can be read, not the length of the encoding. Both return the number of
+    // bytes consumed. The vectorized versions are bit exact with the scalar ones which handle
+    // their tails and are kept as reference. axis is 0 for x and 1 for y.
+    auto ExpandGlyphFlags(Span<const U8> data, Span<U8> flags) -> U32;
+    auto ExpandGlyphFlagsScalar(Span<const U8> data, Span<U8> flags) -> U32;
+    auto DecodeGlyphCoordinates(Span<const U8> data, Span<const U8> flags, U32 axis, Span<TTFPoint> points) -> U32;
+    auto DecodeGlyphCoordinatesScalar(Span<const U8> data, Span<const U8> flags, U32 axis, Span<TTFPoint> points) -> U32;
+
+    constexpr U16 COMPONENT_ARG_1_AND_2_ARE_WORDS = 0x0001;
+    constexpr U16 COMPONENT_ARGS_ARE_XY_VALUES = 0x0002;
+    constexpr U16 COMPONENT_ROUND_XY_TO_GRID = 0x0004;
+    constexpr U16 COMPONENT_WE_HAVE_A_SCALE = 0x0008;
+    constexpr U16 COMPONENT_MORE_COMPONENTS = 0x0020;
+    constexpr U16 COMPONENT_WE_HAVE_AN_X_AND_Y_SCALE = 0x0040;
+    constexpr U16 COMPONENT_WE_HAVE_A_TWO_BY_TWO = 0x0080;
+    constexpr U16 COMPONENT_WE_HAVE_INSTRUCTIONS = 0x0100;
+    constexpr U16 COMPONENT_USE_MY_METRICS = 0x0200;
+    constexpr U16 COMPONENT_SCALED_COMPONENT_OFFSET = 0x0800;
+    constexpr U16 COMPONENT_UNSCALED_COMPONENT_OFFSET = 0x1000;
+
+    // Compound glyphs referencing themselves (directly or not) would recurse forever otherwise.
+    constexpr U32 MAX_COMPONENT_DEPTH = 8;
+
+    // One component of a compound glyph. The transform maps (x, y) to
+    // (xScale * x + scale10 * y, scale01 * x + yScale * y).
+    struct ComponentRecord
+    {
+        U16 flags;
+        U16 glyphIndex;
+        // Either offsets or point numbers depending on COMPONENT_ARGS_ARE_XY_VALUES.
+        I32 argument1;
+        I32 argument2;
+        F32 xScale = 1.f;
+        F32 scale01 = 0.f;
+        F32 scale10 = 0.f;
+        F32 yScale = 1.f;
+    };
 
-    inline auto FontData::CheckFontVersion(U32 v) const -> FontVersion
+    // Decoded points of all the glyphs used as components of compound glyphs, so that composing
+    // e.g. accented letters only needs to copy and transform them instead of parsing glyf again.
+    struct ComponentOutlineCache
     {
-        if (v == FromLE(0x00000100u))
-        {
-            return FontVersion::OpenType10;
-        }
-        else if (v == FromLE(0x65757274u))
-        {
-            return FontVersion::AppleTTF;
-        }
-        else if (v == 0x4F54544F)
-        {
-            return FontVersion::OpenTypeCCF;
-        }
-        else if (v == 0x31707974)
-        {
-            return FontVersion::OldPostScript;
-        }
-        else
+        struct Entry
         {
-            return FontVersion::Unsupported;
-        }
-    }
+            U32 firstPoint;
+            U32 pointCount;
+            U32 firstContour;
+            U32 contourCount;
+        };
+
+        Map<U32, Entry> entries;
+        Array<TTFPoint> vertices;
+        Array<U8> flags;
+        // Relative to the first point of the entry.
+        Array<U16> endPointsOfContours;
 
+        // Appends the points of the glyph to the scratch. Returns false if it isn't cached.
+        auto CopyTo(U32 glyphIndex, GlyphDecodeScratch& scratch) const -> B;
+        auto GetMemoryUsage() const -> U64;
+    };
 
-    auto FontData::ParseContents() -> Error
+    // Location of the objects of a CFF INDEX. The offsets of the objects are 1 based i.e. relative
+    // to the byte before dataOffset.
+    struct CffIndex
     {
-        auto offsetTable = (OffsetTable*)data.data();
+        U32 count = 0;
+        U32 offSize = 0;
+        U32 offsetsOffset = 0;
+        U32 dataOffset = 0;
+    };
 
-        auto version = CheckFontVersion(offsetTable->version);
+    // Everything needed to run the charstrings of a CFF or CFF2 table.
+    struct CffFont
+    {
+        B isCff2 = false;
+        CffIndex charStrings;
+        CffIndex globalSubrs;
+        // Local subroutines and the default variation data index of every font dict. Fonts that
+        // are not CID keyed have a single one.
+        Array<CffIndex> localSubrs;
+        Array<U16> variationDataIndices;
+        // Font dict of every glyph. Empty when there is a single font dict.
+        Array<U16> glyphFontDicts;
+        // Number of variation regions of every item variation data in the CFF2 variation store.
+        // Needed to drop the deltas of the blend operator since only the default instance is
+        // rendered.
+        Array<U16> regionCounts;
+    };
 
-        tableCount = FromBE(offsetTable->numTables);
+    // The operand stack of CFF2 charstrings is 513 entries deep, CFF allows only 48.
+    constexpr U32 CFF_MAX_STACK_SIZE = 513;
+    constexpr U32 CFF_MAX_SUBR_DEPTH = 10;
+    // Two byte operators are stored as 0x0C00 | the second byte.
+    constexpr U32 CFF_TOKEN_OPERAND = 0xFFFF;
+    constexpr U32 CFF_TOKEN_RESUME = 0xFFFE;
 
-        switch (version)
+    struct CffToken
+    {
+        // Charstring operator, CFF_TOKEN_OPERAND or CFF_TOKEN_RESUME.
+        U32 op;
+        union
         {
-            case FontVersion::OpenType10:
-            case FontVersion::AppleTTF:
-                return ParseTtOutlinesFont();
-            case FontVersion::OpenTypeCCF:
-                return ParseCffOutlinesFont();
-            default:
-                return Error::UnsupportedFormat;
-        }
+            F32 value;
+            // Where to continue interpreting the charstring bytes for CFF_TOKEN_RESUME.
+            U32 byteOffset;
+        };
+    };
 
-        return Error::Success;
-    }
+    // Subroutines decoded into token streams so that the ones shared by many glyphs are not
+    // tokenized again on every call. Decoding a subroutine stops at the first hintmask or
+    // cntrmask because the number of mask bytes depends on the stems declared by the caller, the
+    // rest of it is interpreted from the charstring bytes.
+    struct CffSubroutineCache
+    {
+        Array<CffToken> tokens;
+        // First token of every global subroutine followed by the local ones of every font dict
+        // and one past the last token.
+        Array<U32> firstTokens;
+        // Index in firstTokens of the first local subroutine of every font dict.
+        Array<U32> firstLocalSubrs;
+
+        auto GetMemoryUsage() const -> U64;
+    };
 
 
-    auto FontData::ParseTtOutlinesFont() -> Error
+    // Native two-level page table holding the whole codepoint to glyph index mapping. The directory
+    // is indexed by the high bits of the codepoint and points to pages of 256 glyph indices. Page
+    // zero is shared by all blocks that contain no mapped codepoints.
+    struct CompiledCmap
     {
-        auto status = ParseTtfContainedFont();
+        static constexpr U32 PAGE_BITS = 8;
+        static constexpr U32 PAGE_SIZE = 1u << PAGE_BITS;
+        static constexpr U32 PAGE_MASK = PAGE_SIZE - 1;
+        static constexpr U32 MAX_CODEPOINT = 0x10FFFF;
 
-        if (status != Error::Success)
+        Array<U16> directory;
+        Array<U16> pages;
+
+        auto Lookup(U32 codepoint) const -> U32
         {
-            return status;
-        }
+            auto block = codepoint >> PAGE_BITS;
 
-        glyfTable = FindTable(FromLE(GLYF_TAG_LE));
-        locaTable = FindTable(FromLE(LOCA_TAG_LE));
+            // Codepoints above the last mapped block (including negative ones cast to U32) fall
+            // here.
+            if (block >= directory.size())
+            {
+                return 0;
+            }
 
-        if (glyfTable.offset == 0)
-        {
-            return Error::NoGlyfTable;
+            return pages[(U32(directory[block]) << PAGE_BITS) | (codepoint & PAGE_MASK)];
         }
 
-        if (locaTable.offset == 0)
+        auto IsEmpty() const -> B
         {
-            return Error::NoLocaTable;
+            return directory.empty();
         }
 
-        return Error::Success;
-    }
+        // Number of bytes occupied by the directory and the pages.
+        auto GetMemoryUsage() const -> U64
+        {
+            return directory.capacity() * sizeof(U16) + pages.capacity() * sizeof(U16);
+        }
 
+        auto Set(U32 codepoint, U16 glyphIndex) -> V;
+    };
 
-    auto FontData::ParseCffOutlinesFont() -> Error
+    // Pair kerning from GPOS or kern compiled into native tables. The pairs listed one by one are
+    // kept in an open addressing hash table keyed by both glyph indices. The class based GPOS
+    // subtables become class by class matrices with the class of every right glyph stored densely.
+    // The values of the GPOS lookups add up while within a lookup the first subtable applying to a
+    // pair wins. Pairs found in the hash table hold that sum already, otherwise it is the sum over
+    // the class subtables listed for the left glyph, which are the first covering it in every lookup.
+    struct CompiledKerning
     {
-        auto status = ParseTtfContainedFont();
+        static constexpr U32 EMPTY_KEY = ~0u;
+        static constexpr U16 NOT_COVERED = 0xFFFF;
 
-        if (status != Error::Success)
+        struct Entry
         {
-            return status;
-        }
-
-        // TODO: Add CFF outlines support.
-        return Error::UnsupportedFormat;
-    }
+            U32 key = EMPTY_KEY;
+            I16 value = 0;
+        };
 
+        struct ClassPairs
+        {
+            Array<U16> rightClasses;
+            U32 rightClassCount = 0;
+            // Indexed by leftClass * rightClassCount + rightClass.
+            Array<I16> values;
+        };
 
-    auto FontData::FindTable(U32 tag) -> Location
-    {
-        static constexpr U32 initOffset = sizeof(OffsetTable);
-        static constexpr U32 stride = sizeof(TableDirectoryEntry);
+        // A class subtable applying to a left glyph.
+        struct LeftClass
+        {
+            U32 classPairs = 0;
+            // Index of the value of the left class of the glyph with right class 0.
+            U32 firstValue = 0;
+        };
 
-        for(auto k = 0u; k < tableCount; ++k)
+        // A power of two in size and at most half full. The slot of a key is given by the top bits
+        // of its Fibonacci hash.
+        Array<Entry> entries;
+        U32 hashShift = 32;
+        Array<ClassPairs> classPairs;
+        // The class subtables of left glyph g are leftClasses[leftClassOffsets[g]] up to
+        // leftClasses[leftClassOffsets[g + 1]], empty without class kerning.
+        Array<U32> leftClassOffsets;
+        Array<LeftClass> leftClasses;
+
+        auto Hash(U32 key) const -> U32
         {
-            auto currentOffset  = initOffset + k * stride;
+            return (key * 0x9E3779B1u) >> hashShift;
+        }
 
-            if (*(const U32*)((const Byte*) data.data() + currentOffset) == tag)
+        auto Lookup(U32 leftGlyph, U32 rightGlyph) const -> I16
+        {
+            if (!entries.empty())
             {
-                // TODO: provide support for computing table checksums
-                auto tdePtr = (const TableDirectoryEntry*) ((const Byte*)data.data() + currentOffset);
+                auto key = (leftGlyph << 16) | (rightGlyph & 0xFFFF);
+                auto mask = U32(entries.size() - 1);
 
-                return Location
+                for (auto slot = Hash(key); ; slot = (slot + 1) & mask)
                 {
-                    .offset = FromBE(tdePtr->offset),
-                    .length = FromBE(tdePtr->length)
-                };
+                    if (entries[slot].key == key)
+                    {
+                        return entries[slot].value;
+                    }
+
+                    if (entries[slot].key == EMPTY_KEY)
+                    {
+                        break;
+                    }
+                }
             }
+
+            return I16(GetClassValue(leftGlyph, rightGlyph));
         }
 
-        return Location{ .offset = 0, .length = 0 };
-    }
+        // Sums the class kerning of the subtables listed for the left glyph.
+        auto GetClassValue(U32 leftGlyph, U32 rightGlyph) const -> I32
+        {
+            if (leftGlyph + 1 >= leftClassOffsets.size())
+            {
+                return 0;
+            }
 
+            auto value = 0;
 
-    auto FontData::ParseTtfContainedFont() -> Error
-    {
-        #define MTTF_GET_TABLES(VAR_NAME, TAG, ERROR) \
-            VAR_NAME = FindTable(FromLE(TAG)); \
-            if (VAR_NAME.offset == 0) \
-            { \
-                return ERROR; \
-            } \
-        
-        MTTF_GET_TABLES(cmapTable, CMAP_TAG_LE, Error::NoCmapTable);
-        MTTF_GET_TABLES(nameTable, NAME_TAG_LE, Error::NoNameTable);
-        MTTF_GET_TABLES(maxpTable, MAXP_TAG_LE, Error::NoMaxpTable);
-        MTTF_GET_TABLES(hheaTable, HHEA_TAG_LE, Error::NoHheaTable);
-        MTTF_GET_TABLES(headTable, HEAD_TAG_LE, Error::NoHeadTable);
-        MTTF_GET_TABLES(hmtxTable, HMTX_TAG_LE, Error::NoHmtxTable);
+            for (auto i = leftClassOffsets[leftGlyph]; i < leftClassOffsets[leftGlyph + 1]; ++i)
+            {
+                auto& pairs = classPairs[leftClasses[i].classPairs];
+                auto rightClass = rightGlyph < pairs.rightClasses.size() ? pairs.rightClasses[rightGlyph] : 0u;
+                value += pairs.values[leftClasses[i].firstValue + rightClass];
+            }
 
-        auto status = GetIdxDataTableFromCmap();
+            return value;
+        }
 
-        if (status != Error::Success)
+        auto IsEmpty() const -> B
         {
-            return status;
+            return entries.empty() && classPairs.empty();
         }
 
-        status = FetchGlobalInfoFromHead();
+        auto GetMemoryUsage() const -> U64;
+    };
 
-        if (status != Error::Success)
+    // The hmtx table decoded into native arrays indexed by glyph. Glyphs past the long metrics
+    // repeat the last advance width so every glyph has both entries.
+    struct HorizontalMetrics
+    {
+        Array<U16> advanceWidths;
+        Array<I16> leftSideBearings;
+
+        auto GetMemoryUsage() const -> U64
         {
-            return status;
+            return advanceWidths.capacity() * sizeof(U16) + leftSideBearings.capacity() * sizeof(I16);
         }
+    };
 
-        return FetchGlobalInfoFromHhea();
-    }
+    // A run of consecutive codepoints that are mapped to glyph indices in the same way e.g. a
+    // format 4 segment or a format 12 group. Unmapped gaps are represented as well so that
+    // lookups of missing codepoints can be reused too.
+    struct CmapRange
+    {
+        U32 first;
+        U32 last;
+        U32 delta = 0;
+        // Offset of the glyph index array entry of the first codepoint or 0 when the indices are
+        // computed only from the delta.
+        U32 glyphArrayOffset = 0;
+        B mapped = false;
+    };
 
+    static constexpr U32 ASCII_GLYPH_COUNT = 128;
+    // What invalid UTF-8 and UTF-16 sequences decode to.
+    static constexpr U32 REPLACEMENT_CHARACTER = 0xFFFD;
 
-    auto FontData::FetchGlobalInfoFromHead() -> Error
+    struct TextMapping
     {
-        struct HeadTable1 
-        {
-            U32 version;
-            U32 fontRevision;
-            U32 checksumAdjustment;
-            U32 magicNumber;
-            U16 flags;
-            U16 unitsPerEm;
-        };
+        // Code units of the text that were decoded.
+        U64 unitCount;
+        // Glyph indices that were written, one per decoded codepoint.
+        U64 glyphCount;
+    };
 
-        struct HeadTable2 
+    struct LoadOptions
+    {
+        // Compile the selected cmap subtable into a CompiledCmap so that GetCharIndex doesn't
+        // need to walk the big endian subtable on every call.
+        B compileCmap = false;
+        // The face to load from a TrueType collection. Ignored for single font files.
+        U32 faceIndex = 0;
+        // Decode all the glyphs used as components of compound glyphs at load time.
+        B cacheComponentOutlines = false;
+        // Tokenize the CFF subroutines at load time. Ignored for TrueType outlines.
+        B cacheCffSubroutines = false;
+        // Compute the bounding boxes of all the CFF glyphs at load time so that
+        // GetGlyphBoundingBox doesn't decode the glyph. Ignored for TrueType outlines.
+        B cacheCffBoundingBoxes = false;
+        // Decode hmtx into HorizontalMetrics so that the metrics of a glyph are a single load.
+        B decodeHorizontalMetrics = false;
+        // Compile the pair kerning of GPOS, or of kern when GPOS has none, into CompiledKerning.
+        // Needed by GetKerning.
+        B compileKerning = false;
+        // Check that everything read while decoding lies inside the font before accepting it.
+        // Without it the font data is trusted and malformed fonts can cause out of bounds reads.
+        // Validated TrueType fonts also keep loca decoded as native offsets and lengths.
+        B validate = false;
+    };
+
+    // The decoded loca table of a validated font. The offsets are absolute and glyphs without
+    // outlines have zero length.
+    struct GlyphLocations
+    {
+        Array<Location> locations;
+        Error status = Error::Success;
+    };
+
+    // Decoded representations of font tables keyed by the table tag and its offset in the font
+    // buffer. Faces of a collection that point to the same table share a single decoded copy.
+    class DecodedTableCache
+    {
+        Map<U64, Any> entries;
+
+    public:
+        template <typename T, typename TDecode>
+        auto GetOrDecode(U32 tag, U32 offset, TDecode&& decode) -> SharedPtr<const T>
         {
-            I64 created;
-            I64 modified;
-            I16 xMin;
-            I16 yMin;
-            I16 xMax;
-            I16 yMax;
-            U16 macStyle;
-            U16 unused;
-            I16 fontDirectionJint;
-            I16 indexToLocaFormat;
-            I16 glyphDataFormat;
+            auto key = (U64(tag) << 32) | offset;
+            auto entry = entries.find(key);
+
+            if (entry != entries.end())
+            {
+                return AnyCast<SharedPtr<const T>>(entry->second);
+            }
+
+            auto decoded = SharedPtr<const T>(MakeShared<T>(decode()));
+            entries.emplace(key, decoded);
+            return decoded;
+        }
+
+        auto GetEntryCount() const -> U64
+        {
+            return entries.size();
+        }
+    };
+
+    // The contents of the .ttf file;
+    class FontData
+    {
+        Span<const U8> data;
+        // Offset of the offset table of the loaded face. Non zero only for faces of a collection.
+        U32 fontOffset;
+        SharedPtr<const CompiledCmap> compiledCmap;
+        SharedPtr<const ComponentOutlineCache> componentCache;
+        SharedPtr<const CffSubroutineCache> cffSubroutineCache;
+        SharedPtr<const Array<Line>> cffBoundingBoxes;
+        SharedPtr<const GlyphLocations> glyphLocations;
+        SharedPtr<const HorizontalMetrics> horizontalMetrics;
+        SharedPtr<const CompiledKerning> compiledKerning;
+        CffFont cff;
+        StaticArray<U32, ASCII_GLYPH_COUNT> asciiGlyphs;
+
+        U32 tableCount;
+        Location headTable;
+        Location locaTable;
+        Location hheaTable;
+        Location cmapTable;
+        Location maxpTable;
+        Location glyfTable;
+        Location hmtxTable;
+        Location kernTable;
+        Location gposTable;
+        Location nameTable;
+        Location cffTable;
+
+        U32 indexMapOffset;
+        U32 charEncodingFormat;
+        B longLocaIndex;
+
+    public:
+        U16 unitsPerEm;
+        // The bounding box
+        I16 xMin;
+        I16 yMin;
+        I16 xMax;
+        I16 yMax;
+
+        U16 numberOfGlyphs;
+        U16 numberOfLongHorizontalMetrics;
+        I16 ascent;
+        I16 descent;
+        I16 lineGap;
+        U16 advanceWidthMax;
+
+        auto Load(Span<const Byte>, const LoadOptions& options = {}) -> Error;
+        auto GetCharIndex(I32 codepoint) const -> U32;
+        // Maps min(codepoints.size(), glyphs.size()) codepoints at once. Prefer this over
+        // GetCharIndex for whole strings.
+        auto GetCharIndices(Span<const I32> codepoints, Span<U32> glyphs) const -> V;
+        // Decode the text straight into glyph indices without going through a codepoint array.
+        // Each invalid or truncated code unit maps to the glyph of REPLACEMENT_CHARACTER. Stops
+        // when either the text or the glyphs run out.
+        auto GetCharIndicesUtf8(Span<const U8> text, Span<U32> glyphs) const -> TextMapping;
+        auto GetCharIndicesUtf8(StrView text, Span<U32> glyphs) const -> TextMapping;
+        auto GetCharIndicesUtf16(Span<const U16> text, Span<U32> glyphs) const -> TextMapping;
+        auto FetchGlyphDataForCodepoint(I32 codepoint) const -> GlyphData;
+        auto FetchGlyphData(U32 glyphIndex) const -> GlyphData;
+        // Decodes into a caller provided GlyphData reusing its storage and the one of the scratch
+        // so that once they have grown enough no heap allocations happen.
+        auto FetchGlyphDataForCodepoint(I32 codepoint, GlyphDecodeScratch& scratch, GlyphData& output) const -> V;
+        auto FetchGlyphData(U32 glyphIndex, GlyphDecodeScratch& scratch, GlyphData& output) const -> V;
+        // In font units. Zero for glyph indices out of range.
+        auto GetAdvanceWidth(U32 glyphIndex) const -> U16;
+        auto GetLeftSideBearing(U32 glyphIndex) const -> I16;
+        // Horizontal advance adjustment between two glyphs in font units. Zero unless the font was
+        // loaded with LoadOptions::compileKerning.
+        auto GetKerning(U32 leftGlyph, U32 rightGlyph) const -> I16;
+        // The bounding box from the glyph header. CFF glyphs have none so they are decoded unless
+        // the font was loaded with LoadOptions::cacheCffBoundingBoxes.
+        auto GetGlyphBoundingBox(U32 glyphIndex) const -> Line;
+        // Pixels per font unit for glyphs whose ascent to descent span the given height.
+        auto GetScaleForPixelHeight(F32 pixelHeight) const -> F32;
+
+        // Empty unless the font was loaded with LoadOptions::compileCmap.
+        auto GetCompiledCmap() const -> const CompiledCmap&;
+        // Null unless the font was loaded with LoadOptions::cacheComponentOutlines.
+        auto GetComponentOutlineCache() const -> const ComponentOutlineCache*;
+        // Null unless a CFF font was loaded with LoadOptions::cacheCffSubroutines.
+        auto GetCffSubroutineCache() const -> const CffSubroutineCache*;
+        // Null unless the font was loaded with LoadOptions::decodeHorizontalMetrics.
+        auto GetHorizontalMetrics() const -> const HorizontalMetrics*;
+        // Empty unless the font was loaded with LoadOptions::compileKerning.
+        auto GetCompiledKerning() const -> const CompiledKerning&;
+
+        // Returns a zero location when the table is missing. The tag is expected in file byte
+        // order i.e. FromLE(*_TAG_LE).
+        auto FindTable(U32 tag) const -> Location;
+    private:
+        friend class FontCollection;
+
+        auto LoadFace(Span<const Byte>, const LoadOptions& options, DecodedTableCache* cache) -> Error;
+        template <typename T, typename TDecode>
+        auto DecodeShared(DecodedTableCache* cache, U32 tag, U32 offset, TDecode&& decode) const -> SharedPtr<const T>;
+        auto CheckFontVersion(U32 v) const -> FontVersion;
+        auto ParseContents(U32 faceIndex, B validate) -> Error;
+        // Checks the parts of the font read by Load. The rest is checked once it is parsed.
+        auto ValidateTableDirectory() const -> Error;
+        auto ValidateTables() const -> Error;
+        auto ValidateCmapSubtable() const -> Error;
+        auto ValidateGlyph(Location glyph) const -> B;
+        auto DecodeGlyphLocations() const -> GlyphLocations;
+        auto ParseTtOutlinesFont() -> Error;
+        auto ParseCffOutlinesFont()->Error;
+        auto ParseTtfContainedFont() -> Error;
+        auto FetchGlobalInfoFromHead() -> Error;
+        auto FetchGlobalInfoFromHhea() -> Error;
+        auto GetIdxDataTableFromCmap() -> Error;
+        auto CompileCmap() const -> CompiledCmap;
+
+        auto GetCharIndexUncompiled(I32 codepoint) const -> U32;
+        auto GetCharIndexFmt4(U32 codepoint) const -> U32;
+        auto GetCharIndexFmt6(U32 codepoint) const -> U32;
+        auto GetCharIndexFmt12(U32 codepoint) const -> U32;
+        auto FindCmapRangeFmt4(U32 codepoint) const -> CmapRange;
+        auto FindCmapRangeFmt6(U32 codepoint) const -> CmapRange;
+        auto FindCmapRangeFmt12(U32 codepoint) const -> CmapRange;
+        template <U32 FORMAT>
+        auto FindCmapRange(U32 codepoint) const -> CmapRange;
+        template <U32 FORMAT>
+        auto ResolveCmapRange(const CmapRange& range, U32 codepoint) const -> U32;
+        template <U32 FORMAT>
+        auto GetCharIndicesForFormat(Span<const I32> codepoints, Span<U32> glyphs) const -> V;
+        // Maps the longest prefix of whole SIMD blocks that contain only ASCII codepoints and
+        // returns its length.
+        auto MapAsciiCodepoints(const I32* codepoints, U32* glyphs, U64 count) const -> U64;
+        // FORMAT 0 maps through the compiled cmap or to glyph 0 when there is none.
+        template <U32 FORMAT, typename TextUnit>
+        auto GetCharIndicesForText(Span<const TextUnit> text, Span<U32> glyphs) const -> TextMapping;
+        // Maps the longest prefix of ASCII code units and returns its length.
+        template <typename TextUnit>
+        auto MapAsciiText(const TextUnit* text, U32* glyphs, U64 count) const -> U64;
+        // Decode the codepoint at the start of the text and return how many code units it took.
+        static auto DecodeUtf8Codepoint(const U8* text, U64 count, U32& codepoint) -> U32;
+        static auto DecodeUtf16Codepoint(const U16* text, U64 count, U32& codepoint) -> U32;
+        auto BuildAsciiGlyphTable() -> V;
+        auto GetGlyphOffset(U32 glyphIndex) const -> U32;
+        auto GetGlyphLocation(U32 glyphIndex) const -> Location;
+        // Appends the points, flags and contour end points of the glyph to the scratch.
+        auto DecodeGlyphPoints(U32 glyphIndex, GlyphDecodeScratch& scratch, U32 depth) const -> V;
+        auto DecodeSimpleGlyphPoints(U32 offset, I16 numberOfContours, GlyphDecodeScratch& scratch) const -> V;
+        auto DecodeCompoundGlyphPoints(U32 offset, GlyphDecodeScratch& scratch, U32 depth) const -> V;
+        auto ReadComponentRecord(U32& offset) const -> ComponentRecord;
+        auto BuildComponentOutlineCache() const -> ComponentOutlineCache;
+        auto DecodeHorizontalMetrics() const -> HorizontalMetrics;
+        auto CompileKerning() const -> CompiledKerning;
+        // Returns false if GPOS has no kern feature.
+        auto CompileGposKerning(Map<U32, I16>& pairs, CompiledKerning& kerning) const -> B;
+        auto CompileKernTable(Map<U32, I16>& pairs) const -> V;
+        template <typename TVisitor>
+        auto ForEachCoveredGlyph(U64 coverageOffset, TVisitor&& visitor) const -> V;
+        auto ReadClassDefinitions(U64 classDefOffset, U32 classCount) const -> Array<U16>;
+        // Big endian read inside GPOS. Zero outside of it.
+        auto ReadGposU16(U64 offset) const -> U16;
+        auto ParseCffTable() -> Error;
+        auto ReadCffIndex(U32& offset, CffIndex& index) const -> B;
+        auto GetCffIndexObject(const CffIndex& index, U32 i) const -> Location;
+        template <typename TVisitor>
+        auto ParseCffDict(Location dict, TVisitor&& visitor) const -> V;
+        auto ParseCffPrivateDict(Location dict) -> V;
+        auto ParseCffFontDictSelect(U32 offset, U32 fontDictCount) -> V;
+        auto ParseCffVariationStore(U32 offset) -> V;
+        auto ReadCffOperand(U32& offset, U32 end, F32& value) const -> B;
+        auto TokenizeCffSubroutine(Location subr, Array<CffToken>& tokens) const -> V;
+        auto BuildCffSubroutineCache() const -> CffSubroutineCache;
+        auto ComputeCffBoundingBoxes() const -> Array<Line>;
+        auto DecodeCffGlyph(U32 glyphIndex, Outline& outline) const -> V;
+        auto LoadContour
+        (
+            GlyphData& data,
+            Span<const TTFPoint> vertices,
+            Span<const U8> flags,
+            U64 sidx,
+            U64 eidx
+        ) const -> U64;
+    };
+
+
+    // These should work on little endian machine hence we need to
+    // use conversion in order to abstract endianess.
+    constexpr U32 CFF_TAG_LE = 0x20464643;
+    constexpr U32 CFF2_TAG_LE = 0x32464643;
+    constexpr U32 GLYF_TAG_LE = 0x66796C67;
+    constexpr U32 NAME_TAG_LE = 0x656D616E;
+    constexpr U32 LOCA_TAG_LE = 0x61636F6C;
+    constexpr U32 MAXP_TAG_LE = 0x7078616D;
+    constexpr U32 CMAP_TAG_LE = 0x70616D63;
+    constexpr U32 HEAD_TAG_LE = 0x64616568;
+    constexpr U32 HHEA_TAG_LE = 0x61656868;
+    constexpr U32 HMTX_TAG_LE = 0x78746D68;
+    constexpr U32 KERN_TAG_LE = 0x6E72656B;
+    constexpr U32 GPOS_TAG_LE = 0x534F5047;
+
+    constexpr U16 PLATFORM_ID_UNICODE = 0;
+    constexpr U16 PLATFORM_ID_MICROSOFT = 3;
+
+    constexpr U16 PLATFORM_SPECIFIC_ID_MS_UCS2 = 1;
+    constexpr U16 PLATFORM_SPECIFIC_ID_MS_UCS4 = 10;
+
+    struct GrayScaleSurface
+    {
+        Array<Byte> data;
+        U32 width;
+        U32 height;
+    };
+
+    // Three bytes per pixel in red, green, blue order.
+    struct RGBSurface
+    {
+        Array<Byte> data;
+        U32 width;
+        U32 height;
+    };
+
+    // A rectangle of pixels inside a bigger surface, e.g. a glyph slot on an atlas page.
+    struct SurfaceView
+    {
+        Byte* data;
+        U32 width;
+        U32 height;
+        // Bytes between the starts of consecutive rows.
+        U32 stride;
+    };
+
+    // Arithmetic of the scanline rasterizer. The fixed point one works with 24.8 coordinates and
+    // integer areas so its output is the same for every compiler, set of flags and instruction set.
+    // The analytic one doesn't flatten the quadratic curves and integrates their exact coverage, its
+    // work depends on the number of curves rather than on the size.
+    enum class RasterArithmetic
+    {
+        Float,
+        Fixed,
+        Analytic
+    };
+
+    // Surfaces taller than a few dozen rows are split into bands that are rasterized on up to
+    // threadCount threads, fewer when the surface is too small to keep them all busy.
+    template <RasterArithmetic ARITHMETIC = RasterArithmetic::Float>
+    auto RasterizeGlyph(const FontData& fontData, I32 codepoint, I32 height, U32 threadCount = 1) -> GrayScaleSurface;
+
+    // Signed distance field of the glyph with scale pixels per font unit (see
+    // FontData::GetScaleForPixelHeight). Distances are exact distances to the outline in pixels
+    // clamped to the spread and mapped so that 0 is spread outside, 255 is spread inside and the
+    // outline itself is at 128. The glyph is placed like in Rasterize with ceil(spread) extra
+    // pixels on every side. Rows are computed by threadCount threads.
+    auto RasterizeSDF(const GlyphData& glyphData, F32 scale, F32 spread, U32 threadCount = 1) -> GrayScaleSurface;
+
+    // Multi-channel signed distance field with the same size, placement and encoding as
+    // RasterizeSDF. The edges are colored so that the two edges meeting at a corner never share
+    // more than one channel, and the median of the three channels keeps corners sharp at much
+    // lower resolutions than a single-channel field.
+    auto RasterizeMSDF(const GlyphData& glyphData, F32 scale, F32 spread, U32 threadCount = 1) -> RGBSurface;
+
+    // A glyph placed by LayoutRun. Everything is in pixels relative to the start of the run on
+    // the baseline with y pointing up.
+    struct PositionedGlyph
+    {
+        U32 glyphIndex;
+        // Pen position of the glyph origin.
+        F32 x;
+        // Bounding box of the outline at the pen position.
+        F32 minX;
+        F32 minY;
+        F32 maxX;
+        F32 maxY;
+    };
+
+    struct RunLayout
+    {
+        U64 glyphCount;
+        // Pen position after the last glyph i.e. where the next run starts.
+        F32 advance;
+    };
+
+    // Lays out a single line of text in one pass: maps the codepoints to glyphs, advances the pen
+    // by their advance widths and the kerning between them and scales everything to pixels the
+    // same way as RasterizeGlyph. Lays out min(codepoints.size(), glyphs.size()) glyphs without
+    // allocating, except for CFF fonts loaded without cacheCffBoundingBoxes whose glyphs have to
+    // be decoded for their bounding boxes. Load the font with compileCmap,
+    // decodeHorizontalMetrics and compileKerning for the fastest layout.
+    auto LayoutRun(const FontData& fontData, Span<const I32> codepoints, F32 pixelHeight, Span<PositionedGlyph> glyphs) -> RunLayout;
+
+    // Identifies a rasterized glyph in GlyphCache and GlyphAtlas.
+    struct GlyphKey
+    {
+        U32 fontId;
+        U32 glyphIndex;
+        // Pixel height and subpixel offset in steps of the cache or atlas options.
+        U32 size;
+        U32 subpixelOffset;
+
+        auto operator==(const GlyphKey&) const -> B = default;
+    };
+
+    struct GlyphKeyHash
+    {
+        auto operator()(const GlyphKey& key) const -> U64;
+    };
+
+    struct GlyphCacheOptions
+    {
+        // Bitmap bytes kept across all shards before the least recently used glyphs are evicted.
+        U64 byteBudget = U64(64) << 20;
+        // Every shard has its own lock and LRU list. Rounded up to a power of two.
+        U32 shardCount = 16;
+        // Steps per pixel that pixel heights and subpixel offsets are quantized to.
+        U32 sizeSteps = 1;
+        U32 subpixelSteps = 4;
+    };
+
+    struct GlyphCacheStatistics
+    {
+        U64 hits;
+        U64 misses;
+        U64 evictions;
+        // Hits served by the front cache of a thread. Other threads publish theirs in batches so
+        // the count can lag behind.
+        U64 frontHits;
+        U64 entryCount;
+        U64 byteCount;
+    };
+
+    // Rasterized glyph bitmaps shared between threads. Every thread first looks in a small direct
+    // mapped front cache of its own and then in one of several shards picked by the key hash, so
+    // threads rendering the same glyphs rarely touch the same lock. Front cache hits move the
+    // glyph to the front of the LRU list of its shard on the first hit and every few hits after
+    // that, so glyphs served by the front caches aren't the first to be evicted. Returned bitmaps
+    // stay valid after they are evicted for as long as they are referenced.
+    class GlyphCache
+    {
+    public:
+        static constexpr U32 FRONT_CACHE_SIZE = 64;
+
+        struct Entry
+        {
+            GlyphKey key;
+            SharedPtr<const GrayScaleSurface> surface;
+            U64 byteCount;
+            // Neighbours in the LRU list of the shard.
+            U32 previous;
+            U32 next;
+        };
+
+        struct alignas(64) Shard
+        {
+            static constexpr U32 NO_ENTRY = ~0u;
+
+            mutable Mutex mutex;
+            std::unordered_map<GlyphKey, U32, GlyphKeyHash> slots;
+            Array<Entry> entries;
+            Array<U32> freeSlots;
+            // Most recently used first.
+            U32 head = NO_ENTRY;
+            U32 tail = NO_ENTRY;
+            U64 byteCount = 0;
+            U64 hits = 0;
+            U64 misses = 0;
+            U64 evictions = 0;
+        };
+
+        // Shared with the front caches of the threads, which can outlive the cache.
+        struct FrontState
+        {
+            // Bumped by Clear to invalidate the front caches.
+            Atomic<U64> generation = 0;
+            Atomic<U64> frontHits = 0;
+        };
+
+        explicit GlyphCache(const GlyphCacheOptions& options = {});
+        GlyphCache(const GlyphCache&) = delete;
+        auto operator=(const GlyphCache&) -> GlyphCache& = delete;
+
+        // The glyph rasterized at the pixel height like RasterizeGlyph and shifted right by the
+        // subpixel offset in [0, 1). Pass the fractional part of the left edge of the glyph (e.g.
+        // PositionedGlyph::minX) and place the bitmap at its integer part. fontId is any number
+        // that tells apart the fonts used with the cache.
+        auto GetGlyph(const FontData& fontData, U32 fontId, U32 glyphIndex, F32 pixelHeight, F32 subpixelOffset = 0) -> SharedPtr<const GrayScaleSurface>;
+        auto GetStatistics() const -> GlyphCacheStatistics;
+        // Drops every glyph including the ones in the front caches of all threads.
+        auto Clear() -> V;
+
+    private:
+        auto Insert(Shard& shard, const GlyphKey& key, SharedPtr<const GrayScaleSurface> surface) -> V;
+        auto Unlink(Shard& shard, U32 slot) -> V;
+        auto PushFront(Shard& shard, U32 slot) -> V;
+        auto Touch(Shard& shard, const GlyphKey& key) -> V;
+
+        GlyphCacheOptions options;
+        Array<Shard> shards;
+        U64 shardByteBudget;
+        SharedPtr<FrontState> frontState;
+    };
+
+    struct GlyphAtlasOptions
+    {
+        U32 pageWidth = 1024;
+        U32 pageHeight = 1024;
+        // Pages are added as they are needed up to this many. Glyphs are evicted after that.
+        U32 maxPageCount = 4;
+        // Blank pixels kept to the right and below every glyph so that filtering doesn't bleed.
+        U32 padding = 1;
+        // Steps per pixel that pixel heights and subpixel offsets are quantized to.
+        U32 sizeSteps = 1;
+        U32 subpixelSteps = 4;
+    };
+
+    struct AtlasGlyph
+    {
+        U32 page;
+        // Pixel rectangle of the glyph on the page. It's placed like the GlyphCache bitmaps.
+        U32 x;
+        U32 y;
+        U32 width;
+        U32 height;
+        // The same rectangle in texture coordinates.
+        F32 u0;
+        F32 v0;
+        F32 u1;
+        F32 v1;
+    };
+
+    struct AtlasDirtyRect
+    {
+        U32 page;
+        U32 x;
+        U32 y;
+        U32 width;
+        U32 height;
+    };
+
+    // Packs glyphs into fixed size pages of the same format as GrayScaleSurface (blank pixels are
+    // 255) and rasterizes them in place. Every page is split into shelves of similar height that
+    // are filled left to right. When no page has room the least recently used glyphs are evicted
+    // but never the ones used since the last NextFrame so everything drawn in a frame stays put.
+    class GlyphAtlas
+    {
+    public:
+        struct FreeRange
+        {
+            U32 x;
+            U32 width;
+        };
+
+        struct Shelf
+        {
+            U32 y;
+            U32 height;
+            U32 glyphCount;
+            // Unused parts of the shelf ordered by x.
+            Array<FreeRange> freeRanges;
+        };
+
+        struct Page
+        {
+            GrayScaleSurface surface;
+            Array<Shelf> shelves;
+            // Top of the space below the last shelf.
+            U32 shelvesEnd;
+        };
+
+        struct Entry
+        {
+            GlyphKey key;
+            AtlasGlyph glyph;
+            U32 shelf;
+            // Width taken from the shelf including the padding.
+            U32 slotWidth;
+            U64 lastFrame;
+            // Neighbours in the LRU list, most recently used first.
+            U32 previous;
+            U32 next;
         };
 
-        auto headTable1Ptr = (const HeadTable1*)(data.data() + headTable.offset);
-        auto headTable2Ptr = (const HeadTable2*)(data.data() + headTable.offset + sizeof(HeadTable1));
+        static constexpr U32 NO_ENTRY = ~0u;
+
+        explicit GlyphAtlas(const GlyphAtlasOptions& options = {});
+
+        // Places the glyph on a page if it isn't there yet. Returns false when it can't be placed
+        // because it's larger than a page or all the pages are taken by glyphs of this frame.
+        auto GetGlyph(const FontData& fontData, U32 fontId, U32 glyphIndex, F32 pixelHeight, F32 subpixelOffset, AtlasGlyph& glyph) -> B;
+        // Glyphs used before the next frame may be evicted to make room.
+        auto NextFrame() -> V;
+
+        auto GetPageCount() const -> U32;
+        auto GetPage(U32 pageIndex) const -> const GrayScaleSurface&;
+        auto GetGlyphCount() const -> U64;
+        auto GetEvictionCount() const -> U64;
+        // Regions of the pages written since the last ClearDirtyRects, for uploading only what
+        // has changed.
+        auto GetDirtyRects() const -> Span<const AtlasDirtyRect>;
+        auto ClearDirtyRects() -> V;
+
+    private:
+        // Finds room for a slot of the given size including padding and fills in page, shelf, x
+        // and y of the entry.
+        auto Allocate(U32 width, U32 height, Entry& entry) -> B;
+        auto AllocateOnShelf(U32 pageIndex, U32 shelfIndex, U32 width, Entry& entry) -> B;
+        auto Evict(U32 slot) -> V;
+        auto Unlink(U32 slot) -> V;
+        auto PushFront(U32 slot) -> V;
+        auto MarkDirty(const AtlasDirtyRect& rect) -> V;
+
+        GlyphAtlasOptions options;
+        Array<Page> pages;
+        std::unordered_map<GlyphKey, U32, GlyphKeyHash> slots;
+        Array<Entry> entries;
+        Array<U32> freeSlots;
+        U32 head = NO_ENTRY;
+        U32 tail = NO_ENTRY;
+        U64 frame = 0;
+        U64 evictionCount = 0;
+        Array<AtlasDirtyRect> dirtyRects;
+    };
+
+    struct AtlasBakeOptions
+    {
+        U32 pageWidth = 1024;
+        U32 pageHeight = 1024;
+        U32 padding = 1;
+    };
+
+    struct BakedGlyph
+    {
+        I32 codepoint;
+        U32 glyphIndex;
+        F32 pixelHeight;
+        AtlasGlyph glyph;
+    };
+
+    struct BakedAtlas
+    {
+        Array<GrayScaleSurface> pages;
+        // Ordered by pixel height and then codepoint. Codepoints mapped to the same glyph share
+        // its rectangle.
+        Array<BakedGlyph> glyphs;
+    };
+
+    // Builds a static atlas of the codepoints at every pixel height. The glyph sizes come from the
+    // glyph headers so they are packed before anything is rasterized, then the glyphs are drawn
+    // into their slots by threadCount threads (0 means one per core). The result is the same for
+    // any number of threads. Glyphs larger than a page are left out.
+    auto BakeAtlas(const FontData& fontData, Span<const I32> codepoints, Span<const F32> pixelHeights, U32 threadCount, const AtlasBakeOptions& options = {}) -> BakedAtlas;
+
+    struct MappingOptions
+    {
+        // Ask the kernel to back the glyph data with transparent huge pages. This is only worth it
+        // for large fonts (e.g. CJK) and it's silently ignored where it's not supported.
+        B useHugePages = false;
+    };
+
+    // Read only memory mapping of a font file. FontData can be loaded directly from GetData() and
+    // stays valid for as long as the mapping is open. Mappings of the same file are shared between
+    // processes through the page cache.
+    class MappedFontFile
+    {
+        const Byte* mapping = nullptr;
+        U64 size = 0;
+        MappingOptions options;
+
+        #if defined(_WIN32)
+            V* fileHandle = nullptr;
+            V* mappingHandle = nullptr;
+        #endif
+
+    public:
+        MappedFontFile() = default;
+        MappedFontFile(const MappedFontFile&) = delete;
+        MappedFontFile(MappedFontFile&& other) noexcept;
+        ~MappedFontFile();
+
+        auto operator=(const MappedFontFile&) -> MappedFontFile& = delete;
+        auto operator=(MappedFontFile&& other) noexcept -> MappedFontFile&;
+
+        auto Open(const C* path, const MappingOptions& options = {}) -> Error;
+        auto Close() -> V;
+        auto IsOpen() const -> B;
+        auto GetData() const -> Span<const Byte>;
+
+        // Tells the kernel how the tables of a font loaded from this mapping are going to be
+        // accessed. Glyph outlines are read randomly while the tables needed for every lookup
+        // are prefetched.
+        auto AdviseAccessPattern(const FontData& fontData) const -> V;
+    };
+
+    // All the faces of a TrueType collection (.ttc) loaded from a single buffer. Each face is a
+    // view over the same bytes and tables shared by several faces are decoded only once. Single
+    // font files are accepted as collections with one face.
+    class FontCollection
+    {
+        Span<const Byte> data;
+        Array<FontData> faces;
+        DecodedTableCache decodedTables;
+
+    public:
+        auto Load(Span<const Byte>, const LoadOptions& options = {}) -> Error;
+        auto GetFaceCount() const -> U32;
+        auto GetFace(U32 faceIndex) const -> const FontData&;
+        // The number of distinct decoded tables shared by the faces.
+        auto GetDecodedTableCount() const -> U64;
+    };
+}
+
+#ifdef MIN_TTF_IMPLEMENTATION
+
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+namespace MTTF
+{
+    auto FontData::LoadContour(GlyphData& data, Span<const TTFPoint> vertices, Span<const U8> flags, U64 sidx, U64 eidx) const -> U64
+    {
+        auto cidx = sidx;
+
+        data.outline.BeginContour();
+
+        if ((flags[cidx] & 1u) == 0)
+            // The first point is control point
+        {
+            auto curve = QuadraticBezierCurve();
+
+            if ((flags[eidx] & 1u) == 0)
+            {
+                curve.startPoint.x = ((I32(vertices[cidx].x) + I32(vertices[eidx].x)) / 2);
+                curve.startPoint.y = ((I32(vertices[cidx].y) + I32(vertices[eidx].y)) / 2);
+            }
+            else
+            {
+                curve.startPoint = vertices[eidx];
+            }
+
+            curve.controlPoint = vertices[cidx];
+            // No bound checking at this level.
+            cidx += 1;
+
+            if ((flags[cidx] & 1u) == 0)
+            {
+                curve.endPoint.x = ((I32(curve.controlPoint.x) + I32(vertices[cidx].x)) / 2);
+                curve.endPoint.y = ((I32(curve.controlPoint.y) + I32(vertices[cidx].y)) / 2);
+            }
+            else
+            {
+                curve.endPoint = vertices[cidx];
+            }
+
+            data.outline.AddQuadraticBezierCurve(curve.startPoint, curve.controlPoint, curve.endPoint);
+        }
+
+        while (cidx < eidx)
+        {
+            // At least the first point has been added already so we can safely check the
+            // previous point.
+
+            if ((flags[cidx] & 1u) == 0)
+            {
+                // The previous point must be a control point because else we would've
+                // parsed the whole curve in the previous iteration
+                auto startPoint =
+                    TTFPoint
+                    (
+                        ((I32(vertices[cidx - 1].x) + I32(vertices[cidx].x)) / 2),
+                        ((I32(vertices[cidx - 1].y) + I32(vertices[cidx].y)) / 2)
+                    );
+
+                if ((flags[cidx + 1] & 1u) == 0)
+                {
+                    auto endPoint =
+                        TTFPoint
+                        (
+                            ((I32(vertices[cidx].x) + I32(vertices[cidx + 1].x)) / 2),
+                            ((I32(vertices[cidx].y) + I32(vertices[cidx + 1].y)) / 2)
+                        );
+
+                    auto curve = QuadraticBezierCurve(startPoint, vertices[cidx], endPoint);
+                    data.outline.AddQuadraticBezierCurve(curve.startPoint, curve.controlPoint, curve.endPoint);
+                }
+                else
+                {
+                    auto curve =
+                        QuadraticBezierCurve(startPoint, vertices[cidx], vertices[cidx + 1]);
+                    data.outline.AddQuadraticBezierCurve(curve.startPoint, curve.controlPoint, curve.endPoint);
+                }
+            }
+            else
+            {
+                if ((flags[cidx + 1] & 1u) == 0)
+                {
+                    TTFPoint endPoint;
+
+                    if (cidx + 1 == eidx)
+                    {
+                        if ((flags[sidx] & 1u) == 0)
+                        {
+                            endPoint.x = ((I32(vertices[sidx].x) + I32(vertices[eidx].x)) / 2);
+                            endPoint.y = ((I32(vertices[sidx].y) + I32(vertices[eidx].y)) / 2);
+                        }
+                        else
+                        {
+                            endPoint = vertices[sidx];
+                        }
+
+                        auto curve = QuadraticBezierCurve(vertices[cidx], vertices[cidx + 1], endPoint);
+                        data.outline.AddQuadraticBezierCurve(curve.startPoint, curve.controlPoint, curve.endPoint);
+                    }
+                    else
+                    {
+                        // The next index is not the last so we can use at least one more point.
+                        if ((flags[cidx + 2] & 1u) == 0)
+                        {
+                            endPoint.x = ((I32(vertices[cidx + 1].x) + I32(vertices[cidx + 2].x)) / 2);
+                            endPoint.y = ((I32(vertices[cidx + 1].y) + I32(vertices[cidx + 2].y)) / 2);
+                        }
+                        else
+                        {
+                            endPoint = vertices[cidx + 2];
+                        }
+
+                        auto curve = QuadraticBezierCurve(vertices[cidx], vertices[cidx + 1], endPoint);
+                        data.outline.AddQuadraticBezierCurve(curve.startPoint, curve.controlPoint, curve.endPoint);
+                    }
+
+                    // We used one more point here.
+                    cidx += 1;
+                }
+                else
+                {
+                    data.outline.AddLine(vertices[cidx], vertices[cidx + 1]);
+                }
+            }
+
+            cidx += 1;
+        }
+
+        if (cidx == eidx)
+        {
+            if ((flags[eidx] & 1u) == 0)
+            {
+                // The previous point must be a control point because else we would've
+                // parsed the whole curve before this part of the code
+                auto startPoint =
+                    TTFPoint
+                    (
+                        ((I32(vertices[eidx - 1].x) + I32(vertices[eidx].x)) / 2),
+                        ((I32(vertices[eidx - 1].y) + I32(vertices[eidx].y)) / 2)
+                    );
+
+                TTFPoint endPoint;
+
+                if ((flags[sidx] & 1u) == 0)
+                {
+                    endPoint.x = ((I32(vertices[sidx].x) + I32(vertices[eidx].x)) / 2);
+                    endPoint.y = ((I32(vertices[sidx].y) + I32(vertices[eidx].y)) / 2);
+                }
+                else
+                {
+                    endPoint = vertices[sidx];
+                }
+
+                auto curve = QuadraticBezierCurve(startPoint, vertices[eidx], endPoint);
+                data.outline.AddQuadraticBezierCurve(curve.startPoint, curve.controlPoint, curve.endPoint);
+            }
+            else
+            {
+                // If the start was control point we have already pushed this curve in the
+                // beginning.
+                if ((flags[sidx] & 1u) > 0)
+                {
+                    data.outline.AddLine(vertices[eidx], vertices[sidx]);
+                }
+            }
+        }
+
+        data.outline.EndContour();
+
+        return eidx + 1;
+    }
+
+
+    auto CompiledCmap::Set(U32 codepoint, U16 glyphIndex) -> V
+    {
+        if (pages.empty())
+        {
+            // The shared page for unmapped blocks.
+            pages.resize(PAGE_SIZE, 0);
+        }
+
+        auto block = codepoint >> PAGE_BITS;
+
+        if (block >= directory.size())
+        {
+            directory.resize(block + 1, 0);
+        }
+
+        if (directory[block] == 0)
+        {
+            if (glyphIndex == 0)
+            {
+                return;
+            }
+
+            directory[block] = U16(pages.size() >> PAGE_BITS);
+            pages.resize(pages.size() + PAGE_SIZE, 0);
+        }
+
+        pages[(U32(directory[block]) << PAGE_BITS) | (codepoint & PAGE_MASK)] = glyphIndex;
+    }
+
+
+    auto FontData::Load(Span<const U8> data, const LoadOptions& options) -> Error
+    {
+        return LoadFace(data, options, nullptr);
+    }
+
+
+    auto FontData::LoadFace(Span<const U8> data, const LoadOptions& options, DecodedTableCache* cache) -> Error
+    {
+        this->data = data;
+        this->fontOffset = 0;
+        this->compiledCmap = nullptr;
+        this->componentCache = nullptr;
+        this->cffSubroutineCache = nullptr;
+        this->cffBoundingBoxes = nullptr;
+        this->glyphLocations = nullptr;
+        this->horizontalMetrics = nullptr;
+        this->compiledKerning = nullptr;
+        this->cff = CffFont();
+        this->glyfTable = Location{ .offset = 0, .length = 0 };
+        this->locaTable = Location{ .offset = 0, .length = 0 };
+        this->cffTable = Location{ .offset = 0, .length = 0 };
+
+        auto status = ParseContents(options.faceIndex, options.validate);
+
+        if (status != Error::Success)
+        {
+            return status;
+        }
+
+        if (options.validate)
+        {
+            status = ValidateTables();
+
+            if (status != Error::Success)
+            {
+                return status;
+            }
+
+            if (glyfTable.offset != 0)
+            {
+                glyphLocations =
+                    DecodeShared<GlyphLocations>
+                    (
+                        cache,
+                        LOCA_TAG_LE,
+                        locaTable.offset,
+                        [this]() { return DecodeGlyphLocations(); }
+                    );
+
+                if (glyphLocations->status != Error::Success)
+                {
+                    return glyphLocations->status;
+                }
+            }
+        }
+
+        BuildAsciiGlyphTable();
+
+        if (options.compileCmap)
+        {
+            compiledCmap =
+                DecodeShared<CompiledCmap>(cache, CMAP_TAG_LE, indexMapOffset, [this]() { return CompileCmap(); });
+        }
+
+        if (options.decodeHorizontalMetrics)
+        {
+            horizontalMetrics =
+                DecodeShared<HorizontalMetrics>
+                (
+                    cache,
+                    HMTX_TAG_LE,
+                    hmtxTable.offset,
+                    [this]() { return DecodeHorizontalMetrics(); }
+                );
+        }
+
+        if (options.compileKerning)
+        {
+            compiledKerning =
+                DecodeShared<CompiledKerning>
+                (
+                    cache,
+                    gposTable.offset != 0 ? GPOS_TAG_LE : KERN_TAG_LE,
+                    gposTable.offset != 0 ? gposTable.offset : kernTable.offset,
+                    [this]() { return CompileKerning(); }
+                );
+        }
+
+        if (options.cacheComponentOutlines && glyfTable.offset != 0)
+        {
+            componentCache =
+                DecodeShared<ComponentOutlineCache>
+                (
+                    cache,
+                    GLYF_TAG_LE,
+                    glyfTable.offset,
+                    [this]() { return BuildComponentOutlineCache(); }
+                );
+        }
+
+        if (options.cacheCffSubroutines && cffTable.offset != 0)
+        {
+            cffSubroutineCache =
+                DecodeShared<CffSubroutineCache>
+                (
+                    cache,
+                    cff.isCff2 ? CFF2_TAG_LE : CFF_TAG_LE,
+                    cffTable.offset,
+                    [this]() { return BuildCffSubroutineCache(); }
+                );
+        }
+
+        // Keyed by the CharStrings INDEX since the subroutine cache is keyed by the table itself.
+        if (options.cacheCffBoundingBoxes && cffTable.offset != 0)
+        {
+            cffBoundingBoxes =
+                DecodeShared<Array<Line>>
+                (
+                    cache,
+                    cff.isCff2 ? CFF2_TAG_LE : CFF_TAG_LE,
+                    cff.charStrings.offsetsOffset,
+                    [this]() { return ComputeCffBoundingBoxes(); }
+                );
+        }
+
+        return Error::Success;
+    }
+
+
+    template <typename T, typename TDecode>
+    auto FontData::DecodeShared(DecodedTableCache* cache, U32 tag, U32 offset, TDecode&& decode) const -> SharedPtr<const T>
+    {
+        if (cache != nullptr)
+        {
+            return cache->GetOrDecode<T>(tag, offset, decode);
+        }
+
+        return MakeShared<T>(decode());
+    }
+
+
+    auto FontData::GetCharIndex(I32 codepoint) const -> U32
+    {
+        if (compiledCmap != nullptr)
+        {
+            return compiledCmap->Lookup(U32(codepoint));
+        }
+
+        return GetCharIndexUncompiled(codepoint);
+    }
+
+
+    auto FontData::GetCharIndexUncompiled(I32 codepoint) const -> U32
+    {
+        if (codepoint < 0)
+        {
+            return 0;
+        }
+
+        switch (charEncodingFormat)
+        {
+            case 4:
+                return GetCharIndexFmt4(codepoint);
+            case 6:
+                return GetCharIndexFmt6(codepoint);
+            case 12:
+                return GetCharIndexFmt12(codepoint);
+            // This is impossible since we already checked for those formats
+            default:
+                return 0;
+        }
+    }
+
+
+    auto FontData::GetCompiledCmap() const -> const CompiledCmap&
+    {
+        static const CompiledCmap empty;
+        return compiledCmap != nullptr ? *compiledCmap : empty;
+    }
+
+
+    auto FontData::GetComponentOutlineCache() const -> const ComponentOutlineCache*
+    {
+        return componentCache.get();
+    }
+
+
+    auto FontData::GetCffSubroutineCache() const -> const CffSubroutineCache*
+    {
+        return cffSubroutineCache.get();
+    }
+
+
+    auto FontData::GetGlyphBoundingBox(U32 glyphIndex) const -> Line
+    {
+        if (glyphIndex >= numberOfGlyphs)
+        {
+            return Line(TTFPoint(0, 0), TTFPoint(0, 0));
+        }
+
+        if (cffBoundingBoxes != nullptr)
+        {
+            return (*cffBoundingBoxes)[glyphIndex];
+        }
+
+        if (cffTable.offset != 0)
+        {
+            return FetchGlyphData(glyphIndex).boundingBoxDiagonal;
+        }
+
+        auto glyph = GetGlyphLocation(glyphIndex);
+
+        if (glyph.length == 0)
+        {
+            return Line(TTFPoint(0, 0), TTFPoint(0, 0));
+        }
+
+        auto glyfHeaderPtr = (const GlyfHeader*)(data.data() + glyph.offset);
+
+        return
+            Line
+            (
+                TTFPoint(FromBE(glyfHeaderPtr->xMin), FromBE(glyfHeaderPtr->yMin)),
+                TTFPoint(FromBE(glyfHeaderPtr->xMax), FromBE(glyfHeaderPtr->yMax))
+            );
+    }
+
+
+    auto FontData::GetScaleForPixelHeight(F32 pixelHeight) const -> F32
+    {
+        return pixelHeight / (F32(ascent) - descent);
+    }
+
+
+    auto LayoutRun(const FontData& fontData, Span<const I32> codepoints, F32 pixelHeight, Span<PositionedGlyph> glyphs) -> RunLayout
+    {
+        // The codepoints are mapped in blocks so that the batched cmap lookup can be used without
+        // allocating.
+        static constexpr U64 BLOCK_SIZE = 64;
+
+        auto scale = fontData.GetScaleForPixelHeight(pixelHeight);
+        auto count = Min(codepoints.size(), glyphs.size());
+        auto penX = 0.f;
+        auto previousGlyph = ~0u;
+        StaticArray<U32, BLOCK_SIZE> blockGlyphs;
+
+        for (auto blockStart = U64(0); blockStart < count; blockStart += BLOCK_SIZE)
+        {
+            auto blockSize = Min(BLOCK_SIZE, count - blockStart);
+            fontData.GetCharIndices(codepoints.subspan(blockStart, blockSize), Span<U32>(blockGlyphs.data(), blockSize));
+
+            for (auto i = 0u; i < blockSize; ++i)
+            {
+                auto glyphIndex = blockGlyphs[i];
+
+                if (previousGlyph != ~0u)
+                {
+                    penX += fontData.GetKerning(previousGlyph, glyphIndex) * scale;
+                }
+
+                auto boundingBox = fontData.GetGlyphBoundingBox(glyphIndex);
+                auto& glyph = glyphs[blockStart + i];
+                glyph.glyphIndex = glyphIndex;
+                glyph.x = penX;
+                glyph.minX = penX + boundingBox.startPoint.x * scale;
+                glyph.minY = boundingBox.startPoint.y * scale;
+                glyph.maxX = penX + boundingBox.endPoint.x * scale;
+                glyph.maxY = boundingBox.endPoint.y * scale;
+
+                penX += fontData.GetAdvanceWidth(glyphIndex) * scale;
+                previousGlyph = glyphIndex;
+            }
+        }
+
+        return RunLayout{ .glyphCount = count, .advance = penX };
+    }
+
+
+    auto FontData::GetCompiledKerning() const -> const CompiledKerning&
+    {
+        static const CompiledKerning empty;
+        return compiledKerning != nullptr ? *compiledKerning : empty;
+    }
+
+
+    auto FontData::GetKerning(U32 leftGlyph, U32 rightGlyph) const -> I16
+    {
+        if (compiledKerning == nullptr || leftGlyph >= numberOfGlyphs || rightGlyph >= numberOfGlyphs)
+        {
+            return 0;
+        }
+
+        return compiledKerning->Lookup(leftGlyph, rightGlyph);
+    }
+
+
+    auto CompiledKerning::GetMemoryUsage() const -> U64
+    {
+        auto usage = entries.capacity() * sizeof(Entry);
+
+        for (auto& pairs : classPairs)
+        {
+            usage += pairs.rightClasses.capacity() * sizeof(U16) + pairs.values.capacity() * sizeof(I16);
+        }
+
+        usage += leftClassOffsets.capacity() * sizeof(U32) + leftClasses.capacity() * sizeof(LeftClass);
+
+        return usage;
+    }
+
+
+    auto FontData::CompileKerning() const -> CompiledKerning
+    {
+        CompiledKerning kerning;
+        Map<U32, I16> pairs;
+
+        // Shapers ignore kern when GPOS has kerning of its own.
+        if (!CompileGposKerning(pairs, kerning))
+        {
+            CompileKernTable(pairs);
+        }
+
+        if (pairs.empty())
+        {
+            return kerning;
+        }
+
+        auto slotBits = 1u;
+        while ((1ull << slotBits) < 2 * pairs.size())
+        {
+            slotBits += 1;
+        }
+
+        kerning.entries.resize(1ull << slotBits);
+        kerning.hashShift = 32 - slotBits;
+        auto mask = U32(kerning.entries.size() - 1);
+
+        for (auto [key, value] : pairs)
+        {
+            auto slot = kerning.Hash(key);
+
+            while (kerning.entries[slot].key != CompiledKerning::EMPTY_KEY)
+            {
+                slot = (slot + 1) & mask;
+            }
+
+            kerning.entries[slot] = CompiledKerning::Entry{ .key = key, .value = value };
+        }
+
+        return kerning;
+    }
+
+
+    auto FontData::ReadGposU16(U64 offset) const -> U16
+    {
+        if (offset + 2 > gposTable.length)
+        {
+            return 0;
+        }
+
+        return FromBE(*(const U16*)(data.data() + gposTable.offset + offset));
+    }
+
+
+    template <typename TVisitor>
+    auto FontData::ForEachCoveredGlyph(U64 coverageOffset, TVisitor&& visitor) const -> V
+    {
+        auto format = ReadGposU16(coverageOffset);
+        auto count = U32(ReadGposU16(coverageOffset + 2));
+
+        // Calls visitor with the glyph and its coverage index.
+        if (format == 1)
+        {
+            for (auto i = 0u; i < count && coverageOffset + 4 + 2 * i < gposTable.length; ++i)
+            {
+                visitor(U32(ReadGposU16(coverageOffset + 4 + 2 * i)), i);
+            }
+        }
+        else if (format == 2)
+        {
+            for (auto i = 0u; i < count && coverageOffset + 4 + 6 * i < gposTable.length; ++i)
+            {
+                auto rangeOffset = coverageOffset + 4 + 6 * i;
+                auto startGlyph = U32(ReadGposU16(rangeOffset));
+                // One past the last glyph, which stays in range even for fonts without glyphs.
+                auto glyphEnd = Min(U32(ReadGposU16(rangeOffset + 2)) + 1, U32(numberOfGlyphs));
+                auto startIndex = U32(ReadGposU16(rangeOffset + 4));
+
+                for (auto glyph = startGlyph; glyph < glyphEnd; ++glyph)
+                {
+                    visitor(glyph, startIndex + glyph - startGlyph);
+                }
+            }
+        }
+    }
+
+
+    auto FontData::ReadClassDefinitions(U64 classDefOffset, U32 classCount) const -> Array<U16>
+    {
+        // Glyphs that aren't listed are in class zero and so are the ones with invalid classes.
+        Array<U16> classes(numberOfGlyphs, 0);
+        auto format = ReadGposU16(classDefOffset);
+
+        auto setClass = [&](U32 glyph, U16 glyphClass)
+        {
+            if (glyph < numberOfGlyphs && glyphClass < classCount)
+            {
+                classes[glyph] = glyphClass;
+            }
+        };
+
+        if (format == 1)
+        {
+            auto startGlyph = U32(ReadGposU16(classDefOffset + 2));
+            auto glyphCount = U32(ReadGposU16(classDefOffset + 4));
+
+            for (auto i = 0u; i < glyphCount && classDefOffset + 6 + 2 * i < gposTable.length; ++i)
+            {
+                setClass(startGlyph + i, ReadGposU16(classDefOffset + 6 + 2 * i));
+            }
+        }
+        else if (format == 2)
+        {
+            auto rangeCount = U32(ReadGposU16(classDefOffset + 2));
+
+            for (auto i = 0u; i < rangeCount && classDefOffset + 4 + 6 * i < gposTable.length; ++i)
+            {
+                auto rangeOffset = classDefOffset + 4 + 6 * i;
+                auto glyphEnd = Min(U32(ReadGposU16(rangeOffset + 2)) + 1, U32(numberOfGlyphs));
+                auto glyphClass = ReadGposU16(rangeOffset + 4);
+
+                for (auto glyph = U32(ReadGposU16(rangeOffset)); glyph < glyphEnd; ++glyph)
+                {
+                    setClass(glyph, glyphClass);
+                }
+            }
+        }
+
+        return classes;
+    }
+
+
+    auto FontData::CompileGposKerning(Map<U32, I16>& pairs, CompiledKerning& kerning) const -> B
+    {
+        static constexpr U16 LOOKUP_TYPE_PAIR = 2;
+        static constexpr U16 LOOKUP_TYPE_EXTENSION = 9;
+        static constexpr U16 VALUE_FORMAT_X_ADVANCE = 0x0004;
+
+        if (gposTable.offset == 0)
+        {
+            return false;
+        }
+
+        auto featureListOffset = U64(ReadGposU16(6));
+        auto lookupListOffset = U64(ReadGposU16(8));
+
+        // The lookups of every kern feature regardless of the script and language, in the order
+        // of the lookup list.
+        Array<U32> lookupIndices;
+        auto featureCount = U32(ReadGposU16(featureListOffset));
+
+        for (auto i = 0u; i < featureCount; ++i)
+        {
+            auto recordOffset = featureListOffset + 2 + 6 * i;
+
+            if (recordOffset + 4 > gposTable.length)
+            {
+                break;
+            }
+
+            if (*(const U32*)(data.data() + gposTable.offset + recordOffset) != FromLE(KERN_TAG_LE))
+            {
+                continue;
+            }
+
+            auto featureOffset = featureListOffset + ReadGposU16(recordOffset + 4);
+            auto lookupCount = U32(ReadGposU16(featureOffset + 2));
+
+            for (auto j = 0u; j < lookupCount; ++j)
+            {
+                lookupIndices.push_back(ReadGposU16(featureOffset + 4 + 2 * j));
+            }
+        }
+
+        if (lookupIndices.empty())
+        {
+            return false;
+        }
+
+        Sort(lookupIndices);
+        lookupIndices.erase(std::unique(lookupIndices.begin(), lookupIndices.end()), lookupIndices.end());
+
+        auto valueRecordSize = [](U16 valueFormat) { return 2 * U32(std::popcount(U32(valueFormat))); };
+        // The x advance follows the x and y placements when they are present.
+        auto xAdvanceOffset = [](U16 valueFormat) { return 2 * U32(std::popcount(U32(valueFormat & 0x3))); };
+
+        auto& classPairs = kerning.classPairs;
+        // The class subtables applying to every left glyph in the lookup order, sorted by glyph
+        // into the index of the compiled kerning at the end.
+        Array<Pair<U32, CompiledKerning::LeftClass>> coveredGlyphs;
+
+        for (auto lookup = 0u; lookup < lookupIndices.size(); ++lookup)
+        {
+            auto lookupIndex = lookupIndices[lookup];
+            auto lookupOffset = lookupListOffset + ReadGposU16(lookupListOffset + 2 + 2 * lookupIndex);
+            auto lookupType = ReadGposU16(lookupOffset);
+            auto subtableCount = U32(ReadGposU16(lookupOffset + 4));
+
+            // The pairs of a lookup are added to the ones of the previous lookups while within
+            // a lookup the first subtable applying to a pair wins. A class subtable applies to
+            // every pair of the left glyphs it covers.
+            Map<U32, I16> lookupPairs;
+            auto firstClassPairs = U32(classPairs.size());
+            // Class of every glyph in the left position for the class subtables of the lookup,
+            // NOT_COVERED if it isn't covered.
+            Array<Array<U16>> lookupLeftClasses;
+
+            // Class subtable of the lookup applying to the left glyph, none if there isn't any.
+            auto findClassPairs = [&](U32 leftGlyph) -> U32
+            {
+                for (auto j = 0u; j < lookupLeftClasses.size(); ++j)
+                {
+                    if (lookupLeftClasses[j][leftGlyph] != CompiledKerning::NOT_COVERED)
+                    {
+                        return j;
+                    }
+                }
+
+                return U32(lookupLeftClasses.size());
+            };
+
+            for (auto i = 0u; i < subtableCount; ++i)
+            {
+                auto subtableOffset = lookupOffset + ReadGposU16(lookupOffset + 6 + 2 * i);
+                auto subtableType = lookupType;
+
+                if (lookupType == LOOKUP_TYPE_EXTENSION)
+                {
+                    subtableType = ReadGposU16(subtableOffset + 2);
+                    subtableOffset += (U32(ReadGposU16(subtableOffset + 4)) << 16) | ReadGposU16(subtableOffset + 6);
+                }
+
+                if (subtableType != LOOKUP_TYPE_PAIR)
+                {
+                    continue;
+                }
+
+                auto format = ReadGposU16(subtableOffset);
+                auto coverageOffset = subtableOffset + ReadGposU16(subtableOffset + 2);
+                auto valueFormat1 = ReadGposU16(subtableOffset + 4);
+                auto valueFormat2 = ReadGposU16(subtableOffset + 6);
+
+                if ((valueFormat1 & VALUE_FORMAT_X_ADVANCE) == 0)
+                {
+                    continue;
+                }
+
+                auto pairValueSize = valueRecordSize(valueFormat1) + valueRecordSize(valueFormat2);
+
+                if (format == 1)
+                {
+                    auto pairSetCount = U32(ReadGposU16(subtableOffset + 8));
+
+                    ForEachCoveredGlyph
+                    (
+                        coverageOffset,
+                        [&](U32 leftGlyph, U32 coverageIndex)
+                        {
+                            if (coverageIndex >= pairSetCount || leftGlyph >= numberOfGlyphs)
+                            {
+                                return;
+                            }
+
+                            // Shadowed by an earlier class subtable of the lookup.
+                            if (findClassPairs(leftGlyph) < lookupLeftClasses.size())
+                            {
+                                return;
+                            }
+
+                            auto pairSetOffset = subtableOffset + ReadGposU16(subtableOffset + 10 + 2 * coverageIndex);
+                            auto pairCount = U32(ReadGposU16(pairSetOffset));
+
+                            for (auto j = 0u; j < pairCount; ++j)
+                            {
+                                auto recordOffset = pairSetOffset + 2 + U64(j) * (2 + pairValueSize);
+
+                                if (recordOffset >= gposTable.length)
+                                {
+                                    break;
+                                }
+
+                                auto rightGlyph = U32(ReadGposU16(recordOffset));
+                                auto value = I16(ReadGposU16(recordOffset + 2 + xAdvanceOffset(valueFormat1)));
+                                lookupPairs.emplace((leftGlyph << 16) | rightGlyph, value);
+                            }
+                        }
+                    );
+                }
+                else if (format == 2)
+                {
+                    auto leftClassCount = U32(ReadGposU16(subtableOffset + 12));
+                    auto rightClassCount = U32(ReadGposU16(subtableOffset + 14));
+
+                    // The records have to fit in the table which also bounds the size of the matrix.
+                    if
+                    (
+                        leftClassCount == 0 ||
+                        rightClassCount == 0 ||
+                        subtableOffset + 16 + U64(leftClassCount) * rightClassCount * pairValueSize > gposTable.length
+                    )
+                    {
+                        continue;
+                    }
+
+                    CompiledKerning::ClassPairs subtablePairs;
+                    auto classDefinitions = ReadClassDefinitions(subtableOffset + ReadGposU16(subtableOffset + 8), leftClassCount);
+                    subtablePairs.rightClasses = ReadClassDefinitions(subtableOffset + ReadGposU16(subtableOffset + 10), rightClassCount);
+                    subtablePairs.rightClassCount = rightClassCount;
+
+                    // Only the covered glyphs keep their class.
+                    Array<U16> leftClasses(numberOfGlyphs, CompiledKerning::NOT_COVERED);
+                    ForEachCoveredGlyph
+                    (
+                        coverageOffset,
+                        [&](U32 leftGlyph, U32)
+                        {
+                            if (leftGlyph < numberOfGlyphs)
+                            {
+                                leftClasses[leftGlyph] = classDefinitions[leftGlyph];
+                            }
+                        }
+                    );
+                    lookupLeftClasses.push_back(std::move(leftClasses));
+
+                    subtablePairs.values.resize(leftClassCount * rightClassCount);
+                    auto recordsOffset = subtableOffset + 16 + xAdvanceOffset(valueFormat1);
+
+                    for (auto j = 0u; j < subtablePairs.values.size(); ++j)
+                    {
+                        subtablePairs.values[j] = I16(ReadGposU16(recordsOffset + U64(j) * pairValueSize));
+                    }
+
+                    classPairs.push_back(std::move(subtablePairs));
+                }
+            }
+
+            // The listed pairs replace what the class subtables of the lookup would give them,
+            // which is added back for every lookup below.
+            for (auto [key, value] : lookupPairs)
+            {
+                auto leftGlyph = key >> 16;
+                auto rightGlyph = key & 0xFFFF;
+                auto j = findClassPairs(leftGlyph);
+                auto classValue = 0;
+
+                if (j < lookupLeftClasses.size())
+                {
+                    auto& subtablePairs = classPairs[firstClassPairs + j];
+                    auto rightClass = rightGlyph < subtablePairs.rightClasses.size() ? subtablePairs.rightClasses[rightGlyph] : 0u;
+                    classValue = subtablePairs.values[lookupLeftClasses[j][leftGlyph] * subtablePairs.rightClassCount + rightClass];
+                }
+
+                pairs[key] += I16(value - classValue);
+            }
+
+            if (!lookupLeftClasses.empty())
+            {
+                for (auto leftGlyph = 0u; leftGlyph < numberOfGlyphs; ++leftGlyph)
+                {
+                    auto j = findClassPairs(leftGlyph);
+
+                    if (j < lookupLeftClasses.size())
+                    {
+                        auto firstValue = lookupLeftClasses[j][leftGlyph] * classPairs[firstClassPairs + j].rightClassCount;
+                        coveredGlyphs.push_back({leftGlyph, {firstClassPairs + j, firstValue}});
+                    }
+                }
+            }
+        }
+
+        // Counting sort by left glyph which keeps the lookup order of the class subtables of a glyph.
+        if (!coveredGlyphs.empty())
+        {
+            kerning.leftClassOffsets.assign(numberOfGlyphs + 1, 0);
+
+            for (auto& [leftGlyph, leftClass] : coveredGlyphs)
+            {
+                ++kerning.leftClassOffsets[leftGlyph + 1];
+            }
+
+            for (auto i = 0u; i < numberOfGlyphs; ++i)
+            {
+                kerning.leftClassOffsets[i + 1] += kerning.leftClassOffsets[i];
+            }
+
+            kerning.leftClasses.resize(coveredGlyphs.size());
+            auto nextLeftClasses = kerning.leftClassOffsets;
+
+            for (auto& [leftGlyph, leftClass] : coveredGlyphs)
+            {
+                kerning.leftClasses[nextLeftClasses[leftGlyph]++] = leftClass;
+            }
+        }
+
+        // Pairs listed by some lookups still get the class kerning of the others.
+        for (auto& [key, value] : pairs)
+        {
+            value += I16(kerning.GetClassValue(key >> 16, key & 0xFFFF));
+        }
+
+        return true;
+    }
+
+
+    auto FontData::CompileKernTable(Map<U32, I16>& pairs) const -> V
+    {
+        static constexpr U16 COVERAGE_HORIZONTAL = 0x0001;
+        static constexpr U16 COVERAGE_MINIMUM = 0x0002;
+        static constexpr U16 COVERAGE_CROSS_STREAM = 0x0004;
+        static constexpr U16 APPLE_COVERAGE_VERTICAL = 0x8000;
+        static constexpr U16 APPLE_COVERAGE_CROSS_STREAM = 0x4000;
+        static constexpr U16 APPLE_COVERAGE_VARIATION = 0x2000;
+
+        auto readU16 = [&](U64 offset) -> U16
+        {
+            return offset + 2 <= kernTable.length ? FromBE(*(const U16*)(data.data() + kernTable.offset + offset)) : 0;
+        };
+
+        if (kernTable.offset == 0)
+        {
+            return;
+        }
+
+        // The Microsoft version has 16 bit version and table count while Apple's has 32 bit ones
+        // and different subtable headers. Both store format 0 pairs the same way.
+        auto isApple = readU16(0) == 1;
+        auto tableCount = isApple ? (U32(readU16(4)) << 16) | readU16(6) : U32(readU16(2));
+        auto subtableOffset = U64(isApple ? 8 : 4);
+
+        for (auto i = 0u; i < tableCount && subtableOffset < kernTable.length; ++i)
+        {
+            U64 length;
+            U64 pairsOffset;
+            B isHorizontalFormat0;
+
+            if (isApple)
+            {
+                length = (U32(readU16(subtableOffset)) << 16) | readU16(subtableOffset + 2);
+                auto coverage = readU16(subtableOffset + 4);
+                pairsOffset = subtableOffset + 8;
+                isHorizontalFormat0 =
+                    (coverage & 0xFF) == 0 &&
+                    (coverage & (APPLE_COVERAGE_VERTICAL | APPLE_COVERAGE_CROSS_STREAM | APPLE_COVERAGE_VARIATION)) == 0;
+            }
+            else
+            {
+                length = readU16(subtableOffset + 2);
+                auto coverage = readU16(subtableOffset + 4);
+                pairsOffset = subtableOffset + 6;
+                isHorizontalFormat0 =
+                    (coverage >> 8) == 0 &&
+                    (coverage & (COVERAGE_HORIZONTAL | COVERAGE_MINIMUM | COVERAGE_CROSS_STREAM)) == COVERAGE_HORIZONTAL;
+            }
+
+            if (isHorizontalFormat0)
+            {
+                auto pairCount = U32(readU16(pairsOffset));
+
+                // Subtables add up.
+                for (auto j = 0u; j < pairCount && pairsOffset + 8 + 6 * U64(j) < kernTable.length; ++j)
+                {
+                    auto pairOffset = pairsOffset + 8 + 6 * U64(j);
+                    auto key = (U32(readU16(pairOffset)) << 16) | readU16(pairOffset + 2);
+                    pairs[key] += I16(readU16(pairOffset + 4));
+                }
+            }
+
+            // The 16 bit length of Microsoft subtables overflows for big ones, which only works
+            // out when that is the last one.
+            subtableOffset += Max(length, U64(6));
+        }
+    }
+
+
+    auto FontData::GetHorizontalMetrics() const -> const HorizontalMetrics*
+    {
+        return horizontalMetrics.get();
+    }
+
+
+    auto FontData::GetAdvanceWidth(U32 glyphIndex) const -> U16
+    {
+        if (horizontalMetrics != nullptr)
+        {
+            return glyphIndex < numberOfGlyphs ? horizontalMetrics->advanceWidths[glyphIndex] : 0;
+        }
+
+        if (glyphIndex >= numberOfGlyphs || numberOfLongHorizontalMetrics == 0)
+        {
+            return 0;
+        }
+
+        // The glyphs after the long metrics share the advance width of the last one.
+        auto metricIndex = Min(glyphIndex, U32(numberOfLongHorizontalMetrics - 1));
+        return FromBE(*(const U16*)(data.data() + hmtxTable.offset + 4 * metricIndex));
+    }
+
+
+    auto FontData::GetLeftSideBearing(U32 glyphIndex) const -> I16
+    {
+        if (horizontalMetrics != nullptr)
+        {
+            return glyphIndex < numberOfGlyphs ? horizontalMetrics->leftSideBearings[glyphIndex] : 0;
+        }
+
+        if (glyphIndex >= numberOfGlyphs)
+        {
+            return 0;
+        }
+
+        if (glyphIndex < numberOfLongHorizontalMetrics)
+        {
+            return FromBE(*(const I16*)(data.data() + hmtxTable.offset + 4 * glyphIndex + 2));
+        }
+
+        auto bearingOffset = 4 * U32(numberOfLongHorizontalMetrics) + 2 * (glyphIndex - numberOfLongHorizontalMetrics);
+        return FromBE(*(const I16*)(data.data() + hmtxTable.offset + bearingOffset));
+    }
+
+
+    auto FontData::DecodeHorizontalMetrics() const -> HorizontalMetrics
+    {
+        HorizontalMetrics metrics;
+        metrics.advanceWidths.resize(numberOfGlyphs);
+        metrics.leftSideBearings.resize(numberOfGlyphs);
+
+        for (auto glyphIndex = 0u; glyphIndex < numberOfGlyphs; ++glyphIndex)
+        {
+            metrics.advanceWidths[glyphIndex] = GetAdvanceWidth(glyphIndex);
+            metrics.leftSideBearings[glyphIndex] = GetLeftSideBearing(glyphIndex);
+        }
+
+        return metrics;
+    }
+
+
+    auto FontData::CompileCmap() const -> CompiledCmap
+    {
+        CompiledCmap compiledCmap;
+
+        // We only enumerate the ranges covered by the subtable and let the per format lookups
+        // resolve the actual indices, so the compiled table can't disagree with them.
+        auto compileRange = [&](U32 first, U32 last)
+        {
+            last = Min(last, CompiledCmap::MAX_CODEPOINT);
+
+            for (auto codepoint = first; codepoint <= last; ++codepoint)
+            {
+                compiledCmap.Set(codepoint, U16(GetCharIndexUncompiled(I32(codepoint))));
+            }
+        };
+
+        switch (charEncodingFormat)
+        {
+            case 4:
+            {
+                auto segCountX2 = FromBE(*(const U16*)(data.data() + indexMapOffset + 4));
+                auto endCodesOffset = indexMapOffset + 12;
+                auto startCodesOffset = endCodesOffset + segCountX2 + 2;
+
+                for (auto i = 0u; i < segCountX2; i += 2)
+                {
+                    auto endCode = FromBE(*(const U16*)(data.data() + endCodesOffset + i));
+                    auto startCode = FromBE(*(const U16*)(data.data() + startCodesOffset + i));
+
+                    if (startCode <= endCode)
+                    {
+                        compileRange(startCode, endCode);
+                    }
+                }
+                break;
+            }
+            case 6:
+            {
+                auto firstCode = FromBE(*(const U16*)(data.data() + indexMapOffset + 4));
+                auto codeCount = FromBE(*(const U16*)(data.data() + indexMapOffset + 6));
+
+                if (codeCount > 0)
+                {
+                    compileRange(firstCode, U32(firstCode) + codeCount - 1);
+                }
+                break;
+            }
+            case 12:
+            {
+                auto groupCount = FromBE(*(const U32*)(data.data() + indexMapOffset + 10));
+                auto groupsOffset = indexMapOffset + 14;
+
+                for (auto i = 0u; i < groupCount; ++i)
+                {
+                    auto groupPtr = (const U32*)(data.data() + groupsOffset + 12 * i);
+                    auto startCode = FromBE(groupPtr[0]);
+                    auto endCode = FromBE(groupPtr[1]);
+
+                    if (startCode <= endCode && startCode <= CompiledCmap::MAX_CODEPOINT)
+                    {
+                        compileRange(startCode, endCode);
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        // Make sure that lookups never have to deal with an empty page array.
+        if (compiledCmap.IsEmpty())
+        {
+            compiledCmap.Set(0, 0);
+        }
+
+        compiledCmap.directory.shrink_to_fit();
+        compiledCmap.pages.shrink_to_fit();
+
+        return compiledCmap;
+    }
+
+
+    auto FontData::FetchGlyphDataForCodepoint(I32 codepoint) const -> GlyphData
+    {
+        return FetchGlyphData(GetCharIndex(codepoint));
+    }
+
+
+    auto FontData::FetchGlyphDataForCodepoint(I32 codepoint, GlyphDecodeScratch& scratch, GlyphData& output) const -> V
+    {
+        FetchGlyphData(GetCharIndex(codepoint), scratch, output);
+    }
+
+
+    inline auto FontData::CheckFontVersion(U32 v) const -> FontVersion
+    {
+        if (v == FromLE(0x00000100u))
+        {
+            return FontVersion::OpenType10;
+        }
+        else if (v == FromLE(0x65757274u))
+        {
+            return FontVersion::AppleTTF;
+        }
+        else if (v == 0x4F54544F)
+        {
+            return FontVersion::OpenTypeCCF;
+        }
+        else if (v == 0x31707974)
+        {
+            return FontVersion::OldPostScript;
+        }
+        else if (v == FromLE(0x66637474u))
+        {
+            return FontVersion::Collection;
+        }
+        else
+        {
+            return FontVersion::Unsupported;
+        }
+    }
+
+
+    auto FontData::ParseContents(U32 faceIndex, B validate) -> Error
+    {
+        struct CollectionHeader
+        {
+            U32 tag;
+            U16 majorVersion;
+            U16 minorVersion;
+            U32 faceCount;
+        };
+
+        if (data.size() < sizeof(OffsetTable))
+        {
+            return Error::UnsupportedFormat;
+        }
+
+        auto offsetTable = (const OffsetTable*)data.data();
+
+        auto version = CheckFontVersion(offsetTable->version);
+
+        if (version == FontVersion::Collection)
+        {
+            auto headerPtr = (const CollectionHeader*)data.data();
+
+            if (faceIndex >= FromBE(headerPtr->faceCount))
+            {
+                return Error::InvalidFaceIndex;
+            }
+
+            if (sizeof(CollectionHeader) + 4 * (U64(faceIndex) + 1) > data.size())
+            {
+                return Error::InvalidTableDirectory;
+            }
+
+            // The table offsets of the faces are relative to the beginning of the collection so
+            // only the offset table moves.
+            auto faceOffsetsPtr = (const U32*)(data.data() + sizeof(CollectionHeader));
+            fontOffset = FromBE(faceOffsetsPtr[faceIndex]);
+
+            if (U64(fontOffset) + sizeof(OffsetTable) > data.size())
+            {
+                return Error::UnsupportedFormat;
+            }
+
+            offsetTable = (const OffsetTable*)(data.data() + fontOffset);
+            version = CheckFontVersion(offsetTable->version);
+        }
+
+        tableCount = FromBE(offsetTable->numTables);
+
+        if (validate)
+        {
+            auto status = ValidateTableDirectory();
+
+            if (status != Error::Success)
+            {
+                return status;
+            }
+        }
+
+        switch (version)
+        {
+            case FontVersion::OpenType10:
+            case FontVersion::AppleTTF:
+                return ParseTtOutlinesFont();
+            case FontVersion::OpenTypeCCF:
+                return ParseCffOutlinesFont();
+            default:
+                return Error::UnsupportedFormat;
+        }
+
+        return Error::Success;
+    }
+
+
+    auto FontData::ParseTtOutlinesFont() -> Error
+    {
+        auto status = ParseTtfContainedFont();
+
+        if (status != Error::Success)
+        {
+            return status;
+        }
+
+        glyfTable = FindTable(FromLE(GLYF_TAG_LE));
+        locaTable = FindTable(FromLE(LOCA_TAG_LE));
+
+        if (glyfTable.offset == 0)
+        {
+            return Error::NoGlyfTable;
+        }
+
+        if (locaTable.offset == 0)
+        {
+            return Error::NoLocaTable;
+        }
+
+        return Error::Success;
+    }
+
+
+    auto FontData::ParseCffOutlinesFont() -> Error
+    {
+        auto status = ParseTtfContainedFont();
+
+        if (status != Error::Success)
+        {
+            return status;
+        }
+
+        cffTable = FindTable(FromLE(CFF_TAG_LE));
+
+        if (cffTable.offset == 0)
+        {
+            cffTable = FindTable(FromLE(CFF2_TAG_LE));
+        }
+
+        if (cffTable.offset == 0)
+        {
+            return Error::NoCFFTable;
+        }
+
+        return ParseCffTable();
+    }
+
+
+    auto FontData::FindTable(U32 tag) const -> Location
+    {
+        static constexpr U32 stride = sizeof(TableDirectoryEntry);
+        auto initOffset = fontOffset + U32(sizeof(OffsetTable));
+
+        for(auto k = 0u; k < tableCount; ++k)
+        {
+            auto currentOffset  = initOffset + k * stride;
+
+            if (*(const U32*)((const Byte*) data.data() + currentOffset) == tag)
+            {
+                // TODO: provide support for computing table checksums
+                auto tdePtr = (const TableDirectoryEntry*) ((const Byte*)data.data() + currentOffset);
+
+                return Location
+                {
+                    .offset = FromBE(tdePtr->offset),
+                    .length = FromBE(tdePtr->length)
+                };
+            }
+        }
+
+        return Location{ .offset = 0, .length = 0 };
+    }
+
+
+    auto FontData::ValidateTableDirectory() const -> Error
+    {
+        static constexpr U32 stride = sizeof(TableDirectoryEntry);
+        auto directoryOffset = U64(fontOffset) + sizeof(OffsetTable);
+
+        if (directoryOffset + U64(tableCount) * stride > data.size())
+        {
+            return Error::InvalidTableDirectory;
+        }
+
+        for (auto k = 0u; k < tableCount; ++k)
+        {
+            auto tdePtr = (const TableDirectoryEntry*)(data.data() + directoryOffset + k * stride);
+
+            if (U64(FromBE(tdePtr->offset)) + FromBE(tdePtr->length) > data.size())
+            {
+                return Error::InvalidTableDirectory;
+            }
+        }
+
+        // The fixed size parts of the tables read while loading. Missing tables are reported
+        // later with their own errors.
+        struct MinimumLength
+        {
+            U32 tag;
+            U32 length;
+        };
+
+        static constexpr MinimumLength minimumLengths[] =
+        {
+            { HEAD_TAG_LE, 54 },
+            { HHEA_TAG_LE, 36 },
+            { MAXP_TAG_LE, 6 },
+            { CMAP_TAG_LE, 4 },
+        };
+
+        for (auto minimumLength : minimumLengths)
+        {
+            auto table = FindTable(FromLE(minimumLength.tag));
+
+            if (table.offset != 0 && table.length < minimumLength.length)
+            {
+                return Error::InvalidTableLength;
+            }
+        }
+
+        // Every cmap encoding record and the format of the subtable it points to.
+        auto cmap = FindTable(FromLE(CMAP_TAG_LE));
+
+        if (cmap.offset != 0)
+        {
+            auto subtableCount = FromBE(*(const U16*)(data.data() + cmap.offset + 2));
+
+            if (4 + 8 * U32(subtableCount) > cmap.length)
+            {
+                return Error::InvalidCmapTable;
+            }
+
+            for (auto k = 0u; k < subtableCount; ++k)
+            {
+                auto subtableOffset = FromBE(*(const U32*)(data.data() + cmap.offset + 4 + 8 * k + 4));
+
+                if (U64(subtableOffset) + 2 > cmap.length)
+                {
+                    return Error::InvalidCmapTable;
+                }
+            }
+        }
+
+        return Error::Success;
+    }
+
+
+    auto FontData::ValidateTables() const -> Error
+    {
+        auto status = ValidateCmapSubtable();
+
+        if (status != Error::Success)
+        {
+            return status;
+        }
+
+        // The long metrics are followed by left side bearings for the remaining glyphs.
+        if
+        (
+            numberOfLongHorizontalMetrics == 0 ||
+            numberOfLongHorizontalMetrics > numberOfGlyphs ||
+            4 * U32(numberOfLongHorizontalMetrics) + 2 * U32(numberOfGlyphs - numberOfLongHorizontalMetrics) > hmtxTable.length
+        )
+        {
+            return Error::InvalidTableLength;
+        }
+
+        return Error::Success;
+    }
+
+
+    auto FontData::ValidateCmapSubtable() const -> Error
+    {
+        auto readU16 = [&](U64 offset) { return FromBE(*(const U16*)(data.data() + offset)); };
+        auto readU32 = [&](U64 offset) { return FromBE(*(const U32*)(data.data() + offset)); };
+
+        // Subtable lengths are often wrong so everything is checked against the end of cmap.
+        auto subtableOffset = U64(indexMapOffset) - 2;
+        auto cmapEnd = U64(cmapTable.offset) + cmapTable.length;
+
+        if (charEncodingFormat == 4)
+        {
+            if (subtableOffset + 14 > cmapEnd)
+            {
+                return Error::InvalidCmapTable;
+            }
+
+            auto segCountX2 = U32(readU16(subtableOffset + 6));
+            auto searchRange = U32(readU16(subtableOffset + 8));
+            auto entrySelector = U32(readU16(subtableOffset + 10));
+            auto rangeShift = U32(readU16(subtableOffset + 12));
+
+            auto endCodesOffset = subtableOffset + 14;
+            auto startCodesOffset = endCodesOffset + segCountX2 + 2;
+            auto deltasOffset = startCodesOffset + segCountX2;
+            auto rangesOffset = deltasOffset + segCountX2;
+
+            // The binary search only stays inside the end codes when its parameters agree with
+            // each other and it only finds the right segment when they are sorted and the last
+            // one ends at 0xFFFF.
+            if
+            (
+                segCountX2 == 0 ||
+                segCountX2 % 2 != 0 ||
+                rangesOffset + segCountX2 > cmapEnd ||
+                entrySelector > 15 ||
+                searchRange != (2u << entrySelector) ||
+                searchRange + rangeShift > segCountX2 ||
+                readU16(endCodesOffset + segCountX2 - 2) != 0xFFFF
+            )
+            {
+                return Error::InvalidCmapTable;
+            }
+
+            for (auto segmentOffset = 0u; segmentOffset < segCountX2; segmentOffset += 2)
+            {
+                auto endCode = U32(readU16(endCodesOffset + segmentOffset));
+                auto startCode = U32(readU16(startCodesOffset + segmentOffset));
+                auto rangeOffset = U32(readU16(rangesOffset + segmentOffset));
+
+                if
+                (
+                    startCode > endCode ||
+                    (segmentOffset > 0 && readU16(endCodesOffset + segmentOffset - 2) >= endCode)
+                )
+                {
+                    return Error::InvalidCmapTable;
+                }
+
+                if (rangeOffset != 0 && rangesOffset + segmentOffset + rangeOffset + 2 * (endCode - startCode) + 2 > cmapEnd)
+                {
+                    return Error::InvalidCmapTable;
+                }
+            }
+        }
+        else if (charEncodingFormat == 6)
+        {
+            if (subtableOffset + 10 > cmapEnd || subtableOffset + 10 + 2 * U64(readU16(subtableOffset + 8)) > cmapEnd)
+            {
+                return Error::InvalidCmapTable;
+            }
+        }
+        else if (charEncodingFormat == 12)
+        {
+            if (subtableOffset + 16 > cmapEnd || subtableOffset + 16 + 12 * U64(readU32(subtableOffset + 12)) > cmapEnd)
+            {
+                return Error::InvalidCmapTable;
+            }
+        }
+
+        return Error::Success;
+    }
+
+
+    auto FontData::DecodeGlyphLocations() const -> GlyphLocations
+    {
+        GlyphLocations glyphLocations;
+        auto locaEntrySize = longLocaIndex ? 4u : 2u;
+
+        if (U64(numberOfGlyphs + 1) * locaEntrySize > locaTable.length)
+        {
+            glyphLocations.status = Error::InvalidLocaTable;
+            return glyphLocations;
+        }
+
+        glyphLocations.locations.resize(numberOfGlyphs);
+
+        auto glyfEnd = U64(glyfTable.offset) + glyfTable.length;
+
+        for (auto glyphIndex = 0u; glyphIndex < numberOfGlyphs; ++glyphIndex)
+        {
+            auto glyphOffset = GetGlyphOffset(glyphIndex);
+            auto nextGlyphOffset = GetGlyphOffset(glyphIndex + 1);
+
+            if (nextGlyphOffset < glyphOffset || nextGlyphOffset > glyfEnd)
+            {
+                glyphLocations.locations.clear();
+                glyphLocations.status = Error::InvalidLocaTable;
+                return glyphLocations;
+            }
+
+            auto glyph = Location{ .offset = glyphOffset, .length = nextGlyphOffset - glyphOffset };
+
+            if (!ValidateGlyph(glyph))
+            {
+                glyphLocations.locations.clear();
+                glyphLocations.status = Error::InvalidGlyphData;
+                return glyphLocations;
+            }
+
+            glyphLocations.locations[glyphIndex] = glyph;
+        }
+
+        return glyphLocations;
+    }
+
+
+    auto FontData::ValidateGlyph(Location glyph) const -> B
+    {
+        if (glyph.length == 0)
+        {
+            return true;
+        }
+
+        if (glyph.length < sizeof(GlyfHeader))
+        {
+            return false;
+        }
+
+        auto end = U64(glyph.offset) + glyph.length;
+        auto offset = U64(glyph.offset) + sizeof(GlyfHeader);
+        auto readU16 = [&](U64 at) { return FromBE(*(const U16*)(data.data() + at)); };
+        auto numberOfContours = I16(readU16(glyph.offset));
+
+        if (numberOfContours > 0)
+        {
+            if (offset + 2 * U64(numberOfContours) + 2 > end)
+            {
+                return false;
+            }
+
+            // Every contour needs at least one point.
+            auto previousEndPoint = -1;
+
+            for (auto i = 0; i < numberOfContours; ++i)
+            {
+                auto endPoint = I32(readU16(offset + 2 * i));
+
+                if (endPoint <= previousEndPoint)
+                {
+                    return false;
+                }
+
+                previousEndPoint = endPoint;
+            }
+
+            offset += 2 * numberOfContours;
+            offset += 2 + readU16(offset);
+
+            // Walks the flags summing the sizes of the coordinates they describe.
+            auto pointCount = U32(previousEndPoint + 1);
+            auto coordinatesLength = U64(0);
+            auto i = 0u;
+
+            while (i < pointCount)
+            {
+                if (offset >= end)
+                {
+                    return false;
+                }
+
+                auto flag = data[offset];
+                auto runLength = 1u;
+                offset += 1;
+
+                if ((flag & GLYPH_FLAG_REPEAT) > 0)
+                {
+                    if (offset >= end)
+                    {
+                        return false;
+                    }
+
+                    runLength += data[offset];
+                    offset += 1;
+                }
+
+                runLength = Min(runLength, pointCount - i);
+                i += runLength;
+
+                auto xLength = (flag & GLYPH_FLAG_X_SHORT_VECTOR) > 0 ? 1 : (flag & GLYPH_FLAG_X_SAME_OR_POSITIVE) > 0 ? 0 : 2;
+                auto yLength = (flag & GLYPH_FLAG_Y_SHORT_VECTOR) > 0 ? 1 : (flag & GLYPH_FLAG_Y_SAME_OR_POSITIVE) > 0 ? 0 : 2;
+                coordinatesLength += runLength * (xLength + yLength);
+            }
+
+            return offset + coordinatesLength <= end;
+        }
+        else if (numberOfContours < 0)
+        {
+            auto moreComponents = true;
+
+            while (moreComponents)
+            {
+                if (offset + 4 > end)
+                {
+                    return false;
+                }
+
+                auto flags = readU16(offset);
+                moreComponents = (flags & COMPONENT_MORE_COMPONENTS) > 0;
+                offset += 4;
+                offset += (flags & COMPONENT_ARG_1_AND_2_ARE_WORDS) > 0 ? 4 : 2;
+
+                if ((flags & COMPONENT_WE_HAVE_A_SCALE) > 0)
+                {
+                    offset += 2;
+                }
+                else if ((flags & COMPONENT_WE_HAVE_AN_X_AND_Y_SCALE) > 0)
+                {
+                    offset += 4;
+                }
+                else if ((flags & COMPONENT_WE_HAVE_A_TWO_BY_TWO) > 0)
+                {
+                    offset += 8;
+                }
+
+                if (offset > end)
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+
+    auto FontData::ParseTtfContainedFont() -> Error
+    {
+        #define MTTF_GET_TABLES(VAR_NAME, TAG, ERROR) \
+            VAR_NAME = FindTable(FromLE(TAG)); \
+            if (VAR_NAME.offset == 0) \
+            { \
+                return ERROR; \
+            } \
+        
+        MTTF_GET_TABLES(cmapTable, CMAP_TAG_LE, Error::NoCmapTable);
+        MTTF_GET_TABLES(nameTable, NAME_TAG_LE, Error::NoNameTable);
+        MTTF_GET_TABLES(maxpTable, MAXP_TAG_LE, Error::NoMaxpTable);
+        MTTF_GET_TABLES(hheaTable, HHEA_TAG_LE, Error::NoHheaTable);
+        MTTF_GET_TABLES(headTable, HEAD_TAG_LE, Error::NoHeadTable);
+        MTTF_GET_TABLES(hmtxTable, HMTX_TAG_LE, Error::NoHmtxTable);
+
+        // Optional tables.
+        kernTable = FindTable(FromLE(KERN_TAG_LE));
+        gposTable = FindTable(FromLE(GPOS_TAG_LE));
+
+        // The glyph count is the only thing we need from maxp. It follows the version.
+        numberOfGlyphs = FromBE(*(const U16*)(data.data() + maxpTable.offset + 4));
+
+        auto status = GetIdxDataTableFromCmap();
+
+        if (status != Error::Success)
+        {
+            return status;
+        }
+
+        status = FetchGlobalInfoFromHead();
+
+        if (status != Error::Success)
+        {
+            return status;
+        }
+
+        return FetchGlobalInfoFromHhea();
+    }
+
+
+    auto FontData::FetchGlobalInfoFromHead() -> Error
+    {
+        struct HeadTable1 
+        {
+            U32 version;
+            U32 fontRevision;
+            U32 checksumAdjustment;
+            U32 magicNumber;
+            U16 flags;
+            U16 unitsPerEm;
+        };
+
+        struct HeadTable2 
+        {
+            I64 created;
+            I64 modified;
+            I16 xMin;
+            I16 yMin;
+            I16 xMax;
+            I16 yMax;
+            U16 macStyle;
+            U16 unused;
+            I16 fontDirectionJint;
+            I16 indexToLocaFormat;
+            I16 glyphDataFormat;
+        };
+
+        auto headTable1Ptr = (const HeadTable1*)(data.data() + headTable.offset);
+        auto headTable2Ptr = (const HeadTable2*)(data.data() + headTable.offset + sizeof(HeadTable1));
+
+        if (FromBE(headTable1Ptr->version) != 0x00010000) 
+        {
+            return Error::UnsupportedLocaTableVersion;
+        }
+        else
+        {
+            xMin = FromBE(headTable2Ptr->xMin);
+            yMin = FromBE(headTable2Ptr->yMin);
+            xMax = FromBE(headTable2Ptr->xMax);
+            yMax = FromBE(headTable2Ptr->yMax);
+            unitsPerEm = FromBE(headTable1Ptr->unitsPerEm);
+
+            switch(FromBE(headTable2Ptr->indexToLocaFormat))
+            {
+                case 0:
+                    longLocaIndex = false;
+                    return Error::Success;
+                case 1:
+                    longLocaIndex = true;
+                    return Error::Success;
+                default:
+                    return Error::UnsupportedLocaTableIndex;
+            }
+        }
+    }
+
+
+    auto FontData::FetchGlobalInfoFromHhea() -> Error
+    {
+        struct HheaTable
+        {
+            U32 version;
+            I16 ascent;
+            I16 descent;
+            I16 lineGap;
+            U16 advanceWidthMax;
+            I16 minLeftSideBearing;
+            I16 minRightSideBearing;
+            // "The extent is the distance from the left side bearing to the right most positions 
+            // in the glyph outline." 
+            //    - https://developer.apple.com/fonts/TrueType-Reference-Manual/RM06/Chap6hhea.html
+            I16 xMaxExtent;
+            I16 caretSlopeRise;
+            I16 caretSoloRun;
+            I16 caretOffset;
+            I16 reserved0;
+            I16 reserved1;
+            I16 reserved2;
+            I16 reserved3;
+            I16 metricDataFormat;
+            U16 numberOfLongHorizontalMetrics;
+        };
+
+
+        auto hheaTablePtr  = (const HheaTable*)(data.data() + hheaTable.offset);
+
+        if (FromBE(hheaTablePtr->version) != 0x00010000)
+        {
+            return Error::UnsupportedHheaTableVersion;
+        }
+
+        ascent = FromBE(hheaTablePtr->ascent);
+        descent = FromBE(hheaTablePtr->descent);
+        lineGap = FromBE(hheaTablePtr->lineGap);
+        advanceWidthMax = FromBE(hheaTablePtr->advanceWidthMax);
+        numberOfLongHorizontalMetrics = FromBE(hheaTablePtr->numberOfLongHorizontalMetrics);
+
+        return Error::Success;
+    }
+
+
+    auto FontData::GetIdxDataTableFromCmap() -> Error
+    {
+        struct CmapTableHeader
+        {
+            U16 version;
+            U16 subtableCount;
+        };
+
+        struct CmapSubtable
+        {
+            U16 platformId;
+            U16 platformSpecificId;
+            U32 offset;
+        };
+
+        auto cmapHeaderPtr = (const CmapTableHeader*)(data.data() + cmapTable.offset);
+
+        if (cmapHeaderPtr->version != 0)
+        {
+            return Error::UnsupportedFormat;
+        }
+
+        auto subtableCount = FromBE(cmapHeaderPtr->subtableCount);
+
+        this->indexMapOffset = 0;
+
+        for (auto k = 0; k < subtableCount; ++k)
+        {
+            auto offset = this->cmapTable.offset + sizeof(CmapTableHeader) + k * sizeof(CmapSubtable);
+
+            auto subtablePtr = (const CmapSubtable*)(this->data.data() + offset);
+
+            auto platformId = FromBE(subtablePtr->platformId);
+            auto platformSpecificId = FromBE(subtablePtr->platformSpecificId);
+
+            // We support only unicode encodings.
+
+            if (platformId == PLATFORM_ID_UNICODE)
+            {
+                this->indexMapOffset = this->cmapTable.offset + FromBE(subtablePtr->offset);
+                break;
+            }
+
+            if (
+                    platformId == PLATFORM_ID_MICROSOFT &&
+                    (
+                        platformSpecificId == PLATFORM_SPECIFIC_ID_MS_UCS2 ||
+                        platformSpecificId == PLATFORM_SPECIFIC_ID_MS_UCS4
+                    )
+               )
+            {
+                this->indexMapOffset = this->cmapTable.offset + FromBE(subtablePtr->offset);
+            }
+        }
+
+        if (this->indexMapOffset == 0)
+        {
+            return Error::UnsupportedCharEncoding;
+        }
+
+        // We only support format 4, 6 and 12
+        this->charEncodingFormat = FromBE(*(const U16*)(this->data.data() + this->indexMapOffset));
+
+        if (this->charEncodingFormat != 4 && this->charEncodingFormat != 6 && this->charEncodingFormat != 12)
+        {
+            return Error::UnsupportedFormat;
+        }
+
+        this->indexMapOffset += 2;
+        return Error::Success;
+    }
+
+
+    auto FontData::FindCmapRangeFmt4(U32 codepoint) const -> CmapRange
+    {
+        struct Table4
+        {
+            U16 length;
+            U16 unused;
+            U16 segCountX2;
+            U16 searchRange;
+            U16 entrySelector;
+            U16 rangeShift;
+        };
+
+        // Format 4 only covers the basic multilingual plane.
+        if (codepoint > 0xFFFF)
+        {
+            return CmapRange{ .first = 0x10000, .last = ~0u };
+        }
+
+        auto t4Ptr = (const Table4*) (this->data.data() + this->indexMapOffset);
+        auto segCountX2 = FromBE(t4Ptr->segCountX2);
+        auto searchRange = FromBE(t4Ptr->searchRange);
+        auto entrySelector = FromBE(t4Ptr->entrySelector);
+        auto rangeShift = FromBE(t4Ptr->rangeShift);
+
+        auto dataBeginning = this->indexMapOffset + sizeof(Table4);
+
+        auto searchOffset = dataBeginning;
+
+        // Binary search can be performed since segments are sorted by end codepoint
+        if (codepoint >= FromBE(*(const U16*)(this->data.data() + searchOffset + rangeShift)))
+        {
+            searchOffset += rangeShift;
+        }
+
+        searchOffset -= 2;
+
+        for (auto i = 0u; i < entrySelector; ++i)
+        {
+            searchRange /= 2;
+            auto endCodepoint = FromBE(*(const U16*)(this->data.data() + searchOffset + searchRange));
+
+            if (codepoint > endCodepoint)
+            {
+                searchOffset += searchRange;
+            }
+        }
+
+        searchOffset += 2;
+
+        // Now the search_offset should be what we need.
+        auto segment = (searchOffset - dataBeginning) / 2;
+
+        // Two bytes pad after the end codes
+        auto startCodesOffset = dataBeginning + segCountX2 + 2;
+        auto deltasOffset = startCodesOffset + segCountX2;
+        auto rangesOffset = deltasOffset + segCountX2;
+
+        auto segmentEndCode = FromBE(*(const U16*)(this->data.data() + searchOffset));
+        auto segmentStartCode = FromBE(*(const U16*)(this->data.data() + startCodesOffset + 2 * segment));
+        auto segmentRangeOffset = FromBE(*(const U16*)(this->data.data() + rangesOffset + 2 * segment));
+        auto segmentDeltaOffset = FromBE(*(const U16*)(this->data.data() + deltasOffset + 2 * segment));
+
+        if (codepoint < segmentStartCode)
+        {
+            // The gap before the segment is unmapped.
+            return CmapRange{ .first = codepoint, .last = segmentStartCode - 1u };
+        }
+
+        auto range = CmapRange
+        {
+            .first = segmentStartCode,
+            .last = segmentEndCode,
+            .delta = segmentDeltaOffset,
+            .glyphArrayOffset = 0,
+            .mapped = true
+        };
+
+        if (segmentRangeOffset != 0)
+        {
+            // According to the specification we need to use this obscure indexing trick
+            range.glyphArrayOffset = U32(segmentRangeOffset) + rangesOffset + 2 * segment;
+        }
+
+        return range;
+    }
+
+
+    auto FontData::FindCmapRangeFmt6(U32 codepoint) const -> CmapRange
+    {
+        // Skip the first two entries.
+        auto dataBeginning = this->indexMapOffset + 4;
+
+        auto firstCode = FromBE(*(const U16*)(this->data.data() + dataBeginning));
+        dataBeginning += 2;
+        auto code_count = FromBE(*(const U16*)(this->data.data() + dataBeginning));
+        dataBeginning += 2;
+
+        if (codepoint < firstCode)
+        {
+            return CmapRange{ .first = 0, .last = firstCode - 1u };
+        }
+        else if (codepoint >= firstCode + code_count)
+        {
+            return CmapRange{ .first = U32(firstCode) + code_count, .last = ~0u };
+        }
+        else
+        {
+            return CmapRange
+            {
+                .first = firstCode,
+                .last = U32(firstCode) + code_count - 1,
+                .delta = 0,
+                .glyphArrayOffset = dataBeginning,
+                .mapped = true
+            };
+        }
+    }
+
+
+    auto FontData::FindCmapRangeFmt12(U32 codepoint) const -> CmapRange
+    {
+        struct Header
+        {
+            U32 format;
+            U32 length;
+            U32 unused;
+            U32 groupCount;
+        };
+
+        struct Group
+        {
+            U32 startCodepoint;
+            U32 endCodepoint;
+            U32 startCodepointIdx;
+        };
+
+        auto headerPtr = (const Header*)(this->data.data() + this->indexMapOffset - 2);
+
+        auto groupCount = FromBE(headerPtr->groupCount);
+
+        auto groupsOffset = this->indexMapOffset - 2 + sizeof(Header);
+
+        auto searchStart = 0u;
+        auto searchEnd = groupCount;
+
+        while (searchStart < searchEnd)
+        {
+            auto mid = searchStart + (searchEnd - searchStart) / 2;
+
+            auto currentSegmentPtr = (const Group*) (this->data.data() + groupsOffset + mid * sizeof(Group));
+
+            auto startCodepoint = FromBE(currentSegmentPtr->startCodepoint);
+            auto endCodepoint = FromBE(currentSegmentPtr->endCodepoint);
+
+            if (startCodepoint > codepoint)
+            {
+                searchEnd = mid;
+            }
+            else if (endCodepoint < codepoint)
+            {
+                searchStart = mid + 1;
+            }
+            else
+            {
+                return CmapRange
+                {
+                    .first = startCodepoint,
+                    .last = endCodepoint,
+                    .delta = FromBE(currentSegmentPtr->startCodepointIdx) - startCodepoint,
+                    .glyphArrayOffset = 0,
+                    .mapped = true
+                };
+            }
+        }
+
+        // The codepoint falls between the groups before searchStart and the ones after it.
+        auto first = 0u;
+        auto last = ~0u;
+
+        if (searchStart > 0)
+        {
+            auto previousGroupPtr = (const Group*)(this->data.data() + groupsOffset + (searchStart - 1) * sizeof(Group));
+            first = FromBE(previousGroupPtr->endCodepoint) + 1;
+        }
+
+        if (searchStart < groupCount)
+        {
+            auto nextGroupPtr = (const Group*)(this->data.data() + groupsOffset + searchStart * sizeof(Group));
+            last = FromBE(nextGroupPtr->startCodepoint) - 1;
+        }
+
+        return CmapRange{ .first = first, .last = last };
+    }
+
+
+    template <U32 FORMAT>
+    auto FontData::FindCmapRange(U32 codepoint) const -> CmapRange
+    {
+        if constexpr (FORMAT == 4)
+        {
+            return FindCmapRangeFmt4(codepoint);
+        }
+        else if constexpr (FORMAT == 6)
+        {
+            return FindCmapRangeFmt6(codepoint);
+        }
+        else
+        {
+            return FindCmapRangeFmt12(codepoint);
+        }
+    }
+
+
+    template <U32 FORMAT>
+    auto FontData::ResolveCmapRange(const CmapRange& range, U32 codepoint) const -> U32
+    {
+        if (!range.mapped)
+        {
+            return 0;
+        }
+
+        if constexpr (FORMAT == 4)
+        {
+            if (range.glyphArrayOffset == 0)
+            {
+                return (codepoint + range.delta) & 0xFFFFu;
+            }
+
+            auto glyphIndexOffset = range.glyphArrayOffset + 2 * (codepoint - range.first);
+            auto glyphIndex = FromBE(*(const U16*)(this->data.data() + glyphIndexOffset));
+
+            if (glyphIndex != 0)
+            {
+                return (glyphIndex + range.delta) & 0xFFFFu;
+            }
+            else
+            {
+                return glyphIndex;
+            }
+        }
+        else if constexpr (FORMAT == 6)
+        {
+            auto indexOffset = Min(U32(range.glyphArrayOffset + 2 * (codepoint - range.first)), U32(data.size() - 2));
+            return FromBE(*(const U16*)(this->data.data() + indexOffset));
+        }
+        else
+        {
+            return codepoint + range.delta;
+        }
+    }
+
+
+    auto FontData::GetCharIndexFmt4(U32 codepoint) const -> U32
+    {
+        return ResolveCmapRange<4>(FindCmapRangeFmt4(codepoint), codepoint);
+    }
+
+
+    auto FontData::GetCharIndexFmt6(U32 codepoint) const -> U32
+    {
+        return ResolveCmapRange<6>(FindCmapRangeFmt6(codepoint), codepoint);
+    }
+
+
+    auto FontData::GetCharIndexFmt12(U32 codepoint) const -> U32
+    {
+        return ResolveCmapRange<12>(FindCmapRangeFmt12(codepoint), codepoint);
+    }
+
+
+    template <U32 FORMAT>
+    auto FontData::GetCharIndicesForFormat(Span<const I32> codepoints, Span<U32> glyphs) const -> V
+    {
+        // Start with a range that contains only U32 max so the first non ASCII codepoint
+        // triggers a search.
+        auto range = CmapRange{ .first = ~0u, .last = ~0u };
+        auto count = Min(codepoints.size(), glyphs.size());
+        auto i = U64(0);
+
+        while (i < count)
+        {
+            i += MapAsciiCodepoints(codepoints.data() + i, glyphs.data() + i, count - i);
+
+            if (i == count)
+            {
+                break;
+            }
+
+            auto codepoint = U32(codepoints[i]);
+
+            if (codepoint < ASCII_GLYPH_COUNT)
+            {
+                glyphs[i] = asciiGlyphs[codepoint];
+            }
+            else
+            {
+                // Consecutive codepoints very often belong to the same range so we only search
+                // when we leave it. Negative codepoints become huge here and never get mapped.
+                if (codepoint - range.first > range.last - range.first)
+                {
+                    range = FindCmapRange<FORMAT>(codepoint);
+                }
+
+                glyphs[i] = ResolveCmapRange<FORMAT>(range, codepoint);
+            }
+
+            i++;
+        }
+    }
+
+
+    auto FontData::MapAsciiCodepoints(const I32* codepoints, U32* glyphs, U64 count) const -> U64
+    {
+        auto i = U64(0);
+
+        #if defined(__AVX2__)
+            auto notAsciiMask = _mm256_set1_epi32(~I32(ASCII_GLYPH_COUNT - 1));
+
+            for (; i + 8 <= count; i += 8)
+            {
+                auto codepointsBlock = _mm256_loadu_si256((const __m256i*)(codepoints + i));
+
+                if (!_mm256_testz_si256(codepointsBlock, notAsciiMask))
+                {
+                    return i;
+                }
+
+                auto glyphsBlock = _mm256_i32gather_epi32((const int*)asciiGlyphs.data(), codepointsBlock, 4);
+                _mm256_storeu_si256((__m256i*)(glyphs + i), glyphsBlock);
+            }
+        #elif defined(__SSE2__)
+            auto notAsciiMask = _mm_set1_epi32(~I32(ASCII_GLYPH_COUNT - 1));
+            auto zero = _mm_setzero_si128();
+
+            for (; i + 4 <= count; i += 4)
+            {
+                auto codepointsBlock = _mm_loadu_si128((const __m128i*)(codepoints + i));
+                auto ascii = _mm_cmpeq_epi32(_mm_and_si128(codepointsBlock, notAsciiMask), zero);
+
+                if (_mm_movemask_epi8(ascii) != 0xFFFF)
+                {
+                    return i;
+                }
+
+                glyphs[i] = asciiGlyphs[codepoints[i]];
+                glyphs[i + 1] = asciiGlyphs[codepoints[i + 1]];
+                glyphs[i + 2] = asciiGlyphs[codepoints[i + 2]];
+                glyphs[i + 3] = asciiGlyphs[codepoints[i + 3]];
+            }
+        #endif
+
+        return i;
+    }
+
+
+    auto FontData::GetCharIndices(Span<const I32> codepoints, Span<U32> glyphs) const -> V
+    {
+        if (compiledCmap != nullptr)
+        {
+            auto count = Min(codepoints.size(), glyphs.size());
+
+            for (auto i = 0u; i < count; ++i)
+            {
+                glyphs[i] = compiledCmap->Lookup(U32(codepoints[i]));
+            }
+
+            return;
+        }
+
+        switch (charEncodingFormat)
+        {
+            case 4:
+                return GetCharIndicesForFormat<4>(codepoints, glyphs);
+            case 6:
+                return GetCharIndicesForFormat<6>(codepoints, glyphs);
+            case 12:
+                return GetCharIndicesForFormat<12>(codepoints, glyphs);
+            default:
+                return;
+        }
+    }
+
+
+    auto FontData::GetCharIndicesUtf8(Span<const U8> text, Span<U32> glyphs) const -> TextMapping
+    {
+        switch (compiledCmap != nullptr ? 0 : charEncodingFormat)
+        {
+            case 4:
+                return GetCharIndicesForText<4>(text, glyphs);
+            case 6:
+                return GetCharIndicesForText<6>(text, glyphs);
+            case 12:
+                return GetCharIndicesForText<12>(text, glyphs);
+            default:
+                return GetCharIndicesForText<0>(text, glyphs);
+        }
+    }
+
+
+    auto FontData::GetCharIndicesUtf8(StrView text, Span<U32> glyphs) const -> TextMapping
+    {
+        return GetCharIndicesUtf8(Span<const U8>((const U8*)text.data(), text.size()), glyphs);
+    }
+
+
+    auto FontData::GetCharIndicesUtf16(Span<const U16> text, Span<U32> glyphs) const -> TextMapping
+    {
+        switch (compiledCmap != nullptr ? 0 : charEncodingFormat)
+        {
+            case 4:
+                return GetCharIndicesForText<4>(text, glyphs);
+            case 6:
+                return GetCharIndicesForText<6>(text, glyphs);
+            case 12:
+                return GetCharIndicesForText<12>(text, glyphs);
+            default:
+                return GetCharIndicesForText<0>(text, glyphs);
+        }
+    }
+
+
+    template <U32 FORMAT, typename TextUnit>
+    auto FontData::GetCharIndicesForText(Span<const TextUnit> text, Span<U32> glyphs) const -> TextMapping
+    {
+        auto range = CmapRange{ .first = ~0u, .last = ~0u };
+        auto unitIndex = U64(0);
+        auto glyphIndex = U64(0);
+
+        while (unitIndex < text.size() && glyphIndex < glyphs.size())
+        {
+            // ASCII is one code unit per glyph so the prefix is bounded by both spans.
+            auto asciiCount =
+                MapAsciiText
+                (
+                    text.data() + unitIndex,
+                    glyphs.data() + glyphIndex,
+                    Min(text.size() - unitIndex, glyphs.size() - glyphIndex)
+                );
+
+            unitIndex += asciiCount;
+            glyphIndex += asciiCount;
+
+            if (unitIndex == text.size() || glyphIndex == glyphs.size())
+            {
+                break;
+            }
+
+            U32 codepoint;
+
+            if constexpr (sizeof(TextUnit) == 1)
+            {
+                unitIndex += DecodeUtf8Codepoint(text.data() + unitIndex, text.size() - unitIndex, codepoint);
+            }
+            else
+            {
+                unitIndex += DecodeUtf16Codepoint(text.data() + unitIndex, text.size() - unitIndex, codepoint);
+            }
+
+            if constexpr (FORMAT == 0)
+            {
+                glyphs[glyphIndex] = compiledCmap != nullptr ? compiledCmap->Lookup(codepoint) : 0;
+            }
+            else
+            {
+                if (codepoint - range.first > range.last - range.first)
+                {
+                    range = FindCmapRange<FORMAT>(codepoint);
+                }
+
+                glyphs[glyphIndex] = ResolveCmapRange<FORMAT>(range, codepoint);
+            }
+
+            glyphIndex++;
+        }
+
+        return TextMapping{ .unitCount = unitIndex, .glyphCount = glyphIndex };
+    }
+
+
+    template <typename TextUnit>
+    auto FontData::MapAsciiText(const TextUnit* text, U32* glyphs, U64 count) const -> U64
+    {
+        auto i = U64(0);
+
+        #if defined(__AVX2__)
+            constexpr auto BLOCK_UNITS = U64(32 / sizeof(TextUnit));
+            auto notAsciiMask = sizeof(TextUnit) == 1 ? _mm256_set1_epi8(I8(0x80)) : _mm256_set1_epi16(I16(0xFF80));
+
+            for (; i + BLOCK_UNITS <= count; i += BLOCK_UNITS)
+            {
+                auto block = _mm256_loadu_si256((const __m256i*)(text + i));
+
+                if (!_mm256_testz_si256(block, notAsciiMask))
+                {
+                    break;
+                }
+
+                for (auto j = U64(0); j < BLOCK_UNITS; j += 8)
+                {
+                    __m256i indices;
+
+                    if constexpr (sizeof(TextUnit) == 1)
+                    {
+                        indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(text + i + j)));
+                    }
+                    else
+                    {
+                        indices = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(text + i + j)));
+                    }
+
+                    auto glyphsBlock = _mm256_i32gather_epi32((const int*)asciiGlyphs.data(), indices, 4);
+                    _mm256_storeu_si256((__m256i*)(glyphs + i + j), glyphsBlock);
+                }
+            }
+        #elif defined(__SSE2__)
+            constexpr auto BLOCK_UNITS = U64(16 / sizeof(TextUnit));
+            auto notAsciiMask = sizeof(TextUnit) == 1 ? _mm_set1_epi8(I8(0x80)) : _mm_set1_epi16(I16(0xFF80));
+            auto zero = _mm_setzero_si128();
+
+            for (; i + BLOCK_UNITS <= count; i += BLOCK_UNITS)
+            {
+                auto block = _mm_loadu_si128((const __m128i*)(text + i));
+
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(block, notAsciiMask), zero)) != 0xFFFF)
+                {
+                    break;
+                }
+
+                for (auto j = U64(0); j < BLOCK_UNITS; ++j)
+                {
+                    glyphs[i + j] = asciiGlyphs[text[i + j]];
+                }
+            }
+        #endif
+
+        // The rest of the text or the ASCII prefix of the block that had something else.
+        for (; i < count && text[i] < ASCII_GLYPH_COUNT; ++i)
+        {
+            glyphs[i] = asciiGlyphs[text[i]];
+        }
+
+        return i;
+    }
+
+
+    auto FontData::DecodeUtf8Codepoint(const U8* text, U64 count, U32& codepoint) -> U32
+    {
+        auto lead = text[0];
+        U32 length;
+        U32 minimum;
+
+        if (lead < 0x80)
+        {
+            codepoint = lead;
+            return 1;
+        }
+        else if ((lead & 0xE0) == 0xC0)
+        {
+            length = 2;
+            minimum = 0x80;
+            codepoint = lead & 0x1F;
+        }
+        else if ((lead & 0xF0) == 0xE0)
+        {
+            length = 3;
+            minimum = 0x800;
+            codepoint = lead & 0x0F;
+        }
+        else if ((lead & 0xF8) == 0xF0)
+        {
+            length = 4;
+            minimum = 0x10000;
+            codepoint = lead & 0x07;
+        }
+        else
+        {
+            codepoint = REPLACEMENT_CHARACTER;
+            return 1;
+        }
+
+        if (length > count)
+        {
+            codepoint = REPLACEMENT_CHARACTER;
+            return 1;
+        }
+
+        for (auto i = 1u; i < length; ++i)
+        {
+            if ((text[i] & 0xC0) != 0x80)
+            {
+                codepoint = REPLACEMENT_CHARACTER;
+                return 1;
+            }
+
+            codepoint = (codepoint << 6) | (text[i] & 0x3F);
+        }
+
+        // Overlong encodings, surrogates and values past the last plane.
+        if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+        {
+            codepoint = REPLACEMENT_CHARACTER;
+            return 1;
+        }
+
+        return length;
+    }
+
+
+    auto FontData::DecodeUtf16Codepoint(const U16* text, U64 count, U32& codepoint) -> U32
+    {
+        auto unit = U32(text[0]);
+
+        if (unit < 0xD800 || unit > 0xDFFF)
+        {
+            codepoint = unit;
+            return 1;
+        }
+
+        if (unit <= 0xDBFF && count > 1 && text[1] >= 0xDC00 && text[1] <= 0xDFFF)
+        {
+            codepoint = 0x10000 + ((unit - 0xD800) << 10) + (text[1] - 0xDC00u);
+            return 2;
+        }
+
+        // Unpaired surrogate.
+        codepoint = REPLACEMENT_CHARACTER;
+        return 1;
+    }
+
+
+    auto FontData::BuildAsciiGlyphTable() -> V
+    {
+        for (auto codepoint = 0u; codepoint < ASCII_GLYPH_COUNT; ++codepoint)
+        {
+            asciiGlyphs[codepoint] = GetCharIndexUncompiled(I32(codepoint));
+        }
+    }
+
+
+    auto FontData::GetGlyphOffset(U32 glyphIndex) const -> U32
+    {
+        auto offset = this->glyfTable.offset;
+
+        if (this->longLocaIndex)
+        {
+            offset += FromBE(*(const U32*)(this->data.data() + this->locaTable.offset + 4 * glyphIndex));
+        }
+        else
+        {
+            offset += FromBE(*(const U16*)(this->data.data() + this->locaTable.offset + 2 * glyphIndex)) * 2;
+        }
+
+        return offset;
+    }
+
+
+    auto FontData::GetGlyphLocation(U32 glyphIndex) const -> Location
+    {
+        if (glyphLocations != nullptr)
+        {
+            return glyphLocations->locations[glyphIndex];
+        }
+
+        auto glyphOffset = GetGlyphOffset(glyphIndex);
+        return Location{ .offset = glyphOffset, .length = GetGlyphOffset(glyphIndex + 1) - glyphOffset };
+    }
+
+
+    auto FontData::FetchGlyphData(U32 glyphIndex) const -> GlyphData
+    {
+        GlyphData glyphData;
+        GlyphDecodeScratch scratch;
+        FetchGlyphData(glyphIndex, scratch, glyphData);
+        return glyphData;
+    }
+
+
+    auto FontData::FetchGlyphData(U32 glyphIndex, GlyphDecodeScratch& scratch, GlyphData& glyphData) const -> V
+    {
+        glyphData.outline.Clear();
+        glyphData.boundingBoxDiagonal = Line(TTFPoint(0, 0), TTFPoint(0, 0));
+
+        if (glyphIndex >= numberOfGlyphs)
+        {
+            return;
+        }
+
+        // CFF has no per glyph bounding boxes so it is computed from the outline.
+        if (cffTable.offset != 0)
+        {
+            DecodeCffGlyph(glyphIndex, glyphData.outline);
+            glyphData.boundingBoxDiagonal = glyphData.outline.GetBoundingBox();
+            return;
+        }
+
+        auto glyph = this->GetGlyphLocation(glyphIndex);
+
+        // Glyphs without outlines (e.g. space) have no data at all.
+        if (glyph.length == 0)
+        {
+            return;
+        }
+
+        auto glyfHeaderPtr = (const GlyfHeader*)(this->data.data() + glyph.offset);
+
+        auto d0 = TTFPoint(FromBE(glyfHeaderPtr->xMin), FromBE(glyfHeaderPtr->yMin));
+        auto d1 = TTFPoint(FromBE(glyfHeaderPtr->xMax), FromBE(glyfHeaderPtr->yMax));
+
+        glyphData.boundingBoxDiagonal = Line(d0, d1);
+
+        // The scratch arrays only grow so after a few glyphs nothing here allocates.
+        scratch.endPointsOfContours.clear();
+        scratch.flags.clear();
+        scratch.vertices.clear();
+
+        DecodeGlyphPoints(glyphIndex, scratch, 0);
+
+        auto startIndex = 0u;
+
+        for (auto i = 0u; i < scratch.endPointsOfContours.size(); ++i)
+        {
+            // A single point has no area and LoadContour needs at least two.
+            if (scratch.endPointsOfContours[i] == startIndex)
+            {
+                startIndex += 1;
+                continue;
+            }
+
+            startIndex =
+                LoadContour
+                (
+                    glyphData,
+                    Span<const TTFPoint>{scratch.vertices},
+                    Span<const U8>{scratch.flags},
+                    startIndex,
+                    scratch.endPointsOfContours[i]
+                );
+        }
+    }
+
+
+    auto FontData::DecodeGlyphPoints(U32 glyphIndex, GlyphDecodeScratch& scratch, U32 depth) const -> V
+    {
+        if (glyphIndex >= numberOfGlyphs)
+        {
+            return;
+        }
+
+        if (componentCache != nullptr && componentCache->CopyTo(glyphIndex, scratch))
+        {
+            return;
+        }
+
+        auto glyph = this->GetGlyphLocation(glyphIndex);
+
+        if (glyph.length == 0)
+        {
+            return;
+        }
+
+        auto glyfHeaderPtr = (const GlyfHeader*)(this->data.data() + glyph.offset);
+        auto numberOfContours = FromBE(glyfHeaderPtr->numberOfContours);
+        auto currentOffset = U32(glyph.offset + sizeof(GlyfHeader));
+
+        // Simple glyph
+        if (numberOfContours > 0)
+        {
+            DecodeSimpleGlyphPoints(currentOffset, numberOfContours, scratch);
+        }
+        // Compound glyph
+        else if (numberOfContours < 0 && depth < MAX_COMPONENT_DEPTH)
+        {
+            DecodeCompoundGlyphPoints(currentOffset, scratch, depth);
+        }
+    }
+
+
+    auto FontData::DecodeSimpleGlyphPoints(U32 currentOffset, I16 numberOfContours, GlyphDecodeScratch& scratch) const -> V
+    {
+        // The points are appended after the ones already in the scratch so that compound glyphs
+        // can decode their components in place.
+        auto& endPointsOfContours = scratch.endPointsOfContours;
+        auto& flags = scratch.flags;
+        auto& vertices = scratch.vertices;
+
+        auto base = U32(vertices.size());
+        auto contourBase = endPointsOfContours.size();
+        endPointsOfContours.resize(contourBase + numberOfContours);
+
+        auto endPointsOfContoursPtr = (const U16*)(this->data.data() + currentOffset);
+
+        for (auto i = 0; i < numberOfContours; ++i)
+        {
+            endPointsOfContours[contourBase + i] = base + FromBE(endPointsOfContoursPtr[i]);
+        }
+
+        currentOffset += 2 * numberOfContours;
+
+        auto instructionLength = FromBE(*(const U16*)(this->data.data() + currentOffset));
+
+        // Skip instructions;
+        currentOffset += instructionLength + 2;
+
+        auto numberOfVertices = endPointsOfContours.back() + 1 - base;
+
+        flags.resize(base + numberOfVertices);
+        vertices.resize(base + numberOfVertices);
+
+        auto glyphFlags = Span<U8>(flags.data() + base, numberOfVertices);
+        auto glyphVertices = Span<TTFPoint>(vertices.data() + base, numberOfVertices);
+
+        // The coordinates are stored as deltas, all the x ones first and then all the y ones.
+        currentOffset += ExpandGlyphFlags(this->data.subspan(currentOffset), glyphFlags);
+        currentOffset += DecodeGlyphCoordinates(this->data.subspan(currentOffset), glyphFlags, 0, glyphVertices);
+        DecodeGlyphCoordinates(this->data.subspan(currentOffset), glyphFlags, 1, glyphVertices);
+    }
+
+
+    // Expands the flags starting from flags[i] and data[offset]. A repeat count that goes past
+    // the last point is consumed but ignored.
+    auto ExpandGlyphFlagsFrom(Span<const U8> data, Span<U8> flags, U64 i, U32 offset) -> U32
+    {
+        while (i < flags.size())
+        {
+            auto flag = data[offset];
+            auto repeatCount = 0u;
+            offset += 1;
+
+            if ((flag & GLYPH_FLAG_REPEAT) > 0)
+            {
+                repeatCount = data[offset];
+                offset += 1;
+            }
+
+            auto runLength = Min(U64(repeatCount + 1), flags.size() - i);
+            std::memset(flags.data() + i, flag, runLength);
+            i += runLength;
+        }
+
+        return offset;
+    }
+
+
+    auto ExpandGlyphFlagsScalar(Span<const U8> data, Span<U8> flags) -> U32
+    {
+        return ExpandGlyphFlagsFrom(data, flags, 0, 0);
+    }
+
+
+    auto ExpandGlyphFlags(Span<const U8> data, Span<U8> flags) -> U32
+    {
+        auto i = U64(0);
+        auto offset = U32(0);
+
+        // Copies whole blocks of flags that don't repeat and only expands the repeated ones one
+        // at a time. The blocks are stored in full and the part after the first repeated flag
+        // gets overwritten by the expansion.
+        #if defined(__AVX2__)
+            while (i + 32 <= flags.size() && offset + 32 <= data.size())
+            {
+                auto block = _mm256_loadu_si256((const __m256i*)(data.data() + offset));
+                _mm256_storeu_si256((__m256i*)(flags.data() + i), block);
+
+                // Moves the repeat bit of every byte into its sign bit.
+                auto repeatMask = U32(_mm256_movemask_epi8(_mm256_slli_epi16(block, 4)));
+                auto literalCount = repeatMask == 0 ? 32u : U32(std::countr_zero(repeatMask));
+
+                i += literalCount;
+                offset += literalCount;
+
+                if (literalCount < 32)
+                {
+                    auto flag = data[offset];
+                    auto runLength = Min(U64(data[offset + 1]) + 1, flags.size() - i);
+                    std::memset(flags.data() + i, flag, runLength);
+                    i += runLength;
+                    offset += 2;
+                }
+            }
+        #elif defined(__SSE2__)
+            while (i + 16 <= flags.size() && offset + 16 <= data.size())
+            {
+                auto block = _mm_loadu_si128((const __m128i*)(data.data() + offset));
+                _mm_storeu_si128((__m128i*)(flags.data() + i), block);
+
+                auto repeatMask = U32(_mm_movemask_epi8(_mm_slli_epi16(block, 4)));
+                auto literalCount = repeatMask == 0 ? 16u : U32(std::countr_zero(repeatMask));
+
+                i += literalCount;
+                offset += literalCount;
+
+                if (literalCount < 16)
+                {
+                    auto flag = data[offset];
+                    auto runLength = Min(U64(data[offset + 1]) + 1, flags.size() - i);
+                    std::memset(flags.data() + i, flag, runLength);
+                    i += runLength;
+                    offset += 2;
+                }
+            }
+        #endif
+
+        return ExpandGlyphFlagsFrom(data, flags, i, offset);
+    }
+
+
+    // Decodes the coordinates starting from points[i] and data[offset] with previous being the
+    // coordinate of the point before.
+    auto DecodeGlyphCoordinatesFrom
+    (
+        Span<const U8> data,
+        Span<const U8> flags,
+        U32 axis,
+        Span<TTFPoint> points,
+        U64 i,
+        U32 offset,
+        TTFScalar previous
+    ) -> U32
+    {
+        auto shortFlag = U8(GLYPH_FLAG_X_SHORT_VECTOR << axis);
+        auto sameOrPositiveFlag = U8(GLYPH_FLAG_X_SAME_OR_POSITIVE << axis);
+
+        for (; i < points.size(); ++i)
+        {
+            auto delta = I32(0);
+
+            // The short deltas are unsigned bytes with the sign in the flags while the long ones
+            // are signed shorts that can be omitted when they are zero.
+            if ((flags[i] & shortFlag) > 0)
+            {
+                delta = (flags[i] & sameOrPositiveFlag) > 0 ? I32(data[offset]) : -I32(data[offset]);
+                offset += 1;
+            }
+            else if ((flags[i] & sameOrPositiveFlag) == 0)
+            {
+                delta = I16((U16(data[offset]) << 8) | data[offset + 1]);
+                offset += 2;
+            }
+
+            previous = TTFScalar(previous + delta);
+            (axis == 0 ? points[i].x : points[i].y) = previous;
+        }
+
+        return offset;
+    }
+
+
+    auto DecodeGlyphCoordinatesScalar(Span<const U8> data, Span<const U8> flags, U32 axis, Span<TTFPoint> points) -> U32
+    {
+        return DecodeGlyphCoordinatesFrom(data, flags, axis, points, 0, 0, 0);
+    }
+
+
+    auto DecodeGlyphCoordinates(Span<const U8> data, Span<const U8> flags, U32 axis, Span<TTFPoint> points) -> U32
+    {
+        auto i = U64(0);
+        auto offset = U32(0);
+        auto previous = TTFScalar(0);
+
+        // Eight points at a time. The byte size of every delta comes from its flags and their
+        // prefix sum gives where each one starts, so a single shuffle gathers them from the
+        // data into 16 bit lanes, byte swapping the long ones on the way. The deltas of eight
+        // points span at most 16 bytes. The coordinates are then a prefix sum of the deltas.
+        #if defined(__SSSE3__)
+            auto shortFlag = _mm_set1_epi16(GLYPH_FLAG_X_SHORT_VECTOR << axis);
+            auto sameOrPositiveFlag = _mm_set1_epi16(GLYPH_FLAG_X_SAME_OR_POSITIVE << axis);
+            auto allOnes = _mm_set1_epi16(-1);
+            auto zero = _mm_setzero_si128();
+            auto axisMask = _mm_set1_epi32(axis == 0 ? 0x0000FFFF : I32(0xFFFF0000));
+            auto carry = _mm_setzero_si128();
+
+            auto prefixSum = [](__m128i values)
+            {
+                values = _mm_add_epi16(values, _mm_slli_si128(values, 2));
+                values = _mm_add_epi16(values, _mm_slli_si128(values, 4));
+                return _mm_add_epi16(values, _mm_slli_si128(values, 8));
+            };
+
+            for (; i + 8 <= points.size() && offset + 16 <= data.size(); i += 8)
+            {
+                auto flagsBlock = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(flags.data() + i)), zero);
+                auto isShort = _mm_cmpeq_epi16(_mm_and_si128(flagsBlock, shortFlag), shortFlag);
+                auto isSameOrPositive = _mm_cmpeq_epi16(_mm_and_si128(flagsBlock, sameOrPositiveFlag), sameOrPositiveFlag);
+                auto isLong = _mm_andnot_si128(_mm_or_si128(isShort, isSameOrPositive), allOnes);
+
+                auto sizes = _mm_or_si128(_mm_and_si128(isShort, _mm_set1_epi16(1)), _mm_and_si128(isLong, _mm_set1_epi16(2)));
+                auto ends = prefixSum(sizes);
+                auto starts = _mm_sub_epi16(ends, sizes);
+
+                // Byte indices of the low and high byte of each lane, 0x80 zeroes the byte.
+                auto shortShuffle = _mm_or_si128(starts, _mm_set1_epi16(I16(0x8000)));
+                auto longShuffle = _mm_or_si128(_mm_add_epi16(starts, _mm_set1_epi16(1)), _mm_slli_epi16(starts, 8));
+                auto shuffle =
+                    _mm_or_si128
+                    (
+                        _mm_or_si128(_mm_and_si128(isShort, shortShuffle), _mm_and_si128(isLong, longShuffle)),
+                        _mm_andnot_si128(_mm_or_si128(isShort, isLong), _mm_set1_epi16(I16(0x8080)))
+                    );
+
+                auto dataBlock = _mm_loadu_si128((const __m128i*)(data.data() + offset));
+                auto deltas = _mm_shuffle_epi8(dataBlock, shuffle);
+
+                auto negate = _mm_andnot_si128(isSameOrPositive, isShort);
+                deltas = _mm_sub_epi16(_mm_xor_si128(deltas, negate), negate);
+
+                auto coordinates = _mm_add_epi16(prefixSum(deltas), carry);
+                carry = _mm_shuffle_epi8(coordinates, _mm_set1_epi16(0x0F0E));
+
+                auto pointsPtr = (__m128i*)(points.data() + i);
+                auto low = _mm_unpacklo_epi16(coordinates, coordinates);
+                auto high = _mm_unpackhi_epi16(coordinates, coordinates);
+                auto lowPoints = _mm_loadu_si128(pointsPtr);
+                auto highPoints = _mm_loadu_si128(pointsPtr + 1);
+                _mm_storeu_si128(pointsPtr, _mm_or_si128(_mm_and_si128(low, axisMask), _mm_andnot_si128(axisMask, lowPoints)));
+                _mm_storeu_si128(pointsPtr + 1, _mm_or_si128(_mm_and_si128(high, axisMask), _mm_andnot_si128(axisMask, highPoints)));
+
+                offset += U32(_mm_extract_epi16(ends, 7));
+            }
+
+            previous = TTFScalar(_mm_extract_epi16(carry, 0));
+        #endif
+
+        return DecodeGlyphCoordinatesFrom(data, flags, axis, points, i, offset, previous);
+    }
+
+
+    auto FontData::ReadComponentRecord(U32& currentOffset) const -> ComponentRecord
+    {
+        auto readU16 = [&]()
+        {
+            auto value = FromBE(*(const U16*)(this->data.data() + currentOffset));
+            currentOffset += 2;
+            return value;
+        };
+
+        // F2Dot14 fixed point numbers.
+        auto readScale = [&]()
+        {
+            return F32(I16(readU16())) / F32(1 << 14);
+        };
+
+        ComponentRecord record;
+        record.flags = readU16();
+        record.glyphIndex = readU16();
+
+        if ((record.flags & COMPONENT_ARG_1_AND_2_ARE_WORDS) > 0)
+        {
+            record.argument1 = I16(readU16());
+            record.argument2 = I16(readU16());
+        }
+        else
+        {
+            auto arguments = readU16();
+            record.argument1 = arguments >> 8;
+            record.argument2 = arguments & 0xFF;
+
+            // Offsets are signed while point numbers are not.
+            if ((record.flags & COMPONENT_ARGS_ARE_XY_VALUES) > 0)
+            {
+                record.argument1 = I8(record.argument1);
+                record.argument2 = I8(record.argument2);
+            }
+        }
+
+        if ((record.flags & COMPONENT_ARG_1_AND_2_ARE_WORDS) > 0 && (record.flags & COMPONENT_ARGS_ARE_XY_VALUES) == 0)
+        {
+            record.argument1 = U16(record.argument1);
+            record.argument2 = U16(record.argument2);
+        }
+
+        if ((record.flags & COMPONENT_WE_HAVE_A_SCALE) > 0)
+        {
+            record.xScale = readScale();
+            record.yScale = record.xScale;
+        }
+        else if ((record.flags & COMPONENT_WE_HAVE_AN_X_AND_Y_SCALE) > 0)
+        {
+            record.xScale = readScale();
+            record.yScale = readScale();
+        }
+        else if ((record.flags & COMPONENT_WE_HAVE_A_TWO_BY_TWO) > 0)
+        {
+            record.xScale = readScale();
+            record.scale01 = readScale();
+            record.scale10 = readScale();
+            record.yScale = readScale();
+        }
+
+        return record;
+    }
+
+
+    auto FontData::DecodeCompoundGlyphPoints(U32 currentOffset, GlyphDecodeScratch& scratch, U32 depth) const -> V
+    {
+        auto& vertices = scratch.vertices;
+        // Point numbers used for matching are relative to the first point of this glyph.
+        auto compoundBase = U32(vertices.size());
+
+        auto moreComponents = true;
+
+        while (moreComponents)
+        {
+            auto record = ReadComponentRecord(currentOffset);
+            moreComponents = (record.flags & COMPONENT_MORE_COMPONENTS) > 0;
+
+            auto componentBase = U32(vertices.size());
+            DecodeGlyphPoints(record.glyphIndex, scratch, depth + 1);
+            auto componentEnd = U32(vertices.size());
+
+            auto hasTransform =
+                record.xScale != 1.f || record.yScale != 1.f || record.scale01 != 0.f || record.scale10 != 0.f;
+
+            F32 dx = 0.f;
+            F32 dy = 0.f;
+
+            if ((record.flags & COMPONENT_ARGS_ARE_XY_VALUES) > 0)
+            {
+                dx = F32(record.argument1);
+                dy = F32(record.argument2);
+
+                if (hasTransform && (record.flags & COMPONENT_SCALED_COMPONENT_OFFSET) > 0)
+                {
+                    auto x = dx;
+                    dx = record.xScale * x + record.scale10 * dy;
+                    dy = record.scale01 * x + record.yScale * dy;
+                }
+            }
+
+            if (hasTransform)
+            {
+                for (auto i = componentBase; i < componentEnd; ++i)
+                {
+                    auto x = F32(vertices[i].x);
+                    auto y = F32(vertices[i].y);
+                    vertices[i].x = TTFScalar(Round(record.xScale * x + record.scale10 * y));
+                    vertices[i].y = TTFScalar(Round(record.scale01 * x + record.yScale * y));
+                }
+            }
+
+            if ((record.flags & COMPONENT_ARGS_ARE_XY_VALUES) == 0)
+            {
+                // Align the given point of the component with the given point of the glyph so far.
+                auto parentPoint = compoundBase + U32(record.argument1);
+                auto childPoint = componentBase + U32(record.argument2);
+
+                if (parentPoint < componentBase && childPoint < componentEnd)
+                {
+                    dx = F32(vertices[parentPoint].x - vertices[childPoint].x);
+                    dy = F32(vertices[parentPoint].y - vertices[childPoint].y);
+                }
+            }
+
+            // The points are whole font units so the offset always ends up on that grid. This is
+            // what COMPONENT_ROUND_XY_TO_GRID asks for, without it the offset is rounded as well
+            // since the points cannot hold fractions.
+            auto offsetX = I32(Round(dx));
+            auto offsetY = I32(Round(dy));
+
+            if (offsetX != 0 || offsetY != 0)
+            {
+                for (auto i = componentBase; i < componentEnd; ++i)
+                {
+                    vertices[i].x = TTFScalar(vertices[i].x + offsetX);
+                    vertices[i].y = TTFScalar(vertices[i].y + offsetY);
+                }
+            }
+        }
+    }
+
+
+    auto ComponentOutlineCache::CopyTo(U32 glyphIndex, GlyphDecodeScratch& scratch) const -> B
+    {
+        auto entryIt = entries.find(glyphIndex);
+
+        if (entryIt == entries.end())
+        {
+            return false;
+        }
+
+        auto& entry = entryIt->second;
+        auto base = U32(scratch.vertices.size());
+        auto contourBase = scratch.endPointsOfContours.size();
+
+        scratch.vertices.resize(base + entry.pointCount);
+        scratch.flags.resize(base + entry.pointCount);
+        scratch.endPointsOfContours.resize(contourBase + entry.contourCount);
+
+        std::copy_n(vertices.begin() + entry.firstPoint, entry.pointCount, scratch.vertices.begin() + base);
+        std::copy_n(flags.begin() + entry.firstPoint, entry.pointCount, scratch.flags.begin() + base);
+
+        for (auto i = 0u; i < entry.contourCount; ++i)
+        {
+            scratch.endPointsOfContours[contourBase + i] = base + endPointsOfContours[entry.firstContour + i];
+        }
+
+        return true;
+    }
+
+
+    auto ComponentOutlineCache::GetMemoryUsage() const -> U64
+    {
+        return
+            vertices.capacity() * sizeof(TTFPoint) +
+            flags.capacity() * sizeof(U8) +
+            endPointsOfContours.capacity() * sizeof(U16) +
+            entries.size() * (sizeof(U32) + sizeof(Entry));
+    }
+
+
+    auto FontData::BuildComponentOutlineCache() const -> ComponentOutlineCache
+    {
+        // Collect every glyph used as a component first.
+        Set<U32> componentGlyphs;
+
+        for (auto glyphIndex = 0u; glyphIndex < numberOfGlyphs; ++glyphIndex)
+        {
+            auto glyph = GetGlyphLocation(glyphIndex);
+
+            if (glyph.length == 0)
+            {
+                continue;
+            }
+
+            auto glyfHeaderPtr = (const GlyfHeader*)(this->data.data() + glyph.offset);
+
+            if (FromBE(glyfHeaderPtr->numberOfContours) >= 0)
+            {
+                continue;
+            }
+
+            auto currentOffset = U32(glyph.offset + sizeof(GlyfHeader));
+            auto moreComponents = true;
+
+            while (moreComponents)
+            {
+                auto record = ReadComponentRecord(currentOffset);
+                moreComponents = (record.flags & COMPONENT_MORE_COMPONENTS) > 0;
+                componentGlyphs.insert(record.glyphIndex);
+            }
+        }
+
+        ComponentOutlineCache cache;
+        GlyphDecodeScratch scratch;
+        Array<U32> sortedGlyphs(componentGlyphs.begin(), componentGlyphs.end());
+        Sort(sortedGlyphs);
+
+        for (auto glyphIndex : sortedGlyphs)
+        {
+            scratch.vertices.clear();
+            scratch.flags.clear();
+            scratch.endPointsOfContours.clear();
+
+            // The cache isn't attached yet so this always decodes from the glyf table.
+            DecodeGlyphPoints(glyphIndex, scratch, 0);
+
+            auto entry = ComponentOutlineCache::Entry
+            {
+                .firstPoint = U32(cache.vertices.size()),
+                .pointCount = U32(scratch.vertices.size()),
+                .firstContour = U32(cache.endPointsOfContours.size()),
+                .contourCount = U32(scratch.endPointsOfContours.size())
+            };
+
+            cache.vertices.insert(cache.vertices.end(), scratch.vertices.begin(), scratch.vertices.end());
+            cache.flags.insert(cache.flags.end(), scratch.flags.begin(), scratch.flags.end());
+            cache.endPointsOfContours.insert
+            (
+                cache.endPointsOfContours.end(),
+                scratch.endPointsOfContours.begin(),
+                scratch.endPointsOfContours.end()
+            );
+            cache.entries.emplace(glyphIndex, entry);
+        }
+
+        cache.vertices.shrink_to_fit();
+        cache.flags.shrink_to_fit();
+        cache.endPointsOfContours.shrink_to_fit();
+
+        return cache;
+    }
+
+
+    // Type 2 charstring operators. Two byte operators are 0x0C00 | the second byte.
+    constexpr U32 CFF_OP_HSTEM = 1;
+    constexpr U32 CFF_OP_VSTEM = 3;
+    constexpr U32 CFF_OP_VMOVETO = 4;
+    constexpr U32 CFF_OP_RLINETO = 5;
+    constexpr U32 CFF_OP_HLINETO = 6;
+    constexpr U32 CFF_OP_VLINETO = 7;
+    constexpr U32 CFF_OP_RRCURVETO = 8;
+    constexpr U32 CFF_OP_CALLSUBR = 10;
+    constexpr U32 CFF_OP_RETURN = 11;
+    constexpr U32 CFF_OP_ESCAPE = 12;
+    constexpr U32 CFF_OP_ENDCHAR = 14;
+    constexpr U32 CFF_OP_VSINDEX = 15;
+    constexpr U32 CFF_OP_BLEND = 16;
+    constexpr U32 CFF_OP_HSTEMHM = 18;
+    constexpr U32 CFF_OP_HINTMASK = 19;
+    constexpr U32 CFF_OP_CNTRMASK = 20;
+    constexpr U32 CFF_OP_RMOVETO = 21;
+    constexpr U32 CFF_OP_HMOVETO = 22;
+    constexpr U32 CFF_OP_VSTEMHM = 23;
+    constexpr U32 CFF_OP_RCURVELINE = 24;
+    constexpr U32 CFF_OP_RLINECURVE = 25;
+    constexpr U32 CFF_OP_VVCURVETO = 26;
+    constexpr U32 CFF_OP_HHCURVETO = 27;
+    constexpr U32 CFF_OP_SHORTINT = 28;
+    constexpr U32 CFF_OP_CALLGSUBR = 29;
+    constexpr U32 CFF_OP_VHCURVETO = 30;
+    constexpr U32 CFF_OP_HVCURVETO = 31;
+    constexpr U32 CFF_OP_HFLEX = 0x0C22;
+    constexpr U32 CFF_OP_FLEX = 0x0C23;
+    constexpr U32 CFF_OP_HFLEX1 = 0x0C24;
+    constexpr U32 CFF_OP_FLEX1 = 0x0C25;
+
+    // DICT operators.
+    constexpr U32 CFF_DICT_CHAR_STRINGS = 17;
+    constexpr U32 CFF_DICT_PRIVATE = 18;
+    constexpr U32 CFF_DICT_SUBRS = 19;
+    constexpr U32 CFF_DICT_VSINDEX = 22;
+    constexpr U32 CFF_DICT_VSTORE = 24;
+    constexpr U32 CFF_DICT_CHARSTRING_TYPE = 0x0C06;
+    constexpr U32 CFF_DICT_FD_ARRAY = 0x0C24;
+    constexpr U32 CFF_DICT_FD_SELECT = 0x0C25;
+
+
+    inline auto ReadCffOffset(const Byte* bytes, U32 offSize) -> U32
+    {
+        auto offset = 0u;
+
+        for (auto i = 0u; i < offSize; ++i)
+        {
+            offset = (offset << 8) | bytes[i];
+        }
+
+        return offset;
+    }
+
+
+    inline auto GetCffSubrBias(U32 subrCount) -> I32
+    {
+        return subrCount < 1240 ? 107 : (subrCount < 33900 ? 1131 : 32768);
+    }
+
+
+    auto FontData::ParseCffTable() -> Error
+    {
+        auto base = cffTable.offset;
+        auto end = U64(base) + cffTable.length;
+
+        if (cffTable.length < 5 || end > data.size())
+        {
+            return Error::UnsupportedFormat;
+        }
+
+        auto majorVersion = data[base];
+        auto offset = base + data[base + 2];
+        Location topDict = { .offset = 0, .length = 0 };
+
+        cff.isCff2 = majorVersion == 2;
+
+        if (majorVersion == 1)
+        {
+            CffIndex nameIndex;
+            CffIndex topDictIndex;
+            CffIndex stringIndex;
+
+            if
+            (
+                !ReadCffIndex(offset, nameIndex) ||
+                !ReadCffIndex(offset, topDictIndex) ||
+                !ReadCffIndex(offset, stringIndex) ||
+                !ReadCffIndex(offset, cff.globalSubrs)
+            )
+            {
+                return Error::UnsupportedFormat;
+            }
+
+            // OpenType allows only a single font in the font set.
+            topDict = GetCffIndexObject(topDictIndex, 0);
+        }
+        else if (majorVersion == 2)
+        {
+            auto topDictLength = FromBE(*(const U16*)(data.data() + base + 3));
+            topDict = Location{ .offset = offset, .length = topDictLength };
+            offset += topDictLength;
+
+            if (!ReadCffIndex(offset, cff.globalSubrs))
+            {
+                return Error::UnsupportedFormat;
+            }
+        }
+        else
+        {
+            return Error::UnsupportedFormat;
+        }
+
+        U32 charStringsOffset = 0;
+        U32 charstringType = 2;
+        Location privateDict = { .offset = 0, .length = 0 };
+        U32 fontDictArrayOffset = 0;
+        U32 fontDictSelectOffset = 0;
+        U32 variationStoreOffset = 0;
+
+        ParseCffDict
+        (
+            topDict,
+            [&](U32 op, const F64* operands, U32 count)
+            {
+                if (count == 0)
+                {
+                    return;
+                }
+
+                switch (op)
+                {
+                    case CFF_DICT_CHAR_STRINGS:
+                        charStringsOffset = U32(operands[0]);
+                        break;
+                    case CFF_DICT_PRIVATE:
+                        if (count >= 2)
+                        {
+                            privateDict = Location{ .offset = base + U32(operands[1]), .length = U32(operands[0]) };
+                        }
+                        break;
+                    case CFF_DICT_CHARSTRING_TYPE:
+                        charstringType = U32(operands[0]);
+                        break;
+                    case CFF_DICT_FD_ARRAY:
+                        fontDictArrayOffset = U32(operands[0]);
+                        break;
+                    case CFF_DICT_FD_SELECT:
+                        fontDictSelectOffset = U32(operands[0]);
+                        break;
+                    case CFF_DICT_VSTORE:
+                        variationStoreOffset = U32(operands[0]);
+                        break;
+                }
+            }
+        );
+
+        offset = base + charStringsOffset;
+
+        if
+        (
+            charStringsOffset == 0 ||
+            charstringType != 2 ||
+            !ReadCffIndex(offset, cff.charStrings) ||
+            cff.charStrings.count == 0
+        )
+        {
+            return Error::UnsupportedFormat;
+        }
+
+        if (variationStoreOffset != 0)
+        {
+            ParseCffVariationStore(base + variationStoreOffset);
+        }
+
+        // CID keyed fonts and all CFF2 fonts have a private dict for every font dict.
+        if (fontDictArrayOffset != 0)
+        {
+            CffIndex fontDicts;
+            offset = base + fontDictArrayOffset;
+
+            if (!ReadCffIndex(offset, fontDicts))
+            {
+                return Error::UnsupportedFormat;
+            }
+
+            for (auto i = 0u; i < fontDicts.count; ++i)
+            {
+                Location fontPrivateDict = { .offset = 0, .length = 0 };
+
+                ParseCffDict
+                (
+                    GetCffIndexObject(fontDicts, i),
+                    [&](U32 op, const F64* operands, U32 count)
+                    {
+                        if (op == CFF_DICT_PRIVATE && count >= 2)
+                        {
+                            fontPrivateDict = Location{ .offset = base + U32(operands[1]), .length = U32(operands[0]) };
+                        }
+                    }
+                );
+
+                ParseCffPrivateDict(fontPrivateDict);
+            }
+
+            if (fontDictSelectOffset != 0 && fontDicts.count > 1)
+            {
+                ParseCffFontDictSelect(base + fontDictSelectOffset, fontDicts.count);
+            }
+        }
+        else
+        {
+            ParseCffPrivateDict(privateDict);
+        }
+
+        numberOfGlyphs = U16(Min(U32(numberOfGlyphs), cff.charStrings.count));
+
+        return Error::Success;
+    }
+
+
+    auto FontData::ReadCffIndex(U32& offset, CffIndex& index) const -> B
+    {
+        auto end = U64(cffTable.offset) + cffTable.length;
+        // CFF2 has 32 bit object counts.
+        auto countSize = cff.isCff2 ? 4u : 2u;
+
+        index = CffIndex();
+
+        if (offset < cffTable.offset || U64(offset) + countSize + 1 > end)
+        {
+            return false;
+        }
+
+        index.count =
+            cff.isCff2 ?
+            FromBE(*(const U32*)(data.data() + offset)) :
+            FromBE(*(const U16*)(data.data() + offset));
+
+        if (index.count == 0)
+        {
+            offset += countSize;
+            return true;
+        }
+
+        index.offSize = data[offset + countSize];
+        index.offsetsOffset = offset + countSize + 1;
+
+        auto offsetsEnd = U64(index.offsetsOffset) + (U64(index.count) + 1) * index.offSize;
+
+        if (index.offSize < 1 || index.offSize > 4 || offsetsEnd > end)
+        {
+            index = CffIndex();
+            return false;
+        }
+
+        index.dataOffset = U32(offsetsEnd - 1);
+
+        auto dataEnd =
+            U64(index.dataOffset) +
+            ReadCffOffset(data.data() + index.offsetsOffset + U64(index.count) * index.offSize, index.offSize);
+
+        if (dataEnd > end)
+        {
+            index = CffIndex();
+            return false;
+        }
+
+        offset = U32(dataEnd);
+
+        return true;
+    }
+
+
+    auto FontData::GetCffIndexObject(const CffIndex& index, U32 i) const -> Location
+    {
+        if (i >= index.count)
+        {
+            return Location{ .offset = 0, .length = 0 };
+        }
+
+        auto offsetPtr = data.data() + index.offsetsOffset + U64(i) * index.offSize;
+        auto start = ReadCffOffset(offsetPtr, index.offSize);
+        auto next = ReadCffOffset(offsetPtr + index.offSize, index.offSize);
+
+        if (start == 0 || next < start || U64(index.dataOffset) + next > U64(cffTable.offset) + cffTable.length)
+        {
+            return Location{ .offset = 0, .length = 0 };
+        }
+
+        return Location{ .offset = index.dataOffset + start, .length = next - start };
+    }
+
+
+    template <typename TVisitor>
+    auto FontData::ParseCffDict(Location dict, TVisitor&& visitor) const -> V
+    {
+        StaticArray<F64, CFF_MAX_STACK_SIZE> operands;
+        auto count = 0u;
+        auto offset = U64(dict.offset);
+        auto end = Min(offset + dict.length, U64(cffTable.offset) + cffTable.length);
+
+        while (offset < end)
+        {
+            auto b0 = data[offset];
+            auto value = 0.0;
+
+            // CFF2 adds vsindex, blend and vstore to the operators up to 27.
+            if (b0 <= 27)
+            {
+                auto op = U32(b0);
+                offset += 1;
+
+                if (b0 == CFF_OP_ESCAPE)
+                {
+                    if (offset >= end)
+                    {
+                        break;
+                    }
+
+                    op = 0x0C00 | data[offset];
+                    offset += 1;
+                }
+
+                visitor(op, operands.data(), count);
+                count = 0;
+                continue;
+            }
+            else if (b0 == 28 && offset + 3 <= end)
+            {
+                value = I16((U16(data[offset + 1]) << 8) | data[offset + 2]);
+                offset += 3;
+            }
+            else if (b0 == 29 && offset + 5 <= end)
+            {
+                value = I32(ReadCffOffset(data.data() + offset + 1, 4));
+                offset += 5;
+            }
+            else if (b0 == 30)
+            {
+                // Real number written as decimal digits in nibbles, terminated by 0xF.
+                StaticArray<C, 64> text;
+                auto length = 0u;
+                auto terminated = false;
+                offset += 1;
+
+                while (offset < end && !terminated)
+                {
+                    auto byte = data[offset];
+                    offset += 1;
+
+                    for (auto nibble : { U32(byte >> 4), U32(byte & 0xF) })
+                    {
+                        if (nibble == 0xF)
+                        {
+                            terminated = true;
+                            break;
+                        }
+
+                        if (length + 3 > text.size())
+                        {
+                            continue;
+                        }
+
+                        if (nibble <= 9)
+                        {
+                            text[length++] = C('0' + nibble);
+                        }
+                        else if (nibble == 0xA)
+                        {
+                            text[length++] = '.';
+                        }
+                        else if (nibble == 0xB || nibble == 0xC)
+                        {
+                            text[length++] = 'E';
+
+                            if (nibble == 0xC)
+                            {
+                                text[length++] = '-';
+                            }
+                        }
+                        else if (nibble == 0xE)
+                        {
+                            text[length++] = '-';
+                        }
+                    }
+                }
+
+                text[length] = 0;
+                value = std::strtod(text.data(), nullptr);
+            }
+            else if (b0 >= 32 && b0 <= 246)
+            {
+                value = I32(b0) - 139;
+                offset += 1;
+            }
+            else if (b0 >= 247 && b0 <= 250 && offset + 2 <= end)
+            {
+                value = (I32(b0) - 247) * 256 + data[offset + 1] + 108;
+                offset += 2;
+            }
+            else if (b0 >= 251 && b0 <= 254 && offset + 2 <= end)
+            {
+                value = -(I32(b0) - 251) * 256 - data[offset + 1] - 108;
+                offset += 2;
+            }
+            else
+            {
+                // Reserved or truncated operand.
+                break;
+            }
+
+            if (count < operands.size())
+            {
+                operands[count++] = value;
+            }
+        }
+    }
+
+
+    auto FontData::ParseCffPrivateDict(Location dict) -> V
+    {
+        U32 subrsOffset = 0;
+        U32 variationDataIndex = 0;
+
+        ParseCffDict
+        (
+            dict,
+            [&](U32 op, const F64* operands, U32 count)
+            {
+                if (count > 0 && op == CFF_DICT_SUBRS)
+                {
+                    subrsOffset = U32(operands[0]);
+                }
+                else if (count > 0 && op == CFF_DICT_VSINDEX)
+                {
+                    variationDataIndex = U32(operands[0]);
+                }
+            }
+        );
+
+        // The local subroutines are relative to the private dict.
+        CffIndex localSubrs;
+
+        if (subrsOffset != 0)
+        {
+            auto offset = dict.offset + subrsOffset;
+            ReadCffIndex(offset, localSubrs);
+        }
+
+        cff.localSubrs.push_back(localSubrs);
+        cff.variationDataIndices.push_back(U16(variationDataIndex));
+    }
+
+
+    auto FontData::ParseCffFontDictSelect(U32 offset, U32 fontDictCount) -> V
+    {
+        auto end = U64(cffTable.offset) + cffTable.length;
+        auto glyphCount = cff.charStrings.count;
+
+        if (U64(offset) + 1 > end)
+        {
+            return;
+        }
+
+        cff.glyphFontDicts.assign(glyphCount, 0);
+
+        auto setRange = [&](U32 first, U32 last, U32 fontDict)
+        {
+            if (fontDict >= fontDictCount)
+            {
+                return;
+            }
+
+            for (auto glyphIndex = first; glyphIndex < Min(last, glyphCount); ++glyphIndex)
+            {
+                cff.glyphFontDicts[glyphIndex] = U16(fontDict);
+            }
+        };
+
+        auto format = data[offset];
+
+        if (format == 0 && U64(offset) + 1 + glyphCount <= end)
+        {
+            for (auto glyphIndex = 0u; glyphIndex < glyphCount; ++glyphIndex)
+            {
+                setRange(glyphIndex, glyphIndex + 1, data[offset + 1 + glyphIndex]);
+            }
+        }
+        // Ranges of glyphs sharing a font dict followed by a sentinel glyph index. Format 4 is the
+        // CFF2 variant with 32 bit glyph indices and 16 bit font dict indices.
+        else if (format == 3 && U64(offset) + 3 <= end)
+        {
+            auto rangeCount = U32(FromBE(*(const U16*)(data.data() + offset + 1)));
+            auto rangesOffset = offset + 3;
+
+            if (U64(rangesOffset) + 3 * U64(rangeCount) + 2 > end)
+            {
+                return;
+            }
+
+            for (auto i = 0u; i < rangeCount; ++i)
+            {
+                auto rangePtr = data.data() + rangesOffset + 3 * i;
+                setRange(FromBE(*(const U16*)rangePtr), FromBE(*(const U16*)(rangePtr + 3)), rangePtr[2]);
+            }
+        }
+        else if (format == 4 && U64(offset) + 5 <= end)
+        {
+            auto rangeCount = FromBE(*(const U32*)(data.data() + offset + 1));
+            auto rangesOffset = offset + 5;
+
+            if (U64(rangesOffset) + 6 * U64(rangeCount) + 4 > end)
+            {
+                return;
+            }
+
+            for (auto i = 0u; i < rangeCount; ++i)
+            {
+                auto rangePtr = data.data() + rangesOffset + 6 * i;
+                setRange
+                (
+                    FromBE(*(const U32*)rangePtr),
+                    FromBE(*(const U32*)(rangePtr + 6)),
+                    FromBE(*(const U16*)(rangePtr + 4))
+                );
+            }
+        }
+    }
+
+
+    auto FontData::ParseCffVariationStore(U32 offset) -> V
+    {
+        auto end = U64(cffTable.offset) + cffTable.length;
+        // The item variation store is preceded by its length.
+        auto storeOffset = U64(offset) + 2;
+
+        if (storeOffset + 8 > end)
+        {
+            return;
+        }
+
+        auto dataCount = U32(FromBE(*(const U16*)(data.data() + storeOffset + 6)));
+
+        if (storeOffset + 8 + 4 * U64(dataCount) > end)
+        {
+            return;
+        }
+
+        for (auto i = 0u; i < dataCount; ++i)
+        {
+            auto dataOffset = storeOffset + FromBE(*(const U32*)(data.data() + storeOffset + 8 + 4 * i));
+
+            cff.regionCounts.push_back
+            (
+                dataOffset + 6 <= end ? FromBE(*(const U16*)(data.data() + dataOffset + 4)) : U16(0)
+            );
+        }
+    }
+
+
+    auto FontData::ReadCffOperand(U32& offset, U32 end, F32& value) const -> B
+    {
+        auto b0 = data[offset];
+
+        if (b0 >= 32 && b0 <= 246)
+        {
+            value = F32(I32(b0) - 139);
+            offset += 1;
+        }
+        else if (b0 >= 247 && b0 != 255)
+        {
+            if (offset + 2 > end)
+            {
+                return false;
+            }
+
+            auto b1 = I32(data[offset + 1]);
+            value = F32(b0 <= 250 ? (I32(b0) - 247) * 256 + b1 + 108 : -(I32(b0) - 251) * 256 - b1 - 108);
+            offset += 2;
+        }
+        else if (b0 == CFF_OP_SHORTINT)
+        {
+            if (offset + 3 > end)
+            {
+                return false;
+            }
+
+            value = F32(I16((U16(data[offset + 1]) << 8) | data[offset + 2]));
+            offset += 3;
+        }
+        else if (b0 == 255)
+        {
+            // 16.16 fixed point
+            if (offset + 5 > end)
+            {
+                return false;
+            }
+
+            value = F32(I32(ReadCffOffset(data.data() + offset + 1, 4))) / 65536.f;
+            offset += 5;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+
+    auto FontData::TokenizeCffSubroutine(Location subr, Array<CffToken>& tokens) const -> V
+    {
+        auto offset = subr.offset;
+        auto end = subr.offset + subr.length;
+
+        while (offset < end)
+        {
+            CffToken token;
+            token.value = 0.f;
+
+            auto b0 = data[offset];
+
+            if (b0 >= 32 || b0 == CFF_OP_SHORTINT)
+            {
+                token.op = CFF_TOKEN_OPERAND;
+
+                if (!ReadCffOperand(offset, end, token.value))
+                {
+                    return;
+                }
+
+                tokens.push_back(token);
+                continue;
+            }
+
+            token.op = b0;
+
+            if (b0 == CFF_OP_ESCAPE)
+            {
+                if (offset + 1 >= end)
+                {
+                    return;
+                }
+
+                token.op = 0x0C00 | data[offset + 1];
+            }
+
+            if (token.op == CFF_OP_HINTMASK || token.op == CFF_OP_CNTRMASK)
+            {
+                token.op = CFF_TOKEN_RESUME;
+                token.byteOffset = offset;
+                tokens.push_back(token);
+                return;
+            }
+
+            offset += b0 == CFF_OP_ESCAPE ? 2 : 1;
+            tokens.push_back(token);
+
+            if (token.op == CFF_OP_RETURN || token.op == CFF_OP_ENDCHAR)
+            {
+                return;
+            }
+        }
+    }
+
+
+    auto FontData::BuildCffSubroutineCache() const -> CffSubroutineCache
+    {
+        CffSubroutineCache cache;
+
+        auto tokenizeAll = [&](const CffIndex& subrs)
+        {
+            for (auto i = 0u; i < subrs.count; ++i)
+            {
+                cache.firstTokens.push_back(U32(cache.tokens.size()));
+                TokenizeCffSubroutine(GetCffIndexObject(subrs, i), cache.tokens);
+            }
+        };
+
+        tokenizeAll(cff.globalSubrs);
+
+        for (auto& localSubrs : cff.localSubrs)
+        {
+            cache.firstLocalSubrs.push_back(U32(cache.firstTokens.size()));
+            tokenizeAll(localSubrs);
+        }
+
+        cache.firstTokens.push_back(U32(cache.tokens.size()));
+
+        cache.tokens.shrink_to_fit();
+        cache.firstTokens.shrink_to_fit();
+
+        return cache;
+    }
+
+
+    auto FontData::ComputeCffBoundingBoxes() const -> Array<Line>
+    {
+        Array<Line> boundingBoxes(numberOfGlyphs);
+        Outline outline;
+
+        for (auto glyphIndex = 0u; glyphIndex < numberOfGlyphs; ++glyphIndex)
+        {
+            outline.Clear();
+            DecodeCffGlyph(glyphIndex, outline);
+            boundingBoxes[glyphIndex] = outline.GetBoundingBox();
+        }
+
+        return boundingBoxes;
+    }
+
+
+    auto CffSubroutineCache::GetMemoryUsage() const -> U64
+    {
+        return
+            tokens.capacity() * sizeof(CffToken) +
+            firstTokens.capacity() * sizeof(U32) +
+            firstLocalSubrs.capacity() * sizeof(U32);
+    }
+
+
+    // Turns the relative moves of a charstring into outline segments. Contours are closed by the
+    // next move or the end of the charstring.
+    class CffOutlineWriter
+    {
+        Outline& outline;
+        F32 x = 0.f;
+        F32 y = 0.f;
+        TTFPoint contourStart;
+        B contourOpen = false;
+
+        static auto ToPoint(F32 x, F32 y) -> TTFPoint
+        {
+            return TTFPoint(TTFScalar(Round(x)), TTFScalar(Round(y)));
+        }
+
+        auto BeginSegment() -> TTFPoint
+        {
+            auto startPoint = ToPoint(x, y);
+
+            if (!contourOpen)
+            {
+                contourStart = startPoint;
+                contourOpen = true;
+            }
+
+            return startPoint;
+        }
+
+    public:
+        CffOutlineWriter(Outline& outline) : outline(outline) {}
+
+        auto MoveTo(F32 dx, F32 dy) -> V
+        {
+            Close();
+            x += dx;
+            y += dy;
+        }
+
+        auto LineTo(F32 dx, F32 dy) -> V
+        {
+            auto startPoint = BeginSegment();
+            x += dx;
+            y += dy;
+            outline.AddLine(startPoint, ToPoint(x, y));
+        }
+
+        auto CurveTo(F32 dx0, F32 dy0, F32 dx1, F32 dy1, F32 dx2, F32 dy2) -> V
+        {
+            auto startPoint = BeginSegment();
+            auto x0 = x + dx0;
+            auto y0 = y + dy0;
+            auto x1 = x0 + dx1;
+            auto y1 = y0 + dy1;
+            x = x1 + dx2;
+            y = y1 + dy2;
+            outline.AddCubicBezierCurve(startPoint, ToPoint(x0, y0), ToPoint(x1, y1), ToPoint(x, y));
+        }
+
+        auto Close() -> V
+        {
+            if (!contourOpen)
+            {
+                return;
+            }
+
+            auto endPoint = ToPoint(x, y);
+
+            if (endPoint.x != contourStart.x || endPoint.y != contourStart.y)
+            {
+                outline.AddLine(endPoint, contourStart);
+            }
+
+            outline.EndContour();
+            contourOpen = false;
+        }
+    };
+
+
+    auto FontData::DecodeCffGlyph(U32 glyphIndex, Outline& outline) const -> V
+    {
+        // Either a pre-decoded subroutine or raw charstring bytes. The bytes are used once the
+        // tokens run out, which happens at the masks of pre-decoded subroutines.
+        struct Frame
+        {
+            const CffToken* token;
+            const CffToken* tokenEnd;
+            U32 offset;
+            U32 end;
+        };
+
+        auto charString = GetCffIndexObject(cff.charStrings, glyphIndex);
+
+        if (charString.length == 0)
+        {
+            return;
+        }
+
+        auto fontDict = cff.glyphFontDicts.empty() ? 0u : U32(cff.glyphFontDicts[glyphIndex]);
+        auto localSubrs = fontDict < cff.localSubrs.size() ? cff.localSubrs[fontDict] : CffIndex();
+        auto variationDataIndex = fontDict < cff.variationDataIndices.size() ? U32(cff.variationDataIndices[fontDict]) : 0u;
+        auto globalBias = GetCffSubrBias(cff.globalSubrs.count);
+        auto localBias = GetCffSubrBias(localSubrs.count);
+
+        StaticArray<F32, CFF_MAX_STACK_SIZE> stack;
+        auto count = 0u;
+        StaticArray<Frame, CFF_MAX_SUBR_DEPTH + 1> frames;
+        auto depth = 0u;
+        frames[0] = Frame{ nullptr, nullptr, charString.offset, charString.offset + charString.length };
+
+        auto stemCount = 0u;
+        // The advance width may precede the arguments of the first stack clearing operator of CFF
+        // charstrings. It is taken from hmtx so it is just dropped.
+        auto widthParsed = cff.isCff2;
+        auto finished = false;
+
+        auto accented = false;
+
+        auto takeWidth = [&](B hasWidth) -> U32
+        {
+            if (widthParsed)
+            {
+                return 0;
+            }
+
+            widthParsed = true;
+            return hasWidth ? 1 : 0;
+        };
+
+        CffOutlineWriter writer(outline);
+
+        while (!finished)
+        {
+            auto& frame = frames[depth];
+            U32 op;
+
+            if (frame.token != frame.tokenEnd)
+            {
+                auto& token = *frame.token;
+                frame.token += 1;
+
+                if (token.op == CFF_TOKEN_OPERAND)
+                {
+                    if (count < stack.size())
+                    {
+                        stack[count++] = token.value;
+                    }
+                    continue;
+                }
+
+                if (token.op == CFF_TOKEN_RESUME)
+                {
+                    frame.offset = token.byteOffset;
+                    frame.token = frame.tokenEnd;
+                    continue;
+                }
+
+                op = token.op;
+            }
+            else
+            {
+                // CFF2 has no return and endchar operators, the end of the bytes ends the
+                // subroutine or the charstring.
+                if (frame.offset >= frame.end)
+                {
+                    if (depth == 0)
+                    {
+                        break;
+                    }
+
+                    depth -= 1;
+                    continue;
+                }
+
+                auto b0 = data[frame.offset];
+
+                if (b0 >= 32 || b0 == CFF_OP_SHORTINT)
+                {
+                    F32 value;
+
+                    if (!ReadCffOperand(frame.offset, frame.end, value))
+                    {
+                        frame.offset = frame.end;
+                    }
+                    else if (count < stack.size())
+                    {
+                        stack[count++] = value;
+                    }
+
+                    continue;
+                }
+
+                op = b0;
+                frame.offset += 1;
+
+                if (b0 == CFF_OP_ESCAPE && frame.offset < frame.end)
+                {
+                    op = 0x0C00 | data[frame.offset];
+                    frame.offset += 1;
+                }
+            }
+
+            switch (op)
+            {
+                case CFF_OP_HSTEM:
+                case CFF_OP_VSTEM:
+                case CFF_OP_HSTEMHM:
+                case CFF_OP_VSTEMHM:
+                {
+                    // Hints are not used but the masks depend on the number of stems.
+                    auto first = takeWidth(count % 2 == 1);
+                    stemCount += (count - first) / 2;
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_HINTMASK:
+                case CFF_OP_CNTRMASK:
+                {
+                    // Arguments before the first mask are vertical stems.
+                    auto first = takeWidth(count % 2 == 1);
+                    stemCount += (count - first) / 2;
+                    count = 0;
+                    frame.offset += (stemCount + 7) / 8;
+                    break;
+                }
+                case CFF_OP_RMOVETO:
+                {
+                    auto first = takeWidth(count > 2);
+
+                    if (count >= first + 2)
+                    {
+                        writer.MoveTo(stack[first], stack[first + 1]);
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_HMOVETO:
+                case CFF_OP_VMOVETO:
+                {
+                    auto first = takeWidth(count > 1);
+
+                    if (count > first)
+                    {
+                        op == CFF_OP_HMOVETO ? writer.MoveTo(stack[first], 0.f) : writer.MoveTo(0.f, stack[first]);
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_RLINETO:
+                {
+                    for (auto i = 0u; i + 2 <= count; i += 2)
+                    {
+                        writer.LineTo(stack[i], stack[i + 1]);
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_HLINETO:
+                case CFF_OP_VLINETO:
+                {
+                    // Alternating horizontal and vertical lines.
+                    auto horizontal = op == CFF_OP_HLINETO;
+
+                    for (auto i = 0u; i < count; ++i)
+                    {
+                        horizontal ? writer.LineTo(stack[i], 0.f) : writer.LineTo(0.f, stack[i]);
+                        horizontal = !horizontal;
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_RRCURVETO:
+                {
+                    for (auto i = 0u; i + 6 <= count; i += 6)
+                    {
+                        writer.CurveTo(stack[i], stack[i + 1], stack[i + 2], stack[i + 3], stack[i + 4], stack[i + 5]);
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_RCURVELINE:
+                {
+                    auto i = 0u;
+
+                    for (; i + 8 <= count; i += 6)
+                    {
+                        writer.CurveTo(stack[i], stack[i + 1], stack[i + 2], stack[i + 3], stack[i + 4], stack[i + 5]);
+                    }
+
+                    if (i + 2 <= count)
+                    {
+                        writer.LineTo(stack[i], stack[i + 1]);
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_RLINECURVE:
+                {
+                    auto i = 0u;
+
+                    for (; i + 8 <= count; i += 2)
+                    {
+                        writer.LineTo(stack[i], stack[i + 1]);
+                    }
+
+                    if (i + 6 <= count)
+                    {
+                        writer.CurveTo(stack[i], stack[i + 1], stack[i + 2], stack[i + 3], stack[i + 4], stack[i + 5]);
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_VVCURVETO:
+                case CFF_OP_HHCURVETO:
+                {
+                    // An odd argument count means the first curve doesn't start exactly
+                    // vertically (horizontally).
+                    auto i = count % 2;
+                    auto firstDelta = i == 1 ? stack[0] : 0.f;
+
+                    for (; i + 4 <= count; i += 4)
+                    {
+                        if (op == CFF_OP_VVCURVETO)
+                        {
+                            writer.CurveTo(firstDelta, stack[i], stack[i + 1], stack[i + 2], 0.f, stack[i + 3]);
+                        }
+                        else
+                        {
+                            writer.CurveTo(stack[i], firstDelta, stack[i + 1], stack[i + 2], stack[i + 3], 0.f);
+                        }
+
+                        firstDelta = 0.f;
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_HVCURVETO:
+                case CFF_OP_VHCURVETO:
+                {
+                    // Curves alternating between horizontal and vertical tangents. The last one
+                    // may have an extra argument for its other end point coordinate.
+                    auto horizontal = op == CFF_OP_HVCURVETO;
+
+                    for (auto i = 0u; i + 4 <= count; i += 4)
+                    {
+                        auto lastDelta = count - i == 5 ? stack[i + 4] : 0.f;
+
+                        if (horizontal)
+                        {
+                            writer.CurveTo(stack[i], 0.f, stack[i + 1], stack[i + 2], lastDelta, stack[i + 3]);
+                        }
+                        else
+                        {
+                            writer.CurveTo(0.f, stack[i], stack[i + 1], stack[i + 2], stack[i + 3], lastDelta);
+                        }
+
+                        horizontal = !horizontal;
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_FLEX:
+                {
+                    if (count >= 13)
+                    {
+                        writer.CurveTo(stack[0], stack[1], stack[2], stack[3], stack[4], stack[5]);
+                        writer.CurveTo(stack[6], stack[7], stack[8], stack[9], stack[10], stack[11]);
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_HFLEX:
+                {
+                    if (count >= 7)
+                    {
+                        writer.CurveTo(stack[0], 0.f, stack[1], stack[2], stack[3], 0.f);
+                        writer.CurveTo(stack[4], 0.f, stack[5], -stack[2], stack[6], 0.f);
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_HFLEX1:
+                {
+                    if (count >= 9)
+                    {
+                        writer.CurveTo(stack[0], stack[1], stack[2], stack[3], stack[4], 0.f);
+                        writer.CurveTo(stack[5], 0.f, stack[6], stack[7], stack[8], -(stack[1] + stack[3] + stack[7]));
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_FLEX1:
+                {
+                    if (count >= 11)
+                    {
+                        // The last argument is along the direction in which the flex moves the most,
+                        // the other coordinate returns to the start.
+                        auto dx = stack[0] + stack[2] + stack[4] + stack[6] + stack[8];
+                        auto dy = stack[1] + stack[3] + stack[5] + stack[7] + stack[9];
+                        auto horizontal = std::abs(dx) > std::abs(dy);
+
+                        writer.CurveTo(stack[0], stack[1], stack[2], stack[3], stack[4], stack[5]);
+                        writer.CurveTo
+                        (
+                            stack[6],
+                            stack[7],
+                            stack[8],
+                            stack[9],
+                            horizontal ? stack[10] : -dx,
+                            horizontal ? -dy : stack[10]
+                        );
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_CALLSUBR:
+                case CFF_OP_CALLGSUBR:
+                {
+                    auto global = op == CFF_OP_CALLGSUBR;
+                    auto& subrs = global ? cff.globalSubrs : localSubrs;
+
+                    if (count == 0 || depth >= CFF_MAX_SUBR_DEPTH)
+                    {
+                        finished = true;
+                        break;
+                    }
+
+                    count -= 1;
+                    auto subrIndex = I32(stack[count]) + (global ? globalBias : localBias);
+
+                    if (subrIndex < 0 || U32(subrIndex) >= subrs.count)
+                    {
+                        finished = true;
+                        break;
+                    }
+
+                    auto subr = GetCffIndexObject(subrs, U32(subrIndex));
+                    auto next = Frame{ nullptr, nullptr, subr.offset, subr.offset + subr.length };
+
+                    if (cffSubroutineCache != nullptr)
+                    {
+                        auto& cache = *cffSubroutineCache;
+                        auto cacheIndex = U32(subrIndex) + (global ? 0u : cache.firstLocalSubrs[fontDict]);
+                        next.token = cache.tokens.data() + cache.firstTokens[cacheIndex];
+                        next.tokenEnd = cache.tokens.data() + cache.firstTokens[cacheIndex + 1];
+                        // The bytes are only read after a resume token.
+                        next.offset = next.end;
+                    }
+
+                    depth += 1;
+                    frames[depth] = next;
+                    break;
+                }
+                case CFF_OP_RETURN:
+                {
+                    if (depth > 0)
+                    {
+                        depth -= 1;
+                    }
+                    break;
+                }
+                case CFF_OP_ENDCHAR:
+                {
+                    // The accent variant with four arguments (seac) is not supported. Such glyphs
+                    // come out empty rather than as a base glyph without its accent.
+                    auto first = takeWidth(count == 1 || count == 5);
+                    accented = count >= first + 4;
+                    finished = true;
+                    break;
+                }
+                case CFF_OP_VSINDEX:
+                {
+                    if (count > 0)
+                    {
+                        variationDataIndex = U32(stack[count - 1]);
+                    }
+
+                    count = 0;
+                    break;
+                }
+                case CFF_OP_BLEND:
+                {
+                    // Only the default instance is rendered so the deltas that follow the default
+                    // values are dropped.
+                    if (count == 0)
+                    {
+                        break;
+                    }
+
+                    count -= 1;
+                    auto valueCount = U32(stack[count]);
+                    auto regionCount =
+                        variationDataIndex < cff.regionCounts.size() ? U32(cff.regionCounts[variationDataIndex]) : 0u;
+                    auto deltaCount = valueCount * regionCount;
+
+                    count = U64(valueCount) + deltaCount <= count ? count - deltaCount : 0;
+                    break;
+                }
+                default:
+                    // Unsupported operators e.g. the arithmetic ones removed by CFF2.
+                    count = 0;
+                    break;
+            }
+        }
+
+        writer.Close();
+
+        if (accented)
+        {
+            outline.Clear();
+        }
+    }
+
+
+    MappedFontFile::MappedFontFile(MappedFontFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+
+    MappedFontFile::~MappedFontFile()
+    {
+        Close();
+    }
+
+
+    auto MappedFontFile::operator=(MappedFontFile&& other) noexcept -> MappedFontFile&
+    {
+        if (this != &other)
+        {
+            Close();
+            Swap(mapping, other.mapping);
+            Swap(size, other.size);
+            Swap(options, other.options);
+
+            #if defined(_WIN32)
+                Swap(fileHandle, other.fileHandle);
+                Swap(mappingHandle, other.mappingHandle);
+            #endif
+        }
+
+        return *this;
+    }
+
+
+    auto MappedFontFile::Open(const C* path, const MappingOptions& options) -> Error
+    {
+        Close();
+        this->options = options;
+
+        #if defined(_WIN32)
+            fileHandle = CreateFileA
+            (
+                path,
+                GENERIC_READ,
+                FILE_SHARE_READ,
+                nullptr,
+                OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+                nullptr
+            );
+
+            if (fileHandle == INVALID_HANDLE_VALUE)
+            {
+                fileHandle = nullptr;
+                return Error::FileReadError;
+            }
+
+            LARGE_INTEGER fileSize;
+
+            if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+            {
+                Close();
+                return Error::FileReadError;
+            }
+
+            mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+            if (mappingHandle == nullptr)
+            {
+                Close();
+                return Error::FileReadError;
+            }
+
+            mapping = (const Byte*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+            if (mapping == nullptr)
+            {
+                Close();
+                return Error::FileReadError;
+            }
+
+            size = U64(fileSize.QuadPart);
+        #else
+            auto fd = open(path, O_RDONLY | O_CLOEXEC);
+
+            if (fd < 0)
+            {
+                return Error::FileReadError;
+            }
+
+            struct stat fileStat;
+
+            if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0)
+            {
+                close(fd);
+                return Error::FileReadError;
+            }
+
+            auto address = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            // The mapping keeps its own reference to the file.
+            close(fd);
+
+            if (address == MAP_FAILED)
+            {
+                return Error::FileReadError;
+            }
+
+            mapping = (const Byte*)address;
+            size = U64(fileStat.st_size);
+        #endif
+
+        return Error::Success;
+    }
+
+
+    auto MappedFontFile::Close() -> V
+    {
+        #if defined(_WIN32)
+            if (mapping != nullptr)
+            {
+                UnmapViewOfFile(mapping);
+            }
+
+            if (mappingHandle != nullptr)
+            {
+                CloseHandle(mappingHandle);
+                mappingHandle = nullptr;
+            }
+
+            if (fileHandle != nullptr)
+            {
+                CloseHandle(fileHandle);
+                fileHandle = nullptr;
+            }
+        #else
+            if (mapping != nullptr)
+            {
+                munmap((V*)mapping, size);
+            }
+        #endif
+
+        mapping = nullptr;
+        size = 0;
+    }
+
+
+    auto MappedFontFile::IsOpen() const -> B
+    {
+        return mapping != nullptr;
+    }
+
+
+    auto MappedFontFile::GetData() const -> Span<const Byte>
+    {
+        return Span<const Byte>(mapping, size);
+    }
+
+
+    auto MappedFontFile::AdviseAccessPattern(const FontData& fontData) const -> V
+    {
+        #if defined(_WIN32)
+            // There are no per range access hints for views on Windows. FILE_FLAG_RANDOM_ACCESS
+            // already covers the glyph data.
+            (V)fontData;
+        #else
+            if (mapping == nullptr)
+            {
+                return;
+            }
+
+            auto pageSize = U64(sysconf(_SC_PAGESIZE));
+
+            auto advise = [&](U32 tag, I32 advice)
+            {
+                auto location = fontData.FindTable(FromLE(tag));
+
+                if (location.length == 0 || location.offset >= size)
+                {
+                    return;
+                }
+
+                // madvise needs page aligned addresses so the range grows to whole pages.
+                auto begin = U64(location.offset) & ~(pageSize - 1);
+                auto end = Min(U64(location.offset) + location.length, size);
+
+                madvise((V*)(mapping + begin), end - begin, advice);
+            };
+
+            advise(GLYF_TAG_LE, MADV_RANDOM);
+            advise(CFF_TAG_LE, MADV_RANDOM);
+            advise(CFF2_TAG_LE, MADV_RANDOM);
+
+            #if defined(MADV_HUGEPAGE)
+                if (options.useHugePages)
+                {
+                    advise(GLYF_TAG_LE, MADV_HUGEPAGE);
+                }
+            #endif
+
+            advise(CMAP_TAG_LE, MADV_WILLNEED);
+            advise(LOCA_TAG_LE, MADV_WILLNEED);
+            advise(HMTX_TAG_LE, MADV_WILLNEED);
+            advise(HEAD_TAG_LE, MADV_WILLNEED);
+            advise(HHEA_TAG_LE, MADV_WILLNEED);
+        #endif
+    }
+
+
+    auto FontCollection::Load(Span<const Byte> data, const LoadOptions& options) -> Error
+    {
+        this->data = data;
+        this->faces.clear();
+        this->decodedTables = DecodedTableCache();
+
+        auto faceCount = 1u;
+
+        if (data.size() >= 12 && *(const U32*)data.data() == FromLE(0x66637474u))
+        {
+            faceCount = FromBE(*(const U32*)(data.data() + 8));
+
+            // The face count is not trusted for the allocation, every face needs its offset.
+            if (12 + 4 * U64(faceCount) > data.size())
+            {
+                return Error::InvalidTableDirectory;
+            }
+        }
+
+        faces.resize(faceCount);
+
+        for (auto i = 0u; i < faceCount; ++i)
+        {
+            auto faceOptions = options;
+            faceOptions.faceIndex = i;
+
+            auto status = faces[i].LoadFace(data, faceOptions, &decodedTables);
+
+            if (status != Error::Success)
+            {
+                faces.clear();
+                return status;
+            }
+        }
+
+        return Error::Success;
+    }
+
+
+    auto FontCollection::GetFaceCount() const -> U32
+    {
+        return U32(faces.size());
+    }
+
+
+    auto FontCollection::GetFace(U32 faceIndex) const -> const FontData&
+    {
+        return faces[faceIndex];
+    }
+
+
+    auto FontCollection::GetDecodedTableCount() const -> U64
+    {
+        return decodedTables.GetEntryCount();
+    }
+
+
+    // Rasterizer related functions
+
+    struct Point
+    {
+        F32 x;
+        F32 y;
+
+        Point() {}
+        Point(F32 x, F32 y) : x(x), y(y) {}
+    };
+
+
+    struct Edge
+    {
+        Point lowermostPoint;
+        Point uppermostPoint;
+        // Needs to be +1/-1 but gets padded to 4 bytes anyway in order to preserve alignment 
+        F32 direction;
+    };
+
+    inline auto operator<(const Edge& e0, const Edge& e1) -> bool 
+    {
+        return e0.uppermostPoint.y < e1.uppermostPoint.y;
+    }
+
+    inline auto operator==(const Edge& e0, const Edge& e1) -> bool
+    {
+        return e0.uppermostPoint.y == e1.uppermostPoint.y;
+    }
+
+
+    auto AddEdge(Array<Edge>& edges, Point startPoint, Point endPoint) -> V
+    {
+        if (startPoint.y < endPoint.y)
+        {
+            edges.emplace_back(startPoint, endPoint, 1.0);
+        }
+        else if (startPoint.y > endPoint.y)
+        {
+            edges.emplace_back(endPoint, startPoint, -1.0);
+        }
+        else
+        {
+            // In case this happens we can safely drop those
+        }
+    }
+
+
+    // Curves get within this many pixels from their polylines unless the caller asks otherwise.
+    static constexpr F32 DEFAULT_FLATNESS_IN_PIXELS = 1.f / 8;
+    static constexpr F32 MAX_CURVE_SEGMENTS = 1024;
+
+
+    // Curves waiting to be flattened, one array per coefficient so consecutive curves fill the SIMD
+    // lanes. Every curve is kept as a cubic polynomial p(t) = c0 + c1 t + c2 t^2 + c3 t^3 with c3
+    // zero for the quadratics. The arrays share one allocation, so the batch can't be copied.
+    struct CurveBatch
+    {
+        static constexpr U32 ARRAY_COUNT = 11;
+
+        Array<F32> storage;
+        U32 size = 0;
+        F32* c0x; F32* c0y; F32* c1x; F32* c1y; F32* c2x; F32* c2y; F32* c3x; F32* c3y;
+        // The end point is kept apart since c0 + c1 + c2 + c3 isn't exactly it.
+        F32* endX; F32* endY;
+        // Square of the largest second difference of the control points times n(n - 1) where n is
+        // the degree, which bounds the second derivative of the curve.
+        F32* curvature;
+
+        explicit CurveBatch(U32 capacity) : storage(ARRAY_COUNT * capacity)
+        {
+            StaticArray<F32**, ARRAY_COUNT> arrays = { &c0x, &c0y, &c1x, &c1y, &c2x, &c2y, &c3x, &c3y, &endX, &endY, &curvature };
+
+            for (auto arrayIdx = 0u; arrayIdx < ARRAY_COUNT; ++arrayIdx)
+            {
+                *arrays[arrayIdx] = storage.data() + arrayIdx * capacity;
+            }
+        }
+
+        CurveBatch(const CurveBatch&) = delete;
+        auto operator=(const CurveBatch&) -> CurveBatch& = delete;
+
+        auto GetSize() const -> U32
+        {
+            return size;
+        }
+
+        auto Add(Point c0, Point c1, Point c2, Point c3, Point endPoint, F32 curvatureSquared) -> V
+        {
+            c0x[size] = c0.x;
+            c0y[size] = c0.y;
+            c1x[size] = c1.x;
+            c1y[size] = c1.y;
+            c2x[size] = c2.x;
+            c2y[size] = c2.y;
+            c3x[size] = c3.x;
+            c3y[size] = c3.y;
+            endX[size] = endPoint.x;
+            endY[size] = endPoint.y;
+            curvature[size] = curvatureSquared;
+            size++;
+        }
+    };
+
+
+    auto AddQuadratic(CurveBatch& batch, Point point0, Point point1, Point point2) -> V
+    {
+        auto secondDifference = Point(point0.x - 2 * point1.x + point2.x, point0.y - 2 * point1.y + point2.y);
+
+        batch.Add
+        (
+            point0,
+            Point(2 * (point1.x - point0.x), 2 * (point1.y - point0.y)),
+            secondDifference,
+            Point(0, 0),
+            point2,
+            4 * (Square(secondDifference.x) + Square(secondDifference.y))
+        );
+    }
+
+
+    auto AddCubic(CurveBatch& batch, Point point0, Point point1, Point point2, Point point3) -> V
+    {
+        auto secondDifference0 = Point(point0.x - 2 * point1.x + point2.x, point0.y - 2 * point1.y + point2.y);
+        auto secondDifference1 = Point(point1.x - 2 * point2.x + point3.x, point1.y - 2 * point2.y + point3.y);
+
+        batch.Add
+        (
+            point0,
+            Point(3 * (point1.x - point0.x), 3 * (point1.y - point0.y)),
+            Point(3 * secondDifference0.x, 3 * secondDifference0.y),
+            Point(secondDifference1.x - secondDifference0.x, secondDifference1.y - secondDifference0.y),
+            point3,
+            36 * Max(Square(secondDifference0.x) + Square(secondDifference0.y), Square(secondDifference1.x) + Square(secondDifference1.y))
+        );
+    }
+
+
+    // Wang's formula: n uniform pieces keep a curve whose second derivative is bounded by M within
+    // M / (8 n^2) from its polyline.
+    inline auto GetCurveSegmentCount(F32 curvatureSquared, F32 inverseEightFlatness) -> F32
+    {
+        auto count = Min(std::sqrt(std::sqrt(curvatureSquared) * inverseEightFlatness), MAX_CURVE_SEGMENTS);
+        auto rounded = F32(I32(count));
+        return Max(rounded < count ? rounded + 1 : rounded, 1.f);
+    }
+
+
+    // GCC and Clang fuse a multiplication and the addition after it into a multiply-add wherever
+    // the target has FMA, which rounds once instead of twice, and they don't fuse the scalar and
+    // the SIMD code in the same places. Claiming that an empty asm statement changes the product
+    // keeps it rounded on its own. MSVC only fuses with /fp:contract.
+    template <typename T>
+    inline auto KeepRounded(T& product) -> V
+    {
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+        asm("" : "+x"(product));
+#endif
+    }
+
+
+    // Walks the curve with forward differences. The products are kept apart from the additions
+    // and the additions run in the same order as in the SIMD lanes of FlattenCurves so all
+    // instruction sets give the same edges, with or without FMA.
+    auto FlattenCurve(Array<Edge>& edges, const CurveBatch& batch, U32 curveIdx, F32 inverseEightFlatness) -> V
+    {
+        auto count = GetCurveSegmentCount(batch.curvature[curveIdx], inverseEightFlatness);
+        auto step = 1.f / count;
+        auto step2 = step * step;
+        auto step3 = step2 * step;
+
+        auto c1 = Point(batch.c1x[curveIdx] * step, batch.c1y[curveIdx] * step);
+        auto c2 = Point(batch.c2x[curveIdx] * step2, batch.c2y[curveIdx] * step2);
+        auto c3 = Point(batch.c3x[curveIdx] * step3, batch.c3y[curveIdx] * step3);
+        auto c3Times6 = Point(6.f * c3.x, 6.f * c3.y);
+
+        for (auto* product : { &c1.x, &c1.y, &c2.x, &c2.y, &c3.x, &c3.y, &c3Times6.x, &c3Times6.y })
+        {
+            KeepRounded(*product);
+        }
+
+        auto point = Point(batch.c0x[curveIdx], batch.c0y[curveIdx]);
+        auto delta1 = Point(c1.x + c2.x + c3.x, c1.y + c2.y + c3.y);
+        // Doubling is exact so the sum is 2 c2 rounded like the product.
+        auto delta2 = Point(c2.x + c2.x + c3Times6.x, c2.y + c2.y + c3Times6.y);
+        auto delta3 = c3Times6;
+
+        for (auto segment = 1.f; segment < count; ++segment)
+        {
+            auto nextPoint = Point(point.x + delta1.x, point.y + delta1.y);
+            delta1 = Point(delta1.x + delta2.x, delta1.y + delta2.y);
+            delta2 = Point(delta2.x + delta3.x, delta2.y + delta3.y);
+            AddEdge(edges, point, nextPoint);
+            point = nextPoint;
+        }
+
+        AddEdge(edges, point, Point(batch.endX[curveIdx], batch.endY[curveIdx]));
+    }
+
+
+    // Flattens the curves of the batch with flatness in the units of the control points. Blocks of
+    // curves step their forward differences together and the lanes whose curve has fewer pieces
+    // than the longest one in the block are skipped when the edges are written.
+    auto FlattenCurves(Array<Edge>& edges, const CurveBatch& batch, F32 flatness) -> V
+    {
+        auto inverseEightFlatness = 1.f / (8.f * flatness);
+        auto curveIdx = 0u;
+
+#if defined(__SSE2__)
+    #if defined(__AVX2__)
+        static constexpr U32 LANE_COUNT = 8;
+        using Lanes = __m256;
+        auto load = [](const F32* values) { return _mm256_loadu_ps(values); };
+        auto set = [](F32 value) { return _mm256_set1_ps(value); };
+        auto add = [](Lanes a, Lanes b) { return _mm256_add_ps(a, b); };
+        auto multiply = [](Lanes a, Lanes b) { return _mm256_mul_ps(a, b); };
+        auto store = [](F32* values, Lanes a) { _mm256_storeu_ps(values, a); };
+        auto getSegmentCount =
+            [&](const F32* curvature)
+            {
+                auto count = _mm256_min_ps(_mm256_sqrt_ps(_mm256_mul_ps(_mm256_sqrt_ps(_mm256_loadu_ps(curvature)), _mm256_set1_ps(inverseEightFlatness))), _mm256_set1_ps(MAX_CURVE_SEGMENTS));
+                auto rounded = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(count));
+                rounded = _mm256_add_ps(rounded, _mm256_and_ps(_mm256_cmp_ps(rounded, count, _CMP_LT_OQ), _mm256_set1_ps(1.f)));
+                return _mm256_max_ps(rounded, _mm256_set1_ps(1.f));
+            };
+        auto divide = [](Lanes a, Lanes b) { return _mm256_div_ps(a, b); };
+    #else
+        static constexpr U32 LANE_COUNT = 4;
+        using Lanes = __m128;
+        auto load = [](const F32* values) { return _mm_loadu_ps(values); };
+        auto set = [](F32 value) { return _mm_set1_ps(value); };
+        auto add = [](Lanes a, Lanes b) { return _mm_add_ps(a, b); };
+        auto multiply = [](Lanes a, Lanes b) { return _mm_mul_ps(a, b); };
+        auto store = [](F32* values, Lanes a) { _mm_storeu_ps(values, a); };
+        auto getSegmentCount =
+            [&](const F32* curvature)
+            {
+                auto count = _mm_min_ps(_mm_sqrt_ps(_mm_mul_ps(_mm_sqrt_ps(_mm_loadu_ps(curvature)), _mm_set1_ps(inverseEightFlatness))), _mm_set1_ps(MAX_CURVE_SEGMENTS));
+                auto rounded = _mm_cvtepi32_ps(_mm_cvttps_epi32(count));
+                rounded = _mm_add_ps(rounded, _mm_and_ps(_mm_cmplt_ps(rounded, count), _mm_set1_ps(1.f)));
+                return _mm_max_ps(rounded, _mm_set1_ps(1.f));
+            };
+        auto divide = [](Lanes a, Lanes b) { return _mm_div_ps(a, b); };
+    #endif
+
+        StaticArray<F32, LANE_COUNT> counts;
+        StaticArray<F32, LANE_COUNT> pointsX;
+        StaticArray<F32, LANE_COUNT> pointsY;
+        StaticArray<Point, LANE_COUNT> previousPoints;
+
+        for (; curveIdx + LANE_COUNT <= batch.GetSize(); curveIdx += LANE_COUNT)
+        {
+            auto count = getSegmentCount(batch.curvature + curveIdx);
+            auto step = divide(set(1.f), count);
+            auto step2 = multiply(step, step);
+            auto step3 = multiply(step2, step);
+
+            auto c1x = multiply(load(batch.c1x + curveIdx), step);
+            auto c1y = multiply(load(batch.c1y + curveIdx), step);
+            auto c2x = multiply(load(batch.c2x + curveIdx), step2);
+            auto c2y = multiply(load(batch.c2y + curveIdx), step2);
+            auto c3x = multiply(load(batch.c3x + curveIdx), step3);
+            auto c3y = multiply(load(batch.c3y + curveIdx), step3);
+            auto c3Times6X = multiply(set(6.f), c3x);
+            auto c3Times6Y = multiply(set(6.f), c3y);
+
+            for (auto* product : { &c1x, &c1y, &c2x, &c2y, &c3x, &c3y, &c3Times6X, &c3Times6Y })
+            {
+                KeepRounded(*product);
+            }
+
+            auto pointX = load(batch.c0x + curveIdx);
+            auto pointY = load(batch.c0y + curveIdx);
+            auto delta1X = add(add(c1x, c2x), c3x);
+            auto delta1Y = add(add(c1y, c2y), c3y);
+            auto delta2X = add(add(c2x, c2x), c3Times6X);
+            auto delta2Y = add(add(c2y, c2y), c3Times6Y);
+            auto delta3X = c3Times6X;
+            auto delta3Y = c3Times6Y;
+
+            store(counts.data(), count);
+            auto maxCount = 0.f;
+            for (auto lane = 0u; lane < LANE_COUNT; ++lane)
+            {
+                previousPoints[lane] = Point(batch.c0x[curveIdx + lane], batch.c0y[curveIdx + lane]);
+                maxCount = Max(maxCount, counts[lane]);
+            }
+
+            for (auto segment = 1.f; segment < maxCount; ++segment)
+            {
+                pointX = add(pointX, delta1X);
+                pointY = add(pointY, delta1Y);
+                delta1X = add(delta1X, delta2X);
+                delta1Y = add(delta1Y, delta2Y);
+                delta2X = add(delta2X, delta3X);
+                delta2Y = add(delta2Y, delta3Y);
+                store(pointsX.data(), pointX);
+                store(pointsY.data(), pointY);
+
+                for (auto lane = 0u; lane < LANE_COUNT; ++lane)
+                {
+                    if (segment < counts[lane])
+                    {
+                        auto point = Point(pointsX[lane], pointsY[lane]);
+                        AddEdge(edges, previousPoints[lane], point);
+                        previousPoints[lane] = point;
+                    }
+                }
+            }
+
+            for (auto lane = 0u; lane < LANE_COUNT; ++lane)
+            {
+                AddEdge(edges, previousPoints[lane], Point(batch.endX[curveIdx + lane], batch.endY[curveIdx + lane]));
+            }
+        }
+#endif
+
+        for (; curveIdx < batch.GetSize(); ++curveIdx)
+        {
+            FlattenCurve(edges, batch, curveIdx, inverseEightFlatness);
+        }
+    }
+
+
+    // The flatness is in pixels and gets converted to the units of the glyph.
+    auto Linearize(const GlyphData& glyphData, F32 scale, F32 flatness = DEFAULT_FLATNESS_IN_PIXELS) -> Array<Edge>
+    {
+        Array<Edge> edges;
+        edges.reserve(glyphData.outline.commands.size());
+        CurveBatch curves(U32(glyphData.outline.commands.size()));
+
+        auto& outline = glyphData.outline;
+        auto currentPoint = Point(0.f, 0.f);
+        auto pointIdx = 0u;
+
+        for (auto command : outline.commands)
+        {
+            switch (command)
+            {
+                case OutlineCommand::MoveTo:
+                {
+                    auto& point = outline.points[pointIdx];
+                    currentPoint = Point(point.x, point.y);
+                    pointIdx += 1;
+                    break;
+                }
+                case OutlineCommand::LineTo:
+                {
+                    auto& point = outline.points[pointIdx];
+                    auto endPoint = Point(point.x, point.y);
+                    AddEdge(edges, currentPoint, endPoint);
+                    currentPoint = endPoint;
+                    pointIdx += 1;
+                    break;
+                }
+                case OutlineCommand::QuadTo:
+                {
+                    auto& control = outline.points[pointIdx];
+                    auto& point = outline.points[pointIdx + 1];
+                    auto endPoint = Point(point.x, point.y);
+                    AddQuadratic(curves, currentPoint, Point(control.x, control.y), endPoint);
+                    currentPoint = endPoint;
+                    pointIdx += 2;
+                    break;
+                }
+                case OutlineCommand::CubicTo:
+                {
+                    auto& control0 = outline.points[pointIdx];
+                    auto& control1 = outline.points[pointIdx + 1];
+                    auto& point = outline.points[pointIdx + 2];
+                    auto endPoint = Point(point.x, point.y);
+                    AddCubic(curves, currentPoint, Point(control0.x, control0.y), Point(control1.x, control1.y), endPoint);
+                    currentPoint = endPoint;
+                    pointIdx += 3;
+                    break;
+                }
+            }
+        }
+
+        FlattenCurves(edges, curves, flatness / scale);
+
+        return edges;
+    }
+
+
+    auto TransformEdgesToSurfaceSpace(Array<Edge>& edges, F32 scale, Point translation) -> V
+    {
+        for (auto& edge : edges)
+        {
+            // We flip the second coordinate in order to match the coordinates of the pixel grid.
+            // This doesn't change the direction of the edges but now the uppermost edge is with lower
+            // numbers as vertical coordinates which is what we want.
+            edge.lowermostPoint.x *= scale;
+            edge.lowermostPoint.y *= -scale;
+            edge.uppermostPoint.x *= scale;
+            edge.uppermostPoint.y *= -scale;
+            edge.lowermostPoint.x += translation.x;
+            edge.lowermostPoint.y += translation.y;
+            edge.uppermostPoint.x += translation.x;
+            edge.uppermostPoint.y += translation.y;
+        }
+    }
+
+
+    // The first array holds the signed area of each pixel shadowed by an outline. The second one
+    // works as a commulative sum, a value there is added to all the pixels on the right. Both are
+    // padded with zeros to a multiple of SCANLINE_BLOCK_SIZE so that DrawScanline can load whole
+    // blocks. The spans are the ranges of entries the edges wrote to, everything else is zero.
+    template <typename TValue>
+    struct BasicScanline
+    {
+        Array<TValue> area;
+        Array<TValue> cover;
+        Array<Pair<U32, U32>> spans;
+    };
+
+    using Scanline = BasicScanline<F32>;
+
+    static constexpr U32 SCANLINE_BLOCK_SIZE = 8;
+
+    // The fixed point rasterizer works with 24.8 coordinates.
+    static constexpr I32 FIXED_SHIFT = 8;
+    static constexpr I32 FIXED_ONE = 1 << FIXED_SHIFT;
+    // The area of a pixel in the units of BasicScanline<I32>, twice the square of FIXED_ONE so that
+    // the areas of trapezoids stay integers.
+    static constexpr I32 FIXED_PIXEL_AREA = 2 * FIXED_ONE * FIXED_ONE;
+
+
+    // Here it's more convenient to store the edge in slope-intercept form.
+    struct ActiveEdge
+    {
+        F32 lowermostPoint1;
+        F32 uppermostPoint1;
+        F32 uppermostPoint0;
+        // The zeroth component of the intersection of the line passing through the edge's vertices 
+        // with the current scanline. By having this point, the slope and the first components of the 
+        // edge's vertices we can restore their original positions as well as easily compute the zeroth
+        // component of the intersection of the edge with a certain scanline.
+        F32 scanlineTopIntersection0;
+        // The derivative with respect to the zeroth direction.
+        F32 dxdy;
+        F32 direction;
+
+        ActiveEdge(F32 l1, F32 u1, F32 u0, F32 dxdy, F32 dir) :
+            lowermostPoint1(l1),
+            uppermostPoint1(u1),
+            uppermostPoint0(u0),
+            scanlineTopIntersection0(0),
+            dxdy(dxdy),
+            direction(dir)
+        {
+
+        }
+
+        // The intersection with every scanline follows from the uppermost point only, rather than
+        // by adding the slope once per row, so a band can start at any row without replaying the
+        // ones above and still get exactly the same intersections.
+        auto MoveToScanline(F32 scanlineTop) -> V
+        {
+            scanlineTopIntersection0 = uppermostPoint0 + dxdy * (scanlineTop - uppermostPoint1);
+        }
+    };
+
+
+    auto Activate(Array<ActiveEdge>& activeEdges, const Edge& edge, F32 scanlineTop) -> V
+    {
+        static constexpr F32 HORIZONTALITY_TOLERANCE  = (1.0f / F32(1 << 15)) * 4.0f;
+        auto dx = edge.lowermostPoint.x - edge.uppermostPoint.x;
+        auto dy = edge.lowermostPoint.y - edge.uppermostPoint.y;
+
+        if (dy <= HORIZONTALITY_TOLERANCE)
+        {
+            // We dont want horizontal edges just drop them
+        }
+        else 
+        {
+            auto dxdy = dx / dy;
+
+            activeEdges.emplace_back
+            (
+                edge.lowermostPoint.y,
+                edge.uppermostPoint.y,
+                edge.uppermostPoint.x,
+                dxdy,
+                edge.direction
+            );
+            activeEdges.back().MoveToScanline(scanlineTop);
+        }
+    }
+
+    auto AddActiveEdges
+    (
+        Array<ActiveEdge>& activeEdges,
+        const Array<Edge>& edges,
+        U32& edgesIdx,
+        F32 scanlineBot,
+        F32 scanlineTop
+    )
+    {
+        // Add all the edges that have their uppermost point before the end of this scanline
+        while (edgesIdx < edges.size() && edges[edgesIdx].uppermostPoint.y < scanlineBot)
+        {
+            Activate(activeEdges, edges[edgesIdx], scanlineTop);
+            edgesIdx++;
+        }
+    }
+
+    auto ProcessActiveEdge(const ActiveEdge& edge, Scanline& scanline, F32 scanlineBot, F32 scanlineTop)
+    {
+        // Now we need to find the highest point of the edge that is below the top of the scanline and 
+        // the lowest point of the edge that is above the scanline bottom. In case that the edges go 
+        // beyond the sanline the points we search for are intersections.
+        Point highPoint;
+        Point lowPoint;
+
+        if (scanlineTop < edge.uppermostPoint1)
+        {
+            highPoint.x = 
+                edge.scanlineTopIntersection0 + edge.dxdy * (edge.uppermostPoint1 - scanlineTop);
+            highPoint.y = edge.uppermostPoint1;
+        }
+        else
+        {
+            // Here we know that since the actual edge is above the scanline, the 0th direction 
+            // intersection has to be inside the surface since all edges are inside the surface
+            highPoint.x = edge.scanlineTopIntersection0;
+            highPoint.y = scanlineTop;
+        }
+
+        if (scanlineBot < edge.lowermostPoint1)
+        {
+            lowPoint.x = edge.scanlineTopIntersection0 + edge.dxdy;
+            lowPoint.y = scanlineBot;
+        }
+        else 
+        {
+            lowPoint.x = 
+                edge.scanlineTopIntersection0 + edge.dxdy * (edge.lowermostPoint1 - scanlineTop);
+            lowPoint.y = edge.lowermostPoint1;
+        }
+
+        // Once we have clipped the edge to the boundaries of the scanline there are two relevant 
+        // possibilities to look for namely wether or not high_point.0 < low_point.0. In the two cases
+        // the computation of the area will look differently because we process the pixels of the 
+        // scanline from left to right (increasing in the 0th direction) hence we will care about the 
+        // 0th coordinate of the edge. 
+        //
+        // However we can avoid that by simply recognizing that flipping the clipped edge around it's 
+        // vertical center won't change the unsigned area.
+
+        auto dxdy = edge.dxdy;
+        auto sign = edge.direction;
+
+        if (highPoint.x > lowPoint.x)
+        {
+            Swap(lowPoint.x, highPoint.x);
+            // The tangent also flips.
+            dxdy = -dxdy;
+        }
+
+        auto startPixel = Max(0.0f, Floor(highPoint.x));
+        auto startPixelIdx = U32(startPixel);
+        auto firstPixelIdx = startPixelIdx;
+        auto endPixel = Ceil(lowPoint.x);
+        auto height = lowPoint.y - highPoint.y;
+
+        // Spans a single pixel and is trapezoid
+        if (endPixel - startPixel <= 1.0f)
+        {
+            // We use startPixel + 1.0 instead of endPixel to handle vertical edges properly
+            auto area = height * ((startPixel + 1.0 - lowPoint.x) + (startPixel + 1.0 - highPoint.x)) / 2.0;
+
+            scanline.area[startPixelIdx] += sign * area;
+
+            startPixelIdx++;
+            // It induces rectangles in all the other pixels on the right hence we put the height
+            // times one (the width of the rectangles) in the next entry of the commulative sum 
+            // array (second component of the scanline).
+            if (startPixelIdx < scanline.cover.size())
+            {
+                scanline.cover[startPixelIdx] += sign * height;
+            }
+
+            scanline.spans.emplace_back(firstPixelIdx, Min(startPixelIdx + 1, U32(scanline.cover.size())));
+        }
+        else
+        {
+            // We need to find where the edge intersects the vertical pixel barier of the first
+            // pixel containing it.
+
+            auto width = startPixel + 1.0 - highPoint.x;
+            auto dydx = 1.0 / dxdy;
+
+            auto intersection1 = highPoint.y + width * dydx;
+            auto height = intersection1 - highPoint.y;
+
+            auto area = width * height / 2.0;
+
+            scanline.area[startPixelIdx] += sign * area;
+            startPixelIdx++;
+
+            auto endPixelIdx = U32(Round(endPixel - 1.0));
+
+            while (startPixelIdx < endPixelIdx)
+            {
+
+                auto area = (height + height + dydx) / 2.0;
+
+                scanline.area[startPixelIdx] += sign * area;
+
+                height += dydx;
+                startPixelIdx++;
+            }
+
+            // This is a combination of a trapezoid and rectangle
+            auto endWidthRect = endPixel - lowPoint.x;
+            auto endWidthTrap = 1.0 - endWidthRect;
+            auto endHeight = height + endWidthTrap * dydx;
+            auto endPixelArea = (height + endHeight) / 2.0 * endWidthTrap + endHeight * endWidthRect;
+
+            scanline.area[endPixelIdx] += sign * endPixelArea;
+
+            endPixelIdx++;
+
+            if (endPixelIdx < scanline.cover.size())
+            {
+                // All the remaining pixels are ocluded by rectangles with width 1 and height
+                // end_height.
+                scanline.cover[endPixelIdx] += sign * endHeight;
+            }
+
+            scanline.spans.emplace_back(firstPixelIdx, Min(endPixelIdx + 1, U32(scanline.cover.size())));
+        }
+    }
+
+
+    auto ProcessActiveEdges(const Array<ActiveEdge>& edges, Scanline& scanline, F32 scanlineBot, F32 scanlineTop)
+    {
+        for (auto& edge : edges)
+        {
+            ProcessActiveEdge(edge, scanline, scanlineBot, scanlineTop);
+        }
+    }
+
+    auto PrepareActiveEdgesForNextScanline(Array<ActiveEdge>& edges, F32 nextScanlineTop)
+    {
+        for (auto& edge : edges)
+        {
+            edge.MoveToScanline(nextScanlineTop);
+        }
+    }
+
+
+    auto PruneActiveEdges(Array<ActiveEdge>& activeEdges, F32 scanlineTop)
+    {
+        // We check if the edge is above the scanline in order to remove it. The remaining edges keep
+        // the order they were activated in, so a band seeded from the sorted edges in
+        // RasterizeEdgeRows adds up the areas in the same order as a single pass over all the rows.
+        std::erase_if(activeEdges, [&](const ActiveEdge& edge) { return edge.lowermostPoint1 <= scanlineTop; });
+    }
+
+
+    inline auto GetScanlinePixel(F32 value) -> Byte
+    {
+        return 255u - Byte(Min(std::abs(value) * 255.f, 255.f));
+    }
+
+    inline auto GetScanlinePixel(I32 value) -> Byte
+    {
+        return Byte(255 - (Min(std::abs(value), FIXED_PIXEL_AREA) * 255 >> (2 * FIXED_SHIFT + 1)));
+    }
+
+
+    template <typename TValue>
+    auto ClearScanline(BasicScanline<TValue>& scanline) 
+    {
+        for (auto [begin, end] : scanline.spans)
+        {
+            std::memset(scanline.area.data() + begin, 0, (end - begin) * sizeof(TValue));
+            std::memset(scanline.cover.data() + begin, 0, (end - begin) * sizeof(TValue));
+        }
+
+        scanline.spans.clear();
+    }
+
+
+    // Resolves the pixels from begin, which has to be a multiple of SCANLINE_BLOCK_SIZE, to end and
+    // returns the commulative sum after them.
+    //
+    // The commulative sum is computed in blocks of four lanes, pairs first and then the pairs of
+    // pairs, and every block is added to the total of the previous one. The SIMD versions add in
+    // exactly the same order so the output doesn't depend on the instruction set.
+    auto ResolveScanlineBlocks(Byte* row, const Scanline& scanline, U32 begin, U32 end, F32 carryIn) -> F32
+    {
+        auto area = scanline.area.data();
+        auto cover = scanline.cover.data();
+        auto i = begin;
+
+        // The sign depends on the orientation of the contours which is opposite for TrueType and CFF
+        // outlines.
+#if defined(__AVX2__)
+        auto carry = _mm256_set1_ps(carryIn);
+        auto signMask = _mm256_set1_ps(-0.f);
+        auto scale = _mm256_set1_ps(255.f);
+        auto lastLane = _mm256_set1_epi32(3);
+
+        for (; i < end; i += 8)
+        {
+            auto sum = _mm256_loadu_ps(cover + i);
+            sum = _mm256_add_ps(sum, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(sum), 4)));
+            sum = _mm256_add_ps(sum, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(sum), 8)));
+
+            // The upper block continues from the total of the lower one.
+            auto lowSum = _mm256_add_ps(carry, sum);
+            auto highSum = _mm256_add_ps(_mm256_permutevar8x32_ps(lowSum, lastLane), sum);
+            sum = _mm256_blend_ps(lowSum, highSum, 0xF0);
+            carry = _mm256_permutevar8x32_ps(sum, _mm256_set1_epi32(7));
+
+            auto value = _mm256_min_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, _mm256_add_ps(sum, _mm256_loadu_ps(area + i))), scale), scale);
+            auto pixels = _mm256_sub_epi32(_mm256_set1_epi32(255), _mm256_cvttps_epi32(value));
+            auto words = _mm_packs_epi32(_mm256_castsi256_si128(pixels), _mm256_extracti128_si256(pixels, 1));
+            auto bytes = _mm_packus_epi16(words, words);
+
+            if (i + 8 <= end)
+            {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(row + i), bytes);
+            }
+            else
+            {
+                StaticArray<Byte, 16> tail;
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(tail.data()), bytes);
+                std::memcpy(row + i, tail.data(), end - i);
+            }
+        }
+
+        return _mm256_cvtss_f32(carry);
+#elif defined(__SSE2__)
+        auto carry = _mm_set1_ps(carryIn);
+        auto signMask = _mm_set1_ps(-0.f);
+        auto scale = _mm_set1_ps(255.f);
+
+        for (; i < end; i += 4)
+        {
+            auto sum = _mm_loadu_ps(cover + i);
+            sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 4)));
+            sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 8)));
+            sum = _mm_add_ps(carry, sum);
+            carry = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 3, 3));
+
+            auto value = _mm_min_ps(_mm_mul_ps(_mm_andnot_ps(signMask, _mm_add_ps(sum, _mm_loadu_ps(area + i))), scale), scale);
+            auto pixels = _mm_sub_epi32(_mm_set1_epi32(255), _mm_cvttps_epi32(value));
+            auto words = _mm_packs_epi32(pixels, pixels);
+            auto bytes = U32(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+            std::memcpy(row + i, &bytes, Min(end - i, 4u));
+        }
+
+        return _mm_cvtss_f32(carry);
+#else
+        auto carry = carryIn;
+
+        for (; i < end; i += 4)
+        {
+            auto pair0 = cover[i] + cover[i + 1];
+            StaticArray<F32, 4> sum = { cover[i], pair0, (cover[i + 1] + cover[i + 2]) + cover[i], (cover[i + 2] + cover[i + 3]) + pair0 };
+
+            for (auto lane = 0u; lane < 4; ++lane)
+            {
+                sum[lane] = carry + sum[lane];
+            }
+            carry = sum[3];
+
+            for (auto lane = 0u; lane < 4 && i + lane < end; ++lane)
+            {
+                row[i + lane] = GetScanlinePixel(sum[lane] + area[i + lane]);
+            }
+        }
+
+        return carry;
+#endif
+    }
+
+
+    // Integer sums don't depend on the order so the blocks are simply as wide as the registers.
+    auto ResolveScanlineBlocks(Byte* row, const BasicScanline<I32>& scanline, U32 begin, U32 end, I32 carryIn) -> I32
+    {
+        auto area = scanline.area.data();
+        auto cover = scanline.cover.data();
+        auto i = begin;
+
+#if defined(__AVX2__)
+        auto carry = _mm256_set1_epi32(carryIn);
+        auto fullArea = _mm256_set1_epi32(FIXED_PIXEL_AREA);
+        auto lastLane = _mm256_set1_epi32(3);
+
+        for (; i < end; i += 8)
+        {
+            auto sum = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cover + i));
+            sum = _mm256_add_epi32(sum, _mm256_slli_si256(sum, 4));
+            sum = _mm256_add_epi32(sum, _mm256_slli_si256(sum, 8));
+            // The upper block continues from the total of the lower one.
+            sum = _mm256_add_epi32(sum, _mm256_blend_epi32(_mm256_setzero_si256(), _mm256_permutevar8x32_epi32(sum, lastLane), 0xF0));
+            sum = _mm256_add_epi32(carry, sum);
+            carry = _mm256_permutevar8x32_epi32(sum, _mm256_set1_epi32(7));
+
+            auto value = _mm256_min_epi32(_mm256_abs_epi32(_mm256_add_epi32(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(area + i)))), fullArea);
+            value = _mm256_srli_epi32(_mm256_sub_epi32(_mm256_slli_epi32(value, 8), value), 2 * FIXED_SHIFT + 1);
+            auto pixels = _mm256_sub_epi32(_mm256_set1_epi32(255), value);
+            auto words = _mm_packs_epi32(_mm256_castsi256_si128(pixels), _mm256_extracti128_si256(pixels, 1));
+            auto bytes = _mm_packus_epi16(words, words);
+
+            if (i + 8 <= end)
+            {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(row + i), bytes);
+            }
+            else
+            {
+                StaticArray<Byte, 16> tail;
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(tail.data()), bytes);
+                std::memcpy(row + i, tail.data(), end - i);
+            }
+        }
+
+        return _mm256_cvtsi256_si32(carry);
+#elif defined(__SSE2__)
+        auto carry = _mm_set1_epi32(carryIn);
+        auto fullArea = _mm_set1_epi32(FIXED_PIXEL_AREA);
+
+        for (; i < end; i += 4)
+        {
+            auto sum = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cover + i));
+            sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 4));
+            sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 8));
+            sum = _mm_add_epi32(carry, sum);
+            carry = _mm_shuffle_epi32(sum, _MM_SHUFFLE(3, 3, 3, 3));
+
+            // SSE2 has neither an absolute value nor a minimum of 32 bit integers.
+            auto value = _mm_add_epi32(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(area + i)));
+            auto signs = _mm_srai_epi32(value, 31);
+            value = _mm_sub_epi32(_mm_xor_si128(value, signs), signs);
+            auto greater = _mm_cmpgt_epi32(value, fullArea);
+            value = _mm_or_si128(_mm_and_si128(greater, fullArea), _mm_andnot_si128(greater, value));
+            value = _mm_srli_epi32(_mm_sub_epi32(_mm_slli_epi32(value, 8), value), 2 * FIXED_SHIFT + 1);
+
+            auto pixels = _mm_sub_epi32(_mm_set1_epi32(255), value);
+            auto words = _mm_packs_epi32(pixels, pixels);
+            auto bytes = U32(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+            std::memcpy(row + i, &bytes, Min(end - i, 4u));
+        }
+
+        return _mm_cvtsi128_si32(carry);
+#else
+        auto carry = carryIn;
+
+        for (; i < end; ++i)
+        {
+            carry += cover[i];
+            row[i] = GetScanlinePixel(carry + area[i]);
+        }
+
+        return carry;
+#endif
+    }
+
+
+    // Only the blocks the edges wrote to go through the commulative sum. Everything between them has
+    // no area and a constant sum so it's filled with a single value, e.g. the inside of a wide stroke
+    // or the empty space between glyphs. Adding the zeros is exact which keeps the result identical to
+    // resolving the whole width.
+    template <typename TValue>
+    auto DrawScanline(const SurfaceView& surface, BasicScanline<TValue>& scanline, U32 scanlineIdx)
+    {
+        auto row = surface.data + U64(surface.stride) * scanlineIdx;
+        auto& spans = scanline.spans;
+
+        for (auto& span : spans)
+        {
+            span.first = span.first / SCANLINE_BLOCK_SIZE * SCANLINE_BLOCK_SIZE;
+            span.second = Min((span.second + SCANLINE_BLOCK_SIZE - 1) / SCANLINE_BLOCK_SIZE * SCANLINE_BLOCK_SIZE, U32(scanline.area.size()));
+        }
+
+        Sort(spans);
+
+        auto carry = TValue(0);
+        auto column = 0u;
+
+        for (auto spanIdx = 0u; spanIdx < spans.size() && column < surface.width;)
+        {
+            auto begin = Max(spans[spanIdx].first, column);
+            auto end = spans[spanIdx].second;
+
+            // Merge the overlapping and touching spans.
+            for (spanIdx++; spanIdx < spans.size() && spans[spanIdx].first <= end; ++spanIdx)
+            {
+                end = Max(end, spans[spanIdx].second);
+            }
+
+            std::memset(row + column, GetScanlinePixel(carry), Min(begin, surface.width) - column);
+
+            if (begin < end)
+            {
+                carry = ResolveScanlineBlocks(row, scanline, begin, Min(end, surface.width), carry);
+            }
+
+            column = Max(column, Min(end, surface.width));
+        }
+
+        std::memset(row + column, GetScanlinePixel(carry), surface.width - column);
+    }
+
+    // This function implements the high level functionality of the rasterizing algorithm for the
+    // rows from firstRow to endRow.
+    auto RasterizeEdgeRows(const Array<Edge>& edges, const SurfaceView& surface, U32 firstRow, U32 endRow) -> V
+    {
+        Scanline scanline;
+        auto paddedWidth = (surface.width + SCANLINE_BLOCK_SIZE - 1) / SCANLINE_BLOCK_SIZE * SCANLINE_BLOCK_SIZE;
+        scanline.area.resize(paddedWidth, 0.f);
+        scanline.cover.resize(paddedWidth, 0.f);
+
+        // We keep a set of edges that are relevant for the current scanline each iteration
+        Array<ActiveEdge> activeEdges;
+        activeEdges.reserve(surface.width);
+
+        // Edges that start above the first row would have been activated on an earlier one. Their
+        // intersections don't depend on that row so they are activated right on the first one.
+        auto edgesIdx = firstRow == 0 ? 0u : U32(std::partition_point(edges.begin(), edges.end(), [&](const Edge& edge) { return edge.uppermostPoint.y < F32(firstRow); }) - edges.begin());
+
+        for (auto i = 0u; i < edgesIdx; ++i)
+        {
+            if (edges[i].lowermostPoint.y > F32(firstRow))
+            {
+                Activate(activeEdges, edges[i], F32(firstRow));
+            }
+        }
+
+        for (auto i = firstRow; i < endRow; ++i) 
+        {
+            auto scanlineTop = F32(i);
+            auto scanlineBot = F32(i + 1.f);
+
+            // Remove edges that are not relevant for this scanline, hence no longer relevant in 
+            // general.
+            PruneActiveEdges(activeEdges, scanlineTop);
+            // Add all the new edges that have become relevant for the scanline.
+            AddActiveEdges(activeEdges, edges, edgesIdx, scanlineBot, scanlineTop);
+            // Fill the scanline array according to the edges intersecting the scanline
+            ProcessActiveEdges(activeEdges, scanline, scanlineBot, scanlineTop);
+            // Fill the surface scanline according to the scanline array
+            DrawScanline(surface, scanline, i);
+            ClearScanline(scanline);
+            // Transform the representation of the active edges so that they are convenient for
+            // pruning and processing next scanline.
+            PrepareActiveEdgesForNextScanline(activeEdges, scanlineBot);
+        }
+    }
+
+
+    // Calls work(item, thread) for every item on threadCount threads that take the items in order
+    // from a shared counter.
+    template <typename TWork>
+    auto ParallelFor(U64 itemCount, U32 threadCount, TWork&& work) -> V
+    {
+        threadCount = U32(Max(Min(U64(threadCount), itemCount), U64(1)));
+        Atomic<U64> nextItem = 0;
+
+        auto run =
+            [&](U32 thread)
+            {
+                for (auto item = nextItem.fetch_add(1, std::memory_order_relaxed); item < itemCount; item = nextItem.fetch_add(1, std::memory_order_relaxed))
+                {
+                    work(item, thread);
+                }
+            };
+
+        Array<std::thread> threads;
+
+        for (auto t = 1u; t < threadCount; ++t)
+        {
+            threads.emplace_back(run, t);
+        }
+
+        run(0);
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+
+    // A fixed point edge in 24.8 surface coordinates. The first point is the uppermost one.
+    struct FixedEdge
+    {
+        I32 x0;
+        I32 y0;
+        I32 x1;
+        I32 y1;
+        I32 direction;
+    };
+
+    inline auto operator<(const FixedEdge& e0, const FixedEdge& e1) -> bool 
+    {
+        return e0.y0 < e1.y0;
+    }
+
+    struct FixedPoint
+    {
+        I32 x;
+        I32 y;
+    };
+
+    static constexpr I64 FIXED_MAX_CURVE_SEGMENTS = 1024;
+
+
+    // Both round towards negative infinity for a positive denominator.
+    inline auto FloorDivide(I64 numerator, I64 denominator) -> I64
+    {
+        auto quotient = numerator / denominator;
+        return numerator % denominator < 0 ? quotient - 1 : quotient;
+    }
+
+    inline auto RoundDivide(I64 numerator, I64 denominator) -> I64
+    {
+        return FloorDivide(2 * numerator + denominator, 2 * denominator);
+    }
+
+
+    auto AddEdge(Array<FixedEdge>& edges, FixedPoint startPoint, FixedPoint endPoint) -> V
+    {
+        if (startPoint.y < endPoint.y)
+        {
+            edges.push_back(FixedEdge{ startPoint.x, startPoint.y, endPoint.x, endPoint.y, 1 });
+        }
+        else if (startPoint.y > endPoint.y)
+        {
+            edges.push_back(FixedEdge{ endPoint.x, endPoint.y, startPoint.x, startPoint.y, -1 });
+        }
+    }
+
+
+    // Number of uniform pieces after which a curve whose second derivative is at most
+    // secondDerivative is within flatness from them. The error of a piece is at most its
+    // squared length in t times the second derivative over 8.
+    auto GetFixedSegmentCount(I64 secondDerivative, I64 flatness) -> I64
+    {
+        auto count = Max(I64(std::sqrt(F64(secondDerivative) / F64(8 * flatness))), I64(1));
+
+        while (count < FIXED_MAX_CURVE_SEGMENTS && count * count * 8 * flatness < secondDerivative)
+        {
+            count++;
+        }
+
+        return Min(count, FIXED_MAX_CURVE_SEGMENTS);
+    }
+
+
+    // Flattens the outline into 24.8 surface space. The only floating point operations are the
+    // products of the integer font units with the scale, which are exact in double precision, and
+    // the roundings after them so the edges are the same everywhere. The curves are cut in uniform
+    // pieces whose points are computed from the Bernstein form with integers.
+    auto LinearizeFixed(const GlyphData& glyphData, F32 scale, F32 offsetX, F32 flatness = DEFAULT_FLATNESS_IN_PIXELS) -> Array<FixedEdge>
+    {
+        Array<FixedEdge> edges;
+        edges.reserve(glyphData.outline.points.size());
+        auto minX = F64(glyphData.boundingBoxDiagonal.startPoint.x);
+        auto maxY = F64(glyphData.boundingBoxDiagonal.endPoint.y);
+        auto fixedScale = F64(scale) * FIXED_ONE;
+        auto fixedOffsetX = F64(offsetX) * FIXED_ONE;
+        auto fixedFlatness = Max(I64(F64(flatness) * FIXED_ONE), I64(1));
+
+        auto toFixed =
+            [&](const TTFPoint& point)
+            {
+                return FixedPoint{ I32(std::round((F64(point.x) - minX) * fixedScale + fixedOffsetX)), I32(std::round((maxY - point.y) * fixedScale)) };
+            };
+
+        auto& outline = glyphData.outline;
+        auto currentPoint = FixedPoint{ 0, 0 };
+        auto pointIdx = 0u;
+
+        for (auto command : outline.commands)
+        {
+            switch (command)
+            {
+                case OutlineCommand::MoveTo:
+                {
+                    currentPoint = toFixed(outline.points[pointIdx]);
+                    pointIdx += 1;
+                    break;
+                }
+                case OutlineCommand::LineTo:
+                {
+                    auto endPoint = toFixed(outline.points[pointIdx]);
+                    AddEdge(edges, currentPoint, endPoint);
+                    currentPoint = endPoint;
+                    pointIdx += 1;
+                    break;
+                }
+                case OutlineCommand::QuadTo:
+                {
+                    auto p0 = currentPoint;
+                    auto p1 = toFixed(outline.points[pointIdx]);
+                    auto p2 = toFixed(outline.points[pointIdx + 1]);
+                    auto secondDifference = Max(std::abs(I64(p0.x) - 2 * p1.x + p2.x), std::abs(I64(p0.y) - 2 * p1.y + p2.y));
+                    auto count = GetFixedSegmentCount(2 * secondDifference, fixedFlatness);
+
+                    // The points times count squared are a quadratic in the index, stepped exactly
+                    // with forward differences.
+                    auto denominator = count * count;
+                    auto valueX = I64(p0.x) * denominator;
+                    auto valueY = I64(p0.y) * denominator;
+                    auto stepX = 2 * (I64(p1.x) - p0.x) * count + (I64(p0.x) - 2 * p1.x + p2.x);
+                    auto stepY = 2 * (I64(p1.y) - p0.y) * count + (I64(p0.y) - 2 * p1.y + p2.y);
+                    auto accelerationX = 2 * (I64(p0.x) - 2 * p1.x + p2.x);
+                    auto accelerationY = 2 * (I64(p0.y) - 2 * p1.y + p2.y);
+
+                    for (auto i = I64(1); i <= count; ++i)
+                    {
+                        valueX += stepX;
+                        valueY += stepY;
+                        stepX += accelerationX;
+                        stepY += accelerationY;
+
+                        auto point = FixedPoint{ I32(RoundDivide(valueX, denominator)), I32(RoundDivide(valueY, denominator)) };
+                        AddEdge(edges, currentPoint, point);
+                        currentPoint = point;
+                    }
+
+                    pointIdx += 2;
+                    break;
+                }
+                case OutlineCommand::CubicTo:
+                {
+                    auto p0 = currentPoint;
+                    auto p1 = toFixed(outline.points[pointIdx]);
+                    auto p2 = toFixed(outline.points[pointIdx + 1]);
+                    auto p3 = toFixed(outline.points[pointIdx + 2]);
+                    auto secondDifference = Max
+                    (
+                        Max(std::abs(I64(p0.x) - 2 * p1.x + p2.x), std::abs(I64(p0.y) - 2 * p1.y + p2.y)),
+                        Max(std::abs(I64(p1.x) - 2 * p2.x + p3.x), std::abs(I64(p1.y) - 2 * p2.y + p3.y))
+                    );
+                    auto count = GetFixedSegmentCount(6 * secondDifference, fixedFlatness);
+
+                    // The same with a cubic in the index.
+                    auto denominator = count * count * count;
+                    auto linearX = 3 * (I64(p1.x) - p0.x) * count * count;
+                    auto linearY = 3 * (I64(p1.y) - p0.y) * count * count;
+                    auto quadraticX = 3 * (I64(p0.x) - 2 * p1.x + p2.x) * count;
+                    auto quadraticY = 3 * (I64(p0.y) - 2 * p1.y + p2.y) * count;
+                    auto cubicX = I64(p3.x) - 3 * p2.x + 3 * I64(p1.x) - p0.x;
+                    auto cubicY = I64(p3.y) - 3 * p2.y + 3 * I64(p1.y) - p0.y;
+                    auto valueX = I64(p0.x) * denominator;
+                    auto valueY = I64(p0.y) * denominator;
+                    auto stepX = linearX + quadraticX + cubicX;
+                    auto stepY = linearY + quadraticY + cubicY;
+                    auto accelerationX = 2 * quadraticX + 6 * cubicX;
+                    auto accelerationY = 2 * quadraticY + 6 * cubicY;
+
+                    for (auto i = I64(1); i <= count; ++i)
+                    {
+                        valueX += stepX;
+                        valueY += stepY;
+                        stepX += accelerationX;
+                        stepY += accelerationY;
+                        accelerationX += 6 * cubicX;
+                        accelerationY += 6 * cubicY;
+
+                        auto point = FixedPoint{ I32(RoundDivide(valueX, denominator)), I32(RoundDivide(valueY, denominator)) };
+                        AddEdge(edges, currentPoint, point);
+                        currentPoint = point;
+                    }
+
+                    pointIdx += 3;
+                    break;
+                }
+            }
+        }
+
+        return edges;
+    }
+
+
+    struct FixedActiveEdge
+    {
+        FixedEdge edge;
+        // Where the edge enters the current row.
+        I32 rowX;
+        // Where the edge crosses the bottom of the current row, rounded down, and what was left of
+        // the division by the height of the edge.
+        I32 bottomX;
+        I64 bottomRemainder;
+        // The same quotient and remainder for a whole row.
+        I32 stepX;
+        I64 stepRemainder;
+    };
+
+    inline auto GetFixedEdgeX(const FixedEdge& edge, I32 y) -> I32
+    {
+        return y >= edge.y1 ? edge.x1 : edge.x0 + I32(FloorDivide(I64(y - edge.y0) * (edge.x1 - edge.x0), edge.y1 - edge.y0));
+    }
+
+    // The position on every row follows from the end points only, so a band can start at any row
+    // without replaying the ones above. The rows after that are stepped to without divisions.
+    auto Activate(Array<FixedActiveEdge>& activeEdges, const FixedEdge& edge, I32 rowTop) -> V
+    {
+        auto dx = I64(edge.x1 - edge.x0);
+        auto dy = I64(edge.y1 - edge.y0);
+        auto bottomOffset = (I64(rowTop) + FIXED_ONE - edge.y0) * dx;
+        auto bottomX = FloorDivide(bottomOffset, dy);
+        auto stepX = FloorDivide(FIXED_ONE * dx, dy);
+
+        activeEdges.push_back
+        (
+            FixedActiveEdge
+            {
+                edge,
+                GetFixedEdgeX(edge, Max(edge.y0, rowTop)),
+                I32(edge.x0 + bottomX),
+                bottomOffset - bottomX * dy,
+                I32(stepX),
+                FIXED_ONE * dx - stepX * dy
+            }
+        );
+    }
+
+    auto ProcessActiveEdge(FixedActiveEdge& activeEdge, BasicScanline<I32>& scanline, I32 rowTop)
+    {
+        auto& edge = activeEdge.edge;
+        auto lastColumn = I32(scanline.area.size()) - 1;
+        auto rowHeight = Min(edge.y1, rowTop + FIXED_ONE) - Max(edge.y0, rowTop);
+        auto highX = activeEdge.rowX;
+        auto lowX = edge.y1 <= rowTop + FIXED_ONE ? edge.x1 : activeEdge.bottomX;
+        activeEdge.rowX = lowX;
+        activeEdge.bottomX += activeEdge.stepX;
+        activeEdge.bottomRemainder += activeEdge.stepRemainder;
+
+        if (activeEdge.bottomRemainder >= edge.y1 - edge.y0)
+        {
+            activeEdge.bottomX++;
+            activeEdge.bottomRemainder -= edge.y1 - edge.y0;
+        }
+
+        // As with the floating point edges the area doesn't change when the edge is flipped.
+        auto leftX = Max(Min(highX, lowX), 0);
+        auto rightX = Max(Max(highX, lowX), 0);
+        auto firstColumn = Min(leftX >> FIXED_SHIFT, lastColumn);
+        auto endColumn = Min(rightX >> FIXED_SHIFT, lastColumn);
+        auto sign = edge.direction;
+
+        // Every piece of the edge inside a pixel shadows a trapezoid of it and the full height of the
+        // piece of all the pixels on the right.
+        auto addPiece =
+            [&](I32 column, I32 height, I32 x0, I32 x1)
+            {
+                auto columnX = column << FIXED_SHIFT;
+                scanline.area[column] += sign * height * (2 * FIXED_ONE - (x0 - columnX) - (x1 - columnX));
+
+                if (column + 1 <= lastColumn)
+                {
+                    scanline.cover[column + 1] += sign * height * 2 * FIXED_ONE;
+                }
+            };
+
+        if (firstColumn == endColumn)
+        {
+            addPiece(firstColumn, rowHeight, leftX, rightX);
+        }
+        else
+        {
+            // The height at the pixel boundaries is rounded down. It's stepped by the quotient and the
+            // remainder of a pixel's worth of height so that there are no divisions in the loop.
+            auto width = I64(rightX - leftX);
+            auto boundaryX = (firstColumn + 1) << FIXED_SHIFT;
+            auto numerator = I64(boundaryX - leftX) * rowHeight;
+            auto height = I32(numerator / width);
+            auto remainder = numerator % width;
+            auto step = I32(I64(FIXED_ONE) * rowHeight / width);
+            auto stepRemainder = I64(FIXED_ONE) * rowHeight % width;
+            auto previousHeight = 0;
+            auto previousX = leftX;
+
+            for (auto column = firstColumn; column < endColumn; ++column)
+            {
+                addPiece(column, height - previousHeight, previousX, boundaryX);
+                previousHeight = height;
+                previousX = boundaryX;
+                boundaryX += FIXED_ONE;
+                height += step;
+                remainder += stepRemainder;
+
+                if (remainder >= width)
+                {
+                    height++;
+                    remainder -= width;
+                }
+            }
+
+            addPiece(endColumn, rowHeight - previousHeight, previousX, Min(rightX, (lastColumn + 1) << FIXED_SHIFT));
+        }
+
+        scanline.spans.emplace_back(firstColumn, Min(endColumn + 2, lastColumn + 1));
+    }
+
+
+    // Same passes over the rows as RasterizeEdgeRows, with the integer edges.
+    auto RasterizeEdgeRows(const Array<FixedEdge>& edges, const SurfaceView& surface, U32 firstRow, U32 endRow) -> V
+    {
+        BasicScanline<I32> scanline;
+        auto paddedWidth = (surface.width + SCANLINE_BLOCK_SIZE - 1) / SCANLINE_BLOCK_SIZE * SCANLINE_BLOCK_SIZE;
+        scanline.area.resize(paddedWidth, 0);
+        scanline.cover.resize(paddedWidth, 0);
+
+        Array<FixedActiveEdge> activeEdges;
+        auto firstRowTop = I32(firstRow) << FIXED_SHIFT;
+        auto edgesIdx = U32(std::partition_point(edges.begin(), edges.end(), [&](const FixedEdge& edge) { return edge.y0 < firstRowTop; }) - edges.begin());
+
+        for (auto i = 0u; i < edgesIdx; ++i)
+        {
+            if (edges[i].y1 > firstRowTop)
+            {
+                Activate(activeEdges, edges[i], firstRowTop);
+            }
+        }
+
+        for (auto i = firstRow; i < endRow; ++i)
+        {
+            auto rowTop = I32(i) << FIXED_SHIFT;
+
+            std::erase_if(activeEdges, [&](const FixedActiveEdge& edge) { return edge.edge.y1 <= rowTop; });
+
+            while (edgesIdx < edges.size() && edges[edgesIdx].y0 < rowTop + FIXED_ONE)
+            {
+                Activate(activeEdges, edges[edgesIdx], rowTop);
+                edgesIdx++;
+            }
+
+            for (auto& edge : activeEdges)
+            {
+                ProcessActiveEdge(edge, scanline, rowTop);
+            }
+
+            DrawScanline(surface, scanline, i);
+            ClearScanline(scanline);
+        }
+    }
+
+
+    // The analytic rasterizer keeps the quadratic curves. They are split into pieces that are
+    // monotone in both directions and every piece is cut exactly at the scanlines and at the pixel
+    // boundaries by solving the quadratic. The area a piece leaves on the right in its pixel comes in
+    // closed form from the integral of x dy, so the coverage is exact and the number of edges
+    // doesn't grow with the size.
+    struct CurveEdge
+    {
+        // The curve goes down from the first point to the last one.
+        Point point0;
+        Point point1;
+        Point point2;
+        F32 direction;
+    };
+
+    inline auto operator<(const CurveEdge& e0, const CurveEdge& e1) -> bool
+    {
+        return e0.point0.y < e1.point0.y;
+    }
+
+
+    // Point of the curve for u == v and the control point of the piece from u to v otherwise.
+    inline auto Blossom(Point point0, Point point1, Point point2, F32 u, F32 v) -> Point
+    {
+        auto weight0 = (1 - u) * (1 - v);
+        auto weight1 = (1 - u) * v + u * (1 - v);
+        auto weight2 = u * v;
+
+        return Point
+        (
+            weight0 * point0.x + weight1 * point1.x + weight2 * point2.x,
+            weight0 * point0.y + weight1 * point1.y + weight2 * point2.y
+        );
+    }
+
+
+    // Below this the quadratic term moves a solution by less than a thousandth of a pixel, which is
+    // the case for the lines.
+    static constexpr F32 CURVE_STRAIGHTNESS_TOLERANCE = 1.f / 1024;
+
+    // The parameter where a quadratic with Bernstein coefficients p0 <= p1 <= p2 takes the value. The
+    // form with the square root in the denominator doesn't lose precision for almost straight curves.
+    inline auto SolveMonotoneQuadratic(F32 p0, F32 p1, F32 p2, F32 value) -> F32
+    {
+        auto a = p0 - 2 * p1 + p2;
+        auto b = 2 * (p1 - p0);
+        auto c = p0 - value;
+        auto denominator = std::abs(a) < CURVE_STRAIGHTNESS_TOLERANCE ? 2 * b : b + std::sqrt(Max(b * b - 4 * a * c, 0.f));
+
+        return denominator > 0 ? Min(Max(-2 * c / denominator, 0.f), 1.f) : 0.f;
+    }
+
+
+    // Errors in the solutions can leave the control point of a piece slightly outside of the box of
+    // its end points, which would break the monotonicity.
+    inline auto ClampControlPoint(Point point0, Point point1, Point point2) -> Point
+    {
+        return Point
+        (
+            Min(Max(point1.x, Min(point0.x, point2.x)), Max(point0.x, point2.x)),
+            Min(Max(point1.y, Min(point0.y, point2.y)), Max(point0.y, point2.y))
+        );
+    }
+
+
+    // Adds a quadratic in surface space split at its extremums.
+    auto AddCurveEdges(Array<CurveEdge>& edges, Point point0, Point point1, Point point2) -> V
+    {
+        StaticArray<F32, 4> splits = { 0.f };
+        auto splitCount = 1u;
+
+        for (auto [p0, p1, p2] : { std::tuple(point0.x, point1.x, point2.x), std::tuple(point0.y, point1.y, point2.y) })
+        {
+            auto t = (p0 - p1) / (p0 - 2 * p1 + p2);
+            if (0 < t && t < 1)
+            {
+                splits[splitCount++] = t;
+            }
+        }
+
+        if (splitCount == 3 && splits[2] < splits[1])
+        {
+            Swap(splits[1], splits[2]);
+        }
+        splits[splitCount++] = 1.f;
+
+        auto startPoint = point0;
+
+        for (auto splitIdx = 1u; splitIdx < splitCount; ++splitIdx)
+        {
+            auto u = splits[splitIdx - 1];
+            auto v = splits[splitIdx];
+            auto endPoint = splitIdx + 1 == splitCount ? point2 : Blossom(point0, point1, point2, v, v);
+            auto controlPoint = ClampControlPoint(startPoint, Blossom(point0, point1, point2, u, v), endPoint);
+
+            if (startPoint.y < endPoint.y)
+            {
+                edges.push_back(CurveEdge{ startPoint, controlPoint, endPoint, -1.f });
+            }
+            else if (startPoint.y > endPoint.y)
+            {
+                edges.push_back(CurveEdge{ endPoint, controlPoint, startPoint, 1.f });
+            }
+
+            startPoint = endPoint;
+        }
+    }
+
+
+    // Cubics are approximated by quadratics with the control point (3 (c1 + c2) - c0 - c3) / 4. The
+    // error of that is at most sqrt(3) / 36 times the third difference, which goes down with the cube
+    // of the number of uniform pieces.
+    auto AddCubicCurveEdges(Array<CurveEdge>& edges, Point point0, Point point1, Point point2, Point point3, F32 flatness) -> V
+    {
+        static constexpr F32 MAX_CUBIC_PIECES = 64;
+
+        auto thirdDifference = std::hypot(point3.x - 3 * point2.x + 3 * point1.x - point0.x, point3.y - 3 * point2.y + 3 * point1.y - point0.y);
+        auto pieceCount = U32(Min(Max(Ceil(std::cbrt(std::sqrt(3.f) / 36.f * thirdDifference / flatness)), 1.f), MAX_CUBIC_PIECES));
+
+        auto getPoint =
+            [&](F32 t)
+            {
+                auto s = 1 - t;
+                return Point
+                (
+                    s * s * s * point0.x + 3 * s * s * t * point1.x + 3 * s * t * t * point2.x + t * t * t * point3.x,
+                    s * s * s * point0.y + 3 * s * s * t * point1.y + 3 * s * t * t * point2.y + t * t * t * point3.y
+                );
+            };
+
+        // The control points of a piece come from the blossom of the cubic.
+        auto getBlossom =
+            [&](F32 u, F32 v, F32 w)
+            {
+                auto weight0 = (1 - u) * (1 - v) * (1 - w);
+                auto weight1 = u * (1 - v) * (1 - w) + (1 - u) * v * (1 - w) + (1 - u) * (1 - v) * w;
+                auto weight2 = u * v * (1 - w) + u * (1 - v) * w + (1 - u) * v * w;
+                auto weight3 = u * v * w;
+                return Point
+                (
+                    weight0 * point0.x + weight1 * point1.x + weight2 * point2.x + weight3 * point3.x,
+                    weight0 * point0.y + weight1 * point1.y + weight2 * point2.y + weight3 * point3.y
+                );
+            };
+
+        auto startPoint = point0;
+
+        for (auto pieceIdx = 1u; pieceIdx <= pieceCount; ++pieceIdx)
+        {
+            auto u = F32(pieceIdx - 1) / pieceCount;
+            auto v = F32(pieceIdx) / pieceCount;
+            auto endPoint = pieceIdx == pieceCount ? point3 : getPoint(v);
+            auto control0 = getBlossom(u, u, v);
+            auto control1 = getBlossom(u, v, v);
+            auto controlPoint = Point
+            (
+                (3 * (control0.x + control1.x) - startPoint.x - endPoint.x) / 4,
+                (3 * (control0.y + control1.y) - startPoint.y - endPoint.y) / 4
+            );
+
+            AddCurveEdges(edges, startPoint, controlPoint, endPoint);
+            startPoint = endPoint;
+        }
+    }
+
+
+    // Transforms the outline to surface space like RasterizeInto does for the edges. The flatness
+    // only matters for the cubics.
+    auto GetCurveEdges(const GlyphData& glyphData, F32 scale, F32 offsetX, F32 flatness) -> Array<CurveEdge>
+    {
+        Array<CurveEdge> edges;
+        edges.reserve(glyphData.outline.commands.size());
+        auto minX = F32(glyphData.boundingBoxDiagonal.startPoint.x);
+        auto maxY = F32(glyphData.boundingBoxDiagonal.endPoint.y);
+
+        auto toSurface = [&](const TTFPoint& point) { return Point((point.x - minX) * scale + offsetX, (maxY - point.y) * scale); };
+
+        auto& outline = glyphData.outline;
+        auto currentPoint = Point(0.f, 0.f);
+        auto pointIdx = 0u;
+
+        for (auto command : outline.commands)
+        {
+            switch (command)
+            {
+                case OutlineCommand::MoveTo:
+                {
+                    currentPoint = toSurface(outline.points[pointIdx]);
+                    pointIdx += 1;
+                    break;
+                }
+                case OutlineCommand::LineTo:
+                {
+                    auto endPoint = toSurface(outline.points[pointIdx]);
+                    auto middlePoint = Point((currentPoint.x + endPoint.x) / 2, (currentPoint.y + endPoint.y) / 2);
+                    AddCurveEdges(edges, currentPoint, middlePoint, endPoint);
+                    currentPoint = endPoint;
+                    pointIdx += 1;
+                    break;
+                }
+                case OutlineCommand::QuadTo:
+                {
+                    auto endPoint = toSurface(outline.points[pointIdx + 1]);
+                    AddCurveEdges(edges, currentPoint, toSurface(outline.points[pointIdx]), endPoint);
+                    currentPoint = endPoint;
+                    pointIdx += 2;
+                    break;
+                }
+                case OutlineCommand::CubicTo:
+                {
+                    auto endPoint = toSurface(outline.points[pointIdx + 2]);
+                    AddCubicCurveEdges
+                    (
+                        edges,
+                        currentPoint,
+                        toSurface(outline.points[pointIdx]),
+                        toSurface(outline.points[pointIdx + 1]),
+                        endPoint,
+                        flatness
+                    );
+                    currentPoint = endPoint;
+                    pointIdx += 3;
+                    break;
+                }
+            }
+        }
+
+        return edges;
+    }
+
+
+    // Adds a piece of a curve that lies in a single pixel. The integral of x dy along a quadratic is
+    // the one along its chord plus a third of the cross product of the control polygon.
+    inline auto AddCurvePiece(Scanline& scanline, Point point0, Point point1, Point point2, U32 column, F32 sign) -> V
+    {
+        auto height = point2.y - point0.y;
+        auto x0 = point0.x - F32(column);
+        auto x1 = point1.x - F32(column);
+        auto x2 = point2.x - F32(column);
+        auto integral = (x0 + x2) / 2 * height + ((x1 - x0) * height - (point1.y - point0.y) * (x2 - x0)) / 3;
+
+        scanline.area[column] += sign * (height - integral);
+
+        if (column + 1 < scanline.cover.size())
+        {
+            scanline.cover[column + 1] += sign * height;
+        }
+    }
+
+
+    struct ActiveCurve
+    {
+        CurveEdge curve;
+        // Where the curve enters the current row, both the parameter and the point.
+        F32 top;
+        Point topPoint;
+    };
+
+
+    auto Activate(Array<ActiveCurve>& activeCurves, const CurveEdge& curve, F32 rowTop) -> V
+    {
+        auto& [p0, p1, p2, direction] = curve;
+        auto top = rowTop <= p0.y ? 0.f : SolveMonotoneQuadratic(p0.y, p1.y, p2.y, rowTop);
+        auto topPoint = top == 0 ? p0 : Blossom(p0, p1, p2, top, top);
+        topPoint.y = Max(p0.y, rowTop);
+
+        activeCurves.push_back(ActiveCurve{ curve, top, topPoint });
+    }
+
+
+    // Adds the part of the curve inside the row and moves it to the next one.
+    auto ProcessActiveCurve(ActiveCurve& activeCurve, Scanline& scanline, F32 rowTop) -> V
+    {
+        auto& [p0, p1, p2, direction] = activeCurve.curve;
+        auto bottom = Min(p2.y, rowTop + 1);
+        auto u = activeCurve.top;
+        auto v = bottom == p2.y ? 1.f : SolveMonotoneQuadratic(p0.y, p1.y, p2.y, bottom);
+
+        auto point0 = activeCurve.topPoint;
+        auto point2 = v == 1 ? p2 : Blossom(p0, p1, p2, v, v);
+        point2.y = bottom;
+        auto point1 = ClampControlPoint(point0, Blossom(p0, p1, p2, u, v), point2);
+
+        activeCurve.top = v;
+        activeCurve.topPoint = point2;
+
+        if (bottom <= point0.y)
+        {
+            return;
+        }
+
+        auto increasing = point0.x <= point2.x;
+        auto firstColumn = U32(Max(Floor(Min(point0.x, point2.x)), 0.f));
+        auto lastColumn = Min(U32(Max(Floor(Max(point0.x, point2.x)), 0.f)), U32(scanline.area.size() - 1));
+
+        // Cut at every pixel boundary the piece crosses, from left to right or the other way around.
+        auto startPoint = point0;
+        auto start = 0.f;
+
+        for (auto boundaryIdx = 0u; boundaryIdx < lastColumn - firstColumn; ++boundaryIdx)
+        {
+            auto column = increasing ? firstColumn + boundaryIdx : lastColumn - boundaryIdx;
+            auto boundary = F32(increasing ? column + 1 : column);
+            auto end = increasing ?
+                SolveMonotoneQuadratic(point0.x, point1.x, point2.x, boundary) :
+                SolveMonotoneQuadratic(-point0.x, -point1.x, -point2.x, -boundary);
+
+            auto endPoint = Blossom(point0, point1, point2, end, end);
+            endPoint.x = boundary;
+            endPoint.y = Min(Max(endPoint.y, startPoint.y), point2.y);
+
+            AddCurvePiece(scanline, startPoint, ClampControlPoint(startPoint, Blossom(point0, point1, point2, start, end), endPoint), endPoint, column, direction);
+            startPoint = endPoint;
+            start = end;
+        }
+
+        auto lastPieceColumn = increasing ? lastColumn : firstColumn;
+        auto lastControlPoint = start == 0 ? point1 : ClampControlPoint(startPoint, Blossom(point0, point1, point2, start, 1.f), point2);
+        AddCurvePiece(scanline, startPoint, lastControlPoint, point2, lastPieceColumn, direction);
+
+        scanline.spans.emplace_back(firstColumn, Min(lastColumn + 2, U32(scanline.cover.size())));
+    }
+
 
-        if (FromBE(headTable1Ptr->version) != 0x00010000) 
+    // Same passes over the rows as RasterizeEdgeRows, with the curves. A curve enters a row where it
+    // left the previous one, which is the same solution a band seeded in the middle of it gets.
+    auto RasterizeEdgeRows(const Array<CurveEdge>& edges, const SurfaceView& surface, U32 firstRow, U32 endRow) -> V
+    {
+        Scanline scanline;
+        auto paddedWidth = (surface.width + SCANLINE_BLOCK_SIZE - 1) / SCANLINE_BLOCK_SIZE * SCANLINE_BLOCK_SIZE;
+        scanline.area.resize(paddedWidth, 0.f);
+        scanline.cover.resize(paddedWidth, 0.f);
+
+        Array<ActiveCurve> activeCurves;
+        auto edgesIdx = U32(std::partition_point(edges.begin(), edges.end(), [&](const CurveEdge& edge) { return edge.point0.y < F32(firstRow); }) - edges.begin());
+
+        for (auto i = 0u; i < edgesIdx; ++i)
         {
-            return Error::UnsupportedLocaTableVersion;
+            if (edges[i].point2.y > F32(firstRow))
+            {
+                Activate(activeCurves, edges[i], F32(firstRow));
+            }
         }
-        else
+
+        for (auto i = firstRow; i < endRow; ++i)
         {
-            xMin = FromBE(headTable2Ptr->xMin);
-            yMin = FromBE(headTable2Ptr->yMin);
-            xMax = FromBE(headTable2Ptr->xMax);
-            yMax = FromBE(headTable2Ptr->yMax);
-            unitsPerEm = FromBE(headTable1Ptr->unitsPerEm);
+            auto rowTop = F32(i);
 
-            switch(FromBE(headTable2Ptr->indexToLocaFormat))
+            std::erase_if(activeCurves, [&](const ActiveCurve& curve) { return curve.curve.point2.y <= rowTop; });
+
+            while (edgesIdx < edges.size() && edges[edgesIdx].point0.y < rowTop + 1)
             {
-                case 0:
-                    longLocaIndex = false;
-                    return Error::Success;
-                case 1:
-                    longLocaIndex = true;
-                    return Error::Success;
-                default:
-                    return Error::UnsupportedLocaTableIndex;
+                Activate(activeCurves, edges[edgesIdx], rowTop);
+                edgesIdx++;
+            }
+
+            for (auto& curve : activeCurves)
+            {
+                ProcessActiveCurve(curve, scanline, rowTop);
+            }
+
+            DrawScanline(surface, scanline, i);
+            ClearScanline(scanline);
+        }
+    }
+
+
+    // Tall surfaces are split into bands of rows that are rasterized in parallel. The output is the
+    // same for any number of threads. Starting a thread costs about as much as rasterizing several
+    // thousand pixels, so every thread gets at least MIN_RASTER_PIXELS_PER_THREAD of them and
+    // small glyphs are rasterized on the calling thread alone.
+    static constexpr U32 MIN_RASTER_BAND_HEIGHT = 32;
+    static constexpr U64 MIN_RASTER_PIXELS_PER_THREAD = 16384;
+
+    template <typename TEdge>
+    auto RasterizeEdges(const Array<TEdge>& edges, const SurfaceView& surface, U32 threadCount = 1) -> V
+    {
+        threadCount = U32(Min(U64(threadCount), U64(surface.width) * surface.height / MIN_RASTER_PIXELS_PER_THREAD));
+
+        if (threadCount <= 1 || surface.height < 2 * MIN_RASTER_BAND_HEIGHT)
+        {
+            RasterizeEdgeRows(edges, surface, 0, surface.height);
+            return;
+        }
+
+        // A few bands per thread even out the ones that are more expensive.
+        auto bandHeight = Max(MIN_RASTER_BAND_HEIGHT, (surface.height + 4 * threadCount - 1) / (4 * threadCount));
+        auto bandCount = (surface.height + bandHeight - 1) / bandHeight;
+
+        ParallelFor
+        (
+            bandCount,
+            threadCount,
+            [&](U64 band, U32)
+            {
+                RasterizeEdgeRows(edges, surface, U32(band) * bandHeight, Min(U32(band + 1) * bandHeight, surface.height));
+            }
+        );
+    }
+
+    // Size of the surface Rasterize makes for a glyph with the bounding box.
+    auto GetRasterSize(const Line& boundingBox, F32 scale, F32 offsetX, U32& width, U32& height) -> V
+    {
+        width = Ceil((F32(boundingBox.endPoint.x) - boundingBox.startPoint.x + 1.0) * scale + offsetX);
+        height = Ceil((F32(boundingBox.endPoint.y) - boundingBox.startPoint.y + 1.0) * scale);
+    }
+
+    // Rasterizes into a view of the size given by GetRasterSize. Every pixel of it is written. The
+    // curves are flattened to within flatness pixels.
+    template <RasterArithmetic ARITHMETIC = RasterArithmetic::Float>
+    auto RasterizeInto
+    (
+        const GlyphData& glyph_data,
+        F32 scale,
+        F32 offsetX,
+        const SurfaceView& surface,
+        U32 threadCount = 1,
+        F32 flatness = DEFAULT_FLATNESS_IN_PIXELS
+    ) -> V
+    {
+        if constexpr (ARITHMETIC == RasterArithmetic::Fixed)
+        {
+            auto edges = LinearizeFixed(glyph_data, scale, offsetX, flatness);
+            Sort(edges);
+            RasterizeEdges(edges, surface, threadCount);
+            return;
+        }
+        else if constexpr (ARITHMETIC == RasterArithmetic::Analytic)
+        {
+            auto edges = GetCurveEdges(glyph_data, scale, offsetX, flatness);
+            Sort(edges);
+            RasterizeEdges(edges, surface, threadCount);
+            return;
+        }
+
+        F32 minX = glyph_data.boundingBoxDiagonal.startPoint.x;
+        F32 minY = glyph_data.boundingBoxDiagonal.startPoint.y;
+        F32 maxY = glyph_data.boundingBoxDiagonal.endPoint.y;
+
+        // The next code can be confusing beause some operations are omitted due to mental algebra.
+        // If S is the scaling matrix R is the reflection matrix tO is translation of the lowermost 
+        // bounding box point to the origin, then tC is the translation of the resulting bounding box's
+        // center to the origin and tSc is the translation of the scaled bounding box's lowermost point
+        // to the origin then the final transformation T on point p is Tp = RS(p + tO + tC) + t_sc.
+        // Now when we writeout the explicit form of the final translation vector of this affine 
+        // transformation namely RStO + RStC + tsC some of the terms in the components will cencel 
+        // out.
+        // 
+        // This operation is done only once per rasterization so it's irrelevant how efficient it is. 
+        // I would've used more clear form but I've not implemented traits for 2d matrix algebra so I 
+        // have to resort to this confusing componentwise form.
+
+        auto tO = Point(-minX, -minY);
+        auto tC1 = minY - maxY;
+
+        auto translationVector = Point(scale * tO.x + offsetX, -scale * (tO.y + tC1));
+
+        auto edges = Linearize(glyph_data, scale, flatness);
+
+        TransformEdgesToSurfaceSpace(edges, scale, translationVector);
+
+        // Sort by the uppermost edges. Edges with uppermost points the higher up will be first.
+        Sort(edges);
+
+        RasterizeEdges(edges, surface, threadCount);
+    }
+
+    // The offset moves the glyph right by a fraction of a pixel.
+    template <RasterArithmetic ARITHMETIC = RasterArithmetic::Float>
+    auto Rasterize
+    (
+        const GlyphData& glyph_data,
+        F32 scale,
+        F32 offsetX = 0,
+        U32 threadCount = 1,
+        F32 flatness = DEFAULT_FLATNESS_IN_PIXELS
+    ) -> GrayScaleSurface
+    {
+        GrayScaleSurface surface;
+        GetRasterSize(glyph_data.boundingBoxDiagonal, scale, offsetX, surface.width, surface.height);
+        surface.data.resize(surface.height * surface.width);
+
+        RasterizeInto<ARITHMETIC>(glyph_data, scale, offsetX, SurfaceView{ surface.data.data(), surface.width, surface.height, surface.width }, threadCount, flatness);
+
+        return surface;
+    }
+
+    template <RasterArithmetic ARITHMETIC>
+    auto RasterizeGlyph(const FontData& fontData, I32 codepoint, I32 height, U32 threadCount) -> GrayScaleSurface
+    {
+        auto fontScale = fontData.GetScaleForPixelHeight(F32(height));
+
+        auto glyph = fontData.FetchGlyphDataForCodepoint(codepoint);
+        return Rasterize<ARITHMETIC>(glyph, fontScale, 0, threadCount);
+    }
+
+    template auto RasterizeGlyph<RasterArithmetic::Float>(const FontData&, I32, I32, U32) -> GrayScaleSurface;
+    template auto RasterizeGlyph<RasterArithmetic::Fixed>(const FontData&, I32, I32, U32) -> GrayScaleSurface;
+    template auto RasterizeGlyph<RasterArithmetic::Analytic>(const FontData&, I32, I32, U32) -> GrayScaleSurface;
+
+
+    auto GlyphKeyHash::operator()(const GlyphKey& key) const -> U64
+    {
+        auto hash = (U64(key.fontId) << 32 | key.glyphIndex) * 0x9E3779B97F4A7C15ull;
+        hash ^= (U64(key.size) << 32 | key.subpixelOffset) + 0x632BE59BD9B4E019ull + (hash << 6) + (hash >> 2);
+        return hash ^ (hash >> 29);
+    }
+
+
+    // An outline segment in surface space for the distance fields. Lines keep the control point in
+    // the middle so that every segment can be evaluated as a quadratic.
+    struct DistanceSegment
+    {
+        Point p0;
+        Point p1;
+        Point p2;
+        B line;
+    };
+
+    struct DistanceContours
+    {
+        Array<DistanceSegment> segments;
+        // One past the last segment of each contour.
+        Array<U32> contourEnds;
+    };
+
+    inline auto Dot(Point a, Point b) -> F32
+    {
+        return a.x * b.x + a.y * b.y;
+    }
+
+    inline auto Lerp(Point a, Point b, F32 t) -> Point
+    {
+        return Point(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
+    }
+
+    inline auto EvaluateSegment(const DistanceSegment& segment, F32 t) -> Point
+    {
+        return Lerp(Lerp(segment.p0, segment.p1, t), Lerp(segment.p1, segment.p2, t), t);
+    }
+
+    // Moves the outline to the pixel grid of a surface with the glyph placed like in Rasterize and
+    // the given margin on every side. Cubics are approximated by four quadratics each.
+    auto CollectDistanceContours(const GlyphData& glyphData, F32 scale, F32 margin) -> DistanceContours
+    {
+        DistanceContours contours;
+        auto minX = F32(glyphData.boundingBoxDiagonal.startPoint.x);
+        auto maxY = F32(glyphData.boundingBoxDiagonal.endPoint.y);
+
+        auto toSurface = [&](TTFPoint point) { return Point((point.x - minX) * scale + margin, (maxY - point.y) * scale + margin); };
+
+        auto addQuadratic =
+            [&](Point p0, Point p1, Point p2)
+            {
+                // A control point on the chord makes it a line.
+                auto chord = Point(p2.x - p0.x, p2.y - p0.y);
+                auto cross = (p1.x - p0.x) * chord.y - (p1.y - p0.y) * chord.x;
+                auto line = Square(cross) <= 1e-8f * Square(Dot(chord, chord));
+                contours.segments.push_back(DistanceSegment{ p0, line ? Lerp(p0, p2, 0.5f) : p1, p2, line });
+            };
+
+        auto& outline = glyphData.outline;
+        auto currentPoint = Point(0.f, 0.f);
+        auto pointIdx = 0u;
+
+        for (auto command : outline.commands)
+        {
+            switch (command)
+            {
+                case OutlineCommand::MoveTo:
+                {
+                    if (!contours.segments.empty() && (contours.contourEnds.empty() || contours.contourEnds.back() != contours.segments.size()))
+                    {
+                        contours.contourEnds.push_back(U32(contours.segments.size()));
+                    }
+
+                    currentPoint = toSurface(outline.points[pointIdx]);
+                    pointIdx += 1;
+                    break;
+                }
+                case OutlineCommand::LineTo:
+                {
+                    auto endPoint = toSurface(outline.points[pointIdx]);
+                    contours.segments.push_back(DistanceSegment{ currentPoint, Lerp(currentPoint, endPoint, 0.5f), endPoint, true });
+                    currentPoint = endPoint;
+                    pointIdx += 1;
+                    break;
+                }
+                case OutlineCommand::QuadTo:
+                {
+                    auto endPoint = toSurface(outline.points[pointIdx + 1]);
+                    addQuadratic(currentPoint, toSurface(outline.points[pointIdx]), endPoint);
+                    currentPoint = endPoint;
+                    pointIdx += 2;
+                    break;
+                }
+                case OutlineCommand::CubicTo:
+                {
+                    auto c0 = toSurface(outline.points[pointIdx]);
+                    auto c1 = toSurface(outline.points[pointIdx + 1]);
+                    auto endPoint = toSurface(outline.points[pointIdx + 2]);
+
+                    for (auto i = 0u; i < 4; ++i)
+                    {
+                        // Control points of the quarter [t0, t1] of the cubic.
+                        auto t0 = F32(i) / 4;
+                        auto t1 = F32(i + 1) / 4;
+                        auto evaluate =
+                            [&](F32 t)
+                            {
+                                auto a = Lerp(Lerp(currentPoint, c0, t), Lerp(c0, c1, t), t);
+                                auto b = Lerp(Lerp(c0, c1, t), Lerp(c1, endPoint, t), t);
+                                return Pair<Point, Point>(Lerp(a, b, t), Point(3 * (b.x - a.x), 3 * (b.y - a.y)));
+                            };
+                        auto [q0, d0] = evaluate(t0);
+                        auto [q3, d1] = evaluate(t1);
+                        auto h = (t1 - t0) / 3;
+                        auto q1 = Point(q0.x + d0.x * h, q0.y + d0.y * h);
+                        auto q2 = Point(q3.x - d1.x * h, q3.y - d1.y * h);
+                        addQuadratic(q0, Point((3 * (q1.x + q2.x) - q0.x - q3.x) / 4, (3 * (q1.y + q2.y) - q0.y - q3.y) / 4), q3);
+                    }
+
+                    currentPoint = endPoint;
+                    pointIdx += 3;
+                    break;
+                }
+            }
+        }
+
+        if (!contours.segments.empty() && (contours.contourEnds.empty() || contours.contourEnds.back() != contours.segments.size()))
+        {
+            contours.contourEnds.push_back(U32(contours.segments.size()));
+        }
+
+        return contours;
+    }
+
+
+    // Real roots of a t^3 + b t^2 + c t + d.
+    auto SolveCubic(F64 a, F64 b, F64 c, F64 d, F64* roots) -> U32
+    {
+        if (std::abs(a) < 1e-12)
+        {
+            if (std::abs(b) < 1e-12)
+            {
+                if (std::abs(c) < 1e-12)
+                {
+                    return 0;
+                }
+
+                roots[0] = -d / c;
+                return 1;
+            }
+
+            auto discriminant = c * c - 4 * b * d;
+
+            if (discriminant < 0)
+            {
+                return 0;
+            }
+
+            auto root = Sqrt(discriminant);
+            roots[0] = (-c + root) / (2 * b);
+            roots[1] = (-c - root) / (2 * b);
+            return 2;
+        }
+
+        b /= a;
+        c /= a;
+        d /= a;
+
+        auto q = (b * b - 3 * c) / 9;
+        auto r = (2 * b * b * b - 9 * b * c + 27 * d) / 54;
+
+        if (r * r < q * q * q)
+        {
+            auto theta = std::acos(Max(-1.0, Min(1.0, r / Sqrt(q * q * q))));
+            auto scale = -2 * Sqrt(q);
+            roots[0] = scale * std::cos(theta / 3) - b / 3;
+            roots[1] = scale * std::cos((theta + 2 * std::numbers::pi) / 3) - b / 3;
+            roots[2] = scale * std::cos((theta - 2 * std::numbers::pi) / 3) - b / 3;
+            return 3;
+        }
+
+        auto u = -std::copysign(std::cbrt(std::abs(r) + Sqrt(r * r - q * q * q)), r);
+        roots[0] = u + (u != 0 ? q / u : 0) - b / 3;
+        return 1;
+    }
+
+
+    // Squared distance from the point to the segment and the parameter of the closest point.
+    auto GetSegmentDistance(const DistanceSegment& segment, Point point, F32& closestT) -> F32
+    {
+        auto d = Point(segment.p0.x - point.x, segment.p0.y - point.y);
+
+        if (segment.line)
+        {
+            auto direction = Point(segment.p2.x - segment.p0.x, segment.p2.y - segment.p0.y);
+            auto lengthSquared = Dot(direction, direction);
+            closestT = lengthSquared > 0 ? Max(0.f, Min(1.f, -Dot(d, direction) / lengthSquared)) : 0;
+            return Square(d.x + direction.x * closestT) + Square(d.y + direction.y * closestT);
+        }
+
+        // The closest point is where the derivative of |B(t) - p|^2 vanishes or at an end point.
+        auto a = Point(segment.p1.x - segment.p0.x, segment.p1.y - segment.p0.y);
+        auto b = Point(segment.p0.x - 2 * segment.p1.x + segment.p2.x, segment.p0.y - 2 * segment.p1.y + segment.p2.y);
+
+        F64 roots[3];
+        auto rootCount = SolveCubic(Dot(b, b), 3.0 * Dot(a, b), 2.0 * Dot(a, a) + Dot(d, b), Dot(d, a), roots);
+
+        closestT = 0;
+        auto best = Dot(d, d);
+        auto endDistance = Square(segment.p2.x - point.x) + Square(segment.p2.y - point.y);
+
+        if (endDistance < best)
+        {
+            closestT = 1;
+            best = endDistance;
+        }
+
+        for (auto i = 0u; i < rootCount; ++i)
+        {
+            auto t = F32(roots[i]);
+
+            if (t > 0 && t < 1)
+            {
+                auto x = d.x + 2 * a.x * t + b.x * t * t;
+                auto y = d.y + 2 * a.y * t + b.y * t * t;
+                auto distance = x * x + y * y;
+
+                if (distance < best)
+                {
+                    closestT = t;
+                    best = distance;
+                }
+            }
+        }
+
+        return best;
+    }
+
+
+    // Segments whose box grown by the spread overlaps each cell of a coarse grid over the surface.
+    // Pixels only need to look at the segments of their cell since the others are farther than
+    // the spread.
+    struct DistanceGrid
+    {
+        U32 cellSize;
+        U32 columnCount;
+        U32 rowCount;
+        Array<U32> cellStarts;
+        Array<U32> segmentIndices;
+
+        auto GetCell(U32 x, U32 y) const -> Span<const U32>
+        {
+            auto cell = (y / cellSize) * columnCount + x / cellSize;
+            return Span<const U32>(segmentIndices.data() + cellStarts[cell], cellStarts[cell + 1] - cellStarts[cell]);
+        }
+    };
+
+    auto BuildDistanceGrid(const Array<DistanceSegment>& segments, U32 width, U32 height, F32 spread) -> DistanceGrid
+    {
+        DistanceGrid grid;
+        grid.cellSize = U32(Max(Ceil(spread), 8.f));
+        grid.columnCount = (width + grid.cellSize - 1) / grid.cellSize;
+        grid.rowCount = (height + grid.cellSize - 1) / grid.cellSize;
+        grid.cellStarts.assign(U64(grid.columnCount) * grid.rowCount + 1, 0);
+
+        // Counted in the first pass and filled in the second.
+        for (auto pass = 0u; pass < 2; ++pass)
+        {
+            Array<U32> cellFill;
+
+            if (pass == 1)
+            {
+                for (auto i = 1u; i < grid.cellStarts.size(); ++i)
+                {
+                    grid.cellStarts[i] += grid.cellStarts[i - 1];
+                }
+
+                grid.segmentIndices.resize(grid.cellStarts.back());
+                cellFill.assign(grid.cellStarts.begin(), grid.cellStarts.end() - 1);
+            }
+
+            for (auto i = 0u; i < segments.size(); ++i)
+            {
+                auto& segment = segments[i];
+                auto minX = Min(Min(segment.p0.x, segment.p1.x), segment.p2.x) - spread;
+                auto maxX = Max(Max(segment.p0.x, segment.p1.x), segment.p2.x) + spread;
+                auto minY = Min(Min(segment.p0.y, segment.p1.y), segment.p2.y) - spread;
+                auto maxY = Max(Max(segment.p0.y, segment.p1.y), segment.p2.y) + spread;
+
+                auto firstColumn = U32(Max(minX, 0.f)) / grid.cellSize;
+                auto lastColumn = Min(U32(Max(maxX, 0.f)) / grid.cellSize, grid.columnCount - 1);
+                auto firstRow = U32(Max(minY, 0.f)) / grid.cellSize;
+                auto lastRow = Min(U32(Max(maxY, 0.f)) / grid.cellSize, grid.rowCount - 1);
+
+                for (auto row = firstRow; row <= lastRow; ++row)
+                {
+                    for (auto column = firstColumn; column <= lastColumn; ++column)
+                    {
+                        auto cell = row * grid.columnCount + column;
+
+                        if (pass == 0)
+                        {
+                            grid.cellStarts[cell + 1]++;
+                        }
+                        else
+                        {
+                            grid.segmentIndices[cellFill[cell]++] = i;
+                        }
+                    }
+                }
+            }
+        }
+
+        return grid;
+    }
+
+
+    // The outline split where it turns up or down so every piece crosses a horizontal line at most
+    // once. Used to find the winding number of the pixels.
+    auto SplitMonotonicInY(const Array<DistanceSegment>& segments) -> Array<DistanceSegment>
+    {
+        Array<DistanceSegment> monotonic;
+
+        for (auto& segment : segments)
+        {
+            auto curvature = segment.p0.y - 2 * segment.p1.y + segment.p2.y;
+            auto t = curvature != 0 ? (segment.p0.y - segment.p1.y) / curvature : 0.f;
+
+            if (segment.line || t <= 0 || t >= 1)
+            {
+                monotonic.push_back(segment);
+                continue;
+            }
+
+            auto middle = EvaluateSegment(segment, t);
+            monotonic.push_back(DistanceSegment{ segment.p0, Lerp(segment.p0, segment.p1, t), middle, false });
+            monotonic.push_back(DistanceSegment{ middle, Lerp(segment.p1, segment.p2, t), segment.p2, false });
+        }
+
+        return monotonic;
+    }
+
+
+    // Where the horizontal line at y crosses the outline and in which direction, sorted by x.
+    auto FindCrossings(const Array<DistanceSegment>& monotonic, F32 y, Array<Pair<F32, I32>>& crossings) -> V
+    {
+        crossings.clear();
+
+        for (auto& segment : monotonic)
+        {
+            auto y0 = segment.p0.y;
+            auto y2 = segment.p2.y;
+
+            // Half open so that a line through a vertex is counted once.
+            if (y < Min(y0, y2) || y >= Max(y0, y2))
+            {
+                continue;
+            }
+
+            F32 t;
+
+            if (segment.line)
+            {
+                t = (y - y0) / (y2 - y0);
+            }
+            else
+            {
+                auto a = y0 - 2 * segment.p1.y + y2;
+                auto b = 2 * (segment.p1.y - y0);
+                auto c = y0 - y;
+
+                if (std::abs(a) < 1e-6f)
+                {
+                    t = -c / b;
+                }
+                else
+                {
+                    auto root = Sqrt(Max(b * b - 4 * a * c, 0.f));
+                    t = (-b + root) / (2 * a);
+
+                    if (t < 0 || t > 1)
+                    {
+                        t = (-b - root) / (2 * a);
+                    }
+                }
             }
+
+            crossings.emplace_back(EvaluateSegment(segment, Max(0.f, Min(1.f, t))).x, y2 > y0 ? 1 : -1);
         }
+
+        std::sort(crossings.begin(), crossings.end());
     }
 
 
-    auto FontData::FetchGlobalInfoFromHhea() -> Error
+    auto RasterizeSDF(const GlyphData& glyphData, F32 scale, F32 spread, U32 threadCount) -> GrayScaleSurface
     {
-        struct HheaTable
-        {
-            U32 version;
-            I16 ascent;
-            I16 descent;
-            I16 lineGap;
-            U16 advanceWidthMax;
-            I16 minLeftSideBearing;
-            I16 minRightSideBearing;
-            // "The extent is the distance from the left side bearing to the right most positions 
-            // in the glyph outline." 
-            //    - https://developer.apple.com/fonts/TrueType-Reference-Manual/RM06/Chap6hhea.html
-            I16 xMaxExtent;
-            I16 caretSlopeRise;
-            I16 caretSoloRun;
-            I16 caretOffset;
-            I16 reserved0;
-            I16 reserved1;
-            I16 reserved2;
-            I16 reserved3;
-            I16 metricDataFormat;
-            U16 numberOfLongHorizontalMetrics;
-        };
+        GrayScaleSurface surface;
+        spread = Max(spread, 1e-3f);
+        auto margin = Ceil(spread);
 
+        GetRasterSize(glyphData.boundingBoxDiagonal, scale, 0, surface.width, surface.height);
+        surface.width += 2 * U32(margin);
+        surface.height += 2 * U32(margin);
+        surface.data.resize(U64(surface.width) * surface.height);
 
-        auto hheaTablePtr  = (const HheaTable*)(data.data() + hheaTable.offset);
+        auto contours = CollectDistanceContours(glyphData, scale, margin);
+        auto& segments = contours.segments;
+        auto monotonic = SplitMonotonicInY(segments);
+        auto grid = BuildDistanceGrid(segments, surface.width, surface.height, spread);
+        Array<Array<Pair<F32, I32>>> crossings(Max(threadCount, 1u));
 
-        if (FromBE(hheaTablePtr->version) != 0x00010000)
-        {
-            return Error::UnsupportedHheaTableVersion;
-        }
+        ParallelFor
+        (
+            surface.height,
+            threadCount,
+            [&](U64 row, U32 thread)
+            {
+                auto y = F32(row) + 0.5f;
+                auto& rowCrossings = crossings[thread];
+                FindCrossings(monotonic, y, rowCrossings);
 
-        ascent = FromBE(hheaTablePtr->ascent);
-        descent = FromBE(hheaTablePtr->descent);
-        lineGap = FromBE(hheaTablePtr->lineGap);
-        advanceWidthMax = FromBE(hheaTablePtr->advanceWidthMax);
-        numberOfLongHorizontalMetrics = FromBE(hheaTablePtr->numberOfLongHorizontalMetrics);
+                auto crossing = 0u;
+                auto winding = 0;
 
-        return Error::Success;
+                for (auto column = 0u; column < surface.width; ++column)
+                {
+                    auto point = Point(F32(column) + 0.5f, y);
+
+                    while (crossing < rowCrossings.size() && rowCrossings[crossing].first < point.x)
+                    {
+                        winding += rowCrossings[crossing].second;
+                        crossing++;
+                    }
+
+                    auto distance = spread * spread;
+
+                    for (auto segmentIndex : grid.GetCell(column, U32(row)))
+                    {
+                        F32 t;
+                        distance = Min(distance, GetSegmentDistance(segments[segmentIndex], point, t));
+                    }
+
+                    auto signedDistance = winding != 0 ? Sqrt(distance) : -Sqrt(distance);
+                    auto value = Max(0.f, Min(1.f, 0.5f + signedDistance / (2 * spread)));
+                    surface.data[row * surface.width + column] = Byte(Round(value * 255.f));
+                }
+            }
+        );
+
+        return surface;
     }
 
 
-    auto FontData::GetIdxDataTableFromCmap() -> Error
+    // Channels of the MSDF edge colors.
+    static constexpr U8 EDGE_RED = 1;
+    static constexpr U8 EDGE_GREEN = 2;
+    static constexpr U8 EDGE_BLUE = 4;
+    static constexpr U8 EDGE_CYAN = EDGE_GREEN | EDGE_BLUE;
+    static constexpr U8 EDGE_MAGENTA = EDGE_RED | EDGE_BLUE;
+    static constexpr U8 EDGE_YELLOW = EDGE_RED | EDGE_GREEN;
+    static constexpr U8 EDGE_WHITE = EDGE_RED | EDGE_GREEN | EDGE_BLUE;
+
+    inline auto Cross(Point a, Point b) -> F32
     {
-        struct CmapTableHeader
-        {
-            U16 version;
-            U16 subtableCount;
-        };
+        return a.x * b.y - a.y * b.x;
+    }
 
-        struct CmapSubtable
-        {
-            U16 platformId;
-            U16 platformSpecificId;
-            U32 offset;
-        };
+    inline auto Normalize(Point a) -> Point
+    {
+        auto length = Sqrt(Dot(a, a));
+        return length > 0 ? Point(a.x / length, a.y / length) : Point(0.f, 0.f);
+    }
 
-        auto cmapHeaderPtr = (const CmapTableHeader*)(data.data() + cmapTable.offset);
+    inline auto GetSegmentDirection(const DistanceSegment& segment, F32 t) -> Point
+    {
+        auto direction = Lerp(Point(segment.p1.x - segment.p0.x, segment.p1.y - segment.p0.y), Point(segment.p2.x - segment.p1.x, segment.p2.y - segment.p1.y), t);
 
-        if (cmapHeaderPtr->version != 0)
+        // A control point on top of an end point has no tangent there.
+        if (Dot(direction, direction) == 0)
         {
-            return Error::UnsupportedFormat;
+            return Point(segment.p2.x - segment.p0.x, segment.p2.y - segment.p0.y);
         }
 
-        auto subtableCount = FromBE(cmapHeaderPtr->subtableCount);
+        return direction;
+    }
 
-        this->indexMapOffset = 0;
+    // Colors the edges with two channels each so that consecutive edges meeting at a corner share
+    // only one of them. Smooth contours keep all three channels on every edge.
+    auto ColorEdges(const DistanceContours& contours) -> Array<U8>
+    {
+        // Corners are where the direction turns by more than about 8 degrees.
+        static constexpr F32 CORNER_SINE = 0.14f;
 
-        for (auto k = 0; k < subtableCount; ++k)
-        {
-            auto offset = this->cmapTable.offset + sizeof(CmapTableHeader) + k * sizeof(CmapSubtable);
+        Array<U8> colors(contours.segments.size(), EDGE_WHITE);
+        Array<U32> corners;
+        auto contourStart = 0u;
 
-            auto subtablePtr = (const CmapSubtable*)(this->data.data() + offset);
+        for (auto contourEnd : contours.contourEnds)
+        {
+            auto count = contourEnd - contourStart;
+            corners.clear();
 
-            auto platformId = FromBE(subtablePtr->platformId);
-            auto platformSpecificId = FromBE(subtablePtr->platformSpecificId);
+            for (auto i = 0u; i < count; ++i)
+            {
+                auto& previous = contours.segments[contourStart + (i + count - 1) % count];
+                auto& current = contours.segments[contourStart + i];
+                auto incoming = Normalize(GetSegmentDirection(previous, 1));
+                auto outgoing = Normalize(GetSegmentDirection(current, 0));
 
-            // We support only unicode encodings.
+                if (Dot(incoming, outgoing) <= 0 || std::abs(Cross(incoming, outgoing)) > CORNER_SINE)
+                {
+                    corners.push_back(i);
+                }
+            }
 
-            if (platformId == PLATFORM_ID_UNICODE)
+            if (corners.size() == 1)
             {
-                this->indexMapOffset = this->cmapTable.offset + FromBE(subtablePtr->offset);
-                break;
-            }
+                // A teardrop: its only corner is kept sharp by splitting the contour in three.
+                static constexpr StaticArray<U8, 3> TEARDROP_COLORS = { EDGE_MAGENTA, EDGE_WHITE, EDGE_YELLOW };
 
-            if (
-                    platformId == PLATFORM_ID_MICROSOFT &&
-                    (
-                        platformSpecificId == PLATFORM_SPECIFIC_ID_MS_UCS2 ||
-                        platformSpecificId == PLATFORM_SPECIFIC_ID_MS_UCS4
-                    )
-               )
+                for (auto i = 0u; i < count; ++i)
+                {
+                    auto position = (i + count - corners[0]) % count;
+                    colors[contourStart + i] = count >= 3 ? TEARDROP_COLORS[position * 3 / count] : TEARDROP_COLORS[position * 2];
+                }
+            }
+            else if (corners.size() > 1)
             {
-                this->indexMapOffset = this->cmapTable.offset + FromBE(subtablePtr->offset);
+                // Switch colors at every corner. The last run must not share the color of the first
+                // one since they meet at the first corner.
+                static constexpr StaticArray<U8, 3> CORNER_COLORS = { EDGE_CYAN, EDGE_MAGENTA, EDGE_YELLOW };
+                auto colorIndex = 0u;
+
+                for (auto c = 0u; c < corners.size(); ++c)
+                {
+                    if (c == corners.size() - 1 && colorIndex == 0)
+                    {
+                        colorIndex = 1;
+                    }
+
+                    auto runEnd = c + 1 < corners.size() ? corners[c + 1] : corners[0] + count;
+
+                    for (auto i = corners[c]; i < runEnd; ++i)
+                    {
+                        colors[contourStart + i % count] = CORNER_COLORS[colorIndex];
+                    }
+
+                    colorIndex = (colorIndex + 1) % 3;
+                }
             }
-        }
 
-        if (this->indexMapOffset == 0)
-        {
-            return Error::UnsupportedCharEncoding;
+            contourStart = contourEnd;
         }
 
-        // We only support format 4, 6 and 12
-        this->charEncodingFormat = FromBE(*(const U16*)(this->data.data() + this->indexMapOffset));
+        return colors;
+    }
 
-        if (this->charEncodingFormat != 4 && this->charEncodingFormat != 6 && this->charEncodingFormat != 12)
+
+    struct EdgeDistance
+    {
+        F32 distance;
+        // How far from perpendicular the closest point is, for breaking ties at shared corners.
+        F32 obliqueness;
+        // Signed distance to the edge extended along its tangents past the end points. Positive
+        // inside.
+        F32 pseudoDistance;
+    };
+
+    auto GetEdgeDistance(const DistanceSegment& segment, Point point, F32 orientation) -> EdgeDistance
+    {
+        F32 t;
+        auto distance = Sqrt(GetSegmentDistance(segment, point, t));
+        auto closest = EvaluateSegment(segment, t);
+        auto tangent = Normalize(GetSegmentDirection(segment, t));
+        auto toPoint = Point(point.x - closest.x, point.y - closest.y);
+        auto side = Cross(tangent, toPoint) * orientation >= 0 ? 1.f : -1.f;
+
+        auto edgeDistance = EdgeDistance{ distance, distance > 0 ? std::abs(Dot(tangent, toPoint)) / distance : 0.f, side * distance };
+
+        if (t <= 0 || t >= 1)
         {
-            return Error::UnsupportedFormat;
+            auto along = Dot(toPoint, tangent);
+
+            if ((t <= 0 && along < 0) || (t >= 1 && along > 0))
+            {
+                auto perpendicular = Cross(tangent, toPoint) * orientation;
+
+                if (std::abs(perpendicular) < std::abs(edgeDistance.pseudoDistance))
+                {
+                    edgeDistance.pseudoDistance = perpendicular;
+                }
+            }
         }
 
-        this->indexMapOffset += 2;
-        return Error::Success;
+        return edgeDistance;
     }
 
 
-    auto FontData::GetCharIndexFmt4(U32 codepoint) const -> U32
+    inline auto Median(F32 a, F32 b, F32 c) -> F32
     {
-        struct Table4
+        return Max(Min(a, b), Min(Max(a, b), c));
+    }
+
+
+    auto RasterizeMSDF(const GlyphData& glyphData, F32 scale, F32 spread, U32 threadCount) -> RGBSurface
+    {
+        RGBSurface surface;
+        spread = Max(spread, 1e-3f);
+        auto margin = Ceil(spread);
+
+        GetRasterSize(glyphData.boundingBoxDiagonal, scale, 0, surface.width, surface.height);
+        surface.width += 2 * U32(margin);
+        surface.height += 2 * U32(margin);
+
+        auto contours = CollectDistanceContours(glyphData, scale, margin);
+        auto& segments = contours.segments;
+        auto colors = ColorEdges(contours);
+        auto monotonic = SplitMonotonicInY(segments);
+        Array<Array<Pair<F32, I32>>> crossings(Max(threadCount, 1u));
+
+        // Inside is on the same side of the edges for every contour. The outer contours enclose
+        // the most area so the sign of the total area tells which side that is.
+        auto area = 0.f;
+        for (auto& segment : segments)
         {
-            U16 length;
-            U16 unused;
-            U16 segCountX2;
-            U16 searchRange;
-            U16 entrySelector;
-            U16 rangeShift;
-        };
+            area += Cross(segment.p0, segment.p1) + Cross(segment.p1, segment.p2);
+        }
+        auto orientation = area >= 0 ? 1.f : -1.f;
 
-        auto t4Ptr = (const Table4*) (this->data.data() + this->indexMapOffset);
-        auto segCountX2 = FromBE(t4Ptr->segCountX2);
-        auto searchRange = FromBE(t4Ptr->searchRange);
-        auto entrySelector = FromBE(t4Ptr->entrySelector);
-        auto rangeShift = FromBE(t4Ptr->rangeShift);
+        // Normalized to [0, 1] like the output bytes.
+        Array<F32> channels(U64(surface.width) * surface.height * 3);
 
-        auto dataBeginning = this->indexMapOffset + sizeof(Table4);
+        ParallelFor
+        (
+            surface.height,
+            threadCount,
+            [&](U64 row, U32 thread)
+            {
+                auto y = F32(row) + 0.5f;
+                auto& rowCrossings = crossings[thread];
+                FindCrossings(monotonic, y, rowCrossings);
 
-        auto searchOffset = dataBeginning;
+                auto crossing = 0u;
+                auto winding = 0;
 
-        // Binary search can be performed since segments are sorted by end codepoint
-        if (codepoint >= FromBE(*(const U16*)(this->data.data() + searchOffset + rangeShift)))
-        {
-            searchOffset += rangeShift;
-        }
+                for (auto column = 0u; column < surface.width; ++column)
+                {
+                    auto point = Point(F32(column) + 0.5f, y);
 
-        searchOffset -= 2;
+                    while (crossing < rowCrossings.size() && rowCrossings[crossing].first < point.x)
+                    {
+                        winding += rowCrossings[crossing].second;
+                        crossing++;
+                    }
 
-        for (auto i = 0u; i < entrySelector; ++i)
-        {
-            searchRange /= 2;
-            auto endCodepoint = FromBE(*(const U16*)(this->data.data() + searchOffset + searchRange));
+                    // The closest edge of every channel. Pixels have to look at all the edges since
+                    // the pseudo distance of an edge can be short even when the edge is far.
+                    StaticArray<EdgeDistance, 3> closest;
+                    closest.fill(EdgeDistance{ std::numeric_limits<F32>::max(), 1.f, -spread });
+                    auto trueDistance = std::numeric_limits<F32>::max();
 
-            if (codepoint > endCodepoint)
-            {
-                searchOffset += searchRange;
+                    for (auto i = 0u; i < segments.size(); ++i)
+                    {
+                        auto edgeDistance = GetEdgeDistance(segments[i], point, orientation);
+                        trueDistance = Min(trueDistance, edgeDistance.distance);
+
+                        for (auto channel = 0u; channel < 3; ++channel)
+                        {
+                            auto& best = closest[channel];
+
+                            if
+                            (
+                                (colors[i] & (1 << channel)) != 0 &&
+                                (
+                                    edgeDistance.distance < best.distance - 1e-4f ||
+                                    (edgeDistance.distance < best.distance + 1e-4f && edgeDistance.obliqueness < best.obliqueness)
+                                )
+                            )
+                            {
+                                best = edgeDistance;
+                            }
+                        }
+                    }
+
+                    StaticArray<F32, 3> values;
+                    for (auto channel = 0u; channel < 3; ++channel)
+                    {
+                        values[channel] = Max(0.f, Min(1.f, 0.5f + closest[channel].pseudoDistance / (2 * spread)));
+                    }
+
+                    // Where the median disagrees with the winding number (e.g. overlapping contours)
+                    // the pixel falls back to the true distance.
+                    auto inside = winding != 0;
+                    auto median = Median(values[0], values[1], values[2]);
+
+                    if (trueDistance > 1e-3f && (median > 0.5f) != inside)
+                    {
+                        auto value = Max(0.f, Min(1.f, 0.5f + (inside ? trueDistance : -trueDistance) / (2 * spread)));
+                        values.fill(value);
+                    }
+
+                    auto pixel = (row * surface.width + column) * 3;
+                    channels[pixel] = values[0];
+                    channels[pixel + 1] = values[1];
+                    channels[pixel + 2] = values[2];
+                }
             }
-        }
+        );
+
+        // Neighbouring pixels with two channels that change more than the distance between them can
+        // make artifacts when the field is interpolated. A single channel changing that much is
+        // just an edge the other channels don't see. Of such a pair the pixel farther from the
+        // edge is reduced to a single channel field.
+        auto threshold = 1.001f / (2 * spread);
+        auto detectClash =
+            [&](const F32* a, const F32* b)
+            {
+                auto a0 = a[0], a1 = a[1], a2 = a[2];
+                auto b0 = b[0], b1 = b[1], b2 = b[2];
 
-        searchOffset += 2;
+                if (std::abs(b0 - a0) < std::abs(b1 - a1))
+                {
+                    Swap(a0, a1);
+                    Swap(b0, b1);
+                }
 
-        // Now the search_offset should be what we need.
-        auto segment = (searchOffset - dataBeginning) / 2;
+                if (std::abs(b1 - a1) < std::abs(b2 - a2))
+                {
+                    Swap(a1, a2);
+                    Swap(b1, b2);
 
-        // Two bytes pad after the end codes
-        auto startCodesOffset = dataBeginning + segCountX2 + 2;
-        auto deltasOffset = startCodesOffset + segCountX2;
-        auto rangesOffset = deltasOffset + segCountX2;
+                    if (std::abs(b0 - a0) < std::abs(b1 - a1))
+                    {
+                        Swap(a0, a1);
+                        Swap(b0, b1);
+                    }
+                }
 
-        auto segmentStartCode = FromBE(*(const U16*)(this->data.data() + startCodesOffset + 2 * segment));
-        auto segmentRangeOffset = FromBE(*(const U16*)(this->data.data() + rangesOffset + 2 * segment));
-        auto segmentDeltaOffset = FromBE(*(const U16*)(this->data.data() + deltasOffset + 2 * segment));
+                // The channels are sorted by how much they change, so the second one decides.
+                return std::abs(b1 - a1) >= threshold && !(b0 == b1 && b0 == b2) && std::abs(a2 - 0.5f) >= std::abs(b2 - 0.5f);
+            };
 
-        if (codepoint < segmentStartCode)
+        Array<U64> clashes;
+
+        for (auto row = 0u; row < surface.height; ++row)
         {
-            return 0;
+            for (auto column = 0u; column < surface.width; ++column)
+            {
+                auto pixel = channels.data() + (U64(row) * surface.width + column) * 3;
+
+                if
+                (
+                    (column > 0 && detectClash(pixel, pixel - 3)) ||
+                    (column + 1 < surface.width && detectClash(pixel, pixel + 3)) ||
+                    (row > 0 && detectClash(pixel, pixel - 3 * U64(surface.width))) ||
+                    (row + 1 < surface.height && detectClash(pixel, pixel + 3 * U64(surface.width)))
+                )
+                {
+                    clashes.push_back(pixel - channels.data());
+                }
+            }
         }
-        else if (segmentRangeOffset == 0)
+
+        for (auto pixel : clashes)
         {
-            return (codepoint + segmentDeltaOffset) & 0xFFFFu;
+            auto median = Median(channels[pixel], channels[pixel + 1], channels[pixel + 2]);
+            channels[pixel] = median;
+            channels[pixel + 1] = median;
+            channels[pixel + 2] = median;
         }
-        else
+
+        surface.data.resize(channels.size());
+
+        for (auto i = 0u; i < channels.size(); ++i)
         {
-            // According to the specification we need to use this obscure indexing trick
-            auto glyphIndexOffset = U32(segmentRangeOffset);
-            glyphIndexOffset += 2 * (codepoint - segmentStartCode);
-            glyphIndexOffset += rangesOffset + 2 * segment;
+            surface.data[i] = Byte(Round(channels[i] * 255.f));
+        }
 
-            auto glyphIndex = FromBE(*(const U16*)(this->data.data() + glyphIndexOffset));
+        return surface;
+    }
 
-            if (glyphIndex != 0)
-            {
-                return glyphIndex + segmentDeltaOffset;
-            }
-            else
+
+    auto QuantizeGlyphKey(U32 fontId, U32 glyphIndex, F32 pixelHeight, F32 subpixelOffset, U32 sizeSteps, U32 subpixelSteps) -> GlyphKey
+    {
+        auto subpixelStep = U32(Max(subpixelOffset, 0.f) * subpixelSteps);
+
+        return
+            GlyphKey
             {
-                return glyphIndex;
-            }
-        }
+                .fontId = fontId,
+                .glyphIndex = glyphIndex,
+                .size = U32(std::lround(Max(pixelHeight, 0.f) * sizeSteps)),
+                .subpixelOffset = Min(subpixelStep, subpixelSteps - 1)
+            };
     }
 
 
-    auto FontData::GetCharIndexFmt6(U32 codepoint) const -> U32
+    // The front cache of the calling thread. It belongs to the last GlyphCache the thread used and
+    // starts over when another one is used.
+    struct GlyphFrontCache
     {
-        // Skip the first two entries.
-        auto dataBeginning = this->indexMapOffset + 4;
+        static constexpr U64 HIT_FLUSH_COUNT = 256;
+        // Hits of an entry between the refreshes of its place in the LRU list of the shard.
+        static constexpr U32 LRU_REFRESH_HITS = 16;
+
+        struct Entry
+        {
+            GlyphKey key;
+            SharedPtr<const GrayScaleSurface> surface;
+            U32 hits = 0;
+        };
+
+        SharedPtr<GlyphCache::FrontState> owner;
+        U64 generation = 0;
+        U64 pendingHits = 0;
+        StaticArray<Entry, GlyphCache::FRONT_CACHE_SIZE> entries;
+
+        ~GlyphFrontCache()
+        {
+            FlushHits();
+        }
 
-        auto firstCode = FromBE(*(const U16*)(this->data.data() + dataBeginning));
-        dataBeginning += 2;
-        auto code_count = FromBE(*(const U16*)(this->data.data() + dataBeginning));
-        dataBeginning += 2;
+        auto FlushHits() -> V
+        {
+            if (owner != nullptr && pendingHits != 0)
+            {
+                owner->frontHits.fetch_add(pendingHits, std::memory_order_relaxed);
+            }
+
+            pendingHits = 0;
+        }
 
-        if (codepoint >= firstCode + code_count)
+        auto Reset(const SharedPtr<GlyphCache::FrontState>& newOwner, U64 newGeneration) -> V
         {
-            return 0;
+            FlushHits();
+            owner = newOwner;
+            generation = newGeneration;
+            entries.fill(Entry{});
         }
-        else
+
+        static auto Get() -> GlyphFrontCache&
         {
-            auto indexOffset = Max(U32(dataBeginning + (U16(codepoint) - firstCode)), U32(data.size() - 2));
-            return FromBE(*(const U16*)(this->data.data() + indexOffset));
+            static thread_local GlyphFrontCache frontCache;
+            return frontCache;
         }
+    };
 
+
+    GlyphCache::GlyphCache(const GlyphCacheOptions& options) :
+        options(options),
+        shards(std::bit_ceil(Max(options.shardCount, 1u))),
+        shardByteBudget(options.byteBudget / std::bit_ceil(Max(options.shardCount, 1u))),
+        frontState(MakeShared<FrontState>())
+    {
+        this->options.sizeSteps = Max(options.sizeSteps, 1u);
+        this->options.subpixelSteps = Max(options.subpixelSteps, 1u);
     }
 
 
-    auto FontData::GetCharIndexFmt12(U32 codepoint) const -> U32
+    auto GlyphCache::GetGlyph(const FontData& fontData, U32 fontId, U32 glyphIndex, F32 pixelHeight, F32 subpixelOffset) -> SharedPtr<const GrayScaleSurface>
     {
-        struct Header
-        {
-            U32 format;
-            U32 length;
-            U32 unused;
-            U32 groupCount;
-        };
+        auto key = QuantizeGlyphKey(fontId, glyphIndex, pixelHeight, subpixelOffset, options.sizeSteps, options.subpixelSteps);
+        auto hash = GlyphKeyHash()(key);
 
-        struct Group
-        {
-            U32 startCodepoint;
-            U32 endCodepoint;
-            U32 startCodepointIdx;
-        };
+        auto& frontCache = GlyphFrontCache::Get();
+        auto generation = frontState->generation.load(std::memory_order_acquire);
 
-        auto headerPtr = (const Header*)(this->data.data() + this->indexMapOffset - 2);
+        if (frontCache.owner != frontState || frontCache.generation != generation)
+        {
+            frontCache.Reset(frontState, generation);
+        }
 
-        auto groupCount = FromBE(headerPtr->groupCount);
+        auto& frontEntry = frontCache.entries[hash & (FRONT_CACHE_SIZE - 1)];
+        // The low bits pick the front cache entry so the shard comes from the high ones.
+        auto& shard = shards[(hash >> 40) & (shards.size() - 1)];
 
-        auto groupsOffset = this->indexMapOffset - 2 + sizeof(Header);
+        if (frontEntry.surface != nullptr && frontEntry.key == key)
+        {
+            if (++frontCache.pendingHits == GlyphFrontCache::HIT_FLUSH_COUNT)
+            {
+                frontCache.FlushHits();
+            }
 
-        auto searchStart = 0u;
-        auto searchEnd = groupCount;
+            if (frontEntry.hits++ % GlyphFrontCache::LRU_REFRESH_HITS == 0)
+            {
+                Touch(shard, key);
+            }
 
-        while (searchStart < searchEnd)
-        {
-            auto mid = searchStart + (searchEnd - searchEnd) / 2;
+            return frontEntry.surface;
+        }
 
-            auto currentSegmentPtr = (const Group*) (this->data.data() + groupsOffset + mid * sizeof(Group));
+        SharedPtr<const GrayScaleSurface> surface;
 
-            auto startCodepoint = FromBE(currentSegmentPtr->startCodepoint);
-            auto endCodepoint = FromBE(currentSegmentPtr->endCodepoint);
+        {
+            LockGuard lock(shard.mutex);
+            auto slot = shard.slots.find(key);
 
-            if (startCodepoint > codepoint)
+            if (slot != shard.slots.end())
             {
-                searchEnd = mid;
+                shard.hits++;
+                Unlink(shard, slot->second);
+                PushFront(shard, slot->second);
+                surface = shard.entries[slot->second].surface;
             }
-            else if (endCodepoint < codepoint)
+            else
             {
-                searchStart = mid + 1;
+                shard.misses++;
+            }
+        }
+
+        if (surface == nullptr)
+        {
+            // Rasterized without holding the lock so other glyphs of the shard aren't blocked.
+            auto glyph = fontData.FetchGlyphData(glyphIndex);
+            auto scale = fontData.GetScaleForPixelHeight(F32(key.size) / options.sizeSteps);
+            auto offsetX = F32(key.subpixelOffset) / options.subpixelSteps;
+            surface = MakeShared<const GrayScaleSurface>(Rasterize(glyph, scale, offsetX));
+
+            LockGuard lock(shard.mutex);
+            auto slot = shard.slots.find(key);
+
+            // Another thread got to the same glyph first.
+            if (slot != shard.slots.end())
+            {
+                surface = shard.entries[slot->second].surface;
             }
             else
             {
-                return FromBE(currentSegmentPtr->startCodepointIdx) + mid;
+                Insert(shard, key, surface);
             }
         }
 
-        return 0;
+        frontEntry = GlyphFrontCache::Entry{ .key = key, .surface = surface };
+        return surface;
     }
 
 
-    auto FontData::GetGlyphOffset(U32 glyphIndex) const -> U32
+    auto GlyphCache::Insert(Shard& shard, const GlyphKey& key, SharedPtr<const GrayScaleSurface> surface) -> V
     {
-        auto offset = this->glyfTable.offset;
+        auto byteCount = sizeof(Entry) + sizeof(GrayScaleSurface) + surface->data.size();
+        U32 slot;
 
-        if (this->longLocaIndex)
+        if (!shard.freeSlots.empty())
         {
-            offset += FromBE(*(const U32*)(this->data.data() + this->locaTable.offset + 4 * glyphIndex));
+            slot = shard.freeSlots.back();
+            shard.freeSlots.pop_back();
         }
         else
         {
-            offset += FromBE(*(const U16*)(this->data.data() + this->locaTable.offset + 2 * glyphIndex)) * 2;
+            slot = U32(shard.entries.size());
+            shard.entries.emplace_back();
         }
 
-        return offset;
+        shard.entries[slot] =
+            Entry
+            {
+                .key = key,
+                .surface = std::move(surface),
+                .byteCount = byteCount,
+                .previous = Shard::NO_ENTRY,
+                .next = Shard::NO_ENTRY
+            };
+        shard.slots.emplace(key, slot);
+        shard.byteCount += byteCount;
+        PushFront(shard, slot);
+
+        // The new glyph is kept even when it alone is over the budget.
+        while (shard.byteCount > shardByteBudget && shard.tail != slot)
+        {
+            auto evicted = shard.tail;
+            auto& entry = shard.entries[evicted];
+            Unlink(shard, evicted);
+            shard.slots.erase(entry.key);
+            shard.byteCount -= entry.byteCount;
+            entry.surface = nullptr;
+            shard.freeSlots.push_back(evicted);
+            shard.evictions++;
+        }
     }
 
 
-    auto FontData::FetchGlyphData(U32 glyphIndex) const -> GlyphData
+    auto GlyphCache::Unlink(Shard& shard, U32 slot) -> V
     {
-        GlyphData glyphData;
-
-        auto glyphOffset = this->GetGlyphOffset(glyphIndex);
+        auto& entry = shard.entries[slot];
 
-        struct GlyfHeader
+        if (entry.previous != Shard::NO_ENTRY)
         {
-            I16 numberOfContours;
-            I16 xMin;
-            I16 yMin;
-            I16 xMax;
-            I16 yMax;
-        };
+            shard.entries[entry.previous].next = entry.next;
+        }
+        else
+        {
+            shard.head = entry.next;
+        }
 
-        auto glyfHeaderPtr = (const GlyfHeader*)(this->data.data() + glyphOffset);
+        if (entry.next != Shard::NO_ENTRY)
+        {
+            shard.entries[entry.next].previous = entry.previous;
+        }
+        else
+        {
+            shard.tail = entry.previous;
+        }
+    }
 
-        auto d0 = TTFPoint(FromBE(glyfHeaderPtr->xMin), FromBE(glyfHeaderPtr->yMin));
-        auto d1 = TTFPoint(FromBE(glyfHeaderPtr->xMax), FromBE(glyfHeaderPtr->yMax));
 
-        glyphData.boundingBoxDiagonal = Line(d0, d1);
+    auto GlyphCache::PushFront(Shard& shard, U32 slot) -> V
+    {
+        auto& entry = shard.entries[slot];
+        entry.previous = Shard::NO_ENTRY;
+        entry.next = shard.head;
 
-        auto currentOffset = glyphOffset + sizeof(GlyfHeader);
+        if (shard.head != Shard::NO_ENTRY)
+        {
+            shard.entries[shard.head].previous = slot;
+        }
+        else
+        {
+            shard.tail = slot;
+        }
 
-        auto numberOfContours = FromBE(glyfHeaderPtr->numberOfContours);
+        shard.head = slot;
+    }
 
-        // Simple glyph
-        if (numberOfContours >= 0)
-        {
-            Array<U16> endPointsOfContours;
 
-            auto endPointsOfContoursPtr = (const U16*)(this->data.data() + currentOffset);
+    auto GlyphCache::Touch(Shard& shard, const GlyphKey& key) -> V
+    {
+        LockGuard lock(shard.mutex);
+        auto slot = shard.slots.find(key);
 
-            for (auto i = 0; i < numberOfContours; ++i)
-            {
-                endPointsOfContours.push_back(FromBE(endPointsOfContoursPtr[i]));
-            }
+        // Already evicted while the front cache kept it.
+        if (slot != shard.slots.end())
+        {
+            Unlink(shard, slot->second);
+            PushFront(shard, slot->second);
+        }
+    }
 
-            currentOffset += 2 * numberOfContours;
 
-            auto instructionLength = FromBE(*(const U16*)(this->data.data() + currentOffset));
+    auto GlyphCache::GetStatistics() const -> GlyphCacheStatistics
+    {
+        auto& frontCache = GlyphFrontCache::Get();
 
-            // Skip instructions;
-            currentOffset += instructionLength + 2;
+        if (frontCache.owner == frontState)
+        {
+            frontCache.FlushHits();
+        }
 
-            auto numberOfVertices = endPointsOfContours[(numberOfContours - 1)] + 1;
+        GlyphCacheStatistics statistics = {};
+        statistics.frontHits = frontState->frontHits.load(std::memory_order_relaxed);
 
-            Array<U8> flags;
-            flags.reserve(numberOfVertices);
-            U8 repeatFlags = 0;
-            U8 flag  = 0;
+        for (auto& shard : shards)
+        {
+            LockGuard lock(shard.mutex);
+            statistics.hits += shard.hits;
+            statistics.misses += shard.misses;
+            statistics.evictions += shard.evictions;
+            statistics.entryCount += shard.slots.size();
+            statistics.byteCount += shard.byteCount;
+        }
 
-            // Loading the flags first storing the repeating ones as well.
-            for (auto i = 0u; i < numberOfVertices; ++i)
-            {
-                if (repeatFlags == 0)
-                {
-                    flag = this->data.data()[currentOffset];
-                    currentOffset += 1;
+        return statistics;
+    }
 
-                    if ((flag & 0b00001000) > 0)
-                    {
-                        repeatFlags = this->data.data()[currentOffset];
-                        currentOffset += 1;
-                    }
-                }
-                else
-                {
-                    repeatFlags -= 1;
-                }
-
-                flags.push_back(flag);
-            }
-
-            Array<TTFPoint> vertices;
-            vertices.resize(numberOfVertices);
-
-            auto prevCoord = 0;
-            // Reading the first coordinates
-            for (auto i = 0u; i < numberOfVertices; ++i)
-            {
-               // Coordinate is encoded as u8
-               if ((flags[i] & 0b00000010u) > 0)
-               {
-                   auto tmpCoord = this->data[currentOffset];
-                   currentOffset += 1;
-
-                   // Holy shit!!! The documentation was so misleading here. I had so much trouble
-                   // finding this bug...
-                   vertices[i].x = I32(prevCoord) + (((flags[i] & 0b00010000u) > 0) ? I32(tmpCoord) : -I32(tmpCoord));
-                   prevCoord = vertices[i].x;
-               }
-               // coordinate is encoded as i16
-               else
-               {
-                   // checks if the coordinate is not repeated
-                   if ((flags[i] & 0b00010000u) == 0)
-                   {
-                       auto tmpCoord = FromBE(*(const I16*)(this->data.data() + currentOffset));
-                       currentOffset += 2;
-                       vertices[i].x = prevCoord + I32(tmpCoord);
-                       prevCoord = vertices[i].x;
-                   }
-                   else
-                   {
-                       vertices[i].x = prevCoord;
-                   }
-               }
-            }
-
-            prevCoord = 0;
-            // Reading the second coordinates
-            for (auto i = 0u; i < numberOfVertices; ++i)
-            {
-                // Coordinate is encoded as u8
-                if ((flags[i] & 0b00000100u) > 0)
-                {
-                    auto tmpCoord = this->data[currentOffset];
-                    currentOffset += 1;
-
-                    // Holy mother of fuck why nobody mentioned that those were deltas as well?!?
-                    // I'm looking at you
-                    // developer.apple.com/fonts/TrueType-Reference-Manual/RM06/Chap6glyf.html
-                    vertices[i].y = I32(prevCoord) + (((flags[i] & 0b00100000u) > 0) ? I32(tmpCoord) : -I32(tmpCoord));
-                    prevCoord = vertices[i].y;
-                }
-                // coordinate is encoded as i16
-                else
-                {
-                    // checks if the coordinate is not repeated
-                    if ((flags[i] & 0b00100000u) == 0)
-                    {
-                        auto tmpCoord = FromBE(*(const I16*)(this->data.data() + currentOffset));
-                        currentOffset += 2;
-                        vertices[i].y = prevCoord + I32(tmpCoord);
-                        prevCoord = vertices[i].y;
-                    }
-                    else
-                    {
-                        vertices[i].y = prevCoord;
-                    }
-                }
-            }
 
-            auto startIndex = 0u;
+    auto GlyphCache::Clear() -> V
+    {
+        frontState->generation.fetch_add(1, std::memory_order_release);
 
-            for (auto i = 0; i < endPointsOfContours.size(); ++i)
-            {
-                startIndex =
-                    LoadContour
-                    (
-                        glyphData,
-                        Span<const TTFPoint>{vertices},
-                        Span<const U8>{flags},
-                        startIndex,
-                        endPointsOfContours[i]
-                    );
-            }
-        }
-        // Compound glyph
-        else
+        for (auto& shard : shards)
         {
-            // TODO: implement support for compound glyphs
+            LockGuard lock(shard.mutex);
+            shard.slots.clear();
+            shard.entries.clear();
+            shard.freeSlots.clear();
+            shard.head = Shard::NO_ENTRY;
+            shard.tail = Shard::NO_ENTRY;
+            shard.byteCount = 0;
         }
+    }
 
-        return glyphData;
+
+    GlyphAtlas::GlyphAtlas(const GlyphAtlasOptions& options) : options(options)
+    {
+        this->options.pageWidth = Max(options.pageWidth, 1u);
+        this->options.pageHeight = Max(options.pageHeight, 1u);
+        this->options.maxPageCount = Max(options.maxPageCount, 1u);
+        this->options.sizeSteps = Max(options.sizeSteps, 1u);
+        this->options.subpixelSteps = Max(options.subpixelSteps, 1u);
     }
-    
 
-    // Rasterizer related functions
 
-    struct Point
+    auto GlyphAtlas::GetGlyph(const FontData& fontData, U32 fontId, U32 glyphIndex, F32 pixelHeight, F32 subpixelOffset, AtlasGlyph& glyph) -> B
     {
-        F32 x;
-        F32 y;
+        auto key = QuantizeGlyphKey(fontId, glyphIndex, pixelHeight, subpixelOffset, options.sizeSteps, options.subpixelSteps);
+        auto found = slots.find(key);
 
-        Point() {}
-        Point(F32 x, F32 y) : x(x), y(y) {}
-    };
+        if (found != slots.end())
+        {
+            auto slot = found->second;
+            entries[slot].lastFrame = frame;
+            Unlink(slot);
+            PushFront(slot);
+            glyph = entries[slot].glyph;
+            return true;
+        }
 
+        auto glyphData = fontData.FetchGlyphData(glyphIndex);
+        auto scale = fontData.GetScaleForPixelHeight(F32(key.size) / options.sizeSteps);
+        auto offsetX = F32(key.subpixelOffset) / options.subpixelSteps;
+        U32 width;
+        U32 height;
+        GetRasterSize(glyphData.boundingBoxDiagonal, scale, offsetX, width, height);
 
-    struct Edge
-    {
-        Point lowermostPoint;
-        Point uppermostPoint;
-        // Needs to be +1/-1 but gets padded to 4 bytes anyway in order to preserve alignment 
-        F32 direction;
-    };
+        auto slotWidth = width + options.padding;
+        auto slotHeight = height + options.padding;
 
-    inline auto operator<(const Edge& e0, const Edge& e1) -> bool 
-    {
-        return e0.uppermostPoint.y < e1.uppermostPoint.y;
-    }
+        if (slotWidth > options.pageWidth || slotHeight > options.pageHeight)
+        {
+            return false;
+        }
 
-    inline auto operator==(const Edge& e0, const Edge& e1) -> bool
-    {
-        return e0.uppermostPoint.y == e1.uppermostPoint.y;
-    }
+        Entry entry = {};
 
+        while (!Allocate(slotWidth, slotHeight, entry))
+        {
+            if (tail == NO_ENTRY || entries[tail].lastFrame == frame)
+            {
+                return false;
+            }
 
-    auto AddEdge(Array<Edge>& edges, Point startPoint, Point endPoint) -> V
-    {
-        if (startPoint.y < endPoint.y)
+            Evict(tail);
+        }
+
+        entry.key = key;
+        entry.slotWidth = slotWidth;
+        entry.lastFrame = frame;
+        entry.glyph.width = width;
+        entry.glyph.height = height;
+        entry.glyph.u0 = F32(entry.glyph.x) / options.pageWidth;
+        entry.glyph.v0 = F32(entry.glyph.y) / options.pageHeight;
+        entry.glyph.u1 = F32(entry.glyph.x + width) / options.pageWidth;
+        entry.glyph.v1 = F32(entry.glyph.y + height) / options.pageHeight;
+
+        // The padding and whatever an evicted glyph left in the slot are cleared. The glyph itself
+        // is drawn straight into the page.
+        auto& surface = pages[entry.glyph.page].surface;
+        auto slotData = surface.data.data() + U64(entry.glyph.y) * surface.width + entry.glyph.x;
+
+        for (auto row = 0u; row < slotHeight; ++row)
         {
-            edges.emplace_back(startPoint, endPoint, 1.0);
+            std::memset(slotData + U64(row) * surface.width, 255, slotWidth);
         }
-        else if (startPoint.y > endPoint.y)
+
+        RasterizeInto(glyphData, scale, offsetX, SurfaceView{ slotData, width, height, surface.width });
+        MarkDirty(AtlasDirtyRect{ entry.glyph.page, entry.glyph.x, entry.glyph.y, slotWidth, slotHeight });
+
+        U32 slot;
+
+        if (!freeSlots.empty())
         {
-            edges.emplace_back(endPoint, startPoint, -1.0);
+            slot = freeSlots.back();
+            freeSlots.pop_back();
         }
         else
         {
-            // In case this happens we can safely drop those
+            slot = U32(entries.size());
+            entries.emplace_back();
         }
-    }
 
+        entries[slot] = entry;
+        slots.emplace(key, slot);
+        PushFront(slot);
 
-    // Use special case of De Casteljau's algorithm to turn the curve into polyline.
-    auto Linearize
-    (
-        Array<Edge>& edges,
-        F32 flatnessThreshold,
-        Point point0,
-        Point point1,
-        Point point2
-    ) -> V
-    {
-        // We can safely give hard limit to the depth of the "recursive" subdivision. This is because
-        // depth of 15 giving us 2^15 == 32768 divisions for a single curve is insane even at very large
-        // resolutions. For example even if the curve is bounded by a box of width 4000 pixels then for
-        // the length of the curve is
-        //  \[
-        // 2\int\limits_0^1 \left| (p_2 - p_1)t + (p_1 - p_0) (1-t)\right|dt 
-        //  =
-        // 2\int\limits_0^1 \left| (p_2 - 2p_1 +p_0)t + (p_1 - p_0)\right|dt 
-        // \leq
-        // 2 \int\limits_0^1 8000t dt + 2 \int\limits_0^1 4000 dt 
-        // = 
-        // 8000 + 8000 
-        // =
-        // 16000
-        // 	\]
-        // This means that on average the length of each individual piece of this subdivided curve is 
-        // going to be less than half a pixel!
+        glyph = entry.glyph;
+        return true;
+    }
 
-        // Number of points times the division depth
-        static constexpr U32 STACK_SIZE = 3 * 16;
 
-        StaticArray<Point, STACK_SIZE> stack;
-        stack[0] = point0;
-        stack[1] = point1;
-        stack[2] = point2;
-        U32 stackSize = 3;
+    auto GlyphAtlas::Allocate(U32 width, U32 height, Entry& entry) -> B
+    {
+        // The shortest shelf that fits and doesn't waste more than a third of its height.
+        auto bestPage = NO_ENTRY;
+        auto bestShelf = NO_ENTRY;
+        auto bestHeight = ~0u;
 
-        while (0 < stackSize)
+        for (auto pageIndex = 0u; pageIndex < pages.size(); ++pageIndex)
         {
-            auto beta02 = stack[stackSize - 1];
-            auto beta01 = stack[stackSize - 2];
-            auto beta00 = stack[stackSize - 3];
-            stackSize -= 3;
+            auto& shelves = pages[pageIndex].shelves;
 
-            auto approxLength =
-                Sqrt(Square(beta00.x - beta01.x) + Square(beta00.y - beta01.y)) +
-                Sqrt(Square(beta01.x - beta02.x) + Square(beta01.y - beta02.y));
-
-            if (approxLength > flatnessThreshold && stackSize + 6 < STACK_SIZE)
+            for (auto shelfIndex = 0u; shelfIndex < shelves.size(); ++shelfIndex)
             {
-                auto beta10 = Point((beta01.x + beta00.x) / 2.0, (beta01.y + beta00.y) / 2.0);
-                auto beta11 = Point((beta02.x + beta01.x) / 2.0, (beta02.y + beta01.y) / 2.0);
-                auto beta20 = Point((beta11.x + beta10.x) / 2.0, (beta11.y + beta10.y) / 2.0);
-                // We still havent reached the desired flatness which means we have to subdivide
-                stack[stackSize] = beta00;
-                stack[stackSize + 1] = beta10;
-                stack[stackSize + 2] = beta20;
+                auto& shelf = shelves[shelfIndex];
 
-                stack[stackSize + 3] = beta20;
-                stack[stackSize + 4] = beta11;
-                stack[stackSize + 5] = beta02;
+                if (shelf.height < height || shelf.height * 2 > height * 3 || shelf.height >= bestHeight)
+                {
+                    continue;
+                }
 
-                stackSize += 6;
-            }
-            else 
-            {
-                AddEdge(edges, beta00, beta01);
-                AddEdge(edges, beta01, beta02);
+                for (auto& range : shelf.freeRanges)
+                {
+                    if (range.width >= width)
+                    {
+                        bestPage = pageIndex;
+                        bestShelf = shelfIndex;
+                        bestHeight = shelf.height;
+                        break;
+                    }
+                }
             }
         }
-    }
-
-
-    static constexpr F32 FLATNESS_CONSTANT_IN_PIXELS = 1;
 
-    auto Linearize(const GlyphData& glyphData, F32 scale) -> Array<Edge>
-    {
-        Array<Edge> edges;
-
-        // Invert the scalar transform in order to get the flatness threshold in the glyph coordinate
-        // system.
-        auto flatnessThreshold = FLATNESS_CONSTANT_IN_PIXELS / scale;
-        // We do this to avoid using square root during linearization of Bezier Curves.
-        flatnessThreshold = flatnessThreshold * flatnessThreshold;
+        if (bestPage != NO_ENTRY)
+        {
+            return AllocateOnShelf(bestPage, bestShelf, width, entry);
+        }
 
-        for (auto& curve : glyphData.components)
+        // A new shelf below the others, on a new page if none has room. The shelf heights are
+        // rounded up so that glyphs of similar sizes can share them.
+        for (auto pageIndex = 0u; pageIndex <= pages.size(); ++pageIndex)
         {
-            if (HoldsAlternative<QuadraticBezierCurve>(curve))
+            if (pageIndex == pages.size())
             {
-                auto& bezier = Get<QuadraticBezierCurve>(curve);
-                Linearize
-                (
-                    edges,
-                    flatnessThreshold,
-                    Point(bezier.startPoint.x, bezier.startPoint.y),
-                    Point(bezier.controlPoint.x, bezier.controlPoint.y),
-                    Point(bezier.endPoint.x, bezier.endPoint.y)
-                );
+                if (pages.size() == options.maxPageCount)
+                {
+                    break;
+                }
+
+                auto& page = pages.emplace_back();
+                page.surface.width = options.pageWidth;
+                page.surface.height = options.pageHeight;
+                page.surface.data.assign(U64(options.pageWidth) * options.pageHeight, 255);
+                page.shelvesEnd = 0;
             }
-            else if (HoldsAlternative<Line>(curve))
+
+            auto& page = pages[pageIndex];
+
+            if (page.shelvesEnd + height > options.pageHeight)
             {
-                auto& line = Get<Line>(curve);
-                AddEdge
-                (
-                    edges,
-                    Point(line.startPoint.x, line.startPoint.y),
-                    Point(line.endPoint.x, line.endPoint.y)
-                );
+                continue;
             }
-        }
 
-        return edges;
-    }
+            auto shelfHeight = Min((height + 3) & ~3u, options.pageHeight - page.shelvesEnd);
+            page.shelves.push_back(Shelf{ page.shelvesEnd, shelfHeight, 0, { FreeRange{ 0, options.pageWidth } } });
+            page.shelvesEnd += shelfHeight;
 
+            return AllocateOnShelf(pageIndex, U32(page.shelves.size() - 1), width, entry);
+        }
 
-    auto TransformEdgesToSurfaceSpace(Array<Edge>& edges, F32 scale, Point translation) -> V
-    {
-        for (auto& edge : edges)
+        // Rather than evicting take any shelf that is tall enough.
+        for (auto pageIndex = 0u; pageIndex < pages.size(); ++pageIndex)
         {
-            // We flip the second coordinate in order to match the coordinates of the pixel grid.
-            // This doesn't change the direction of the edges but now the uppermost edge is with lower
-            // numbers as vertical coordinates which is what we want.
-            edge.lowermostPoint.x *= scale;
-            edge.lowermostPoint.y *= -scale;
-            edge.uppermostPoint.x *= scale;
-            edge.uppermostPoint.y *= -scale;
-            edge.lowermostPoint.x += translation.x;
-            edge.lowermostPoint.y += translation.y;
-            edge.uppermostPoint.x += translation.x;
-            edge.uppermostPoint.y += translation.y;
-        }
-    }
+            auto& shelves = pages[pageIndex].shelves;
 
+            for (auto shelfIndex = 0u; shelfIndex < shelves.size(); ++shelfIndex)
+            {
+                if (shelves[shelfIndex].height >= height && AllocateOnShelf(pageIndex, shelfIndex, width, entry))
+                {
+                    return true;
+                }
+            }
+        }
 
-    // Here it's more convenient to store the edge in slope-intercept form.
-    struct ActiveEdge
-    {
-        F32 lowermostPoint1;
-        F32 uppermostPoint1;
-        // The zeroth component of the intersection of the line passing through the edge's vertices 
-        // with the current scanline. By having this point, the slope and the first components of the 
-        // edge's vertices we can restore their original positions as well as easily compute the zeroth
-        // component of the intersection of the edge with a certain scanline.
-        F32 scanlineTopIntersection0;
-        // The derivative with respect to the zeroth direction.
-        F32 dxdy;
-        F32 direction;
+        return false;
+    }
 
-        ActiveEdge(F32 l1, F32 u1, F32 sti0, F32 dxdy, F32 dir) :
-            lowermostPoint1(l1),
-            uppermostPoint1(u1),
-            scanlineTopIntersection0(sti0),
-            dxdy(dxdy),
-            direction(dir)
+
+    auto GlyphAtlas::AllocateOnShelf(U32 pageIndex, U32 shelfIndex, U32 width, Entry& entry) -> B
+    {
+        auto& shelf = pages[pageIndex].shelves[shelfIndex];
+
+        for (auto i = 0u; i < shelf.freeRanges.size(); ++i)
         {
+            auto& range = shelf.freeRanges[i];
+
+            if (range.width < width)
+            {
+                continue;
+            }
+
+            entry.glyph.page = pageIndex;
+            entry.glyph.x = range.x;
+            entry.glyph.y = shelf.y;
+            entry.shelf = shelfIndex;
+
+            range.x += width;
+            range.width -= width;
+
+            if (range.width == 0)
+            {
+                shelf.freeRanges.erase(shelf.freeRanges.begin() + i);
+            }
 
+            shelf.glyphCount++;
+            return true;
         }
-    };
+
+        return false;
+    }
 
 
-    auto Activate(Array<ActiveEdge>& activeEdges, const Edge& edge, F32 scanlineTop) -> V
+    auto GlyphAtlas::Evict(U32 slot) -> V
     {
-        static constexpr F32 HORIZONTALITY_TOLERANCE  = (1.0f / F32(1 << 15)) * 4.0f;
-        auto dx = edge.lowermostPoint.x - edge.uppermostPoint.x;
-        auto dy = edge.lowermostPoint.y - edge.uppermostPoint.y;
+        auto& entry = entries[slot];
+        auto& page = pages[entry.glyph.page];
+        auto& shelf = page.shelves[entry.shelf];
 
-        if (dy <= HORIZONTALITY_TOLERANCE)
+        Unlink(slot);
+        slots.erase(entry.key);
+        freeSlots.push_back(slot);
+        evictionCount++;
+
+        // Give the slot back to the shelf merging it with the free ranges around it.
+        auto next = std::lower_bound
+        (
+            shelf.freeRanges.begin(),
+            shelf.freeRanges.end(),
+            entry.glyph.x,
+            [](const FreeRange& range, U32 x) { return range.x < x; }
+        );
+        next = shelf.freeRanges.insert(next, FreeRange{ entry.glyph.x, entry.slotWidth });
+
+        if (next + 1 != shelf.freeRanges.end() && next->x + next->width == (next + 1)->x)
         {
-            // We dont want horizontal edges just drop them
+            next->width += (next + 1)->width;
+            shelf.freeRanges.erase(next + 1);
         }
-        else 
-        {
-            auto dxdy = dx / dy;
 
-            auto scanlineTopIntersection0 = 
-                edge.uppermostPoint.x + dxdy * (scanlineTop - edge.uppermostPoint.y);
-
-            activeEdges.emplace_back
-            (
-                edge.lowermostPoint.y,
-                edge.uppermostPoint.y,
-                scanlineTopIntersection0,
-                dxdy,
-                edge.direction
-            );
+        if (next != shelf.freeRanges.begin() && (next - 1)->x + (next - 1)->width == next->x)
+        {
+            (next - 1)->width += next->width;
+            shelf.freeRanges.erase(next);
         }
-    }
 
-    auto AddActiveEdges
-    (
-        Array<ActiveEdge>& activeEdges,
-        const Array<Edge>& edges,
-        U32& edgesIdx,
-        F32 scanlineBot,
-        F32 scanlineTop
-    )
-    {
-        // Add all the edges that have their uppermost point before the end of this scanline
-        while (edgesIdx < edges.size() && edges[edgesIdx].uppermostPoint.y < scanlineBot)
+        shelf.glyphCount--;
+
+        // Empty shelves at the bottom give their space back to the page.
+        while (!page.shelves.empty() && page.shelves.back().glyphCount == 0)
         {
-            Activate(activeEdges, edges[edgesIdx], scanlineTop);
-            edgesIdx++;
+            page.shelvesEnd = page.shelves.back().y;
+            page.shelves.pop_back();
         }
     }
 
-    auto ProcessActiveEdge(const ActiveEdge& edge, Array<Point>& scanline, F32 scanlineBot, F32 scanlineTop)
+
+    auto GlyphAtlas::Unlink(U32 slot) -> V
     {
-        // Now we need to find the highest point of the edge that is below the top of the scanline and 
-        // the lowest point of the edge that is above the scanline bottom. In case that the edges go 
-        // beyond the sanline the points we search for are intersections.
-        Point highPoint;
-        Point lowPoint;
+        auto& entry = entries[slot];
 
-        if (scanlineTop < edge.uppermostPoint1)
+        if (entry.previous != NO_ENTRY)
         {
-            highPoint.x = 
-                edge.scanlineTopIntersection0 + edge.dxdy * (edge.uppermostPoint1 - scanlineTop);
-            highPoint.y = edge.uppermostPoint1;
+            entries[entry.previous].next = entry.next;
         }
         else
         {
-            // Here we know that since the actual edge is above the scanline, the 0th direction 
-            // intersection has to be inside the surface since all edges are inside the surface
-            highPoint.x = edge.scanlineTopIntersection0;
-            highPoint.y = scanlineTop;
+            head = entry.next;
         }
 
-        if (scanlineBot < edge.lowermostPoint1)
+        if (entry.next != NO_ENTRY)
         {
-            lowPoint.x = edge.scanlineTopIntersection0 + edge.dxdy;
-            lowPoint.y = scanlineBot;
+            entries[entry.next].previous = entry.previous;
         }
-        else 
+        else
         {
-            lowPoint.x = 
-                edge.scanlineTopIntersection0 + edge.dxdy * (edge.lowermostPoint1 - scanlineTop);
-            lowPoint.y = edge.lowermostPoint1;
+            tail = entry.previous;
         }
+    }
 
-        // Once we have clipped the edge to the boundaries of the scanline there are two relevant 
-        // possibilities to look for namely wether or not high_point.0 < low_point.0. In the two cases
-        // the computation of the area will look differently because we process the pixels of the 
-        // scanline from left to right (increasing in the 0th direction) hence we will care about the 
-        // 0th coordinate of the edge. 
-        //
-        // However we can avoid that by simply recognizing that flipping the clipped edge around it's 
-        // vertical center won't change the unsigned area.
 
-        auto dxdy = edge.dxdy;
-        auto sign = edge.direction;
+    auto GlyphAtlas::PushFront(U32 slot) -> V
+    {
+        auto& entry = entries[slot];
+        entry.previous = NO_ENTRY;
+        entry.next = head;
 
-        if (highPoint.x > lowPoint.x)
+        if (head != NO_ENTRY)
         {
-            Swap(lowPoint.x, highPoint.x);
-            // The tangent also flips.
-            dxdy = -dxdy;
+            entries[head].previous = slot;
+        }
+        else
+        {
+            tail = slot;
         }
 
-        auto startPixel = Max(0.0f, Floor(highPoint.x));
-        auto startPixelIdx = U32(startPixel);
-        auto endPixel = Ceil(lowPoint.x);
-        auto height = lowPoint.y - highPoint.y;
+        head = slot;
+    }
 
-        // Spans a single pixel and is trapezoid
-        if (endPixel - startPixel <= 1.0f)
-        {
-            // We use startPixel + 1.0 instead of endPixel to handle vertical edges properly
-            auto area = height * ((startPixel + 1.0 - lowPoint.x) + (startPixel + 1.0 - highPoint.x)) / 2.0;
 
-            scanline[startPixelIdx].x += sign * area;
+    auto GlyphAtlas::MarkDirty(const AtlasDirtyRect& rect) -> V
+    {
+        // Glyphs placed one after another on a shelf become a single rectangle.
+        if (!dirtyRects.empty())
+        {
+            auto& last = dirtyRects.back();
 
-            startPixelIdx++;
-            // It induces rectangles in all the other pixels on the right hence we put the height
-            // times one (the width of the rectangles) in the next entry of the commulative sum 
-            // array (second component of the scanline).
-            if (startPixelIdx < scanline.size())
+            if (last.page == rect.page && last.y == rect.y && last.x + last.width == rect.x)
             {
-                scanline[startPixelIdx].y += sign * height;
+                last.width += rect.width;
+                last.height = Max(last.height, rect.height);
+                return;
             }
         }
-        else
-        {
-            // We need to find where the edge intersects the vertical pixel barier of the first
-            // pixel containing it.
 
-            auto width = startPixel + 1.0 - highPoint.x;
-            auto dydx = 1.0 / dxdy;
+        dirtyRects.push_back(rect);
+    }
 
-            auto intersection1 = highPoint.y + width * dydx;
-            auto height = intersection1 - highPoint.y;
 
-            auto area = width * height / 2.0;
+    auto GlyphAtlas::NextFrame() -> V
+    {
+        frame++;
+    }
 
-            scanline[startPixelIdx].x += sign * area;
-            startPixelIdx++;
 
-            auto endPixelIdx = U32(Round(endPixel - 1.0));
+    auto GlyphAtlas::GetPageCount() const -> U32
+    {
+        return U32(pages.size());
+    }
 
-            while (startPixelIdx < endPixelIdx)
-            {
 
-                auto area = (height + height + dydx) / 2.0;
+    auto GlyphAtlas::GetPage(U32 pageIndex) const -> const GrayScaleSurface&
+    {
+        return pages[pageIndex].surface;
+    }
 
-                scanline[startPixelIdx].x += sign * area;
 
-                height += dydx;
-                startPixelIdx++;
-            }
+    auto GlyphAtlas::GetGlyphCount() const -> U64
+    {
+        return slots.size();
+    }
 
-            // This is a combination of a trapezoid and rectangle
-            auto endWidthRect = endPixel - lowPoint.x;
-            auto endWidthTrap = 1.0 - endWidthRect;
-            auto endHeight = height + endWidthTrap * dydx;
-            auto endPixelArea = (height + endHeight) / 2.0 * endWidthTrap + endHeight * endWidthRect;
 
-            scanline[endPixelIdx].x += sign * endPixelArea;
+    auto GlyphAtlas::GetEvictionCount() const -> U64
+    {
+        return evictionCount;
+    }
 
-            endPixelIdx++;
 
-            if (endPixelIdx < scanline.size())
-            {
-                // All the remaining pixels are ocluded by rectangles with width 1 and height
-                // end_height.
-                scanline[endPixelIdx].y += sign * endHeight;
-            }
-        }
+    auto GlyphAtlas::GetDirtyRects() const -> Span<const AtlasDirtyRect>
+    {
+        return dirtyRects;
     }
 
 
-    auto ProcessActiveEdges(const Array<ActiveEdge>& edges, Array<Point>& scanline, F32 scanlineBot, F32 scanlineTop)
+    auto GlyphAtlas::ClearDirtyRects() -> V
     {
-        for (auto& edge : edges)
-        {
-            ProcessActiveEdge(edge, scanline, scanlineBot, scanlineTop);
-        }
+        dirtyRects.clear();
     }
 
-    auto PrepareActiveEdgesForNextScanline(Array<ActiveEdge>& edges)
+
+    auto BakeAtlas(const FontData& fontData, Span<const I32> codepoints, Span<const F32> pixelHeights, U32 threadCount, const AtlasBakeOptions& options) -> BakedAtlas
     {
-        for (auto& edge : edges)
+        struct BakeJob
         {
-            // Find the value of x 1 unit further by adding the slope.
-            edge.scanlineTopIntersection0 += edge.dxdy;
-        }
-    }
+            U32 glyphIndex;
+            U32 sizeIndex;
+            AtlasGlyph glyph;
+        };
 
+        BakedAtlas atlas;
+        auto pageWidth = Max(options.pageWidth, 1u);
+        auto pageHeight = Max(options.pageHeight, 1u);
 
-    auto PruneActiveEdges(Array<ActiveEdge>& activeEdges, F32 scanlineTop)
-    {
-        auto idx = 0;
+        // Every distinct glyph of every size is drawn once.
+        Array<U32> glyphIndices(codepoints.size());
+        fontData.GetCharIndices(codepoints, glyphIndices);
+        Array<U32> distinctGlyphs = glyphIndices;
+        std::sort(distinctGlyphs.begin(), distinctGlyphs.end());
+        distinctGlyphs.erase(std::unique(distinctGlyphs.begin(), distinctGlyphs.end()), distinctGlyphs.end());
 
-        while (idx < activeEdges.size())
+        Array<BakeJob> jobs;
+        Map<U64, U32> jobIndices;
+
+        for (auto sizeIndex = 0u; sizeIndex < pixelHeights.size(); ++sizeIndex)
         {
-            // We check if the edge is above the scanline in order to remove it
-            if (activeEdges[idx].lowermostPoint1 <= scanlineTop)
+            auto scale = fontData.GetScaleForPixelHeight(pixelHeights[sizeIndex]);
+
+            for (auto glyphIndex : distinctGlyphs)
             {
-                Swap(activeEdges[idx], activeEdges.back());
-                activeEdges.pop_back();
-                idx--;
-            }
+                BakeJob job = {};
+                job.glyphIndex = glyphIndex;
+                job.sizeIndex = sizeIndex;
+                GetRasterSize(fontData.GetGlyphBoundingBox(glyphIndex), scale, 0, job.glyph.width, job.glyph.height);
 
-            idx++;
+                if (job.glyph.width + options.padding <= pageWidth && job.glyph.height + options.padding <= pageHeight)
+                {
+                    jobs.push_back(job);
+                }
+            }
         }
-    }
 
+        // Tallest first so that every shelf is filled with glyphs of about the same height. The
+        // order only depends on the input which keeps the packing deterministic.
+        std::sort
+        (
+            jobs.begin(),
+            jobs.end(),
+            [](const BakeJob& a, const BakeJob& b)
+            {
+                if (a.glyph.height != b.glyph.height)
+                {
+                    return a.glyph.height > b.glyph.height;
+                }
 
-    auto ClearScanline(Array<Point>& scanline) 
-    {
-        for (auto& pix : scanline)
-        {
-            pix.x = 0.f;
-            pix.y = 0.f;
-        }
-    }
+                if (a.glyph.width != b.glyph.width)
+                {
+                    return a.glyph.width > b.glyph.width;
+                }
+
+                return a.sizeIndex != b.sizeIndex ? a.sizeIndex < b.sizeIndex : a.glyphIndex < b.glyphIndex;
+            }
+        );
 
+        U32 shelfX = pageWidth;
+        U32 shelfY = 0;
+        U32 shelfHeight = 0;
 
-    auto DrawScanline(GrayScaleSurface& surface, const Array<Point>& scanline, U32 scanlineIdx)
-    {
-        F32 commulativeSum = 0.f;
-        for (auto i = 0; i < surface.width; ++i)
+        for (auto i = 0u; i < jobs.size(); ++i)
         {
-            commulativeSum += scanline[i].y;
-            auto value = Max(Min((commulativeSum + scanline[i].x) * 255.f, 255.f), 0.f);
-            surface.data[surface.width * scanlineIdx + i] = 255u - Byte(value);
-        }
-    }
+            auto& glyph = jobs[i].glyph;
+            auto slotWidth = glyph.width + options.padding;
+            auto slotHeight = glyph.height + options.padding;
 
-    // This function implements the high level functionality of the rasterizing algorithm
-    auto RasterizeEdges(Array<Edge>& edges, GrayScaleSurface& surface) 
-    {
-        surface.data.resize(surface.height * surface.width);
+            if (shelfX + slotWidth > pageWidth)
+            {
+                shelfX = 0;
+                shelfY += shelfHeight;
+                shelfHeight = slotHeight;
 
-        // We store first component which represents the signed area of a pixel shadowed by an outline,
-        // and then a second component that works as a commulative sum which will indicate that the 
-        // area will be added to all the rest of the pixels on the right.
-        Array<Point> scanline;
-        scanline.resize(surface.width , Point(0.f, 0.f));
+                if (atlas.pages.empty() || shelfY + shelfHeight > pageHeight)
+                {
+                    auto& page = atlas.pages.emplace_back();
+                    page.width = pageWidth;
+                    page.height = pageHeight;
+                    page.data.assign(U64(pageWidth) * pageHeight, 255);
+                    shelfY = 0;
+                }
+            }
 
-        // We keep a set of edges that are relevant for the current scanline each iteration
-        Array<ActiveEdge> activeEdges;
-        activeEdges.reserve(surface.width);
+            glyph.page = U32(atlas.pages.size() - 1);
+            glyph.x = shelfX;
+            glyph.y = shelfY;
+            glyph.u0 = F32(glyph.x) / pageWidth;
+            glyph.v0 = F32(glyph.y) / pageHeight;
+            glyph.u1 = F32(glyph.x + glyph.width) / pageWidth;
+            glyph.v1 = F32(glyph.y + glyph.height) / pageHeight;
+            shelfX += slotWidth;
 
-        auto edgesIdx = 0u;
+            jobIndices[(U64(jobs[i].sizeIndex) << 32) | jobs[i].glyphIndex] = i;
+        }
 
-        for (auto i = 0u; i < surface.height;++i) 
+        for (auto sizeIndex = 0u; sizeIndex < pixelHeights.size(); ++sizeIndex)
         {
-            auto scanlineTop = F32(i);
-            auto scanlineBot = F32(i + 1.f);
+            for (auto i = 0u; i < codepoints.size(); ++i)
+            {
+                auto job = jobIndices.find((U64(sizeIndex) << 32) | glyphIndices[i]);
 
-            // Remove edges that are not relevant for this scanline, hence no longer relevant in 
-            // general.
-            PruneActiveEdges(activeEdges, scanlineTop);
-            // Add all the new edges that have become relevant for the scanline.
-            AddActiveEdges(activeEdges, edges, edgesIdx, scanlineBot, scanlineTop);
-            // Fill the scanline array according to the edges intersecting the scanline
-            ProcessActiveEdges(activeEdges, scanline, scanlineBot, scanlineTop);
-            // Fill the surface scanline according to the scanline array
-            DrawScanline(surface, scanline, i);
-            ClearScanline(scanline);
-            // Transform the representation of the active edges so that they are convenient for
-            // pruning and processing next scanline.
-            PrepareActiveEdgesForNextScanline(activeEdges);
+                if (job != jobIndices.end())
+                {
+                    atlas.glyphs.push_back(BakedGlyph{ codepoints[i], glyphIndices[i], pixelHeights[sizeIndex], jobs[job->second].glyph });
+                }
+            }
         }
-    }
 
-    auto Rasterize(const GlyphData& glyph_data, F32 scale) -> GrayScaleSurface
-    {
-        GrayScaleSurface surface;
+        // Every thread starts on its own contiguous part of the jobs and then steals single jobs
+        // from the parts of the others. Each slot is written by exactly one thread.
+        struct alignas(64) JobQueue
+        {
+            Atomic<U64> next;
+            U64 end;
+        };
 
-        F32 minX = glyph_data.boundingBoxDiagonal.startPoint.x;
-        F32 minY = glyph_data.boundingBoxDiagonal.startPoint.y;
-        F32 maxX = glyph_data.boundingBoxDiagonal.endPoint.x;
-        F32 maxY = glyph_data.boundingBoxDiagonal.endPoint.y;
+        if (threadCount == 0)
+        {
+            threadCount = Max(std::thread::hardware_concurrency(), 1u);
+        }
 
-        surface.width = Ceil((maxX - minX+ 1.0) * scale);
-        surface.height = Ceil((maxY - minY + 1.0) * scale);
+        threadCount = U32(Max(Min(U64(threadCount), U64(jobs.size())), U64(1)));
+        Array<JobQueue> queues(threadCount);
 
-        // The next code can be confusing beause some operations are omitted due to mental algebra.
-        // If S is the scaling matrix R is the reflection matrix tO is translation of the lowermost 
-        // bounding box point to the origin, then tC is the translation of the resulting bounding box's
-        // center to the origin and tSc is the translation of the scaled bounding box's lowermost point
-        // to the origin then the final transformation T on point p is Tp = RS(p + tO + tC) + t_sc.
-        // Now when we writeout the explicit form of the final translation vector of this affine 
-        // transformation namely RStO + RStC + tsC some of the terms in the components will cencel 
-        // out.
-        // 
-        // This operation is done only once per rasterization so it's irrelevant how efficient it is. 
-        // I would've used more clear form but I've not implemented traits for 2d matrix algebra so I 
-        // have to resort to this confusing componentwise form.
+        for (auto t = 0u; t < threadCount; ++t)
+        {
+            queues[t].next = jobs.size() * t / threadCount;
+            queues[t].end = jobs.size() * (t + 1) / threadCount;
+        }
 
-        auto tO = Point(-minX, -minY);
-        auto tC1 = minY - maxY;
+        auto work =
+            [&](U32 thread)
+            {
+                GlyphDecodeScratch scratch;
+                GlyphData glyphData;
 
-        auto translationVector = Point(scale * tO.x, -scale * (tO.y + tC1));
+                for (auto q = 0u; q < threadCount; ++q)
+                {
+                    auto& queue = queues[(thread + q) % threadCount];
 
-        auto edges = Linearize(glyph_data, scale);
+                    for (auto i = queue.next.fetch_add(1, std::memory_order_relaxed); i < queue.end; i = queue.next.fetch_add(1, std::memory_order_relaxed))
+                    {
+                        auto& job = jobs[i];
+                        auto& page = atlas.pages[job.glyph.page];
+                        auto scale = fontData.GetScaleForPixelHeight(pixelHeights[job.sizeIndex]);
 
-        TransformEdgesToSurfaceSpace(edges, scale, translationVector);
+                        fontData.FetchGlyphData(job.glyphIndex, scratch, glyphData);
+                        RasterizeInto
+                        (
+                            glyphData,
+                            scale,
+                            0,
+                            SurfaceView{ page.data.data() + U64(job.glyph.y) * pageWidth + job.glyph.x, job.glyph.width, job.glyph.height, pageWidth }
+                        );
+                    }
+                }
+            };
 
-        // Sort by the uppermost edges. Edges with uppermost points the higher up will be first.
-        Sort(edges);
+        Array<std::thread> threads;
 
-        RasterizeEdges(edges, surface);
+        for (auto t = 1u; t < threadCount; ++t)
+        {
+            threads.emplace_back(work, t);
+        }
 
-        return surface;
-    }
+        work(0);
 
-    auto RasterizeGlyph(const FontData& fontData, I32 codepoint, I32 height) -> GrayScaleSurface
-    {
-        auto expectedMaxHeight = F32(fontData.ascent) - fontData.descent;
-        auto fontScale = height / expectedMaxHeight;
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
 
-        auto glyph = fontData.FetchGlyphDataForCodepoint(codepoint);
-        return Rasterize(glyph, fontScale);
+        return atlas;
     }
 }
 
-#endif
\ No newline at end of file
+#endif
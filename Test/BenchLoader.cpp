@@ -0,0 +1,647 @@
+// MIT License
+//
+// Copyright(c) 2024 Mihail Mladenov
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#define MIN_TTF_IMPLEMENTATION
+#include "../MinTTF.hpp"
+#include "OpenSans.hpp"
+#include "TestHelpers.hpp"
+
+#include <iostream>
+#include <random>
+
+using namespace MTTF;
+
+static constexpr U32 LOOKUP_COUNT = 1u << 24;
+
+auto BenchmarkCmap(const FontData& fontData, const Array<I32>& codepoints, const C* name) -> V
+{
+	U64 checksum = 0;
+
+	auto seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			// Wraps around instead of masking so that any number of codepoints works.
+			auto index = U64(0);
+			for (auto i = 0u; i < LOOKUP_COUNT; ++i)
+			{
+				checksum += fontData.GetCharIndex(codepoints[index]);
+				index = index + 1 == codepoints.size() ? 0 : index + 1;
+			}
+		}
+	);
+
+	std::cout << name << ": " << seconds * 1e9 / LOOKUP_COUNT << " ns/lookup (checksum " << checksum << ")\n";
+}
+
+auto BenchmarkBatchedCmap(const FontData& fontData, const Array<I32>& codepoints, const C* name) -> V
+{
+	Array<U32> glyphs(codepoints.size());
+	U64 checksum = 0;
+	auto batchCount = LOOKUP_COUNT / codepoints.size();
+
+	auto seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			for (auto i = 0u; i < batchCount; ++i)
+			{
+				fontData.GetCharIndices(codepoints, glyphs);
+				checksum += glyphs[i % glyphs.size()];
+			}
+		}
+	);
+
+	std::cout << name << ": " << seconds * 1e9 / LOOKUP_COUNT << " ns/lookup (checksum " << checksum << ")\n";
+}
+
+auto BenchmarkGlyphDecode(const FontData& fontData, U32 passCount, const C* name) -> V
+{
+	GlyphDecodeScratch scratch;
+	GlyphData glyphData;
+	U64 checksum = 0;
+
+	auto seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			for (auto pass = 0u; pass < passCount; ++pass)
+			{
+				for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+				{
+					fontData.FetchGlyphData(glyphIndex, scratch, glyphData);
+					checksum += glyphData.outline.points.size();
+				}
+			}
+		}
+	);
+
+	auto glyphCount = F64(passCount) * fontData.numberOfGlyphs;
+	std::cout << name << ": " << seconds * 1e9 / glyphCount << " ns/glyph (checksum " << checksum << ")\n";
+}
+
+auto BenchmarkAdvanceWidths(const FontData& fontData, const Array<U32>& glyphs, const C* name) -> V
+{
+	U64 checksum = 0;
+
+	auto seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			auto index = U64(0);
+			for (auto i = 0u; i < LOOKUP_COUNT; ++i)
+			{
+				checksum += fontData.GetAdvanceWidth(glyphs[index]);
+				index = index + 1 == glyphs.size() ? 0 : index + 1;
+			}
+		}
+	);
+
+	std::cout << name << ": " << seconds * 1e9 / LOOKUP_COUNT << " ns/lookup (checksum " << checksum << ")\n";
+}
+
+auto BenchmarkKerning(const FontData& fontData, const Array<U32>& glyphs, const C* name) -> V
+{
+	I64 checksum = 0;
+
+	auto seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			auto index = U64(0);
+			for (auto i = 0u; i < LOOKUP_COUNT; ++i)
+			{
+				auto nextIndex = index + 1 == glyphs.size() ? 0 : index + 1;
+				checksum += fontData.GetKerning(glyphs[index], glyphs[nextIndex]);
+				index = nextIndex;
+			}
+		}
+	);
+
+	std::cout << name << ": " << seconds * 1e9 / LOOKUP_COUNT << " ns/pair (checksum " << checksum << ")\n";
+}
+
+auto BenchmarkUtf8(const FontData& fontData, const Str& document, const C* name) -> V
+{
+	constexpr auto PASS_COUNT = 16u;
+	Array<U32> glyphs(document.size());
+	U64 checksum = 0;
+
+	auto seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			for (auto pass = 0u; pass < PASS_COUNT; ++pass)
+			{
+				auto mapping = fontData.GetCharIndicesUtf8(document, glyphs);
+				checksum += mapping.glyphCount + glyphs[pass];
+			}
+		}
+	);
+
+	std::cout << name << ": " << PASS_COUNT * document.size() / seconds / 1e9 << " GB/s (checksum " << checksum << ")\n";
+}
+
+auto BenchmarkGlyphCache(const FontData& fontData, const Array<U32>& glyphs) -> V
+{
+	constexpr auto PASS_COUNT = 64u;
+	GlyphCache cache;
+	U64 checksum = 0;
+
+	auto rasterizeSeconds = MeasureSeconds
+	(
+		[&]()
+		{
+			for (auto glyphIndex : glyphs)
+			{
+				checksum += cache.GetGlyph(fontData, 0, glyphIndex, 16.f)->width;
+			}
+		}
+	);
+
+	auto cachedSeconds = MeasureSeconds
+	(
+		[&]()
+		{
+			for (auto pass = 0u; pass < PASS_COUNT; ++pass)
+			{
+				for (auto glyphIndex : glyphs)
+				{
+					checksum += cache.GetGlyph(fontData, 0, glyphIndex, 16.f)->width;
+				}
+			}
+		}
+	);
+
+	auto statistics = cache.GetStatistics();
+	std::cout << "Glyph cache first pass: " << rasterizeSeconds * 1e9 / glyphs.size() << " ns/glyph, cached: "
+		<< cachedSeconds * 1e9 / (PASS_COUNT * glyphs.size()) << " ns/glyph (" << statistics.frontHits << " front hits, "
+		<< statistics.hits << " hits, " << statistics.misses << " misses, checksum " << checksum << ")\n";
+}
+
+auto BenchmarkBakeAtlas(const FontData& fontData) -> V
+{
+	// The whole charset of the font at 10 sizes.
+	Array<I32> charset;
+	for (auto codepoint = 0; codepoint < 0x10000; ++codepoint)
+	{
+		if (fontData.GetCharIndex(codepoint) != 0)
+		{
+			charset.push_back(codepoint);
+		}
+	}
+
+	Array<F32> pixelHeights = { 10.f, 12.f, 14.f, 16.f, 20.f, 24.f, 32.f, 40.f, 48.f, 64.f };
+	auto coreCount = Max(std::thread::hardware_concurrency(), 1u);
+	auto singleThreadSeconds = 0.0;
+
+	for (auto threadCount = 1u; threadCount <= coreCount; threadCount *= 2)
+	{
+		U64 pageCount = 0;
+		auto seconds = MeasureSeconds([&]() { pageCount = BakeAtlas(fontData, charset, pixelHeights, threadCount).pages.size(); });
+		singleThreadSeconds = threadCount == 1 ? seconds : singleThreadSeconds;
+
+		std::cout << "Bake " << charset.size() << " codepoints at " << pixelHeights.size() << " sizes, " << threadCount << " threads: "
+			<< seconds * 1e3 << " ms, speedup " << singleThreadSeconds / seconds << " (" << pageCount << " pages)\n";
+	}
+}
+
+auto BenchmarkLayout(const FontData& fontData, const Array<I32>& document, const C* name) -> V
+{
+	constexpr auto PASS_COUNT = 16u;
+	Array<PositionedGlyph> glyphs(document.size());
+	F64 checksum = 0;
+
+	auto seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			for (auto pass = 0u; pass < PASS_COUNT; ++pass)
+			{
+				checksum += LayoutRun(fontData, document, 16.f, glyphs).advance;
+			}
+		}
+	);
+
+	std::cout << name << ": " << PASS_COUNT * document.size() / seconds / 1e6 << " Mglyphs/s (checksum " << checksum << ")\n";
+}
+
+auto BenchmarkLinearize(const FontData& fontData, F32 pixelHeight) -> V
+{
+	Array<GlyphData> glyphs;
+	for (auto codepoint = 'A'; codepoint <= 'z'; ++codepoint)
+	{
+		glyphs.push_back(fontData.FetchGlyphDataForCodepoint(codepoint));
+	}
+
+	constexpr auto PASS_COUNT = 2000u;
+	auto scale = fontData.GetScaleForPixelHeight(pixelHeight);
+	U64 edgeCount = 0;
+
+	auto seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			for (auto pass = 0u; pass < PASS_COUNT; ++pass)
+			{
+				for (auto& glyph : glyphs)
+				{
+					edgeCount += Linearize(glyph, scale).size();
+				}
+			}
+		}
+	);
+
+	std::cout << "Linearize at " << pixelHeight << " px: " << seconds * 1e6 / (PASS_COUNT * glyphs.size()) << " us/glyph, "
+		<< F64(edgeCount) / (PASS_COUNT * glyphs.size()) << " edges/glyph\n";
+}
+
+template <RasterArithmetic ARITHMETIC>
+auto BenchmarkRasterize(const FontData& fontData, F32 pixelHeight) -> V
+{
+	Array<GlyphData> glyphs;
+	for (auto codepoint : { '@', 'W', 'g', '&', 'S', 'm', 'B', '%' })
+	{
+		glyphs.push_back(fontData.FetchGlyphDataForCodepoint(codepoint));
+	}
+
+	auto scale = fontData.GetScaleForPixelHeight(pixelHeight);
+	auto passCount = Max(1u, U32(4e6f / (pixelHeight * pixelHeight)));
+	U64 pixelCount = 0;
+
+	auto seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			for (auto pass = 0u; pass < passCount; ++pass)
+			{
+				for (auto& glyph : glyphs)
+				{
+					pixelCount += Rasterize<ARITHMETIC>(glyph, scale).data.size();
+				}
+			}
+		}
+	);
+
+	// The edges that go through the sort and the scanlines, curves for the analytic rasterizer.
+	U64 edgeCount = 0;
+	for (auto& glyph : glyphs)
+	{
+		if constexpr (ARITHMETIC == RasterArithmetic::Float)
+		{
+			edgeCount += Linearize(glyph, scale).size();
+		}
+		else if constexpr (ARITHMETIC == RasterArithmetic::Fixed)
+		{
+			edgeCount += LinearizeFixed(glyph, scale, 0).size();
+		}
+		else
+		{
+			edgeCount += GetCurveEdges(glyph, scale, 0, DEFAULT_FLATNESS_IN_PIXELS).size();
+		}
+	}
+
+	static constexpr const char* NAMES[] = { "Rasterize at ", "Fixed point rasterize at ", "Analytic rasterize at " };
+	std::cout << NAMES[U32(ARITHMETIC)] << pixelHeight << " px: " << seconds * 1e6 / (passCount * glyphs.size()) << " us/glyph, "
+		<< pixelCount / seconds / 1e6 << " Mpixels/s, " << F64(edgeCount) / glyphs.size() << " edges/glyph\n";
+}
+
+auto BenchmarkDrawScanline() -> V
+{
+	constexpr auto WIDTH = 4093u;
+	constexpr auto ROW_COUNT = 4096u;
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<F32> distribution(-0.25f, 0.25f);
+
+	Scanline scanline;
+	scanline.area.resize(WIDTH + SCANLINE_BLOCK_SIZE, 0.f);
+	scanline.cover.resize(WIDTH + SCANLINE_BLOCK_SIZE, 0.f);
+	for (auto i = 0u; i < WIDTH; ++i)
+	{
+		scanline.area[i] = distribution(generator);
+		scanline.cover[i] = distribution(generator);
+	}
+
+	Array<Byte> pixels(WIDTH * ROW_COUNT);
+	scanline.spans.emplace_back(0, WIDTH);
+	auto seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			for (auto row = 0u; row < ROW_COUNT; ++row)
+			{
+				DrawScanline(SurfaceView{ pixels.data(), WIDTH, ROW_COUNT, WIDTH }, scanline, row);
+			}
+		}
+	);
+
+	std::cout << "DrawScanline: " << seconds * 1e9 / (WIDTH * ROW_COUNT) << " ns/pixel (checksum " << U32(pixels[WIDTH * ROW_COUNT - 1]) << ")\n";
+
+	// A row of a text line with a few thin strokes, the rest is only filled.
+	constexpr auto STROKE_COUNT = 8u;
+	for (auto i = 0u; i < WIDTH; ++i)
+	{
+		scanline.area[i] = i % (WIDTH / STROKE_COUNT) < 4 ? distribution(generator) : 0.f;
+		scanline.cover[i] = i % (WIDTH / STROKE_COUNT) < 4 ? distribution(generator) : 0.f;
+	}
+
+	seconds = MeasureSeconds
+	(
+		[&]()
+		{
+			for (auto row = 0u; row < ROW_COUNT; ++row)
+			{
+				scanline.spans.clear();
+				for (auto stroke = 0u; stroke < STROKE_COUNT; ++stroke)
+				{
+					scanline.spans.emplace_back(stroke * (WIDTH / STROKE_COUNT), stroke * (WIDTH / STROKE_COUNT) + 4);
+				}
+
+				DrawScanline(SurfaceView{ pixels.data(), WIDTH, ROW_COUNT, WIDTH }, scanline, row);
+			}
+		}
+	);
+
+	std::cout << "DrawScanline, " << STROKE_COUNT << " strokes: " << seconds * 1e9 / (WIDTH * ROW_COUNT) << " ns/pixel (checksum " << U32(pixels[WIDTH * ROW_COUNT - 1]) << ")\n";
+}
+
+auto BenchmarkBandRasterize(const FontData& fontData, I32 pixelHeight) -> V
+{
+	auto singleThreadSeconds = 0.0;
+
+	for (auto threadCount : { 1u, 2u, 4u, 8u, 16u })
+	{
+		U64 checksum = 0;
+		auto seconds = MeasureSeconds
+		(
+			[&]()
+			{
+				for (auto codepoint : { '@', 'W', 'g', '&' })
+				{
+					checksum += RasterizeGlyph(fontData, codepoint, pixelHeight, threadCount).data[0];
+				}
+			}
+		);
+		singleThreadSeconds = threadCount == 1 ? seconds : singleThreadSeconds;
+
+		std::cout << "Rasterize at " << pixelHeight << " px, " << threadCount << " threads: " << seconds * 1e3 / 4 << " ms/glyph, speedup "
+			<< singleThreadSeconds / seconds << " (checksum " << checksum << ")\n";
+	}
+}
+
+auto main() -> I32
+{
+	FontData fontData;
+	FontData compiledFontData;
+	LoadOptions options;
+	options.compileCmap = true;
+
+	if
+	(
+		fontData.Load(Span<const U8>(OpenSans, OpenSansSize)) != Error::Success ||
+		compiledFontData.Load(Span<const U8>(OpenSans, OpenSansSize), options) != Error::Success
+	)
+	{
+		return -1;
+	}
+
+	std::cout << "Compiled cmap: " << compiledFontData.GetCompiledCmap().GetMemoryUsage() << " bytes\n";
+
+	std::mt19937 generator(42);
+	Array<I32> latin(4096);
+	Array<I32> bmp(4096);
+	std::uniform_int_distribution<I32> latinDistribution(0x20, 0x17F);
+	std::uniform_int_distribution<I32> bmpDistribution(0, 0xFFFF);
+
+	for (auto i = 0u; i < latin.size(); ++i)
+	{
+		latin[i] = latinDistribution(generator);
+		bmp[i] = bmpDistribution(generator);
+	}
+
+	BenchmarkCmap(fontData, latin, "Per format, Latin");
+	BenchmarkCmap(compiledFontData, latin, "Compiled, Latin");
+	BenchmarkCmap(fontData, bmp, "Per format, BMP");
+	BenchmarkCmap(compiledFontData, bmp, "Compiled, BMP");
+
+	StrView sampleText =
+		"The quick brown fox jumps over the lazy dog. Za\xc5\xbe\xc3\xb3\xc5\x82\xc4\x87 g\xc4\x99\xc5\x9bl\xc4\x85 ja\xc5\xba\xc5\x84. ";
+	Array<I32> text;
+	while (text.size() < 4096)
+	{
+		for (auto c : sampleText)
+		{
+			text.push_back(U8(c));
+		}
+	}
+	text.resize(4096);
+
+	BenchmarkCmap(fontData, text, "Per codepoint, text");
+	BenchmarkBatchedCmap(fontData, text, "Batched, text");
+	BenchmarkBatchedCmap(fontData, latin, "Batched, Latin");
+	BenchmarkBatchedCmap(compiledFontData, text, "Batched compiled, text");
+
+	FontData metricsFontData;
+	LoadOptions metricsOptions;
+	metricsOptions.decodeHorizontalMetrics = true;
+	if (metricsFontData.Load(Span<const U8>(OpenSans, OpenSansSize), metricsOptions) != Error::Success)
+	{
+		return -1;
+	}
+
+	Array<U32> textGlyphs(text.size());
+	fontData.GetCharIndices(text, textGlyphs);
+
+	BenchmarkAdvanceWidths(fontData, textGlyphs, "Advance widths from hmtx");
+	BenchmarkAdvanceWidths(metricsFontData, textGlyphs, "Advance widths decoded");
+
+	// Pairs between all the Latin letters and a class subtable for everything else in the text.
+	Array<KerningPair> pairs;
+	for (U16 left = 36; left < 94; ++left)
+	{
+		for (U16 right = 36; right < 94; right += 2)
+		{
+			pairs.push_back(KerningPair{ left, right, I16(left - right) });
+		}
+	}
+
+	ClassKerning classes;
+	classes.leftClassCount = 4;
+	classes.rightClassCount = 4;
+	classes.values.assign(16, -20);
+	for (auto glyph : textGlyphs)
+	{
+		classes.leftClasses[U16(glyph)] = glyph % 4;
+		classes.rightClasses[U16(glyph)] = glyph % 4;
+	}
+
+	auto tables = CopyTables
+	(
+		fontData,
+		Span<const U8>(OpenSans, OpenSansSize),
+		{ CMAP_TAG_LE, GLYF_TAG_LE, HEAD_TAG_LE, HHEA_TAG_LE, HMTX_TAG_LE, LOCA_TAG_LE, MAXP_TAG_LE, NAME_TAG_LE }
+	);
+	tables.emplace_back(GPOS_TAG_LE, BuildGposTable({ GposKernLookup{ .subtables = { pairs, classes } } }));
+	auto kernedFont = WriteFont(0x00010000, tables);
+
+	FontData kernedFontData;
+	LoadOptions kerningOptions;
+	kerningOptions.compileKerning = true;
+	if (kernedFontData.Load(kernedFont, kerningOptions) != Error::Success)
+	{
+		return -1;
+	}
+
+	std::cout << "Compiled kerning: " << kernedFontData.GetCompiledKerning().GetMemoryUsage() << " bytes\n";
+	BenchmarkKerning(kernedFontData, textGlyphs, "Kerning, text");
+
+	// Class kerning split the way font tools emit it, over several lookups of many class subtables
+	// which each cover a slice of the left glyphs. The offsets of the table limit its size.
+	constexpr auto CLASS_LOOKUP_COUNT = 4u;
+	constexpr auto CLASS_SUBTABLE_COUNT = 16u;
+	Array<U32> distinctGlyphs = textGlyphs;
+	std::sort(distinctGlyphs.begin(), distinctGlyphs.end());
+	distinctGlyphs.erase(std::unique(distinctGlyphs.begin(), distinctGlyphs.end()), distinctGlyphs.end());
+
+	Array<GposKernLookup> classLookups(CLASS_LOOKUP_COUNT);
+	for (auto lookup = 0u; lookup < CLASS_LOOKUP_COUNT; ++lookup)
+	{
+		for (auto subtable = 0u; subtable < CLASS_SUBTABLE_COUNT; ++subtable)
+		{
+			ClassKerning slice;
+			slice.leftClassCount = 4;
+			slice.rightClassCount = 4;
+			slice.values.assign(16, I16(-1 - I32(lookup)));
+			for (auto i = 0u; i < distinctGlyphs.size(); ++i)
+			{
+				auto glyph = U16(distinctGlyphs[i]);
+				if (i % CLASS_SUBTABLE_COUNT == subtable)
+				{
+					slice.leftClasses[glyph] = glyph % 4;
+				}
+				slice.rightClasses[glyph] = (glyph + subtable) % 4;
+			}
+			classLookups[lookup].subtables.push_back(std::move(slice));
+		}
+	}
+
+	auto classTables = tables;
+	classTables.back() = { GPOS_TAG_LE, BuildGposTable(classLookups) };
+	auto classKernedFont = WriteFont(0x00010000, classTables);
+
+	FontData classKernedFontData;
+	if (classKernedFontData.Load(classKernedFont, kerningOptions) != Error::Success)
+	{
+		return -1;
+	}
+
+	std::cout << "Compiled class kerning: " << classKernedFontData.GetCompiledKerning().GetMemoryUsage() << " bytes\n";
+	BenchmarkKerning(classKernedFontData, textGlyphs, "Kerning, text, many class subtables");
+
+	// A long document laid out as one run, with and without the load time tables.
+	Array<I32> document;
+	while (document.size() < 1 << 20)
+	{
+		document.insert(document.end(), text.begin(), text.end());
+	}
+
+	// Log lines that are ASCII apart from the occasional name.
+	Str logDocument;
+	for (auto line = 0u; logDocument.size() < 1 << 22; ++line)
+	{
+		logDocument += "2026-10-16T12:00:00.000Z INFO worker[" + std::to_string(line % 64) + "] request finished in 12 ms";
+		logDocument += line % 20 == 0 ? " user=Za\xc5\xbe\xc3\xb3\xc5\x82\xc4\x87\n" : " user=guest\n";
+	}
+
+	Str asciiDocument(logDocument.size(), ' ');
+	for (auto i = 0u; i < asciiDocument.size(); ++i)
+	{
+		asciiDocument[i] = C(0x20 + i % 95);
+	}
+
+	BenchmarkUtf8(fontData, asciiDocument, "UTF-8 to glyphs, ASCII");
+	BenchmarkUtf8(fontData, logDocument, "UTF-8 to glyphs, log");
+	BenchmarkUtf8(compiledFontData, logDocument, "UTF-8 to glyphs compiled, log");
+
+	FontData layoutFontData;
+	LoadOptions layoutOptions = kerningOptions;
+	layoutOptions.compileCmap = true;
+	layoutOptions.decodeHorizontalMetrics = true;
+	if (layoutFontData.Load(kernedFont, layoutOptions) != Error::Success)
+	{
+		return -1;
+	}
+
+	BenchmarkLayout(fontData, document, "Layout, no load options");
+	BenchmarkLayout(layoutFontData, document, "Layout, compiled cmap, metrics and kerning");
+
+	BenchmarkGlyphCache(fontData, textGlyphs);
+
+	BenchmarkBakeAtlas(fontData);
+
+	BenchmarkDrawScanline();
+	for (auto pixelHeight : { 16.f, 64.f, 256.f, 1024.f })
+	{
+		BenchmarkLinearize(fontData, pixelHeight);
+		BenchmarkRasterize<RasterArithmetic::Float>(fontData, pixelHeight);
+		BenchmarkRasterize<RasterArithmetic::Fixed>(fontData, pixelHeight);
+		BenchmarkRasterize<RasterArithmetic::Analytic>(fontData, pixelHeight);
+	}
+	BenchmarkBandRasterize(fontData, 4096);
+
+	U64 outlineBytes = 0;
+	U64 curveBytes = 0;
+	for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		auto glyphData = fontData.FetchGlyphData(glyphIndex);
+		if (glyphData.outline.commands.empty())
+		{
+			continue;
+		}
+		glyphData.outline.ShrinkToFit();
+		outlineBytes += glyphData.outline.GetMemoryUsage();
+		curveBytes += sizeof(Array<TTFCurve>) + glyphData.outline.GetSegmentCount() * sizeof(TTFCurve);
+	}
+
+	std::cout << "Outlines: " << outlineBytes << " bytes, as TTFCurve arrays: " << curveBytes << " bytes\n";
+
+	auto cffFontBytes = BuildCffFont(fontData, Span<const U8>(OpenSans, OpenSansSize));
+	FontData cffFontData;
+	FontData cachedCffFontData;
+	LoadOptions cffOptions;
+	cffOptions.cacheCffSubroutines = true;
+	if
+	(
+		cffFontData.Load(cffFontBytes) != Error::Success ||
+		cachedCffFontData.Load(cffFontBytes, cffOptions) != Error::Success
+	)
+	{
+		return -1;
+	}
+
+	std::cout << "CFF subroutine cache: " << cachedCffFontData.GetCffSubroutineCache()->GetMemoryUsage() << " bytes\n";
+
+	BenchmarkGlyphDecode(fontData, 64, "TrueType glyph decode");
+	BenchmarkGlyphDecode(cffFontData, 64, "CFF glyph decode");
+	BenchmarkGlyphDecode(cachedCffFontData, 64, "CFF glyph decode, cached subroutines");
+}
@@ -0,0 +1,161 @@
+// MIT License
+//
+// Copyright(c) 2024 Mihail Mladenov
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#define MIN_TTF_IMPLEMENTATION
+#include "../MinTTF.hpp"
+#include "OpenSans.hpp"
+#include "TestHelpers.hpp"
+
+#include <cstdlib>
+#include <new>
+
+using namespace MTTF;
+
+static U64 allocationCount = 0;
+
+// Both the single and the array forms are replaced along with their matching deallocation
+// functions. Deallocate is kept out of line so that GCC does not see a pointer from operator new
+// reach free.
+static auto Allocate(std::size_t size) -> V*
+{
+	allocationCount++;
+
+	if (auto pointer = std::malloc(size == 0 ? 1 : size))
+	{
+		return pointer;
+	}
+
+	throw std::bad_alloc();
+}
+
+[[gnu::noinline]]
+static auto Deallocate(V* pointer) noexcept -> V
+{
+	std::free(pointer);
+}
+
+auto operator new(std::size_t size) -> V*
+{
+	return Allocate(size);
+}
+
+auto operator new[](std::size_t size) -> V*
+{
+	return Allocate(size);
+}
+
+auto operator delete(V* pointer) noexcept -> V
+{
+	Deallocate(pointer);
+}
+
+auto operator delete(V* pointer, std::size_t) noexcept -> V
+{
+	Deallocate(pointer);
+}
+
+auto operator delete[](V* pointer) noexcept -> V
+{
+	Deallocate(pointer);
+}
+
+auto operator delete[](V* pointer, std::size_t) noexcept -> V
+{
+	Deallocate(pointer);
+}
+
+auto main() -> I32
+{
+	FontData fontData;
+	if (fontData.Load(Span<const U8>(OpenSans, OpenSansSize)) != Error::Success)
+	{
+		return -1;
+	}
+
+	GlyphDecodeScratch scratch;
+	GlyphData glyphData;
+
+	// Warm up so that the scratch and the output grow to fit the largest glyph.
+	for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		fontData.FetchGlyphData(glyphIndex, scratch, glyphData);
+	}
+
+	auto allocationsBefore = allocationCount;
+
+	for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		fontData.FetchGlyphData(glyphIndex, scratch, glyphData);
+	}
+
+	for (auto codepoint = 0x20; codepoint < 0x250; ++codepoint)
+	{
+		fontData.FetchGlyphDataForCodepoint(codepoint, scratch, glyphData);
+	}
+
+	if (allocationCount != allocationsBefore)
+	{
+		return -1;
+	}
+
+	// Layout allocates nothing either, CFF fonts included once their bounding boxes are cached.
+	LoadOptions layoutOptions;
+	layoutOptions.compileCmap = true;
+	layoutOptions.decodeHorizontalMetrics = true;
+	layoutOptions.compileKerning = true;
+	layoutOptions.cacheCffBoundingBoxes = true;
+
+	auto cffFontBytes = BuildCffFont(fontData, Span<const U8>(OpenSans, OpenSansSize));
+	FontData layoutFontData;
+	FontData cffFontData;
+	if
+	(
+		layoutFontData.Load(Span<const U8>(OpenSans, OpenSansSize), layoutOptions) != Error::Success ||
+		cffFontData.Load(cffFontBytes, layoutOptions) != Error::Success
+	)
+	{
+		return -1;
+	}
+
+	Array<I32> text;
+	for (auto codepoint = 0x20; codepoint < 0x250; ++codepoint)
+	{
+		text.push_back(codepoint);
+	}
+	Array<PositionedGlyph> glyphs(text.size());
+
+	allocationsBefore = allocationCount;
+
+	for (auto* font : { &layoutFontData, &cffFontData })
+	{
+		if (LayoutRun(*font, text, 16.f, glyphs).glyphCount != text.size())
+		{
+			return -1;
+		}
+	}
+
+	if (allocationCount != allocationsBefore)
+	{
+		return -1;
+	}
+}
@@ -29,6 +29,7 @@ using namespace MTTF;
 
 #include <fstream>
 #include <string>
+#include <chrono>
 
 inline auto WritePGM(const GrayScaleSurface& surf)
 {
@@ -53,34 +54,821 @@ inline auto WriteToSVG(const GlyphData& glyphData)
 	svg += std::to_string(glyphData.boundingBoxDiagonal.endPoint.y) + " ";
 	svg += "\">\n";
 
-	for (auto& component : glyphData.components)
+	glyphData.outline.ForEachSegment
+	(
+		[&](const auto& segment)
+		{
+			if constexpr (std::is_same_v<std::decay_t<decltype(segment)>, QuadraticBezierCurve>)
+			{
+				auto& curve = segment;
+
+				auto cp1X = curve.startPoint.x + 2.f / 3.f * (curve.controlPoint.x - curve.startPoint.x);
+				auto cp1Y = curve.startPoint.y + 2.f / 3.f * (curve.controlPoint.y - curve.startPoint.y);
+				auto cp2X = curve.endPoint.x + 2.f / 3.f * (curve.controlPoint.x - curve.endPoint.x);
+				auto cp2Y = curve.endPoint.y + 2.f / 3.f * (curve.controlPoint.y - curve.endPoint.y);
+
+				svg += "<path stroke=\"#000000\" fill=\"none\" d=\"";
+				svg += "M " + std::to_string(curve.startPoint.x) + " " + std::to_string(curve.startPoint.y) + " ";
+				svg += "C " + std::to_string(cp1X) + " " + std::to_string(cp1Y) + " ";
+				svg += std::to_string(cp2X) + " " + std::to_string(cp2Y) + " ";
+				svg += std::to_string(curve.endPoint.x) + " " + std::to_string(curve.endPoint.y);
+				svg += "\"></path>\n";
+			}
+			else if constexpr (std::is_same_v<std::decay_t<decltype(segment)>, CubicBezierCurve>)
+			{
+				auto& curve = segment;
+
+				svg += "<path stroke=\"#000000\" fill=\"none\" d=\"";
+				svg += "M " + std::to_string(curve.startPoint.x) + " " + std::to_string(curve.startPoint.y) + " ";
+				svg += "C " + std::to_string(curve.controlPoint0.x) + " " + std::to_string(curve.controlPoint0.y) + " ";
+				svg += std::to_string(curve.controlPoint1.x) + " " + std::to_string(curve.controlPoint1.y) + " ";
+				svg += std::to_string(curve.endPoint.x) + " " + std::to_string(curve.endPoint.y);
+				svg += "\"></path>\n";
+			}
+			else
+			{
+				auto& line = segment;
+				svg += "<path stroke=\"#000000\" fill=\"none\" d=\"";
+				svg += "M " + std::to_string(line.startPoint.x) + " " + std::to_string(line.startPoint.y) + " ";
+				svg += "L " + std::to_string(line.endPoint.x) + " " + std::to_string(line.endPoint.y);
+				svg += "\"></path>\n";
+			}
+		}
+	);
+
+	svg += "</svg>\n";
+	ofs.write(svg.data(), svg.size());
+}
+
+template <typename TFunction>
+inline auto MeasureSeconds(TFunction&& function) -> F64
+{
+	auto start = std::chrono::steady_clock::now();
+	function();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<F64>(end - start).count();
+}
+
+// Up to 8 bytes, the ones above the value are zero.
+inline auto WriteBE(Array<Byte>& bytes, U64 value, U32 size) -> V
+{
+	for (auto i = size; i > 0; --i)
+	{
+		bytes.push_back(Byte(value >> (8 * (i - 1))));
+	}
+}
+
+inline auto WriteCffNumber(Array<Byte>& bytes, F64 value) -> V
+{
+	auto integer = I32(std::lround(value));
+
+	if (F64(integer) != value)
+	{
+		bytes.push_back(255);
+		WriteBE(bytes, U32(I32(std::lround(value * 65536.0))), 4);
+	}
+	else if (integer >= -107 && integer <= 107)
+	{
+		bytes.push_back(Byte(integer + 139));
+	}
+	else if (integer >= 108 && integer <= 1131)
+	{
+		bytes.push_back(Byte((integer - 108) / 256 + 247));
+		bytes.push_back(Byte((integer - 108) % 256));
+	}
+	else if (integer >= -1131 && integer <= -108)
+	{
+		bytes.push_back(Byte((-integer - 108) / 256 + 251));
+		bytes.push_back(Byte((-integer - 108) % 256));
+	}
+	else
+	{
+		bytes.push_back(28);
+		WriteBE(bytes, U16(I16(integer)), 2);
+	}
+}
+
+// CFF2 indices have four byte counts.
+inline auto WriteCffIndex(Array<Byte>& bytes, const Array<Array<Byte>>& objects, U32 countSize = 2) -> V
+{
+	WriteBE(bytes, U32(objects.size()), countSize);
+
+	if (objects.empty())
+	{
+		return;
+	}
+
+	bytes.push_back(4);
+
+	auto offset = 1u;
+	WriteBE(bytes, offset, 4);
+
+	for (auto& object : objects)
+	{
+		offset += U32(object.size());
+		WriteBE(bytes, offset, 4);
+	}
+
+	for (auto& object : objects)
+	{
+		bytes.insert(bytes.end(), object.begin(), object.end());
+	}
+}
+
+using FontTables = Array<Pair<U32, Array<Byte>>>;
+
+// Copies the tables with the given tags (in little endian) out of a font.
+inline auto CopyTables(const FontData& fontData, Span<const Byte> fontBytes, std::initializer_list<U32> tags) -> FontTables
+{
+	FontTables tables;
+
+	for (auto tag : tags)
+	{
+		auto location = fontData.FindTable(FromLE(tag));
+		auto begin = fontBytes.begin() + location.offset;
+		tables.emplace_back(tag, Array<Byte>(begin, begin + location.length));
+	}
+
+	return tables;
+}
+
+inline auto WriteFont(U32 sfntVersion, const FontTables& tables) -> Array<Byte>
+{
+	Array<Byte> font;
+	WriteBE(font, sfntVersion, 4);
+	WriteBE(font, U32(tables.size()), 2);
+	WriteBE(font, 0, 6);
+
+	auto offset = U32(font.size() + 16 * tables.size());
+
+	for (auto& [tag, table] : tables)
+	{
+		WriteBE(font, FromBE(tag), 4);
+		WriteBE(font, 0, 4);
+		WriteBE(font, offset, 4);
+		WriteBE(font, U32(table.size()), 4);
+		offset += (U32(table.size()) + 3) & ~3u;
+	}
+
+	for (auto& [tag, table] : tables)
+	{
+		font.insert(font.end(), table.begin(), table.end());
+		font.resize((font.size() + 3) & ~3ull, 0);
+	}
+
+	return font;
+}
+
+// A simple glyph record whose contours have only on curve points.
+inline auto BuildSimpleGlyph(const Array<Array<TTFPoint>>& contours) -> Array<Byte>
+{
+	Array<TTFPoint> points;
+	Array<Byte> endPoints;
+	for (auto& contour : contours)
+	{
+		points.insert(points.end(), contour.begin(), contour.end());
+		WriteBE(endPoints, U32(points.size() - 1), 2);
+	}
+
+	auto minPoint = points[0];
+	auto maxPoint = points[0];
+	for (auto point : points)
 	{
-		if (HoldsAlternative<QuadraticBezierCurve>(component))
+		minPoint = TTFPoint(Min(minPoint.x, point.x), Min(minPoint.y, point.y));
+		maxPoint = TTFPoint(Max(maxPoint.x, point.x), Max(maxPoint.y, point.y));
+	}
+
+	Array<Byte> glyph;
+	WriteBE(glyph, U32(contours.size()), 2);
+	WriteBE(glyph, U16(minPoint.x), 2);
+	WriteBE(glyph, U16(minPoint.y), 2);
+	WriteBE(glyph, U16(maxPoint.x), 2);
+	WriteBE(glyph, U16(maxPoint.y), 2);
+	glyph.insert(glyph.end(), endPoints.begin(), endPoints.end());
+	WriteBE(glyph, 0, 2);
+	glyph.insert(glyph.end(), points.size(), 0x01);
+
+	// Word sized deltas for both axes.
+	for (auto axis = 0u; axis < 2; ++axis)
+	{
+		auto previous = 0;
+		for (auto point : points)
 		{
-			auto& curve = Get<QuadraticBezierCurve>(component);
+			auto coordinate = axis == 0 ? point.x : point.y;
+			WriteBE(glyph, U16(coordinate - previous), 2);
+			previous = coordinate;
+		}
+	}
 
-			auto cp1X = curve.startPoint.x + 2.f / 3.f * (curve.controlPoint.x - curve.startPoint.x);
-			auto cp1Y = curve.startPoint.y + 2.f / 3.f * (curve.controlPoint.y - curve.startPoint.y);
-			auto cp2X = curve.endPoint.x + 2.f / 3.f * (curve.controlPoint.x - curve.endPoint.x);
-			auto cp2Y = curve.endPoint.y + 2.f / 3.f * (curve.controlPoint.y - curve.endPoint.y);
+	return glyph;
+}
 
-			svg += "<path stroke=\"#000000\" fill=\"none\" d=\"";
-			svg += "M " + std::to_string(curve.startPoint.x) + " " + std::to_string(curve.startPoint.y) + " ";
-			svg += "C " + std::to_string(cp1X) + " " + std::to_string(cp1Y) + " ";
-			svg += std::to_string(cp2X) + " " + std::to_string(cp2Y) + " ";
-			svg += std::to_string(curve.endPoint.x) + " " + std::to_string(curve.endPoint.y);
-			svg += "\"></path>\n";
+// Replaces the outlines of a TrueType font with the given glyf records. The glyphs past them are
+// left empty.
+inline auto BuildGlyfFont(const FontData& fontData, Span<const Byte> fontBytes, const Array<Array<Byte>>& glyphs) -> Array<Byte>
+{
+	Array<Byte> glyf;
+	Array<Byte> loca;
+
+	for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		WriteBE(loca, U32(glyf.size()), 4);
+		if (glyphIndex < glyphs.size())
+		{
+			glyf.insert(glyf.end(), glyphs[glyphIndex].begin(), glyphs[glyphIndex].end());
+			glyf.resize((glyf.size() + 3) & ~3ull, 0);
 		}
-		else
+	}
+	WriteBE(loca, U32(glyf.size()), 4);
+
+	auto tables = CopyTables(fontData, fontBytes, { CMAP_TAG_LE, HEAD_TAG_LE, HHEA_TAG_LE, HMTX_TAG_LE, MAXP_TAG_LE, NAME_TAG_LE });
+	tables.emplace_back(GLYF_TAG_LE, glyf);
+	tables.emplace_back(LOCA_TAG_LE, loca);
+
+	// The long loca format.
+	for (auto& [tag, table] : tables)
+	{
+		if (tag == HEAD_TAG_LE)
 		{
-			auto& line = Get<Line>(component);
-			svg += "<path stroke=\"#000000\" fill=\"none\" d=\"";
-			svg += "M " + std::to_string(line.startPoint.x) + " " + std::to_string(line.startPoint.y) + " ";
-			svg += "L " + std::to_string(line.endPoint.x) + " " + std::to_string(line.endPoint.y);
-			svg += "\"></path>\n";
+			table[50] = 0;
+			table[51] = 1;
 		}
 	}
 
-	svg += "</svg>\n";
-	ofs.write(svg.data(), svg.size());
-}
\ No newline at end of file
+	return WriteFont(0x00010000, tables);
+}
+
+inline auto WriteCffDictInt(Array<Byte>& bytes, U32 value) -> V
+{
+	bytes.push_back(29);
+	WriteBE(bytes, value, 4);
+}
+
+// Builds an OpenType font with a CFF table holding the given charstrings and subroutines.
+inline auto WriteCffFont
+(
+	const FontData& fontData,
+	Span<const Byte> fontBytes,
+	const Array<Array<Byte>>& charStrings,
+	const Array<Array<Byte>>& globalSubrs,
+	const Array<Array<Byte>>& localSubrs
+) -> Array<Byte>
+{
+	Array<Byte> cff = { 1, 0, 4, 4 };
+	WriteCffIndex(cff, { Array<Byte>{ 'M', 'i', 'n', 'T', 'T', 'F' } });
+
+	// The top dict has a fixed size so the offsets can be computed before writing it.
+	static constexpr U32 TOP_DICT_SIZE = 17;
+	static constexpr U32 PRIVATE_DICT_SIZE = 6;
+	Array<Byte> globalSubrIndex;
+	Array<Byte> charStringIndex;
+	WriteCffIndex(globalSubrIndex, globalSubrs);
+	WriteCffIndex(charStringIndex, charStrings);
+
+	auto charStringsOffset = U32(cff.size() + 2 + 1 + 2 * 4 + TOP_DICT_SIZE + 2 + globalSubrIndex.size());
+	auto privateOffset = U32(charStringsOffset + charStringIndex.size());
+
+	Array<Byte> topDict;
+	WriteCffDictInt(topDict, charStringsOffset);
+	topDict.push_back(17);
+	WriteCffDictInt(topDict, PRIVATE_DICT_SIZE);
+	WriteCffDictInt(topDict, privateOffset);
+	topDict.push_back(18);
+
+	WriteCffIndex(cff, { topDict });
+	WriteCffIndex(cff, {});
+	cff.insert(cff.end(), globalSubrIndex.begin(), globalSubrIndex.end());
+	cff.insert(cff.end(), charStringIndex.begin(), charStringIndex.end());
+	// The local subroutines directly follow the private dict.
+	WriteCffDictInt(cff, PRIVATE_DICT_SIZE);
+	cff.push_back(19);
+	WriteCffIndex(cff, localSubrs);
+
+	// Everything but the outlines comes from the TrueType font.
+	auto tables = CopyTables(fontData, fontBytes, { CMAP_TAG_LE, HEAD_TAG_LE, HHEA_TAG_LE, HMTX_TAG_LE, MAXP_TAG_LE, NAME_TAG_LE });
+	tables.emplace_back(CFF_TAG_LE, cff);
+
+	return WriteFont(0x4F54544F, tables);
+}
+
+// Builds an OpenType font with a CFF2 table holding the given charstrings. Each font dict has a
+// private dict with only the given vsindex. The font dict of every glyph is selected by ranges of
+// their first glyph and font dict. The variation store has one item variation data with the given
+// number of regions for each entry of regionCounts.
+inline auto WriteCff2Font
+(
+	const FontData& fontData,
+	Span<const Byte> fontBytes,
+	const Array<Array<Byte>>& charStrings,
+	const Array<U32>& fontDictVariationDataIndices,
+	const Array<Pair<U32, U32>>& fontDictRanges,
+	const Array<U32>& regionCounts
+) -> Array<Byte>
+{
+	static constexpr U32 TOP_DICT_SIZE = 4 * 5 + 6;
+	static constexpr U32 FONT_DICT_SIZE = 11;
+	static constexpr U32 PRIVATE_DICT_SIZE = 6;
+
+	Array<Byte> globalSubrIndex;
+	Array<Byte> charStringIndex;
+	WriteCffIndex(globalSubrIndex, {}, 4);
+	WriteCffIndex(charStringIndex, charStrings, 4);
+
+	// A single axis with a region per variation data region.
+	auto maxRegionCount = *std::max_element(regionCounts.begin(), regionCounts.end());
+	Array<Byte> store;
+	WriteBE(store, 1, 2);
+	WriteBE(store, U32(8 + 4 * regionCounts.size()), 4);
+	WriteBE(store, U32(regionCounts.size()), 2);
+	auto dataOffset = U32(8 + 4 * regionCounts.size() + 4 + 6 * maxRegionCount);
+	for (auto regionCount : regionCounts)
+	{
+		WriteBE(store, dataOffset, 4);
+		dataOffset += 6 + 2 * regionCount;
+	}
+	WriteBE(store, 1, 2);
+	WriteBE(store, maxRegionCount, 2);
+	for (auto region = 0u; region < maxRegionCount; ++region)
+	{
+		WriteBE(store, 0, 2);
+		WriteBE(store, 0x4000, 2);
+		WriteBE(store, 0x4000, 2);
+	}
+	for (auto regionCount : regionCounts)
+	{
+		WriteBE(store, 0, 2);
+		WriteBE(store, 0, 2);
+		WriteBE(store, regionCount, 2);
+		for (auto region = 0u; region < regionCount; ++region)
+		{
+			WriteBE(store, region, 2);
+		}
+	}
+
+	Array<Byte> fontDictSelect = { 3 };
+	WriteBE(fontDictSelect, U32(fontDictRanges.size()), 2);
+	for (auto [firstGlyph, fontDict] : fontDictRanges)
+	{
+		WriteBE(fontDictSelect, firstGlyph, 2);
+		WriteBE(fontDictSelect, fontDict, 1);
+	}
+	WriteBE(fontDictSelect, U32(charStrings.size()), 2);
+
+	auto charStringsOffset = U32(5 + TOP_DICT_SIZE + globalSubrIndex.size());
+	auto storeOffset = U32(charStringsOffset + charStringIndex.size());
+	auto fontDictSelectOffset = U32(storeOffset + 2 + store.size());
+	auto fontDictArrayOffset = U32(fontDictSelectOffset + fontDictSelect.size());
+	auto fontDictCount = U32(fontDictVariationDataIndices.size());
+	auto privateOffset = U32(fontDictArrayOffset + 4 + 1 + 4 * (fontDictCount + 1) + FONT_DICT_SIZE * fontDictCount);
+
+	Array<Array<Byte>> fontDicts;
+	Array<Byte> privateDicts;
+	for (auto variationDataIndex : fontDictVariationDataIndices)
+	{
+		Array<Byte> fontDict;
+		WriteCffDictInt(fontDict, PRIVATE_DICT_SIZE);
+		WriteCffDictInt(fontDict, U32(privateOffset + privateDicts.size()));
+		fontDict.push_back(18);
+		fontDicts.push_back(fontDict);
+
+		WriteCffDictInt(privateDicts, variationDataIndex);
+		privateDicts.push_back(22);
+	}
+
+	Array<Byte> cff = { 2, 0, 5 };
+	WriteBE(cff, TOP_DICT_SIZE, 2);
+	WriteCffDictInt(cff, charStringsOffset);
+	cff.push_back(17);
+	WriteCffDictInt(cff, storeOffset);
+	cff.push_back(24);
+	WriteCffDictInt(cff, fontDictArrayOffset);
+	cff.insert(cff.end(), { 12, 36 });
+	WriteCffDictInt(cff, fontDictSelectOffset);
+	cff.insert(cff.end(), { 12, 37 });
+	cff.insert(cff.end(), globalSubrIndex.begin(), globalSubrIndex.end());
+	cff.insert(cff.end(), charStringIndex.begin(), charStringIndex.end());
+	WriteBE(cff, U32(store.size()), 2);
+	cff.insert(cff.end(), store.begin(), store.end());
+	cff.insert(cff.end(), fontDictSelect.begin(), fontDictSelect.end());
+	WriteCffIndex(cff, fontDicts, 4);
+	cff.insert(cff.end(), privateDicts.begin(), privateDicts.end());
+
+	auto tables = CopyTables(fontData, fontBytes, { CMAP_TAG_LE, HEAD_TAG_LE, HHEA_TAG_LE, HMTX_TAG_LE, MAXP_TAG_LE, NAME_TAG_LE });
+	tables.emplace_back(CFF2_TAG_LE, cff);
+
+	return WriteFont(0x4F54544F, tables);
+}
+
+// Builds an OpenType font with CFF outlines out of the glyphs of a TrueType font. The quadratic
+// curves are elevated to cubic ones. Every contour becomes a subroutine, the ones shared by more
+// than one glyph (e.g. by accented letters) are global. The charstrings also carry a width, hints
+// and masks so that all of that gets parsed.
+inline auto BuildCffFont(const FontData& fontData, Span<const Byte> fontBytes) -> Array<Byte>
+{
+	struct ContourCall
+	{
+		TTFPoint start;
+		U32 contour;
+	};
+
+	Map<Str, U32> contourIndices;
+	Array<Str> contours;
+	Array<U32> useCounts;
+	Array<Array<ContourCall>> glyphContours(fontData.numberOfGlyphs);
+
+	for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		auto outline = fontData.FetchGlyphData(glyphIndex).outline;
+		auto pointIdx = 0u;
+		F64 previousX = 0;
+		F64 previousY = 0;
+		Array<Byte> contour;
+		TTFPoint start;
+
+		auto finishContour = [&]()
+		{
+			if (contour.empty())
+			{
+				return;
+			}
+
+			// A mask at the end so that cached subroutines have to resume from the bytes.
+			contour.push_back(19);
+			contour.push_back(0x80);
+			contour.push_back(11);
+
+			auto key = Str(contour.begin(), contour.end());
+			auto [it, inserted] = contourIndices.emplace(key, U32(contours.size()));
+
+			if (inserted)
+			{
+				contours.push_back(key);
+				useCounts.push_back(0);
+			}
+
+			useCounts[it->second] += 1;
+			glyphContours[glyphIndex].push_back(ContourCall{ start, it->second });
+			contour.clear();
+		};
+
+		auto writeDelta = [&](F64 x, F64 y)
+		{
+			WriteCffNumber(contour, x - previousX);
+			WriteCffNumber(contour, y - previousY);
+			previousX = x;
+			previousY = y;
+		};
+
+		for (auto command : outline.commands)
+		{
+			if (command == OutlineCommand::MoveTo)
+			{
+				finishContour();
+				start = outline.points[pointIdx];
+				previousX = start.x;
+				previousY = start.y;
+				pointIdx += 1;
+			}
+			else if (command == OutlineCommand::LineTo)
+			{
+				writeDelta(outline.points[pointIdx].x, outline.points[pointIdx].y);
+				contour.push_back(5);
+				pointIdx += 1;
+			}
+			else if (command == OutlineCommand::QuadTo)
+			{
+				auto& control = outline.points[pointIdx];
+				auto& end = outline.points[pointIdx + 1];
+				writeDelta((previousX + 2.0 * control.x) / 3.0, (previousY + 2.0 * control.y) / 3.0);
+				writeDelta((end.x + 2.0 * control.x) / 3.0, (end.y + 2.0 * control.y) / 3.0);
+				writeDelta(end.x, end.y);
+				contour.push_back(8);
+				pointIdx += 2;
+			}
+		}
+
+		finishContour();
+	}
+
+	// Subroutine numbers of the contours in the global or in the local index.
+	Array<Array<Byte>> globalSubrs;
+	Array<Array<Byte>> localSubrs;
+	Array<I32> subrNumbers(contours.size());
+
+	for (auto i = 0u; i < contours.size(); ++i)
+	{
+		auto& subrs = useCounts[i] > 1 ? globalSubrs : localSubrs;
+		subrNumbers[i] = I32(subrs.size());
+		subrs.emplace_back(contours[i].begin(), contours[i].end());
+	}
+
+	auto bias = [](U64 count) { return count < 1240 ? 107 : (count < 33900 ? 1131 : 32768); };
+	auto globalBias = bias(globalSubrs.size());
+	auto localBias = bias(localSubrs.size());
+
+	Array<Array<Byte>> charStrings;
+
+	for (auto& calls : glyphContours)
+	{
+		Array<Byte> charString;
+		// Width followed by two horizontal stems.
+		for (auto value : { 500, 0, 10, 20, 10 })
+		{
+			WriteCffNumber(charString, value);
+		}
+		charString.push_back(18);
+
+		TTFPoint current(0, 0);
+
+		for (auto& call : calls)
+		{
+			WriteCffNumber(charString, call.start.x - current.x);
+			WriteCffNumber(charString, call.start.y - current.y);
+			charString.push_back(21);
+
+			auto global = useCounts[call.contour] > 1;
+			WriteCffNumber(charString, subrNumbers[call.contour] - (global ? globalBias : localBias));
+			charString.push_back(global ? 29 : 10);
+			current = call.start;
+		}
+
+		charString.push_back(14);
+		charStrings.push_back(charString);
+	}
+
+	return WriteCffFont(fontData, fontBytes, charStrings, globalSubrs, localSubrs);
+}
+
+struct KerningPair
+{
+	U16 leftGlyph;
+	U16 rightGlyph;
+	I16 value;
+};
+
+// A class based GPOS pair subtable. Listed glyphs are covered on the left, the others have class
+// zero on the right.
+struct ClassKerning
+{
+	Map<U16, U16> leftClasses;
+	Map<U16, U16> rightClasses;
+	U16 leftClassCount;
+	U16 rightClassCount;
+	// Indexed by leftClass * rightClassCount + rightClass.
+	Array<I16> values;
+};
+
+// A Microsoft kern table with a single format 0 subtable.
+inline auto BuildKernTable(Array<KerningPair> pairs) -> Array<Byte>
+{
+	std::sort(pairs.begin(), pairs.end(), [](auto& a, auto& b) { return Pair(a.leftGlyph, a.rightGlyph) < Pair(b.leftGlyph, b.rightGlyph); });
+
+	Array<Byte> kern;
+	WriteBE(kern, 0, 2);
+	WriteBE(kern, 1, 2);
+	WriteBE(kern, 0, 2);
+	WriteBE(kern, U32(14 + 6 * pairs.size()), 2);
+	WriteBE(kern, 0x0001, 2);
+
+	auto entrySelector = U32(std::bit_width(pairs.size()) - 1);
+	WriteBE(kern, U32(pairs.size()), 2);
+	WriteBE(kern, 6u << entrySelector, 2);
+	WriteBE(kern, entrySelector, 2);
+	WriteBE(kern, U32(6 * pairs.size() - (6u << entrySelector)), 2);
+
+	for (auto& pair : pairs)
+	{
+		WriteBE(kern, pair.leftGlyph, 2);
+		WriteBE(kern, pair.rightGlyph, 2);
+		WriteBE(kern, U16(pair.value), 2);
+	}
+
+	return kern;
+}
+
+// A subtable of a GPOS kern lookup, either pairs listed one by one or class kerning.
+using GposKernSubtable = Variant<Array<KerningPair>, ClassKerning>;
+
+struct GposKernLookup
+{
+	Array<GposKernSubtable> subtables;
+	// Puts every subtable behind an extension subtable.
+	B extension = false;
+};
+
+// A GPOS table with a kern feature made of the given lookups.
+inline auto BuildGposTable(const Array<GposKernLookup>& kernLookups) -> Array<Byte>
+{
+	auto patchBE = [](Array<Byte>& bytes, U64 offset, U32 value)
+	{
+		bytes[offset] = Byte(value >> 8);
+		bytes[offset + 1] = Byte(value);
+	};
+
+	// Pair positioning format 1. The first values also have an x placement to exercise the value
+	// record layout.
+	auto writePairSubtable = [&](const Array<KerningPair>& subtablePairs)
+	{
+		Map<U16, Array<KerningPair>> pairSets;
+		for (auto& pair : subtablePairs)
+		{
+			pairSets[pair.leftGlyph].push_back(pair);
+		}
+
+		Array<U16> leftGlyphs;
+		for (auto& [glyph, pairSet] : pairSets)
+		{
+			leftGlyphs.push_back(glyph);
+		}
+		std::sort(leftGlyphs.begin(), leftGlyphs.end());
+
+		Array<Byte> subtable;
+		WriteBE(subtable, 1, 2);
+		WriteBE(subtable, 0, 2);
+		WriteBE(subtable, 0x0005, 2);
+		WriteBE(subtable, 0x0004, 2);
+		WriteBE(subtable, U32(leftGlyphs.size()), 2);
+		subtable.resize(subtable.size() + 2 * leftGlyphs.size());
+
+		for (auto i = 0u; i < leftGlyphs.size(); ++i)
+		{
+			patchBE(subtable, 10 + 2 * i, U32(subtable.size()));
+			auto& pairSet = pairSets[leftGlyphs[i]];
+			WriteBE(subtable, U32(pairSet.size()), 2);
+
+			for (auto& pair : pairSet)
+			{
+				WriteBE(subtable, pair.rightGlyph, 2);
+				WriteBE(subtable, 7, 2);
+				WriteBE(subtable, U16(pair.value), 2);
+				WriteBE(subtable, 9, 2);
+			}
+		}
+
+		patchBE(subtable, 2, U32(subtable.size()));
+		WriteBE(subtable, 1, 2);
+		WriteBE(subtable, U32(leftGlyphs.size()), 2);
+		for (auto glyph : leftGlyphs)
+		{
+			WriteBE(subtable, glyph, 2);
+		}
+
+		return subtable;
+	};
+
+	// Pair positioning format 2 with a format 2 coverage, a format 1 left class definition and a
+	// format 2 right one.
+	auto writeClassSubtable = [&](const ClassKerning& classes)
+	{
+		Array<Byte> subtable;
+		WriteBE(subtable, 2, 2);
+		WriteBE(subtable, 0, 2);
+		WriteBE(subtable, 0x0004, 2);
+		WriteBE(subtable, 0, 2);
+		WriteBE(subtable, 0, 4);
+		WriteBE(subtable, classes.leftClassCount, 2);
+		WriteBE(subtable, classes.rightClassCount, 2);
+
+		for (auto value : classes.values)
+		{
+			WriteBE(subtable, U16(value), 2);
+		}
+
+		Array<U16> leftGlyphs;
+		for (auto& [glyph, glyphClass] : classes.leftClasses)
+		{
+			leftGlyphs.push_back(glyph);
+		}
+		std::sort(leftGlyphs.begin(), leftGlyphs.end());
+
+		patchBE(subtable, 2, U32(subtable.size()));
+		WriteBE(subtable, 2, 2);
+		WriteBE(subtable, U32(leftGlyphs.size()), 2);
+		for (auto i = 0u; i < leftGlyphs.size(); ++i)
+		{
+			WriteBE(subtable, leftGlyphs[i], 2);
+			WriteBE(subtable, leftGlyphs[i], 2);
+			WriteBE(subtable, i, 2);
+		}
+
+		patchBE(subtable, 8, U32(subtable.size()));
+		WriteBE(subtable, 1, 2);
+		WriteBE(subtable, leftGlyphs.front(), 2);
+		WriteBE(subtable, U32(leftGlyphs.back() - leftGlyphs.front() + 1), 2);
+		for (auto glyph = leftGlyphs.front(); glyph <= leftGlyphs.back(); ++glyph)
+		{
+			auto glyphClass = classes.leftClasses.find(glyph);
+			WriteBE(subtable, glyphClass != classes.leftClasses.end() ? glyphClass->second : 0, 2);
+		}
+
+		Array<Pair<U16, U16>> rightClasses(classes.rightClasses.begin(), classes.rightClasses.end());
+		std::sort(rightClasses.begin(), rightClasses.end());
+
+		patchBE(subtable, 10, U32(subtable.size()));
+		WriteBE(subtable, 2, 2);
+		WriteBE(subtable, U32(rightClasses.size()), 2);
+		for (auto [glyph, glyphClass] : rightClasses)
+		{
+			WriteBE(subtable, glyph, 2);
+			WriteBE(subtable, glyph, 2);
+			WriteBE(subtable, glyphClass, 2);
+		}
+
+		return subtable;
+	};
+
+	auto writeLookup = [&](U32 type, const Array<Array<Byte>>& subtables)
+	{
+		Array<Byte> lookup;
+		WriteBE(lookup, type, 2);
+		WriteBE(lookup, 0, 2);
+		WriteBE(lookup, U32(subtables.size()), 2);
+
+		auto offset = U32(6 + 2 * subtables.size());
+		for (auto& subtable : subtables)
+		{
+			WriteBE(lookup, offset, 2);
+			offset += U32(subtable.size());
+		}
+
+		for (auto& subtable : subtables)
+		{
+			lookup.insert(lookup.end(), subtable.begin(), subtable.end());
+		}
+
+		return lookup;
+	};
+
+	Array<Array<Byte>> lookups;
+	for (auto& kernLookup : kernLookups)
+	{
+		Array<Array<Byte>> subtables;
+		for (auto& kernSubtable : kernLookup.subtables)
+		{
+			auto subtable = HoldsAlternative<ClassKerning>(kernSubtable)
+				? writeClassSubtable(Get<ClassKerning>(kernSubtable))
+				: writePairSubtable(Get<Array<KerningPair>>(kernSubtable));
+
+			if (kernLookup.extension)
+			{
+				Array<Byte> extension;
+				WriteBE(extension, 1, 2);
+				WriteBE(extension, 2, 2);
+				WriteBE(extension, 8, 4);
+				extension.insert(extension.end(), subtable.begin(), subtable.end());
+				subtable = extension;
+			}
+
+			subtables.push_back(subtable);
+		}
+
+		lookups.push_back(writeLookup(kernLookup.extension ? 9 : 2, subtables));
+	}
+
+	Array<Byte> lookupList;
+	WriteBE(lookupList, U32(lookups.size()), 2);
+	auto lookupOffset = U32(2 + 2 * lookups.size());
+	for (auto& lookup : lookups)
+	{
+		WriteBE(lookupList, lookupOffset, 2);
+		lookupOffset += U32(lookup.size());
+	}
+	for (auto& lookup : lookups)
+	{
+		lookupList.insert(lookupList.end(), lookup.begin(), lookup.end());
+	}
+
+	// A single DFLT script whose default language uses the kern feature.
+	Array<Byte> scriptList;
+	WriteBE(scriptList, 1, 2);
+	WriteBE(scriptList, 0x44464C54, 4);
+	WriteBE(scriptList, 8, 2);
+	WriteBE(scriptList, 4, 2);
+	WriteBE(scriptList, 0, 2);
+	WriteBE(scriptList, 0, 2);
+	WriteBE(scriptList, 0xFFFF, 2);
+	WriteBE(scriptList, 1, 2);
+	WriteBE(scriptList, 0, 2);
+
+	Array<Byte> featureList;
+	WriteBE(featureList, 1, 2);
+	WriteBE(featureList, 0x6B65726E, 4);
+	WriteBE(featureList, 8, 2);
+	WriteBE(featureList, 0, 2);
+	WriteBE(featureList, U32(lookups.size()), 2);
+	for (auto i = 0u; i < lookups.size(); ++i)
+	{
+		WriteBE(featureList, i, 2);
+	}
+
+	Array<Byte> gpos;
+	WriteBE(gpos, 0x00010000, 4);
+	WriteBE(gpos, 10, 2);
+	WriteBE(gpos, U32(10 + scriptList.size()), 2);
+	WriteBE(gpos, U32(10 + scriptList.size() + featureList.size()), 2);
+	gpos.insert(gpos.end(), scriptList.begin(), scriptList.end());
+	gpos.insert(gpos.end(), featureList.begin(), featureList.end());
+	gpos.insert(gpos.end(), lookupList.begin(), lookupList.end());
+
+	return gpos;
+}
@@ -26,8 +26,1285 @@
 #include "OpenSans.hpp"
 #include "TestHelpers.hpp"
 
+#include <random>
+
 using namespace MTTF;
 
+// Builds a collection with two faces that share all the tables of the embedded font.
+auto BuildCollection() -> Array<Byte>
+{
+	auto tableCount = (U32(OpenSans[4]) << 8) | OpenSans[5];
+	auto directorySize = 12 + 16 * tableCount;
+	auto headerSize = 12 + 4 * 2;
+	auto fontBase = headerSize + directorySize;
+
+	auto writeU32 = [](Byte* destination, U32 value)
+	{
+		destination[0] = Byte(value >> 24);
+		destination[1] = Byte(value >> 16);
+		destination[2] = Byte(value >> 8);
+		destination[3] = Byte(value);
+	};
+
+	Array<Byte> collection(fontBase + OpenSansSize);
+	writeU32(collection.data(), 0x74746366);
+	writeU32(collection.data() + 4, 0x00010000);
+	writeU32(collection.data() + 8, 2);
+	writeU32(collection.data() + 12, fontBase);
+	writeU32(collection.data() + 16, headerSize);
+
+	std::copy(OpenSans, OpenSans + OpenSansSize, collection.begin() + fontBase);
+
+	for (auto i = 0u; i < tableCount; ++i)
+	{
+		auto entry = collection.data() + fontBase + 12 + 16 * i;
+		auto offset = (U32(entry[8]) << 24) | (U32(entry[9]) << 16) | (U32(entry[10]) << 8) | entry[11];
+		writeU32(entry + 8, offset + fontBase);
+	}
+
+	std::copy
+	(
+		collection.begin() + fontBase,
+		collection.begin() + fontBase + directorySize,
+		collection.begin() + headerSize
+	);
+
+	return collection;
+}
+
+// Decodes the flags and coordinates of every simple glyph with both the vectorized and the
+// scalar decoders and checks that they agree bit for bit.
+auto CheckSimpleGlyphDecoding(const FontData& fontData, Span<const U8> data) -> B
+{
+	auto readU16 = [&](U32 offset) { return U32((data[offset] << 8) | data[offset + 1]); };
+	auto readU32 = [&](U32 offset) { return (readU16(offset) << 16) | readU16(offset + 2); };
+
+	auto head = fontData.FindTable(FromLE(*(const U32*)"head"));
+	auto loca = fontData.FindTable(FromLE(*(const U32*)"loca"));
+	auto glyf = fontData.FindTable(FromLE(*(const U32*)"glyf"));
+	auto longLoca = readU16(head.offset + 50) != 0;
+
+	auto checkStream = [](Span<const U8> stream, U32 pointCount)
+	{
+		Array<U8> flags(pointCount);
+		Array<U8> scalarFlags(pointCount);
+		Array<TTFPoint> points(pointCount, TTFPoint(0, 0));
+		Array<TTFPoint> scalarPoints(pointCount, TTFPoint(0, 0));
+
+		auto offset = ExpandGlyphFlags(stream, flags);
+		if (offset != ExpandGlyphFlagsScalar(stream, scalarFlags) || flags != scalarFlags)
+		{
+			return false;
+		}
+
+		for (auto axis = 0u; axis < 2; ++axis)
+		{
+			auto coordinates = stream.subspan(offset);
+			auto length = DecodeGlyphCoordinates(coordinates, flags, axis, points);
+			if (length != DecodeGlyphCoordinatesScalar(coordinates, flags, axis, scalarPoints))
+			{
+				return false;
+			}
+			offset += length;
+		}
+
+		for (auto i = 0u; i < pointCount; ++i)
+		{
+			if (points[i].x != scalarPoints[i].x || points[i].y != scalarPoints[i].y)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		auto glyphOffset = glyf.offset +
+			(longLoca ? readU32(loca.offset + 4 * glyphIndex) : 2 * readU16(loca.offset + 2 * glyphIndex));
+		auto nextGlyphOffset = glyf.offset +
+			(longLoca ? readU32(loca.offset + 4 * glyphIndex + 4) : 2 * readU16(loca.offset + 2 * glyphIndex + 2));
+		auto contourCount = I16(readU16(glyphOffset));
+
+		if (glyphOffset == nextGlyphOffset || contourCount <= 0)
+		{
+			continue;
+		}
+
+		auto pointCount = readU16(glyphOffset + 10 + 2 * (contourCount - 1)) + 1;
+		auto instructionsOffset = glyphOffset + 10 + 2 * contourCount;
+
+		// The stream is cut at the end of the glyph so that the vectorized decoders have to
+		// handle the tails without reading past it.
+		auto streamOffset = instructionsOffset + 2 + readU16(instructionsOffset);
+		if (!checkStream(data.subspan(streamOffset, nextGlyphOffset - streamOffset), pointCount))
+		{
+			return false;
+		}
+	}
+
+	// Synthetic streams with long runs of repeated flags, all kinds of deltas and coordinates
+	// that overflow.
+	std::mt19937 generator(7);
+	for (auto iteration = 0u; iteration < 256; ++iteration)
+	{
+		auto pointCount = 1 + generator() % 300;
+		Array<U8> stream;
+		Array<U8> pointFlags;
+
+		while (pointFlags.size() < pointCount)
+		{
+			auto flag = U8(generator() & 0x3F);
+			stream.push_back(flag);
+			auto repeatCount = (flag & 0x08) > 0 ? U8(generator() % (iteration % 2 == 0 ? 4 : 40)) : U8(0);
+			if ((flag & 0x08) > 0)
+			{
+				stream.push_back(repeatCount);
+			}
+			pointFlags.insert(pointFlags.end(), repeatCount + 1, flag);
+		}
+		pointFlags.resize(pointCount);
+
+		for (auto axis = 0u; axis < 2; ++axis)
+		{
+			for (auto flag : pointFlags)
+			{
+				if ((flag & (0x02 << axis)) > 0)
+				{
+					stream.push_back(U8(generator()));
+				}
+				else if ((flag & (0x10 << axis)) == 0)
+				{
+					stream.push_back(U8(generator()));
+					stream.push_back(U8(generator()));
+				}
+			}
+		}
+
+		if (!checkStream(stream, pointCount))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Reads the points, flags and contour ends of a glyph straight from the glyf table. Components
+// of compound glyphs are followed as long as they are only moved, anything else is reported as
+// unsupported by returning false.
+auto DecodeReferencePoints
+(
+	const FontData& fontData,
+	Span<const U8> data,
+	U32 glyphIndex,
+	Array<TTFPoint>& points,
+	Array<U8>& flags,
+	Array<U32>& contourEnds
+) -> B
+{
+	auto readU16 = [&](U32 offset) { return U32((data[offset] << 8) | data[offset + 1]); };
+	auto readU32 = [&](U32 offset) { return (readU16(offset) << 16) | readU16(offset + 2); };
+
+	auto head = fontData.FindTable(FromLE(*(const U32*)"head"));
+	auto loca = fontData.FindTable(FromLE(*(const U32*)"loca"));
+	auto glyf = fontData.FindTable(FromLE(*(const U32*)"glyf"));
+	auto longLoca = readU16(head.offset + 50) != 0;
+
+	auto glyphOffset = glyf.offset +
+		(longLoca ? readU32(loca.offset + 4 * glyphIndex) : 2 * readU16(loca.offset + 2 * glyphIndex));
+	auto nextGlyphOffset = glyf.offset +
+		(longLoca ? readU32(loca.offset + 4 * glyphIndex + 4) : 2 * readU16(loca.offset + 2 * glyphIndex + 2));
+
+	if (glyphOffset == nextGlyphOffset)
+	{
+		return true;
+	}
+
+	auto contourCount = I16(readU16(glyphOffset));
+
+	if (contourCount < 0)
+	{
+		auto offset = glyphOffset + 10;
+		auto componentFlags = 0x20u;
+
+		while ((componentFlags & 0x20) > 0)
+		{
+			componentFlags = readU16(offset);
+			auto componentIndex = readU16(offset + 2);
+			offset += 4;
+
+			// Only moved components, with the offsets given as coordinates.
+			if ((componentFlags & 0x02) == 0 || (componentFlags & (0x08 | 0x40 | 0x80)) > 0)
+			{
+				return false;
+			}
+
+			auto dx = (componentFlags & 0x01) > 0 ? I16(readU16(offset)) : I8(data[offset]);
+			auto dy = (componentFlags & 0x01) > 0 ? I16(readU16(offset + 2)) : I8(data[offset + 1]);
+			offset += (componentFlags & 0x01) > 0 ? 4 : 2;
+
+			auto firstPoint = U32(points.size());
+			if (!DecodeReferencePoints(fontData, data, componentIndex, points, flags, contourEnds))
+			{
+				return false;
+			}
+
+			for (auto i = firstPoint; i < points.size(); ++i)
+			{
+				points[i] = TTFPoint(points[i].x + dx, points[i].y + dy);
+			}
+		}
+
+		return true;
+	}
+
+	auto firstPoint = U32(points.size());
+	for (auto contour = 0; contour < contourCount; ++contour)
+	{
+		contourEnds.push_back(firstPoint + readU16(glyphOffset + 10 + 2 * contour));
+	}
+
+	auto pointCount = contourCount > 0 ? contourEnds.back() + 1 - firstPoint : 0;
+	auto instructionsOffset = glyphOffset + 10 + 2 * contourCount;
+	auto offset = instructionsOffset + 2 + readU16(instructionsOffset);
+
+	while (flags.size() < firstPoint + pointCount)
+	{
+		auto flag = data[offset++];
+		auto repeatCount = (flag & 0x08) > 0 ? data[offset++] : 0;
+		flags.insert(flags.end(), repeatCount + 1, flag);
+	}
+	flags.resize(firstPoint + pointCount);
+	points.resize(firstPoint + pointCount, TTFPoint(0, 0));
+
+	for (auto axis = 0u; axis < 2; ++axis)
+	{
+		auto coordinate = 0;
+
+		for (auto i = firstPoint; i < points.size(); ++i)
+		{
+			if ((flags[i] & (0x02 << axis)) > 0)
+			{
+				auto delta = I32(data[offset++]);
+				coordinate += (flags[i] & (0x10 << axis)) > 0 ? delta : -delta;
+			}
+			else if ((flags[i] & (0x10 << axis)) == 0)
+			{
+				coordinate += I16(readU16(offset));
+				offset += 2;
+			}
+
+			(axis == 0 ? points[i].x : points[i].y) = TTFScalar(coordinate);
+		}
+	}
+
+	return true;
+}
+
+// The per-segment decoding of a contour from before outlines were packed, one curve at a time.
+auto DecodeReferenceContour(Span<const TTFPoint> vertices, Span<const U8> flags, U32 sidx, U32 eidx, Array<TTFCurve>& curves) -> V
+{
+	auto midpoint = [&](U32 a, U32 b)
+	{
+		return TTFPoint
+		(
+			TTFScalar((I32(vertices[a].x) + I32(vertices[b].x)) / 2),
+			TTFScalar((I32(vertices[a].y) + I32(vertices[b].y)) / 2)
+		);
+	};
+	auto onCurve = [&](U32 i) { return (flags[i] & 1u) > 0; };
+
+	auto cidx = sidx;
+
+	if (!onCurve(cidx))
+	{
+		auto startPoint = onCurve(eidx) ? vertices[eidx] : midpoint(cidx, eidx);
+		auto controlPoint = vertices[cidx];
+		cidx += 1;
+		auto endPoint = onCurve(cidx) ? vertices[cidx] : midpoint(cidx - 1, cidx);
+		curves.emplace_back(QuadraticBezierCurve(startPoint, controlPoint, endPoint));
+	}
+
+	while (cidx < eidx)
+	{
+		if (!onCurve(cidx))
+		{
+			auto endPoint = onCurve(cidx + 1) ? vertices[cidx + 1] : midpoint(cidx, cidx + 1);
+			curves.emplace_back(QuadraticBezierCurve(midpoint(cidx - 1, cidx), vertices[cidx], endPoint));
+		}
+		else if (!onCurve(cidx + 1))
+		{
+			auto endPoint = cidx + 1 == eidx
+				? (onCurve(sidx) ? vertices[sidx] : midpoint(sidx, eidx))
+				: (onCurve(cidx + 2) ? vertices[cidx + 2] : midpoint(cidx + 1, cidx + 2));
+			curves.emplace_back(QuadraticBezierCurve(vertices[cidx], vertices[cidx + 1], endPoint));
+			cidx += 1;
+		}
+		else
+		{
+			curves.emplace_back(Line(vertices[cidx], vertices[cidx + 1]));
+		}
+
+		cidx += 1;
+	}
+
+	if (cidx == eidx)
+	{
+		if (!onCurve(eidx))
+		{
+			auto endPoint = onCurve(sidx) ? vertices[sidx] : midpoint(sidx, eidx);
+			curves.emplace_back(QuadraticBezierCurve(midpoint(eidx - 1, eidx), vertices[eidx], endPoint));
+		}
+		else if (onCurve(sidx))
+		{
+			curves.emplace_back(Line(vertices[eidx], vertices[sidx]));
+		}
+	}
+}
+
+auto GetCurvePoints(const TTFCurve& curve) -> Array<TTFPoint>
+{
+	if (HoldsAlternative<Line>(curve))
+	{
+		auto& line = Get<Line>(curve);
+		return { line.startPoint, line.endPoint };
+	}
+
+	if (HoldsAlternative<QuadraticBezierCurve>(curve))
+	{
+		auto& quadratic = Get<QuadraticBezierCurve>(curve);
+		return { quadratic.startPoint, quadratic.controlPoint, quadratic.endPoint };
+	}
+
+	auto& cubic = Get<CubicBezierCurve>(curve);
+	return { cubic.startPoint, cubic.controlPoint0, cubic.controlPoint1, cubic.endPoint };
+}
+
+// Compares the packed outline of every glyph, segment by segment, with the reference decoding.
+// Returns the number of glyphs that were compared.
+auto CheckOutlinesAgainstReference(const FontData& fontData, Span<const U8> data) -> U32
+{
+	auto checkedCount = 0u;
+
+	for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		Array<TTFPoint> points;
+		Array<U8> flags;
+		Array<U32> contourEnds;
+
+		if (!DecodeReferencePoints(fontData, data, glyphIndex, points, flags, contourEnds))
+		{
+			continue;
+		}
+
+		Array<TTFCurve> expectedCurves;
+		auto contourCount = 0u;
+		auto startIndex = 0u;
+
+		for (auto contourEnd : contourEnds)
+		{
+			if (contourEnd > startIndex)
+			{
+				DecodeReferenceContour(points, flags, startIndex, contourEnd, expectedCurves);
+				contourCount += 1;
+			}
+			startIndex = contourEnd + 1;
+		}
+
+		auto outline = fontData.FetchGlyphData(glyphIndex).outline;
+		auto movedOutline = std::move(outline);
+		movedOutline.ShrinkToFit();
+		auto curves = movedOutline.ToCurves();
+
+		if
+		(
+			curves.size() != expectedCurves.size() ||
+			movedOutline.GetSegmentCount() != expectedCurves.size() ||
+			movedOutline.contourEnds.size() != contourCount
+		)
+		{
+			return 0;
+		}
+
+		for (auto i = 0u; i < curves.size(); ++i)
+		{
+			auto curvePoints = GetCurvePoints(curves[i]);
+			auto expectedPoints = GetCurvePoints(expectedCurves[i]);
+
+			if
+			(
+				curves[i].index() != expectedCurves[i].index() ||
+				!std::equal
+				(
+					curvePoints.begin(),
+					curvePoints.end(),
+					expectedPoints.begin(),
+					[](TTFPoint a, TTFPoint b) { return a.x == b.x && a.y == b.y; }
+				)
+			)
+			{
+				return 0;
+			}
+		}
+
+		checkedCount += 1;
+	}
+
+	return checkedCount;
+}
+
+// Builds compound glyphs out of a square and a triangle and checks where their points end up
+// with offsets, scales, rotations, point matching and nested components.
+auto CheckCompoundGlyphs(const FontData& fontData) -> B
+{
+	auto fontBytes = Span<const U8>(OpenSans, OpenSansSize);
+
+	Array<TTFPoint> square = { { 0, 0 }, { 100, 0 }, { 100, 100 }, { 0, 100 } };
+	Array<TTFPoint> triangle = { { 10, 10 }, { 50, 10 }, { 30, 60 } };
+
+	struct Component
+	{
+		U16 flags;
+		U16 glyphIndex;
+		I16 argument1;
+		I16 argument2;
+		// F2Dot14 values, as many as the flags ask for.
+		Array<I16> scales;
+	};
+
+	auto buildCompound = [](const Array<Component>& components)
+	{
+		Array<Byte> glyph;
+		WriteBE(glyph, 0xFFFF, 2);
+		WriteBE(glyph, 0, 8);
+
+		for (auto i = 0u; i < components.size(); ++i)
+		{
+			auto& component = components[i];
+			auto flags = component.flags | (i + 1 < components.size() ? COMPONENT_MORE_COMPONENTS : 0);
+			WriteBE(glyph, flags, 2);
+			WriteBE(glyph, component.glyphIndex, 2);
+			auto argumentSize = (flags & COMPONENT_ARG_1_AND_2_ARE_WORDS) > 0 ? 2 : 1;
+			WriteBE(glyph, U16(component.argument1), argumentSize);
+			WriteBE(glyph, U16(component.argument2), argumentSize);
+			for (auto scale : component.scales)
+			{
+				WriteBE(glyph, U16(scale), 2);
+			}
+		}
+
+		return glyph;
+	};
+
+	constexpr U16 WORDS = COMPONENT_ARG_1_AND_2_ARE_WORDS;
+	constexpr U16 XY = COMPONENT_ARGS_ARE_XY_VALUES;
+
+	Array<Array<Byte>> glyphs =
+	{
+		{},
+		BuildSimpleGlyph({ square }),
+		BuildSimpleGlyph({ triangle }),
+		// Word and byte offsets.
+		buildCompound({ { XY | WORDS, 1, -300, 1000, {} }, { XY, 1, 5, -7, {} } }),
+		// A uniform scale, the offset is not scaled.
+		buildCompound({ { XY | COMPONENT_WE_HAVE_A_SCALE, 1, 30, 40, { 0x2000 } } }),
+		// Separate scales with a scaled offset.
+		buildCompound({ { XY | COMPONENT_WE_HAVE_AN_X_AND_Y_SCALE | COMPONENT_SCALED_COMPONENT_OFFSET, 1, 10, 20, { 0x6000, I16(0xC000) } } }),
+		// A quarter turn.
+		buildCompound({ { XY | WORDS | COMPONENT_WE_HAVE_A_TWO_BY_TWO, 1, 200, 0, { 0, 0x4000, I16(0xC000), 0 } } }),
+		// The first point of the triangle goes on the third point of the square.
+		buildCompound({ { XY, 1, 0, 0, {} }, { 0, 2, 2, 0, {} } }),
+		// A nested compound glyph.
+		buildCompound({ { XY | COMPONENT_ROUND_XY_TO_GRID, 3, 1, 2, {} } }),
+		// A scaled offset that lands between units.
+		buildCompound({ { XY | COMPONENT_WE_HAVE_A_SCALE | COMPONENT_SCALED_COMPONENT_OFFSET | COMPONENT_ROUND_XY_TO_GRID, 1, 3, 5, { 0x2000 } } }),
+	};
+
+	Array<Array<Array<TTFPoint>>> expectedContours =
+	{
+		{ { { -300, 1000 }, { -200, 1000 }, { -200, 1100 }, { -300, 1100 } }, { { 5, -7 }, { 105, -7 }, { 105, 93 }, { 5, 93 } } },
+		{ { { 30, 40 }, { 80, 40 }, { 80, 90 }, { 30, 90 } } },
+		{ { { 15, -20 }, { 165, -20 }, { 165, -120 }, { 15, -120 } } },
+		{ { { 200, 0 }, { 200, 100 }, { 100, 100 }, { 100, 0 } } },
+		{ { { 0, 0 }, { 100, 0 }, { 100, 100 }, { 0, 100 } }, { { 100, 100 }, { 140, 100 }, { 120, 150 } } },
+		{ { { -299, 1002 }, { -199, 1002 }, { -199, 1102 }, { -299, 1102 } }, { { 6, -5 }, { 106, -5 }, { 106, 95 }, { 6, 95 } } },
+		{ { { 2, 3 }, { 52, 3 }, { 52, 53 }, { 2, 53 } } },
+	};
+
+	// FontData only references the bytes so they have to outlive it.
+	auto compoundFont = BuildGlyfFont(fontData, fontBytes, glyphs);
+	FontData compoundFontData;
+	if (compoundFontData.Load(compoundFont) != Error::Success)
+	{
+		return false;
+	}
+
+	for (auto i = 0u; i < expectedContours.size(); ++i)
+	{
+		// Closed contours of lines repeat their first point at the end.
+		Array<TTFPoint> expectedPoints;
+		for (auto& contour : expectedContours[i])
+		{
+			expectedPoints.insert(expectedPoints.end(), contour.begin(), contour.end());
+			expectedPoints.push_back(contour[0]);
+		}
+
+		auto outline = compoundFontData.FetchGlyphData(3 + i).outline;
+
+		if
+		(
+			outline.contourEnds.size() != expectedContours[i].size() ||
+			outline.points.size() != expectedPoints.size() ||
+			!std::equal
+			(
+				expectedPoints.begin(),
+				expectedPoints.end(),
+				outline.points.begin(),
+				[](TTFPoint a, TTFPoint b) { return a.x == b.x && a.y == b.y; }
+			)
+		)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Decodes hand written charstrings that use the curve shorthands, the flex operators, seac and in
+// CFF2 blend, vsindex and FDSelect, and compares the segments with the expected ones.
+auto CheckCffOperators(const FontData& fontData) -> B
+{
+	auto fontBytes = Span<const U8>(OpenSans, OpenSansSize);
+
+	auto charString = [](std::initializer_list<Pair<std::initializer_list<F64>, std::initializer_list<Byte>>> calls)
+	{
+		Array<Byte> bytes;
+		for (auto& [operands, op] : calls)
+		{
+			for (auto operand : operands)
+			{
+				WriteCffNumber(bytes, operand);
+			}
+			bytes.insert(bytes.end(), op.begin(), op.end());
+		}
+		return bytes;
+	};
+
+	using Segments = Array<Array<TTFPoint>>;
+
+	auto checkGlyph = [](const FontData& font, U32 glyphIndex, const Segments& expectedSegments)
+	{
+		auto curves = font.FetchGlyphData(glyphIndex).outline.ToCurves();
+
+		if (curves.size() != expectedSegments.size())
+		{
+			return false;
+		}
+
+		for (auto i = 0u; i < curves.size(); ++i)
+		{
+			auto points = GetCurvePoints(curves[i]);
+			auto& expectedPoints = expectedSegments[i];
+
+			if
+			(
+				points.size() != expectedPoints.size() ||
+				!std::equal
+				(
+					points.begin(),
+					points.end(),
+					expectedPoints.begin(),
+					[](TTFPoint a, TTFPoint b) { return a.x == b.x && a.y == b.y; }
+				)
+			)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	Array<Array<Byte>> charStrings =
+	{
+		charString({ { {}, { 14 } } }),
+		charString({ { { 0, 0 }, { 21 } }, { { 10, 20, 30, 40, 50, 60, 70, 80, 90 }, { 27 } }, { {}, { 14 } } }),
+		charString({ { { 0, 0 }, { 21 } }, { { 5, 10, 20, 30, 40 }, { 26 } }, { {}, { 14 } } }),
+		charString({ { { 0, 0 }, { 21 } }, { { 10, 20, 30, 40, 50, 60, 70, 80, 90 }, { 31 } }, { {}, { 14 } } }),
+		charString({ { { 0, 0 }, { 21 } }, { { 10, 20, 30, 40, 50, 60, 70, 80 }, { 30 } }, { {}, { 14 } } }),
+		charString({ { { 0, 0 }, { 21 } }, { { 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 110, 120, 50 }, { 12, 35 } }, { {}, { 14 } } }),
+		charString({ { { 0, 0 }, { 21 } }, { { 10, 20, 30, 40, 50, 60, 70 }, { 12, 34 } }, { {}, { 14 } } }),
+		charString({ { { 0, 0 }, { 21 } }, { { 10, 5, 20, 15, 30, 40, 50, -5, 60 }, { 12, 36 } }, { {}, { 14 } } }),
+		charString({ { { 0, 0 }, { 21 } }, { { 10, 5, 20, 10, 30, 5, 40, -5, 50, -10, 60 }, { 12, 37 } }, { {}, { 14 } } }),
+		charString({ { { 0, 0 }, { 21 } }, { { 5, 10, 10, 20, 5, 30, -5, 40, -10, 50, 60 }, { 12, 37 } }, { {}, { 14 } } }),
+		// A bump whose control points reach higher than the curve.
+		charString({ { { 0, 0 }, { 21 } }, { { 0, 100, 100, 0, 0, -100 }, { 8 } }, { {}, { 14 } } }),
+		// An accented glyph built with seac, with a width in front.
+		charString({ { { 0, 0 }, { 21 } }, { { 100, 0 }, { 5 } }, { { 500, 0, 0, 65, 66 }, { 14 } } }),
+	};
+
+	Array<Segments> expectedGlyphs =
+	{
+		{},
+		{
+			{ { 0, 0 }, { 20, 10 }, { 50, 50 }, { 100, 50 } },
+			{ { 100, 50 }, { 160, 50 }, { 230, 130 }, { 320, 130 } },
+			{ { 320, 130 }, { 0, 0 } }
+		},
+		{ { { 0, 0 }, { 5, 10 }, { 25, 40 }, { 25, 80 } }, { { 25, 80 }, { 0, 0 } } },
+		{
+			{ { 0, 0 }, { 10, 0 }, { 30, 30 }, { 30, 70 } },
+			{ { 30, 70 }, { 30, 120 }, { 90, 190 }, { 170, 280 } },
+			{ { 170, 280 }, { 0, 0 } }
+		},
+		{
+			{ { 0, 0 }, { 0, 10 }, { 20, 40 }, { 60, 40 } },
+			{ { 60, 40 }, { 110, 40 }, { 170, 110 }, { 170, 190 } },
+			{ { 170, 190 }, { 0, 0 } }
+		},
+		{
+			{ { 0, 0 }, { 10, 20 }, { 40, 60 }, { 90, 120 } },
+			{ { 90, 120 }, { 160, 200 }, { 250, 300 }, { 360, 420 } },
+			{ { 360, 420 }, { 0, 0 } }
+		},
+		{
+			{ { 0, 0 }, { 10, 0 }, { 30, 30 }, { 70, 30 } },
+			{ { 70, 30 }, { 120, 30 }, { 180, 0 }, { 250, 0 } },
+			{ { 250, 0 }, { 0, 0 } }
+		},
+		{
+			{ { 0, 0 }, { 10, 5 }, { 30, 20 }, { 60, 20 } },
+			{ { 60, 20 }, { 100, 20 }, { 150, 15 }, { 210, 0 } },
+			{ { 210, 0 }, { 0, 0 } }
+		},
+		{
+			{ { 0, 0 }, { 10, 5 }, { 30, 15 }, { 60, 20 } },
+			{ { 60, 20 }, { 100, 15 }, { 150, 5 }, { 210, 0 } },
+			{ { 210, 0 }, { 0, 0 } }
+		},
+		{
+			{ { 0, 0 }, { 5, 10 }, { 15, 30 }, { 20, 60 } },
+			{ { 20, 60 }, { 15, 100 }, { 5, 150 }, { 0, 210 } },
+			{ { 0, 210 }, { 0, 0 } }
+		},
+		{ { { 0, 0 }, { 0, 100 }, { 100, 100 }, { 100, 0 } }, { { 100, 0 }, { 0, 0 } } },
+		{},
+	};
+
+	// FontData only references the bytes so they have to outlive it.
+	auto cffFont = WriteCffFont(fontData, fontBytes, charStrings, {}, {});
+	FontData cffFontData;
+	if (cffFontData.Load(cffFont) != Error::Success)
+	{
+		return false;
+	}
+
+	for (auto glyphIndex = 0u; glyphIndex < expectedGlyphs.size(); ++glyphIndex)
+	{
+		if (!checkGlyph(cffFontData, glyphIndex, expectedGlyphs[glyphIndex]))
+		{
+			return false;
+		}
+	}
+
+	// The bounding box follows the curve, not its control points.
+	auto bump = cffFontData.FetchGlyphData(10).boundingBoxDiagonal;
+	if (bump.startPoint.x != 0 || bump.startPoint.y != 0 || bump.endPoint.x != 100 || bump.endPoint.y != 75)
+	{
+		return false;
+	}
+
+	// The first two glyphs use a font dict with one region, the others one with three regions.
+	// The last glyph switches back to the single region with vsindex. A wrong region count
+	// leaves extra operands that show up as extra lines or no line at all.
+	Array<Array<Byte>> cff2CharStrings =
+	{
+		charString({ { { 10, 20 }, { 21 } }, { { 30, 40 }, { 5 } } }),
+		charString({ { { 10, 20 }, { 21 } }, { { 30, 40, 1, 2, 2 }, { 16 } }, { {}, { 5 } } }),
+		charString({ { { 10, 20 }, { 21 } }, { { 30, 40, 1, 2, 3, 4, 5, 6, 2 }, { 16 } }, { {}, { 5 } } }),
+		charString({ { { 0 }, { 15 } }, { { 10, 20 }, { 21 } }, { { 30, 40, 1, 2, 2 }, { 16 } }, { {}, { 5 } } }),
+	};
+
+	FontData cff2FontData;
+	auto cff2Font = WriteCff2Font(fontData, fontBytes, cff2CharStrings, { 0, 1 }, { { 0, 0 }, { 2, 1 } }, { 1, 3 });
+	if (cff2FontData.Load(cff2Font) != Error::Success)
+	{
+		return false;
+	}
+
+	for (auto glyphIndex = 0u; glyphIndex < cff2CharStrings.size(); ++glyphIndex)
+	{
+		if (!checkGlyph(cff2FontData, glyphIndex, { { { 10, 20 }, { 40, 60 } }, { { 40, 60 }, { 10, 20 } } }))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Offset of the table directory entry of the given table in a single font file.
+auto FindTableEntry(const Array<Byte>& font, const C* tag) -> U32
+{
+	auto tableCount = (U32(font[4]) << 8) | font[5];
+
+	for (auto i = 0u; i < tableCount; ++i)
+	{
+		if (std::equal(tag, tag + 4, font.begin() + 12 + 16 * i))
+		{
+			return 12 + 16 * i;
+		}
+	}
+
+	return 0;
+}
+
+auto ReadBE(const Array<Byte>& bytes, U32 offset, U32 size) -> U32
+{
+	auto value = 0u;
+	for (auto i = 0u; i < size; ++i)
+	{
+		value = (value << 8) | bytes[offset + i];
+	}
+	return value;
+}
+
+// Loads broken copies of the embedded font with validation and checks that each is rejected.
+auto CheckValidation() -> B
+{
+	LoadOptions options;
+	options.validate = true;
+
+	auto loadBroken = [&](auto&& breakFont) -> Error
+	{
+		Array<Byte> font(OpenSans, OpenSans + OpenSansSize);
+		breakFont(font);
+		FontData brokenFontData;
+		return brokenFontData.Load(font, options);
+	};
+
+	auto tableOffset = [](const Array<Byte>& font, const C* tag) { return ReadBE(font, FindTableEntry(font, tag) + 8, 4); };
+
+	auto tooManyTables = loadBroken([](Array<Byte>& font) { font[4] = 0xFF; });
+	auto glyfPastTheEnd = loadBroken([](Array<Byte>& font) { font[FindTableEntry(font, "glyf") + 12] = 0x7F; });
+	auto shortHead = loadBroken([](Array<Byte>& font) { font[FindTableEntry(font, "head") + 15] = 20; });
+
+	// The embedded font uses short loca offsets.
+	auto locaNotMonotonic = loadBroken
+	(
+		[&](Array<Byte>& font)
+		{
+			auto loca = tableOffset(font, "loca");
+			font[loca + 2 * 10] = 0xFF;
+		}
+	);
+	auto locaPastGlyf = loadBroken
+	(
+		[&](Array<Byte>& font)
+		{
+			auto loca = tableOffset(font, "loca");
+			auto glyphCount = ReadBE(font, tableOffset(font, "maxp") + 4, 2);
+			font[loca + 2 * glyphCount] = 0xFF;
+		}
+	);
+	auto instructionsPastGlyph = loadBroken
+	(
+		[&](Array<Byte>& font)
+		{
+			// Glyph 36 is 'A', a simple glyph with a single contour.
+			auto glyph = tableOffset(font, "glyf") + 2 * ReadBE(font, tableOffset(font, "loca") + 2 * 36, 2);
+			auto contourCount = ReadBE(font, glyph, 2);
+			font[glyph + 10 + 2 * contourCount] = 0xFF;
+		}
+	);
+	auto badCmapSearch = loadBroken
+	(
+		[&](Array<Byte>& font)
+		{
+			auto cmap = tableOffset(font, "cmap");
+			auto subtableCount = ReadBE(font, cmap + 2, 2);
+
+			// Breaks the rangeShift of every format 4 subtable.
+			for (auto i = 0u; i < subtableCount; ++i)
+			{
+				auto subtable = cmap + ReadBE(font, cmap + 4 + 8 * i + 4, 4);
+				if (ReadBE(font, subtable, 2) == 4)
+				{
+					font[subtable + 12] = 0x7F;
+				}
+			}
+		}
+	);
+
+	return
+		tooManyTables == Error::InvalidTableDirectory &&
+		glyfPastTheEnd == Error::InvalidTableDirectory &&
+		shortHead == Error::InvalidTableLength &&
+		locaNotMonotonic == Error::InvalidLocaTable &&
+		locaPastGlyf == Error::InvalidLocaTable &&
+		instructionsPastGlyph == Error::InvalidGlyphData &&
+		badCmapSearch == Error::InvalidCmapTable;
+}
+
+// Maps random text encoded as UTF-8 and UTF-16 to glyphs and checks them against the glyphs of
+// the codepoints, with malformed sequences mapped to the replacement glyph.
+auto CheckTextDecoding(const FontData& fontData) -> B
+{
+	auto replacementGlyph = fontData.GetCharIndex(REPLACEMENT_CHARACTER);
+
+	// Long ASCII runs so the SIMD blocks get used, broken by codepoints of every UTF-8 length.
+	std::mt19937 generator(7);
+	std::uniform_int_distribution<I32> runDistribution(0, 70);
+	std::uniform_int_distribution<I32> asciiDistribution(0, 0x7F);
+	std::uniform_int_distribution<I32> otherDistribution(0x80, 0x10FFFF);
+	Array<I32> codepoints;
+	while (codepoints.size() < 5000)
+	{
+		for (auto i = runDistribution(generator); i > 0; --i)
+		{
+			codepoints.push_back(asciiDistribution(generator));
+		}
+
+		auto codepoint = otherDistribution(generator);
+		codepoints.push_back(codepoint >= 0xD800 && codepoint <= 0xDFFF ? 0x142 : codepoint);
+	}
+
+	Array<U8> utf8;
+	Array<U16> utf16;
+	for (auto codepoint : codepoints)
+	{
+		if (codepoint < 0x80)
+		{
+			utf8.push_back(U8(codepoint));
+		}
+		else if (codepoint < 0x800)
+		{
+			utf8.insert(utf8.end(), { U8(0xC0 | (codepoint >> 6)), U8(0x80 | (codepoint & 0x3F)) });
+		}
+		else if (codepoint < 0x10000)
+		{
+			utf8.insert(utf8.end(), { U8(0xE0 | (codepoint >> 12)), U8(0x80 | ((codepoint >> 6) & 0x3F)), U8(0x80 | (codepoint & 0x3F)) });
+		}
+		else
+		{
+			utf8.insert
+			(
+				utf8.end(),
+				{ U8(0xF0 | (codepoint >> 18)), U8(0x80 | ((codepoint >> 12) & 0x3F)), U8(0x80 | ((codepoint >> 6) & 0x3F)), U8(0x80 | (codepoint & 0x3F)) }
+			);
+		}
+
+		if (codepoint < 0x10000)
+		{
+			utf16.push_back(U16(codepoint));
+		}
+		else
+		{
+			utf16.push_back(U16(0xD800 + ((codepoint - 0x10000) >> 10)));
+			utf16.push_back(U16(0xDC00 + ((codepoint - 0x10000) & 0x3FF)));
+		}
+	}
+
+	Array<U32> expectedGlyphs(codepoints.size());
+	fontData.GetCharIndices(codepoints, expectedGlyphs);
+
+	Array<U32> glyphs(codepoints.size() + 1);
+	auto utf8Mapping = fontData.GetCharIndicesUtf8(utf8, glyphs);
+	if
+	(
+		utf8Mapping.unitCount != utf8.size() ||
+		utf8Mapping.glyphCount != codepoints.size() ||
+		!std::equal(expectedGlyphs.begin(), expectedGlyphs.end(), glyphs.begin())
+	)
+	{
+		return false;
+	}
+
+	std::fill(glyphs.begin(), glyphs.end(), 0);
+	auto utf16Mapping = fontData.GetCharIndicesUtf16(utf16, glyphs);
+	if
+	(
+		utf16Mapping.unitCount != utf16.size() ||
+		utf16Mapping.glyphCount != codepoints.size() ||
+		!std::equal(expectedGlyphs.begin(), expectedGlyphs.end(), glyphs.begin())
+	)
+	{
+		return false;
+	}
+
+	// Stops after the last glyph that fits.
+	auto truncatedMapping = fontData.GetCharIndicesUtf8(utf8, Span<U32>(glyphs.data(), 100));
+	auto truncatedUnits = 0u;
+	for (auto i = 0u; i < 100; ++i)
+	{
+		truncatedUnits += codepoints[i] < 0x80 ? 1 : codepoints[i] < 0x800 ? 2 : codepoints[i] < 0x10000 ? 3 : 4;
+	}
+	if (truncatedMapping.glyphCount != 100 || truncatedMapping.unitCount != truncatedUnits)
+	{
+		return false;
+	}
+
+	// An overlong '/', an encoded surrogate, a stray continuation byte and a truncated sequence.
+	auto invalidMapping = fontData.GetCharIndicesUtf8("a\xC0\xAF" "b\xED\xA0\x80" "c\x80" "d\xE2\x82", glyphs);
+	Array<I32> invalidExpected = { 'a', -1, -1, 'b', -1, -1, -1, 'c', -1, 'd', -1, -1 };
+	if (invalidMapping.glyphCount != invalidExpected.size())
+	{
+		return false;
+	}
+
+	for (auto i = 0u; i < invalidExpected.size(); ++i)
+	{
+		if (glyphs[i] != (invalidExpected[i] < 0 ? replacementGlyph : fontData.GetCharIndex(invalidExpected[i])))
+		{
+			return false;
+		}
+	}
+
+	Array<U16> invalidUtf16 = { 0xD800, 'a', 0xDC00, 0xD83D, 0xDE00, 0xDBFF };
+	auto invalidUtf16Mapping = fontData.GetCharIndicesUtf16(invalidUtf16, glyphs);
+	return
+		invalidUtf16Mapping.unitCount == 6 &&
+		invalidUtf16Mapping.glyphCount == 5 &&
+		glyphs[0] == replacementGlyph &&
+		glyphs[1] == fontData.GetCharIndex('a') &&
+		glyphs[2] == replacementGlyph &&
+		glyphs[3] == fontData.GetCharIndex(0x1F600) &&
+		glyphs[4] == replacementGlyph;
+}
+
+// Swaps the cmap for a format 12 one whose groups leave gaps, both below the first group and
+// past the last one, and checks the batched lookups against the single ones.
+auto CheckFormat12Cmap(const FontData& fontData) -> B
+{
+	auto fontBytes = Span<const U8>(OpenSans, OpenSansSize);
+
+	// startCodepoint, endCodepoint and startGlyphId of each group.
+	StaticArray<U32, 12> groups =
+	{
+		0x41, 0x5A, 36,
+		0x61, 0x7A, 68,
+		0x100, 0x17F, 200,
+		0x1F600, 0x1F64F, 400
+	};
+
+	Array<Byte> cmap;
+	WriteBE(cmap, 0, 2);
+	WriteBE(cmap, 1, 2);
+	WriteBE(cmap, 3, 2);
+	WriteBE(cmap, 10, 2);
+	WriteBE(cmap, 12, 4);
+	WriteBE(cmap, 12, 2);
+	WriteBE(cmap, 0, 2);
+	WriteBE(cmap, 16 + 4 * groups.size(), 4);
+	WriteBE(cmap, 0, 4);
+	WriteBE(cmap, groups.size() / 3, 4);
+	for (auto value : groups)
+	{
+		WriteBE(cmap, value, 4);
+	}
+
+	auto tables = CopyTables
+	(
+		fontData,
+		fontBytes,
+		{ GLYF_TAG_LE, HEAD_TAG_LE, HHEA_TAG_LE, HMTX_TAG_LE, LOCA_TAG_LE, MAXP_TAG_LE, NAME_TAG_LE }
+	);
+	tables.emplace_back(CMAP_TAG_LE, cmap);
+	auto font = WriteFont(0x00010000, tables);
+
+	FontData format12FontData;
+	if (format12FontData.Load(font) != Error::Success)
+	{
+		return false;
+	}
+
+	for (auto group = 0u; group < groups.size(); group += 3)
+	{
+		auto first = groups[group];
+		auto last = groups[group + 1];
+		auto glyph = groups[group + 2];
+		if
+		(
+			format12FontData.GetCharIndex(first) != glyph ||
+			format12FontData.GetCharIndex(last) != glyph + last - first ||
+			format12FontData.GetCharIndex(first - 1) != 0 ||
+			format12FontData.GetCharIndex(last + 1) != 0
+		)
+		{
+			return false;
+		}
+	}
+
+	// Sorted so that consecutive codepoints keep landing in the same gap.
+	Array<I32> codepoints;
+	for (auto codepoint = -8; codepoint < 0x20000; codepoint += 1 + (codepoint > 0x200) * 97)
+	{
+		codepoints.push_back(codepoint);
+	}
+	codepoints.push_back(0x7FFFFFFF);
+
+	Array<U32> glyphs(codepoints.size());
+	format12FontData.GetCharIndices(codepoints, glyphs);
+
+	for (auto i = 0u; i < codepoints.size(); ++i)
+	{
+		if (glyphs[i] != format12FontData.GetCharIndex(codepoints[i]))
+		{
+			return false;
+		}
+	}
+
+	return CheckTextDecoding(format12FontData);
+}
+
+// Lays out a run spanning several cmap blocks and checks the pen positions and bounding boxes
+// against the ones computed glyph by glyph.
+auto CheckLayout(const FontData& fontData) -> B
+{
+	auto pixelHeight = 24.f;
+	auto scale = pixelHeight / (F32(fontData.ascent) - fontData.descent);
+
+	// Long enough to span several cmap blocks.
+	std::u32string_view sample = U"AVAWA To, iij. \u0142\u4E00";
+	Array<I32> text;
+	for (auto i = 0; i < 200; ++i)
+	{
+		text.push_back(I32(sample[i % sample.size()]));
+	}
+
+	Array<PositionedGlyph> glyphs(text.size() + 1);
+	auto layout = LayoutRun(fontData, text, pixelHeight, glyphs);
+
+	if (layout.glyphCount != text.size())
+	{
+		return false;
+	}
+
+	auto penX = 0.f;
+	for (auto i = 0u; i < text.size(); ++i)
+	{
+		auto glyphIndex = fontData.GetCharIndex(text[i]);
+		if (i > 0)
+		{
+			penX += fontData.GetKerning(glyphs[i - 1].glyphIndex, glyphIndex) * scale;
+		}
+
+		auto boundingBox = fontData.FetchGlyphData(glyphIndex).boundingBoxDiagonal;
+		auto& glyph = glyphs[i];
+
+		if
+		(
+			glyph.glyphIndex != glyphIndex ||
+			std::abs(glyph.x - penX) > 1e-3f ||
+			std::abs(glyph.minX - (penX + boundingBox.startPoint.x * scale)) > 1e-3f ||
+			std::abs(glyph.minY - boundingBox.startPoint.y * scale) > 1e-3f ||
+			std::abs(glyph.maxX - (penX + boundingBox.endPoint.x * scale)) > 1e-3f ||
+			std::abs(glyph.maxY - boundingBox.endPoint.y * scale) > 1e-3f
+		)
+		{
+			return false;
+		}
+
+		penX += fontData.GetAdvanceWidth(glyphIndex) * scale;
+	}
+
+	if (std::abs(layout.advance - penX) > 1e-3f)
+	{
+		return false;
+	}
+
+	// Only as many glyphs as fit in the output are laid out.
+	auto truncated = LayoutRun(fontData, text, pixelHeight, Span<PositionedGlyph>(glyphs.data(), 3));
+	auto truncatedAdvance = glyphs[2].x + fontData.GetAdvanceWidth(glyphs[2].glyphIndex) * scale;
+	return truncated.glyphCount == 3 && std::abs(truncated.advance - truncatedAdvance) < 1e-3f;
+}
+
+// The kerning of a pair the way a shaper applies the lookups. Within a lookup the first
+// subtable that covers the left glyph and, for listed pairs, also lists the right one gives the
+// value. The values of the lookups add up.
+auto ResolveGposKerning(const Array<GposKernLookup>& lookups, U16 left, U16 right) -> I16
+{
+	auto value = 0;
+
+	for (auto& lookup : lookups)
+	{
+		for (auto& subtable : lookup.subtables)
+		{
+			if (HoldsAlternative<ClassKerning>(subtable))
+			{
+				auto& classes = Get<ClassKerning>(subtable);
+				auto leftClass = classes.leftClasses.find(left);
+				if (leftClass != classes.leftClasses.end())
+				{
+					auto rightClass = classes.rightClasses.find(right);
+					auto rightClassIndex = rightClass != classes.rightClasses.end() ? rightClass->second : 0;
+					value += classes.values[leftClass->second * classes.rightClassCount + rightClassIndex];
+					break;
+				}
+			}
+			else
+			{
+				auto& subtablePairs = Get<Array<KerningPair>>(subtable);
+				auto pair = std::find_if
+				(
+					subtablePairs.begin(),
+					subtablePairs.end(),
+					[&](const KerningPair& pair) { return pair.leftGlyph == left && pair.rightGlyph == right; }
+				);
+				if (pair != subtablePairs.end())
+				{
+					value += pair->value;
+					break;
+				}
+			}
+		}
+	}
+
+	return I16(value);
+}
+
+// Compiles the kerning of fonts with a kern table and with GPOS and compares every pair of the
+// glyphs involved with the values expected from the tables.
+auto CheckKerning(const FontData& fontData) -> B
+{
+	auto fontBytes = Span<const U8>(OpenSans, OpenSansSize);
+
+	// Uppercase letters on the left and lowercase ones on the right.
+	Array<KerningPair> pairs;
+	for (U16 left = 36; left < 62; left += 3)
+	{
+		for (U16 right = 68; right < 94; right += 5)
+		{
+			pairs.push_back(KerningPair{ left, right, I16(left * 7 - right * 11) });
+		}
+	}
+
+	ClassKerning classes;
+	classes.leftClassCount = 3;
+	classes.rightClassCount = 4;
+	for (U16 glyph = 30; glyph < 62; ++glyph)
+	{
+		classes.leftClasses[glyph] = glyph % 3;
+	}
+	for (U16 glyph = 68; glyph < 94; glyph += 2)
+	{
+		classes.rightClasses[glyph] = 1 + glyph % 3;
+	}
+	for (auto i = 0; i < 12; ++i)
+	{
+		classes.values.push_back(I16(i * 13 - 70));
+	}
+
+	// Added on top of some of the pairs and of some of the class kerning by the second lookup.
+	Array<KerningPair> extraPairs(pairs.begin(), pairs.begin() + 10);
+	extraPairs.insert(extraPairs.end(), { { 31, 70, 0 }, { 32, 72, 0 }, { 58, 90, 0 } });
+	for (auto& pair : extraPairs)
+	{
+		pair.value = 5;
+	}
+
+	// The third lookup lists class subtables before a pair one. The first classes covering a left
+	// glyph win, even for pairs the pair subtable lists.
+	ClassKerning shadowingClasses;
+	shadowingClasses.leftClassCount = 2;
+	shadowingClasses.rightClassCount = 2;
+	for (U16 glyph = 40; glyph < 50; ++glyph)
+	{
+		shadowingClasses.leftClasses[glyph] = glyph % 2;
+	}
+	shadowingClasses.rightClasses[75] = 1;
+	shadowingClasses.values = { 1, 2, 3, 4 };
+	// Partly shadowed by the classes before it.
+	ClassKerning overlappingClasses;
+	overlappingClasses.leftClassCount = 1;
+	overlappingClasses.rightClassCount = 1;
+	for (U16 glyph = 46; glyph < 54; ++glyph)
+	{
+		overlappingClasses.leftClasses[glyph] = 0;
+	}
+	overlappingClasses.values = { 7 };
+	Array<KerningPair> shadowedPairs = { { 40, 75, 100 }, { 45, 75, 100 }, { 52, 75, 100 }, { 56, 75, 100 }, { 56, 76, -100 } };
+
+	Array<GposKernLookup> lookups =
+	{
+		GposKernLookup{ .subtables = { pairs, classes } },
+		GposKernLookup{ .subtables = { extraPairs }, .extension = true },
+		GposKernLookup{ .subtables = { shadowingClasses, overlappingClasses, shadowedPairs } },
+	};
+
+	auto tables = CopyTables
+	(
+		fontData,
+		fontBytes,
+		{ CMAP_TAG_LE, GLYF_TAG_LE, HEAD_TAG_LE, HHEA_TAG_LE, HMTX_TAG_LE, LOCA_TAG_LE, MAXP_TAG_LE, NAME_TAG_LE }
+	);
+	tables.emplace_back(KERN_TAG_LE, BuildKernTable(pairs));
+	auto kernFont = WriteFont(0x00010000, tables);
+	tables.emplace_back(GPOS_TAG_LE, BuildGposTable(lookups));
+	auto gposFont = WriteFont(0x00010000, tables);
+
+	LoadOptions options;
+	options.compileKerning = true;
+	FontData kernFontData;
+	FontData gposFontData;
+	FontData uncompiledFontData;
+
+	if
+	(
+		kernFontData.Load(kernFont, options) != Error::Success ||
+		gposFontData.Load(gposFont, options) != Error::Success ||
+		uncompiledFontData.Load(gposFont) != Error::Success ||
+		kernFontData.GetCompiledKerning().IsEmpty() ||
+		!uncompiledFontData.GetCompiledKerning().IsEmpty()
+	)
+	{
+		return false;
+	}
+
+	// The glyph ranges of the coverage and class definitions are clamped even when maxp claims
+	// there are no glyphs at all.
+	auto glyphlessFont = gposFont;
+	auto maxp = ReadBE(glyphlessFont, FindTableEntry(glyphlessFont, "maxp") + 8, 4);
+	glyphlessFont[maxp + 4] = 0;
+	glyphlessFont[maxp + 5] = 0;
+	FontData glyphlessFontData;
+	if (glyphlessFontData.Load(glyphlessFont, options) != Error::Success || glyphlessFontData.GetKerning(36, 70) != 0)
+	{
+		return false;
+	}
+
+	Map<U32, I16> expectedPairs;
+	for (auto& pair : pairs)
+	{
+		expectedPairs[(U32(pair.leftGlyph) << 16) | pair.rightGlyph] = pair.value;
+	}
+
+	for (auto left = 0u; left < 100; ++left)
+	{
+		for (auto right = 0u; right < 100; ++right)
+		{
+			auto pair = expectedPairs.find((left << 16) | right);
+			auto kernValue = pair != expectedPairs.end() ? pair->second : I16(0);
+			auto gposValue = ResolveGposKerning(lookups, U16(left), U16(right));
+
+			if
+			(
+				kernFontData.GetKerning(left, right) != kernValue ||
+				gposFontData.GetKerning(left, right) != gposValue ||
+				uncompiledFontData.GetKerning(left, right) != 0
+			)
+			{
+				return false;
+			}
+		}
+	}
+
+	return gposFontData.GetKerning(36, gposFontData.numberOfGlyphs) == 0 && CheckLayout(gposFontData);
+}
+
 auto main() -> I32
 {
 	FontData fontData;
@@ -38,4 +1315,398 @@ auto main() -> I32
 	}
 	auto glyphData = fontData.FetchGlyphDataForCodepoint(75);
 	WriteToSVG(glyphData);
+
+	// The components of the embedded font are only moved so every glyph gets compared.
+	if (CheckOutlinesAgainstReference(fontData, Span<const U8>(OpenSans, OpenSansSize)) != fontData.numberOfGlyphs)
+	{
+		return -1;
+	}
+
+	if (!CheckSimpleGlyphDecoding(fontData, Span<const U8>(OpenSans, OpenSansSize)))
+	{
+		return -1;
+	}
+
+	if (fontData.FetchGlyphDataForCodepoint(0xE9).outline.GetSegmentCount() == 0 || !CheckCompoundGlyphs(fontData))
+	{
+		return -1;
+	}
+
+	FontData cachedFontData;
+	LoadOptions cacheOptions;
+	cacheOptions.cacheComponentOutlines = true;
+	if
+	(
+		cachedFontData.Load(Span<const U8>(OpenSans, OpenSansSize), cacheOptions) != Error::Success ||
+		cachedFontData.GetComponentOutlineCache() == nullptr
+	)
+	{
+		return -1;
+	}
+
+	for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		auto outline = fontData.FetchGlyphData(glyphIndex).outline;
+		auto cachedOutline = cachedFontData.FetchGlyphData(glyphIndex).outline;
+
+		if
+		(
+			outline.points.size() != cachedOutline.points.size() ||
+			!std::equal(outline.commands.begin(), outline.commands.end(), cachedOutline.commands.begin(), cachedOutline.commands.end())
+		)
+		{
+			return -1;
+		}
+
+		for (auto i = 0u; i < outline.points.size(); ++i)
+		{
+			if (outline.points[i].x != cachedOutline.points[i].x || outline.points[i].y != cachedOutline.points[i].y)
+			{
+				return -1;
+			}
+		}
+	}
+
+	if (!CheckCffOperators(fontData))
+	{
+		return -1;
+	}
+
+	// The CFF version must decode to the same outlines with the quadratic curves turned into cubic ones.
+	auto cffFontBytes = BuildCffFont(fontData, Span<const U8>(OpenSans, OpenSansSize));
+	FontData cffFontData;
+	FontData cachedCffFontData;
+	LoadOptions cffOptions;
+	cffOptions.cacheCffSubroutines = true;
+	cffOptions.cacheCffBoundingBoxes = true;
+	if
+	(
+		cffFontData.Load(cffFontBytes) != Error::Success ||
+		cachedCffFontData.Load(cffFontBytes, cffOptions) != Error::Success ||
+		cffFontData.GetCffSubroutineCache() != nullptr ||
+		cachedCffFontData.GetCffSubroutineCache() == nullptr ||
+		cffFontData.numberOfGlyphs != fontData.numberOfGlyphs
+	)
+	{
+		return -1;
+	}
+
+	// Flattens the segments of an outline into their points with the quadratic curves raised
+	// to the cubic ones the CFF builder writes.
+	auto collectSegmentPoints = [](const Outline& outline)
+	{
+		Array<TTFPoint> segmentPoints;
+		outline.ForEachSegment
+		(
+			[&](const auto& segment)
+			{
+				using TSegment = std::decay_t<decltype(segment)>;
+				if constexpr (std::is_same_v<TSegment, QuadraticBezierCurve>)
+				{
+					auto elevate = [&](TTFPoint point)
+					{
+						return TTFPoint
+						(
+							TTFScalar(std::round((point.x + 2.0 * segment.controlPoint.x) / 3.0)),
+							TTFScalar(std::round((point.y + 2.0 * segment.controlPoint.y) / 3.0))
+						);
+					};
+
+					segmentPoints.insert
+					(
+						segmentPoints.end(),
+						{ segment.startPoint, elevate(segment.startPoint), elevate(segment.endPoint), segment.endPoint }
+					);
+				}
+				else if constexpr (std::is_same_v<TSegment, CubicBezierCurve>)
+				{
+					segmentPoints.insert
+					(
+						segmentPoints.end(),
+						{ segment.startPoint, segment.controlPoint0, segment.controlPoint1, segment.endPoint }
+					);
+				}
+				else
+				{
+					segmentPoints.insert(segmentPoints.end(), { segment.startPoint, segment.endPoint });
+				}
+			}
+		);
+		return segmentPoints;
+	};
+
+	for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		auto outline = fontData.FetchGlyphData(glyphIndex).outline;
+		auto expectedPoints = collectSegmentPoints(outline);
+
+		for (auto* font : { &cffFontData, &cachedCffFontData })
+		{
+			auto cffOutline = font->FetchGlyphData(glyphIndex).outline;
+			auto cffPoints = collectSegmentPoints(cffOutline);
+
+			if
+			(
+				cffOutline.contourEnds.size() != outline.contourEnds.size() ||
+				cffOutline.GetSegmentCount() != outline.GetSegmentCount() ||
+				cffPoints.size() != expectedPoints.size()
+			)
+			{
+				return -1;
+			}
+
+			for (auto i = 0u; i < cffPoints.size(); ++i)
+			{
+				if (cffPoints[i].x != expectedPoints[i].x || cffPoints[i].y != expectedPoints[i].y)
+				{
+					return -1;
+				}
+			}
+		}
+
+		// The cached bounding boxes match the ones of the decoded outlines.
+		auto boundingBox = cffFontData.GetGlyphBoundingBox(glyphIndex);
+		auto cachedBoundingBox = cachedCffFontData.GetGlyphBoundingBox(glyphIndex);
+		if
+		(
+			cachedBoundingBox.startPoint.x != boundingBox.startPoint.x ||
+			cachedBoundingBox.startPoint.y != boundingBox.startPoint.y ||
+			cachedBoundingBox.endPoint.x != boundingBox.endPoint.x ||
+			cachedBoundingBox.endPoint.y != boundingBox.endPoint.y
+		)
+		{
+			return -1;
+		}
+	}
+
+	FontData metricsFontData;
+	LoadOptions metricsOptions;
+	metricsOptions.decodeHorizontalMetrics = true;
+	if
+	(
+		metricsFontData.Load(Span<const U8>(OpenSans, OpenSansSize), metricsOptions) != Error::Success ||
+		metricsFontData.GetHorizontalMetrics() == nullptr ||
+		fontData.GetHorizontalMetrics() != nullptr
+	)
+	{
+		return -1;
+	}
+
+	// The last glyph of the embedded font is past the long metrics and only has a bearing.
+	struct ExpectedMetrics
+	{
+		I32 codepoint;
+		U16 advanceWidth;
+		I16 leftSideBearing;
+	};
+
+	for (auto expected : { ExpectedMetrics{ ' ', 532, 0 }, ExpectedMetrics{ 'A', 1295, 0 }, ExpectedMetrics{ 'i', 517, 160 } })
+	{
+		auto glyphIndex = fontData.GetCharIndex(expected.codepoint);
+		if
+		(
+			fontData.GetAdvanceWidth(glyphIndex) != expected.advanceWidth ||
+			fontData.GetLeftSideBearing(glyphIndex) != expected.leftSideBearing
+		)
+		{
+			return -1;
+		}
+	}
+
+	// Its bearing comes from the array of bearings that follows the long metrics.
+	auto lastBearing = I16(164);
+
+	if
+	(
+		fontData.numberOfLongHorizontalMetrics >= fontData.numberOfGlyphs ||
+		fontData.GetAdvanceWidth(fontData.numberOfGlyphs - 1) != fontData.GetAdvanceWidth(fontData.numberOfLongHorizontalMetrics - 1) ||
+		fontData.GetLeftSideBearing(fontData.numberOfGlyphs - 1) != lastBearing ||
+		metricsFontData.GetLeftSideBearing(fontData.numberOfGlyphs - 1) != lastBearing
+	)
+	{
+		return -1;
+	}
+
+	for (auto glyphIndex = 0u; glyphIndex <= fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		if
+		(
+			metricsFontData.GetAdvanceWidth(glyphIndex) != fontData.GetAdvanceWidth(glyphIndex) ||
+			metricsFontData.GetLeftSideBearing(glyphIndex) != fontData.GetLeftSideBearing(glyphIndex)
+		)
+		{
+			return -1;
+		}
+	}
+
+	if (fontData.GetAdvanceWidth(fontData.numberOfGlyphs) != 0 || fontData.GetLeftSideBearing(~0u) != 0)
+	{
+		return -1;
+	}
+
+	if (!CheckKerning(fontData) || !CheckLayout(fontData))
+	{
+		return -1;
+	}
+
+	FontData validatedFontData;
+	LoadOptions validateOptions;
+	validateOptions.validate = true;
+	if (validatedFontData.Load(Span<const U8>(OpenSans, OpenSansSize), validateOptions) != Error::Success || !CheckValidation())
+	{
+		return -1;
+	}
+
+	for (auto glyphIndex = 0u; glyphIndex < fontData.numberOfGlyphs; ++glyphIndex)
+	{
+		auto outline = fontData.FetchGlyphData(glyphIndex).outline;
+		auto validatedOutline = validatedFontData.FetchGlyphData(glyphIndex).outline;
+
+		if
+		(
+			!std::equal(outline.commands.begin(), outline.commands.end(), validatedOutline.commands.begin(), validatedOutline.commands.end()) ||
+			!std::equal
+			(
+				outline.points.begin(),
+				outline.points.end(),
+				validatedOutline.points.begin(),
+				validatedOutline.points.end(),
+				[](TTFPoint a, TTFPoint b) { return a.x == b.x && a.y == b.y; }
+			)
+		)
+		{
+			return -1;
+		}
+	}
+
+	FontData compiledFontData;
+	LoadOptions options;
+	options.compileCmap = true;
+	result = compiledFontData.Load(Span<const U8>(OpenSans, OpenSansSize), options);
+	if (result != Error::Success || compiledFontData.GetCompiledCmap().IsEmpty())
+	{
+		return -1;
+	}
+
+	for (auto codepoint = -1; codepoint <= I32(CompiledCmap::MAX_CODEPOINT) + 1; ++codepoint)
+	{
+		if (compiledFontData.GetCharIndex(codepoint) != fontData.GetCharIndex(codepoint))
+		{
+			return -1;
+		}
+	}
+
+	Array<I32> codepoints;
+	for (auto codepoint = -300; codepoint < 0x11000; codepoint += 1 + (codepoint & 3))
+	{
+		codepoints.push_back(codepoint);
+		codepoints.push_back(codepoint & 0x7F);
+	}
+	codepoints.push_back(0x7FFFFFFF);
+
+	Array<U32> glyphs(codepoints.size());
+	Array<U32> compiledGlyphs(codepoints.size());
+	fontData.GetCharIndices(codepoints, glyphs);
+	compiledFontData.GetCharIndices(codepoints, compiledGlyphs);
+
+	for (auto i = 0u; i < codepoints.size(); ++i)
+	{
+		if (glyphs[i] != fontData.GetCharIndex(codepoints[i]) || compiledGlyphs[i] != glyphs[i])
+		{
+			return -1;
+		}
+	}
+
+	if (!CheckTextDecoding(fontData) || !CheckTextDecoding(compiledFontData) || !CheckFormat12Cmap(fontData))
+	{
+		return -1;
+	}
+
+	{
+		std::fstream ofs("OpenSans.ttf", std::ios::binary | std::ios::out | std::ios::trunc);
+		ofs.write((const C*)OpenSans, OpenSansSize);
+	}
+
+	MappedFontFile missingFile;
+	if (missingFile.Open("MissingFont.ttf") != Error::FileReadError || missingFile.IsOpen())
+	{
+		return -1;
+	}
+
+	MappedFontFile mappedFile;
+	FontData mappedFontData;
+	if
+	(
+		mappedFile.Open("OpenSans.ttf") != Error::Success ||
+		mappedFontData.Load(mappedFile.GetData()) != Error::Success
+	)
+	{
+		return -1;
+	}
+	mappedFile.AdviseAccessPattern(mappedFontData);
+
+	for (auto codepoint = 0; codepoint < 0x10000; ++codepoint)
+	{
+		if (mappedFontData.GetCharIndex(codepoint) != fontData.GetCharIndex(codepoint))
+		{
+			return -1;
+		}
+	}
+
+	auto collectionData = BuildCollection();
+	FontCollection collection;
+	if
+	(
+		collection.Load(collectionData, options) != Error::Success ||
+		collection.GetFaceCount() != 2 ||
+		collection.GetDecodedTableCount() != 1 ||
+		&collection.GetFace(0).GetCompiledCmap() != &collection.GetFace(1).GetCompiledCmap()
+	)
+	{
+		return -1;
+	}
+
+	FontData secondFace;
+	LoadOptions secondFaceOptions;
+	secondFaceOptions.faceIndex = 1;
+	if (secondFace.Load(collectionData, secondFaceOptions) != Error::Success)
+	{
+		return -1;
+	}
+
+	secondFaceOptions.faceIndex = 2;
+	if (FontData().Load(collectionData, secondFaceOptions) != Error::InvalidFaceIndex)
+	{
+		return -1;
+	}
+
+	// A face count far past the end of the data must neither be allocated nor read.
+	auto hugeCollectionData = collectionData;
+	hugeCollectionData[8] = hugeCollectionData[9] = hugeCollectionData[10] = hugeCollectionData[11] = 0xFF;
+	FontCollection hugeCollection;
+	secondFaceOptions.faceIndex = 1000000;
+	if
+	(
+		hugeCollection.Load(hugeCollectionData) != Error::InvalidTableDirectory ||
+		hugeCollection.GetFaceCount() != 0 ||
+		FontData().Load(hugeCollectionData, secondFaceOptions) != Error::InvalidTableDirectory
+	)
+	{
+		return -1;
+	}
+
+	for (auto codepoint = 0; codepoint < 0x10000; ++codepoint)
+	{
+		auto glyphIndex = fontData.GetCharIndex(codepoint);
+
+		if
+		(
+			collection.GetFace(0).GetCharIndex(codepoint) != glyphIndex ||
+			collection.GetFace(1).GetCharIndex(codepoint) != glyphIndex ||
+			secondFace.GetCharIndex(codepoint) != glyphIndex
+		)
+		{
+			return -1;
+		}
+	}
 }
\ No newline at end of file
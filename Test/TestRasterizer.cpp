@@ -26,8 +26,1058 @@
 #include "OpenSans.hpp"
 #include "TestHelpers.hpp"
 
+#include <random>
+#include <thread>
+
 using namespace MTTF;
 
+auto CheckGlyphCache(const FontData& fontData) -> B
+{
+	GlyphCache cache;
+	auto glyphA = fontData.GetCharIndex('A');
+	auto first = cache.GetGlyph(fontData, 0, glyphA, 32.f);
+	auto second = cache.GetGlyph(fontData, 0, glyphA, 32.2f);
+	auto reference = RasterizeGlyph(fontData, 'A', 32);
+
+	// The height is quantized to whole pixels so both lookups are the same glyph.
+	auto statistics = cache.GetStatistics();
+	if
+	(
+		first != second ||
+		first->width != reference.width ||
+		first->height != reference.height ||
+		first->data != reference.data ||
+		statistics.misses != 1 ||
+		statistics.frontHits != 1 ||
+		statistics.entryCount != 1
+	)
+	{
+		return false;
+	}
+
+	// A different subpixel offset and font id are different glyphs.
+	auto shifted = cache.GetGlyph(fontData, 0, glyphA, 32.f, 0.5f);
+	auto otherFont = cache.GetGlyph(fontData, 1, glyphA, 32.f);
+	if (shifted == first || shifted->data == first->data || otherFont == first || cache.GetStatistics().misses != 3)
+	{
+		return false;
+	}
+
+	cache.Clear();
+	if (cache.GetStatistics().entryCount != 0 || cache.GetGlyph(fontData, 0, glyphA, 32.f) == first)
+	{
+		return false;
+	}
+
+	// A single shard with room for a few glyphs evicts the least recently used ones.
+	GlyphCacheOptions smallOptions;
+	smallOptions.shardCount = 1;
+	smallOptions.byteBudget = 4 * (first->data.size() + 256);
+	GlyphCache smallCache(smallOptions);
+	for (auto glyphIndex = 36u; glyphIndex < 62; ++glyphIndex)
+	{
+		smallCache.GetGlyph(fontData, 0, glyphIndex, 32.f);
+	}
+
+	statistics = smallCache.GetStatistics();
+	if (statistics.evictions == 0 || statistics.byteCount > smallOptions.byteBudget || statistics.entryCount + statistics.evictions != 26)
+	{
+		return false;
+	}
+
+	// Room for four of five glyphs. The first one is used again through the front cache before the
+	// fifth comes in, so the second one is the least recently used and gets evicted.
+	Array<SharedPtr<const GrayScaleSurface>> lruGlyphs;
+	auto lruByteBudget = U64(0);
+	for (auto glyphIndex = 36u; glyphIndex < 41; ++glyphIndex)
+	{
+		lruGlyphs.push_back(cache.GetGlyph(fontData, 0, glyphIndex, 32.f));
+		lruByteBudget += sizeof(GlyphCache::Entry) + sizeof(GrayScaleSurface) + lruGlyphs.back()->data.size();
+	}
+
+	GlyphCacheOptions lruOptions;
+	lruOptions.shardCount = 1;
+	lruOptions.byteBudget = lruByteBudget - 1;
+	GlyphCache lruCache(lruOptions);
+	for (auto glyphIndex = 36u; glyphIndex < 40; ++glyphIndex)
+	{
+		lruCache.GetGlyph(fontData, 0, glyphIndex, 32.f);
+	}
+	auto refreshed = lruCache.GetGlyph(fontData, 0, 36, 32.f);
+	lruCache.GetGlyph(fontData, 0, 40, 32.f);
+
+	statistics = lruCache.GetStatistics();
+	if (statistics.frontHits != 1 || statistics.evictions != 1)
+	{
+		return false;
+	}
+
+	// Another thread has a front cache of its own and so sees what the shard kept.
+	B keptFirst = false;
+	B evictedSecond = false;
+	std::thread
+	(
+		[&]()
+		{
+			auto missesBefore = lruCache.GetStatistics().misses;
+			keptFirst = lruCache.GetGlyph(fontData, 0, 36, 32.f) == refreshed && lruCache.GetStatistics().misses == missesBefore;
+			lruCache.GetGlyph(fontData, 0, 37, 32.f);
+			evictedSecond = lruCache.GetStatistics().misses == missesBefore + 1;
+		}
+	).join();
+	if (!keptFirst || !evictedSecond)
+	{
+		return false;
+	}
+
+	// Many threads going through the same glyphs get the same bitmaps and every lookup is counted
+	// once the threads exit.
+	constexpr auto THREAD_COUNT = 8u;
+	constexpr auto LOOKUP_COUNT = 4000u;
+	GlyphCache sharedCache;
+	Array<GrayScaleSurface> expected;
+	for (auto glyphIndex = 0u; glyphIndex < 200; ++glyphIndex)
+	{
+		expected.push_back(*sharedCache.GetGlyph(fontData, 0, glyphIndex, 20.f, 0.25f));
+	}
+
+	std::atomic<U32> mismatches = 0;
+	Array<std::thread> threads;
+	for (auto t = 0u; t < THREAD_COUNT; ++t)
+	{
+		threads.emplace_back
+		(
+			[&, t]()
+			{
+				for (auto i = 0u; i < LOOKUP_COUNT; ++i)
+				{
+					auto glyphIndex = (i * 7 + t * 13) % 200;
+					auto surface = sharedCache.GetGlyph(fontData, 0, glyphIndex, 20.f, 0.3f);
+					if (surface->data != expected[glyphIndex].data)
+					{
+						mismatches++;
+					}
+				}
+			}
+		);
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	statistics = sharedCache.GetStatistics();
+	return
+		mismatches == 0 &&
+		statistics.misses == 200 &&
+		statistics.hits + statistics.frontHits + statistics.misses == 200 + THREAD_COUNT * LOOKUP_COUNT;
+}
+
+// The glyph on the page has to match the one rasterized on its own and be surrounded by blank
+// padding on the right and below.
+auto CheckAtlasGlyph(const GrayScaleSurface& page, const AtlasGlyph& glyph, const GrayScaleSurface& expected, U32 padding) -> B
+{
+	if
+	(
+		glyph.width != expected.width ||
+		glyph.height != expected.height ||
+		glyph.x + glyph.width + padding > page.width ||
+		glyph.y + glyph.height + padding > page.height ||
+		std::abs(glyph.u0 * page.width - glyph.x) > 1e-3f ||
+		std::abs(glyph.v1 * page.height - (glyph.y + glyph.height)) > 1e-3f
+	)
+	{
+		return false;
+	}
+
+	for (auto y = 0u; y < glyph.height + padding; ++y)
+	{
+		for (auto x = 0u; x < glyph.width + padding; ++x)
+		{
+			auto pixel = page.data[(glyph.y + y) * page.width + glyph.x + x];
+			auto expectedPixel = x < glyph.width && y < glyph.height ? expected.data[y * expected.width + x] : Byte(255);
+
+			if (pixel != expectedPixel)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+auto CheckGlyphAtlas(const FontData& fontData) -> B
+{
+	GlyphCache references;
+	GlyphAtlasOptions options;
+	options.pageWidth = 96;
+	options.pageHeight = 96;
+	options.maxPageCount = 3;
+	options.padding = 2;
+	GlyphAtlas atlas(options);
+
+	// Letters, digits and punctuation of a few sizes so that there are several shelf heights.
+	Array<AtlasGlyph> glyphs;
+	for (auto glyphIndex = 4u; glyphIndex < 70; ++glyphIndex)
+	{
+		auto pixelHeight = 14.f + (glyphIndex % 3) * 5.f;
+		AtlasGlyph glyph;
+
+		if
+		(
+			!atlas.GetGlyph(fontData, 0, glyphIndex, pixelHeight, 0.25f, glyph) ||
+			!CheckAtlasGlyph(atlas.GetPage(glyph.page), glyph, *references.GetGlyph(fontData, 0, glyphIndex, pixelHeight, 0.25f), options.padding)
+		)
+		{
+			return false;
+		}
+
+		// No two glyphs share a pixel.
+		for (auto& other : glyphs)
+		{
+			if
+			(
+				other.page == glyph.page &&
+				other.x < glyph.x + glyph.width + options.padding &&
+				glyph.x < other.x + other.width + options.padding &&
+				other.y < glyph.y + glyph.height + options.padding &&
+				glyph.y < other.y + other.height + options.padding
+			)
+			{
+				return false;
+			}
+		}
+
+		glyphs.push_back(glyph);
+	}
+
+	if (atlas.GetPageCount() < 2 || atlas.GetGlyphCount() != glyphs.size() || atlas.GetEvictionCount() != 0)
+	{
+		return false;
+	}
+
+	// Every placed pixel is covered by a dirty rectangle.
+	for (auto& glyph : glyphs)
+	{
+		auto covered = false;
+		for (auto& rect : atlas.GetDirtyRects())
+		{
+			covered |=
+				rect.page == glyph.page &&
+				rect.x <= glyph.x && glyph.x + glyph.width <= rect.x + rect.width &&
+				rect.y <= glyph.y && glyph.y + glyph.height <= rect.y + rect.height;
+		}
+
+		if (!covered)
+		{
+			return false;
+		}
+	}
+
+	// Glyphs already in the atlas don't get drawn again.
+	atlas.ClearDirtyRects();
+	AtlasGlyph again;
+	if
+	(
+		!atlas.GetGlyph(fontData, 0, 36, 14.f, 0.25f, again) ||
+		again.x != glyphs[32].x ||
+		again.y != glyphs[32].y ||
+		!atlas.GetDirtyRects().empty()
+	)
+	{
+		return false;
+	}
+
+	// Too big for a page.
+	if (atlas.GetGlyph(fontData, 0, 36, 300.f, 0.f, again))
+	{
+		return false;
+	}
+
+	// Everything drawn in this frame has to stay so the atlas eventually runs out of room.
+	auto placed = 0u;
+	for (auto glyphIndex = 70u; glyphIndex < 400 && atlas.GetGlyph(fontData, 0, glyphIndex, 24.f, 0.f, again); ++glyphIndex)
+	{
+		placed++;
+	}
+	if (placed == 330 || atlas.GetEvictionCount() != 0)
+	{
+		return false;
+	}
+
+	// Over several frames the least recently used glyphs make room for new ones.
+	for (auto frame = 0u; frame < 20; ++frame)
+	{
+		atlas.NextFrame();
+
+		for (auto i = 0u; i < 30; ++i)
+		{
+			auto glyphIndex = 100 + (frame * 17 + i * 5) % 300;
+			auto pixelHeight = 12.f + (i % 4) * 6.f;
+			AtlasGlyph glyph;
+
+			if
+			(
+				!atlas.GetGlyph(fontData, 1, glyphIndex, pixelHeight, 0.f, glyph) ||
+				!CheckAtlasGlyph(atlas.GetPage(glyph.page), glyph, *references.GetGlyph(fontData, 1, glyphIndex, pixelHeight, 0.f), options.padding)
+			)
+			{
+				return false;
+			}
+		}
+	}
+
+	return atlas.GetEvictionCount() != 0 && atlas.GetPageCount() == options.maxPageCount;
+}
+
+auto CheckBakeAtlas(const FontData& fontData) -> B
+{
+	Array<I32> codepoints;
+	for (auto codepoint = 0x20; codepoint < 0x250; ++codepoint)
+	{
+		codepoints.push_back(codepoint);
+	}
+	// Unmapped codepoints all share the .notdef glyph.
+	codepoints.push_back(0x10FFFF);
+
+	Array<F32> pixelHeights = { 12.f, 20.f, 33.f };
+	AtlasBakeOptions options;
+	options.pageWidth = 256;
+	options.pageHeight = 256;
+	options.padding = 2;
+
+	auto atlas = BakeAtlas(fontData, codepoints, pixelHeights, 1, options);
+	if (atlas.pages.size() < 2 || atlas.glyphs.size() != codepoints.size() * pixelHeights.size())
+	{
+		return false;
+	}
+
+	// The same bytes no matter how many threads.
+	for (auto threadCount : { 2u, 3u, 0u })
+	{
+		auto parallelAtlas = BakeAtlas(fontData, codepoints, pixelHeights, threadCount, options);
+		if (parallelAtlas.pages.size() != atlas.pages.size())
+		{
+			return false;
+		}
+
+		for (auto i = 0u; i < atlas.pages.size(); ++i)
+		{
+			if (parallelAtlas.pages[i].data != atlas.pages[i].data)
+			{
+				return false;
+			}
+		}
+	}
+
+	GlyphCache references;
+	for (auto& baked : atlas.glyphs)
+	{
+		auto reference = references.GetGlyph(fontData, 0, baked.glyphIndex, baked.pixelHeight);
+		if
+		(
+			baked.glyphIndex != fontData.GetCharIndex(baked.codepoint) ||
+			!CheckAtlasGlyph(atlas.pages[baked.glyph.page], baked.glyph, *reference, options.padding)
+		)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Compares the distance field against distances to densely sampled outline points.
+auto CheckDistanceField(const GlyphData& glyphData, F32 scale, F32 spread) -> B
+{
+	auto field = RasterizeSDF(glyphData, scale, spread, 1);
+	auto margin = std::ceil(spread);
+	auto minX = F32(glyphData.boundingBoxDiagonal.startPoint.x);
+	auto maxY = F32(glyphData.boundingBoxDiagonal.endPoint.y);
+
+	Array<Pair<F32, F32>> samples;
+	auto toSurface = [&](F32 x, F32 y) { return Pair<F32, F32>((x - minX) * scale + margin, (maxY - y) * scale + margin); };
+	glyphData.outline.ForEachSegment
+	(
+		[&](const auto& segment)
+		{
+			for (auto i = 0; i <= 400; ++i)
+			{
+				auto t = i / 400.f;
+				auto s = 1 - t;
+				using Segment = std::decay_t<decltype(segment)>;
+
+				if constexpr (std::is_same_v<Segment, Line>)
+				{
+					samples.push_back(toSurface(s * segment.startPoint.x + t * segment.endPoint.x, s * segment.startPoint.y + t * segment.endPoint.y));
+				}
+				else if constexpr (std::is_same_v<Segment, QuadraticBezierCurve>)
+				{
+					samples.push_back
+					(
+						toSurface
+						(
+							s * s * segment.startPoint.x + 2 * s * t * segment.controlPoint.x + t * t * segment.endPoint.x,
+							s * s * segment.startPoint.y + 2 * s * t * segment.controlPoint.y + t * t * segment.endPoint.y
+						)
+					);
+				}
+				else
+				{
+					samples.push_back
+					(
+						toSurface
+						(
+							s * s * s * segment.startPoint.x + 3 * s * s * t * segment.controlPoint0.x +
+								3 * s * t * t * segment.controlPoint1.x + t * t * t * segment.endPoint.x,
+							s * s * s * segment.startPoint.y + 3 * s * s * t * segment.controlPoint0.y +
+								3 * s * t * t * segment.controlPoint1.y + t * t * t * segment.endPoint.y
+						)
+					);
+				}
+			}
+		}
+	);
+
+	auto coverage = Rasterize(glyphData, scale);
+
+	for (auto y = 0u; y < field.height; ++y)
+	{
+		for (auto x = 0u; x < field.width; ++x)
+		{
+			auto distance = spread;
+			for (auto& sample : samples)
+			{
+				distance = std::min(distance, std::hypot(sample.first - (x + 0.5f), sample.second - (y + 0.5f)));
+			}
+
+			auto value = field.data[y * field.width + x];
+			auto unsignedDistance = std::abs(value / 255.f - 0.5f) * 2 * spread;
+
+			if (std::abs(unsignedDistance - distance) > 0.05f)
+			{
+				return false;
+			}
+
+			// Fully covered pixels are inside and empty ones outside.
+			auto coverageX = I32(x) - I32(margin);
+			auto coverageY = I32(y) - I32(margin);
+			if (coverageX >= 0 && coverageY >= 0 && coverageX < I32(coverage.width) && coverageY < I32(coverage.height))
+			{
+				auto ink = coverage.data[coverageY * coverage.width + coverageX];
+				if ((ink == 0 && value < 128) || (ink == 255 && value > 128))
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+auto CheckSignedDistanceFields(const FontData& fontData) -> B
+{
+	// A square has easy distances: 1.5 pixels inside and outside of the left edge.
+	GlyphData square;
+	square.outline.AddLine(TTFPoint(0, 0), TTFPoint(0, 100));
+	square.outline.AddLine(TTFPoint(0, 100), TTFPoint(100, 100));
+	square.outline.AddLine(TTFPoint(100, 100), TTFPoint(100, 0));
+	square.outline.AddLine(TTFPoint(100, 0), TTFPoint(0, 0));
+	square.outline.EndContour();
+	square.boundingBoxDiagonal = Line(TTFPoint(0, 0), TTFPoint(100, 100));
+
+	auto field = RasterizeSDF(square, 0.5f, 4.f);
+	if
+	(
+		field.width != 59 ||
+		field.height != 59 ||
+		field.data[30 * field.width + 5] != 175 ||
+		field.data[30 * field.width + 2] != 80 ||
+		field.data[30 * field.width + 30] != 255 ||
+		field.data[0] != 0
+	)
+	{
+		return false;
+	}
+
+	auto scale = fontData.GetScaleForPixelHeight(48.f);
+	for (auto codepoint : { 'S', 'g', '@', '&' })
+	{
+		if (!CheckDistanceField(fontData.FetchGlyphDataForCodepoint(codepoint), scale, 6.f))
+		{
+			return false;
+		}
+	}
+
+	// Cubics are approximated by quadratics but stay well within a pixel.
+	auto cffFont = BuildCffFont(fontData, Span<const U8>(OpenSans, OpenSansSize));
+	FontData cffFontData;
+	if (cffFontData.Load(cffFont) != Error::Success)
+	{
+		return false;
+	}
+
+	for (auto codepoint : { 'S', '&' })
+	{
+		if (!CheckDistanceField(cffFontData.FetchGlyphDataForCodepoint(codepoint), scale, 6.f))
+		{
+			return false;
+		}
+	}
+
+	// Rows computed in parallel give the same field.
+	auto glyph = fontData.FetchGlyphDataForCodepoint('W');
+	return RasterizeSDF(glyph, scale, 4.f, 1).data == RasterizeSDF(glyph, scale, 4.f, 4).data;
+}
+
+auto GetMedian(F32 a, F32 b, F32 c) -> F32
+{
+	return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+auto GetMedian(const RGBSurface& surface, U32 x, U32 y) -> F32
+{
+	auto pixel = surface.data.data() + (y * surface.width + x) * 3;
+	return GetMedian(pixel[0], pixel[1], pixel[2]);
+}
+
+// Counts the fine samples on the wrong side of the square when the channels are interpolated and
+// combined the way a shader would.
+auto CountSquareMismatches(const RGBSurface& surface, F32 minCorner, F32 maxCorner) -> U32
+{
+	constexpr auto SUBDIVISIONS = 16u;
+	auto mismatches = 0u;
+
+	for (auto y = SUBDIVISIONS / 2; y < (surface.height - 1) * SUBDIVISIONS + SUBDIVISIONS / 2; ++y)
+	{
+		for (auto x = SUBDIVISIONS / 2; x < (surface.width - 1) * SUBDIVISIONS + SUBDIVISIONS / 2; ++x)
+		{
+			auto u = (x + 0.5f) / SUBDIVISIONS - 0.5f;
+			auto v = (y + 0.5f) / SUBDIVISIONS - 0.5f;
+			auto column = U32(u);
+			auto row = U32(v);
+			auto fu = u - column;
+			auto fv = v - row;
+			StaticArray<F32, 3> values;
+
+			for (auto channel = 0u; channel < 3; ++channel)
+			{
+				auto sample = [&](U32 sampleColumn, U32 sampleRow) { return F32(surface.data[(sampleRow * surface.width + sampleColumn) * 3 + channel]); };
+				values[channel] =
+					(sample(column, row) * (1 - fu) + sample(column + 1, row) * fu) * (1 - fv) +
+					(sample(column, row + 1) * (1 - fu) + sample(column + 1, row + 1) * fu) * fv;
+			}
+
+			auto inside = u + 0.5f > minCorner && u + 0.5f < maxCorner && v + 0.5f > minCorner && v + 0.5f < maxCorner;
+			if ((GetMedian(values[0], values[1], values[2]) > 127.5f) != inside)
+			{
+				mismatches++;
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+auto CheckMultiChannelDistanceFields(const FontData& fontData) -> B
+{
+	GlyphData square;
+	square.outline.AddLine(TTFPoint(0, 0), TTFPoint(0, 100));
+	square.outline.AddLine(TTFPoint(0, 100), TTFPoint(100, 100));
+	square.outline.AddLine(TTFPoint(100, 100), TTFPoint(100, 0));
+	square.outline.AddLine(TTFPoint(100, 0), TTFPoint(0, 0));
+	square.outline.EndContour();
+	square.boundingBoxDiagonal = Line(TTFPoint(0, 0), TTFPoint(100, 100));
+
+	// Inside the square the median is the distance to the closest edge, same as the single channel
+	// field.
+	auto field = RasterizeSDF(square, 0.5f, 4.f);
+	auto multiField = RasterizeMSDF(square, 0.5f, 4.f);
+	if (multiField.width != field.width || multiField.height != field.height || multiField.data.size() != field.data.size() * 3)
+	{
+		return false;
+	}
+
+	for (auto y = 0u; y < field.height; ++y)
+	{
+		for (auto x = 0u; x < field.width; ++x)
+		{
+			auto expected = field.data[y * field.width + x];
+			if (expected > 128 && std::abs(GetMedian(multiField, x, y) - expected) > 1)
+			{
+				return false;
+			}
+		}
+	}
+
+	// At a tenth of the size the corners of a single channel field get round while the multi
+	// channel one keeps them.
+	field = RasterizeSDF(square, 0.1f, 2.f);
+	multiField = RasterizeMSDF(square, 0.1f, 2.f);
+	RGBSurface grayField{ Array<Byte>(field.data.size() * 3), field.width, field.height };
+	for (auto i = 0u; i < grayField.data.size(); ++i)
+	{
+		grayField.data[i] = field.data[i / 3];
+	}
+
+	auto singleMismatches = CountSquareMismatches(grayField, 2.f, 12.f);
+	auto multiMismatches = CountSquareMismatches(multiField, 2.f, 12.f);
+	if (multiMismatches * 4 > singleMismatches)
+	{
+		return false;
+	}
+
+	// Every pixel clearly off the outline is on the same side as in the exact field.
+	auto scale = fontData.GetScaleForPixelHeight(32.f);
+	for (auto codepoint : { 'S', 'g', '@', '&', 'W', 'M' })
+	{
+		auto glyph = fontData.FetchGlyphDataForCodepoint(codepoint);
+		field = RasterizeSDF(glyph, scale, 3.f);
+		multiField = RasterizeMSDF(glyph, scale, 3.f);
+
+		for (auto y = 0u; y < field.height; ++y)
+		{
+			for (auto x = 0u; x < field.width; ++x)
+			{
+				auto expected = F32(field.data[y * field.width + x]);
+				if (std::abs(expected - 127.5f) > 8 && (GetMedian(multiField, x, y) > 127.5f) != (expected > 127.5f))
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	// Only real clashes are flattened to a single channel, so pixels near the outline keep their
+	// separate channels and with them the sharp corners.
+	auto smallScale = fontData.GetScaleForPixelHeight(24.f);
+	for (auto codepoint : { 'M', 'W', 'A' })
+	{
+		auto glyph = fontData.FetchGlyphDataForCodepoint(codepoint);
+		field = RasterizeSDF(glyph, smallScale, 2.f);
+		multiField = RasterizeMSDF(glyph, smallScale, 2.f);
+		auto nearEdge = 0u;
+		auto flattened = 0u;
+
+		for (auto i = 0u; i < field.data.size(); ++i)
+		{
+			auto pixel = multiField.data.data() + 3 * i;
+			if (std::abs(F32(field.data[i]) - 127.5f) < 64)
+			{
+				nearEdge++;
+				flattened += pixel[0] == pixel[1] && pixel[0] == pixel[2];
+			}
+		}
+
+		if (flattened * 10 > nearEdge)
+		{
+			return false;
+		}
+	}
+
+	auto glyph = fontData.FetchGlyphDataForCodepoint('K');
+	return RasterizeMSDF(glyph, scale, 4.f, 1).data == RasterizeMSDF(glyph, scale, 4.f, 3).data;
+}
+
+// The blocked commulative sum stays within a level of a sequential one in double precision and
+// writes exactly the width of the row.
+auto CheckDrawScanline() -> B
+{
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<F32> distribution(-0.5f, 0.5f);
+
+	for (auto width : { 1u, 3u, 4u, 7u, 8u, 9u, 31u, 100u })
+	{
+		Scanline scanline;
+		auto paddedWidth = (width + SCANLINE_BLOCK_SIZE - 1) / SCANLINE_BLOCK_SIZE * SCANLINE_BLOCK_SIZE;
+		scanline.area.resize(paddedWidth, 0.f);
+		scanline.cover.resize(paddedWidth, 0.f);
+
+		for (auto i = 0u; i < width; ++i)
+		{
+			scanline.area[i] = distribution(generator);
+			scanline.cover[i] = distribution(generator);
+		}
+
+		scanline.spans.emplace_back(0, width);
+
+		auto stride = width + 5;
+		Array<Byte> pixels(stride * 2, Byte(77));
+		DrawScanline(SurfaceView{ pixels.data(), width, 2, stride }, scanline, 1);
+
+		auto sum = 0.0;
+		for (auto i = 0u; i < stride * 2; ++i)
+		{
+			if (i < stride + width && i >= stride)
+			{
+				sum += scanline.cover[i - stride];
+				auto expected = 255.0 - std::min(std::abs(sum + scanline.area[i - stride]) * 255.0, 255.0);
+				if (std::abs(pixels[i] - expected) > 1.01)
+				{
+					return false;
+				}
+			}
+			else if (pixels[i] != 77)
+			{
+				return false;
+			}
+		}
+	}
+
+	// Resolving only a few unsorted and overlapping spans of a wide row gives the same pixels as
+	// resolving all of it and leaves the scanline zeroed.
+	constexpr auto WIDTH = 1000u;
+	auto paddedWidth = (WIDTH + SCANLINE_BLOCK_SIZE - 1) / SCANLINE_BLOCK_SIZE * SCANLINE_BLOCK_SIZE;
+
+	for (auto pass = 0u; pass < 50; ++pass)
+	{
+		Scanline sparse;
+		sparse.area.resize(paddedWidth, 0.f);
+		sparse.cover.resize(paddedWidth, 0.f);
+
+		for (auto spanIdx = 0u; spanIdx < pass % 7; ++spanIdx)
+		{
+			auto begin = U32(generator() % WIDTH);
+			auto end = Min(begin + 1 + U32(generator() % 40), WIDTH);
+
+			for (auto i = begin; i < end; ++i)
+			{
+				sparse.area[i] += distribution(generator);
+				sparse.cover[i] += distribution(generator);
+			}
+
+			sparse.spans.emplace_back(begin, end);
+		}
+
+		auto dense = sparse;
+		dense.spans.assign(1, { 0, WIDTH });
+
+		Array<Byte> sparsePixels(WIDTH);
+		Array<Byte> densePixels(WIDTH);
+		DrawScanline(SurfaceView{ sparsePixels.data(), WIDTH, 1, WIDTH }, sparse, 0);
+		DrawScanline(SurfaceView{ densePixels.data(), WIDTH, 1, WIDTH }, dense, 0);
+		ClearScanline(sparse);
+
+		if
+		(
+			sparsePixels != densePixels ||
+			!sparse.spans.empty() ||
+			std::any_of(sparse.area.begin(), sparse.area.end(), [](F32 value) { return value != 0; }) ||
+			std::any_of(sparse.cover.begin(), sparse.cover.end(), [](F32 value) { return value != 0; })
+		)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Bands start in the middle of edges so their intersections have to be exactly the ones a single
+// pass over the rows gets to.
+auto CheckBandRasterization(const FontData& fontData) -> B
+{
+	auto cffFont = BuildCffFont(fontData, Span<const U8>(OpenSans, OpenSansSize));
+	FontData cffFontData;
+	if (cffFontData.Load(cffFont) != Error::Success)
+	{
+		return false;
+	}
+
+	for (auto font : { &fontData, const_cast<const FontData*>(&cffFontData) })
+	{
+		for (auto codepoint : { '@', 'g', 'S', 'W', '%' })
+		{
+			auto serial = RasterizeGlyph(*font, codepoint, 900);
+
+			for (auto threadCount : { 2u, 3u, 16u })
+			{
+				if (RasterizeGlyph(*font, codepoint, 900, threadCount).data != serial.data)
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	// Too short to split.
+	return RasterizeGlyph(fontData, 'A', 40, 8).data == RasterizeGlyph(fontData, 'A', 40).data;
+}
+
+// The fixed point rasterizer has to give the same bytes with every compiler, optimization level
+// and instruction set, so it's checked against a checksum taken once.
+auto CheckFixedPointRasterization(const FontData& fontData) -> B
+{
+	auto cffFont = BuildCffFont(fontData, Span<const U8>(OpenSans, OpenSansSize));
+	FontData cffFontData;
+	if (cffFontData.Load(cffFont) != Error::Success)
+	{
+		return false;
+	}
+
+	U64 checksum = 0xCBF29CE484222325ull;
+	for (auto font : { &fontData, const_cast<const FontData*>(&cffFontData) })
+	{
+		for (auto codepoint = 'A'; codepoint <= 'z'; ++codepoint)
+		{
+			for (auto height : { 13, 48, 200 })
+			{
+				auto surface = RasterizeGlyph<RasterArithmetic::Fixed>(*font, codepoint, height);
+				checksum = (checksum ^ (U64(surface.width) << 32 | surface.height)) * 0x100000001B3ull;
+
+				for (auto pixel : surface.data)
+				{
+					checksum = (checksum ^ pixel) * 0x100000001B3ull;
+				}
+			}
+		}
+	}
+
+	if (checksum != 0x89A8BCDE72E358B6ull)
+	{
+		return false;
+	}
+
+	// Straight edges give the same coverage as the floating point rasterizer up to rounding.
+	GlyphData triangle;
+	triangle.outline.AddLine(TTFPoint(0, 0), TTFPoint(30, 100));
+	triangle.outline.AddLine(TTFPoint(30, 100), TTFPoint(100, 0));
+	triangle.outline.AddLine(TTFPoint(100, 0), TTFPoint(0, 0));
+	triangle.outline.EndContour();
+	triangle.boundingBoxDiagonal = Line(TTFPoint(0, 0), TTFPoint(100, 100));
+
+	auto floatSurface = Rasterize(triangle, 0.37f, 0.3f);
+	auto fixedSurface = Rasterize<RasterArithmetic::Fixed>(triangle, 0.37f, 0.3f);
+	if (floatSurface.width != fixedSurface.width || floatSurface.height != fixedSurface.height)
+	{
+		return false;
+	}
+
+	for (auto i = 0u; i < floatSurface.data.size(); ++i)
+	{
+		if (std::abs(floatSurface.data[i] - fixedSurface.data[i]) > 2)
+		{
+			return false;
+		}
+	}
+
+	// Curves are close to a rendering at eight times the size scaled down.
+	auto glyph = fontData.FetchGlyphDataForCodepoint('@');
+	auto scale = fontData.GetScaleForPixelHeight(40.f);
+	auto small = Rasterize<RasterArithmetic::Fixed>(glyph, scale, 0, 1, 1.f / 32);
+	auto large = Rasterize<RasterArithmetic::Fixed>(glyph, 8 * scale, 0, 1, 1.f / 32);
+	auto error = 0.0;
+
+	for (auto y = 0u; y < small.height; ++y)
+	{
+		for (auto x = 0u; x < small.width; ++x)
+		{
+			auto sum = 0.0;
+			for (auto sampleY = y * 8; sampleY < y * 8 + 8; ++sampleY)
+			{
+				for (auto sampleX = x * 8; sampleX < x * 8 + 8; ++sampleX)
+				{
+					sum += sampleX < large.width && sampleY < large.height ? large.data[sampleY * large.width + sampleX] : 255;
+				}
+			}
+
+			error += std::abs(sum / 64 - small.data[y * small.width + x]);
+		}
+	}
+
+	if (error / small.data.size() > 2)
+	{
+		return false;
+	}
+
+	return RasterizeGlyph<RasterArithmetic::Fixed>(fontData, 'g', 700, 5).data == RasterizeGlyph<RasterArithmetic::Fixed>(fontData, 'g', 700).data;
+}
+
+// Samples every curve of the outline, the lines are skipped.
+auto SampleCurves(const GlyphData& glyphData, U32 sampleCount) -> Array<Pair<F32, F32>>
+{
+	Array<Pair<F32, F32>> samples;
+	glyphData.outline.ForEachSegment
+	(
+		[&](const auto& segment)
+		{
+			using Segment = std::decay_t<decltype(segment)>;
+
+			for (auto i = 0u; i <= sampleCount; ++i)
+			{
+				auto t = F32(i) / sampleCount;
+				auto s = 1 - t;
+
+				if constexpr (std::is_same_v<Segment, QuadraticBezierCurve>)
+				{
+					samples.emplace_back
+					(
+						s * s * segment.startPoint.x + 2 * s * t * segment.controlPoint.x + t * t * segment.endPoint.x,
+						s * s * segment.startPoint.y + 2 * s * t * segment.controlPoint.y + t * t * segment.endPoint.y
+					);
+				}
+				else if constexpr (std::is_same_v<Segment, CubicBezierCurve>)
+				{
+					samples.emplace_back
+					(
+						s * s * s * segment.startPoint.x + 3 * s * s * t * segment.controlPoint0.x +
+							3 * s * t * t * segment.controlPoint1.x + t * t * t * segment.endPoint.x,
+						s * s * s * segment.startPoint.y + 3 * s * s * t * segment.controlPoint0.y +
+							3 * s * t * t * segment.controlPoint1.y + t * t * t * segment.endPoint.y
+					);
+				}
+			}
+		}
+	);
+
+	return samples;
+}
+
+auto CheckCurveFlattening(const FontData& fontData) -> B
+{
+	auto cffFont = BuildCffFont(fontData, Span<const U8>(OpenSans, OpenSansSize));
+	FontData cffFontData;
+	if (cffFontData.Load(cffFont) != Error::Success)
+	{
+		return false;
+	}
+
+	auto scale = 0.05f;
+
+	for (auto font : { &fontData, const_cast<const FontData*>(&cffFontData) })
+	{
+		for (auto codepoint : { 'S', '@', 'g', 'o' })
+		{
+			auto glyph = font->FetchGlyphDataForCodepoint(codepoint);
+			auto samples = SampleCurves(glyph, 64);
+			auto previousEdgeCount = ~0u;
+
+			for (auto flatness : { 1.f / 32, 1.f / 8, 2.f })
+			{
+				auto edges = Linearize(glyph, scale, flatness);
+
+				// Every point of every curve is within the flatness from some edge.
+				for (auto& sample : samples)
+				{
+					auto distance = std::numeric_limits<F32>::max();
+					for (auto& edge : edges)
+					{
+						auto dx = edge.lowermostPoint.x - edge.uppermostPoint.x;
+						auto dy = edge.lowermostPoint.y - edge.uppermostPoint.y;
+						auto t = std::clamp(((sample.first - edge.uppermostPoint.x) * dx + (sample.second - edge.uppermostPoint.y) * dy) / (dx * dx + dy * dy), 0.f, 1.f);
+						distance = std::min(distance, std::hypot(edge.uppermostPoint.x + t * dx - sample.first, edge.uppermostPoint.y + t * dy - sample.second));
+					}
+
+					if (distance * scale > flatness * 1.01f)
+					{
+						return false;
+					}
+				}
+
+				// Looser flatness never gives more edges.
+				if (edges.size() > previousEdgeCount)
+				{
+					return false;
+				}
+				previousEdgeCount = U32(edges.size());
+			}
+		}
+	}
+
+	// Blocks of curves stepped in SIMD lanes give the edges of the curves stepped one by one.
+	auto glyph = cffFontData.FetchGlyphDataForCodepoint('@');
+	CurveBatch curves(U32(glyph.outline.commands.size()));
+	glyph.outline.ForEachSegment
+	(
+		[&](const auto& segment)
+		{
+			using Segment = std::decay_t<decltype(segment)>;
+			auto toPoint = [](const TTFPoint& point) { return Point(point.x, point.y); };
+
+			if constexpr (std::is_same_v<Segment, QuadraticBezierCurve>)
+			{
+				AddQuadratic(curves, toPoint(segment.startPoint), toPoint(segment.controlPoint), toPoint(segment.endPoint));
+			}
+			else if constexpr (std::is_same_v<Segment, CubicBezierCurve>)
+			{
+				AddCubic(curves, toPoint(segment.startPoint), toPoint(segment.controlPoint0), toPoint(segment.controlPoint1), toPoint(segment.endPoint));
+			}
+		}
+	);
+
+	Array<Edge> blockEdges;
+	Array<Edge> curveEdges;
+	FlattenCurves(blockEdges, curves, 0.5f);
+	for (auto curveIdx = 0u; curveIdx < curves.GetSize(); ++curveIdx)
+	{
+		FlattenCurve(curveEdges, curves, curveIdx, 1.f / (8.f * 0.5f));
+	}
+
+	auto getKey =
+		[](const Edge& edge)
+		{
+			return std::make_tuple(edge.uppermostPoint.y, edge.uppermostPoint.x, edge.lowermostPoint.y, edge.lowermostPoint.x, edge.direction);
+		};
+	auto lessThan = [&](const Edge& e0, const Edge& e1) { return getKey(e0) < getKey(e1); };
+	std::sort(blockEdges.begin(), blockEdges.end(), lessThan);
+	std::sort(curveEdges.begin(), curveEdges.end(), lessThan);
+
+	// The forward differences can't be fused into multiply-adds so the two are exactly equal.
+	return curves.GetSize() > 8 && blockEdges.size() == curveEdges.size() &&
+		std::equal(blockEdges.begin(), blockEdges.end(), curveEdges.begin(), [&](const Edge& e0, const Edge& e1) { return getKey(e0) == getKey(e1); });
+}
+
+auto CheckAnalyticRasterization(const FontData& fontData) -> B
+{
+	auto cffFont = BuildCffFont(fontData, Span<const U8>(OpenSans, OpenSansSize));
+	FontData cffFontData;
+	if (cffFontData.Load(cffFont) != Error::Success)
+	{
+		return false;
+	}
+
+	// The exact coverage is within rounding from a rendering of the curves flattened very finely.
+	for (auto font : { &fontData, const_cast<const FontData*>(&cffFontData) })
+	{
+		for (auto codepoint : { 'S', '@', 'g', '&', 'e' })
+		{
+			auto glyph = font->FetchGlyphDataForCodepoint(codepoint);
+
+			for (auto height : { 13.f, 48.f, 200.f })
+			{
+				auto scale = font->GetScaleForPixelHeight(height);
+				auto analytic = Rasterize<RasterArithmetic::Analytic>(glyph, scale, 0.3f, 1, 1.f / 256);
+				auto flattened = Rasterize(glyph, scale, 0.3f, 1, 1.f / 256);
+
+				if (analytic.width != flattened.width || analytic.height != flattened.height)
+				{
+					return false;
+				}
+
+				for (auto i = 0u; i < analytic.data.size(); ++i)
+				{
+					if (std::abs(analytic.data[i] - flattened.data[i]) > 2)
+					{
+						return false;
+					}
+				}
+			}
+		}
+	}
+
+	// The quadratic curves are never flattened.
+	auto glyph = fontData.FetchGlyphDataForCodepoint('@');
+	if (GetCurveEdges(glyph, 0.01f, 0, DEFAULT_FLATNESS_IN_PIXELS).size() != GetCurveEdges(glyph, 2.f, 0, DEFAULT_FLATNESS_IN_PIXELS).size())
+	{
+		return false;
+	}
+
+	return RasterizeGlyph<RasterArithmetic::Analytic>(fontData, 'g', 700, 5).data == RasterizeGlyph<RasterArithmetic::Analytic>(fontData, 'g', 700).data;
+}
+
 auto main() -> I32
 {
 	FontData fontData;
@@ -35,7 +1085,7 @@ auto main() -> I32
 	auto surface = RasterizeGlyph(fontData, 65, 1000);
 	WritePGM(surface);
 
-	if (result != Error::Success)
+	if (result != Error::Success || !CheckCurveFlattening(fontData) || !CheckDrawScanline() || !CheckBandRasterization(fontData) || !CheckFixedPointRasterization(fontData) || !CheckAnalyticRasterization(fontData) || !CheckGlyphCache(fontData) || !CheckGlyphAtlas(fontData) || !CheckBakeAtlas(fontData) || !CheckSignedDistanceFields(fontData) || !CheckMultiChannelDistanceFields(fontData))
 	{
 		return -1;
 	}